@@ -85,7 +85,7 @@ namespace gr
 		createGraphicsPipeline();
 
 		for (FrameContext& fc : mContexts) {
-			fc.renderSubmitter().setDefaultMaterial(mGraphicsPipeline, mPipLayout, mGlobalContext.rc().getEmptyDescriptorSet());
+			fc.renderSubmitter().setDefaultMaterial(mGraphicsPipelines, mPipLayout, mGlobalContext.rc().getEmptyDescriptorSet());
 		}
 
 		mGui.init(&mGlobalContext);
@@ -133,6 +133,10 @@ namespace gr
 
 			mGui.updatePreFrame(&mContexts[mCurrentFrame]);
 
+			mGlobalContext.getLoader().update(&mContexts[mCurrentFrame]);
+			mGlobalContext.getTextureStreamer().update(&mContexts[mCurrentFrame]);
+			mGlobalContext.getDefragmenter().update(&mContexts[mCurrentFrame]);
+
 			updateScene(&mContexts[mCurrentFrame]);
 
 			draw(mContexts[mCurrentFrame]);
@@ -346,7 +350,7 @@ namespace gr
 		createDescriptorSets();
 		createGraphicsPipeline();
 		for (FrameContext& fc : mContexts) {
-			fc.renderSubmitter().setDefaultMaterial(mGraphicsPipeline, mPipLayout, mGlobalContext.rc().getEmptyDescriptorSet());
+			fc.renderSubmitter().setDefaultMaterial(mGraphicsPipelines, mPipLayout, mGlobalContext.rc().getEmptyDescriptorSet());
 		}
 	}
 
@@ -370,7 +374,7 @@ namespace gr
 					 &inheritanceInfo);
 				 renderBuff.begin(beginInfo);
 
-				 frame->renderSubmitter().flushDraws(renderBuff);
+				 frame->renderSubmitter().flushDraws(frame, renderBuff);
 
 				 renderBuff.end();
 			 }
@@ -425,10 +429,10 @@ namespace gr
 		buff.executeCommands(1, &renderBuff);
 		/*
 		if (mGui.isWireframeRenderModeEnabled()) {
-			buff.bindPipeline(vk::PipelineBindPoint::eGraphics, mWireframePipeline);
+			buff.bindPipeline(vk::PipelineBindPoint::eGraphics, mWireframePipelines[0]);
 		}
 		else {
-			buff.bindPipeline(vk::PipelineBindPoint::eGraphics, mGraphicsPipeline);
+			buff.bindPipeline(vk::PipelineBindPoint::eGraphics, mGraphicsPipelines[0]);
 		}
 
 
@@ -585,15 +589,6 @@ namespace gr
 	{
 		vkg::GraphicsPipelineBuilder builder;
 		
-		// Set Vertex Input descriptions
-		{
-			vkg::VertexInputDescription vid;
-			Mesh::addToVertexInputDescription(0, &vid);
-
-			assert(vid.getBindingDescription().size() == 1);
-			builder.setVertexBindingDescriptions( vid.getBindingDescription() );
-			builder.setVertexAttirbuteDescriptions( vid.getAttributeDescriptions() );
-		}
 		builder.setFrontFace(vk::FrontFace::eCounterClockwise);
 		builder.setCulling(vk::CullModeFlagBits::eBack);
 		builder.setShaderStages(mShaderModules[0], mShaderModules[1]);
@@ -604,11 +599,27 @@ namespace gr
 		builder.setPipelineLayout(mPipLayout);
 		builder.setDepthState(true, true, vk::CompareOp::eLess);
 
-		mGraphicsPipeline = builder.createPipeline(mGlobalContext.rc().getDevice(), mRenderPass, 0);
+		mGraphicsPipelines.resize(mesh::NUM_VERTEX_FORMATS);
+		mWireframePipelines.resize(mesh::NUM_VERTEX_FORMATS);
+		for (uint32_t i = 0; i < mesh::NUM_VERTEX_FORMATS; ++i) {
+			// Set Vertex Input descriptions
+			{
+				vkg::VertexInputDescription vid;
+				Mesh::addToVertexInputDescription(0, &vid, static_cast<mesh::VertexFormat>(i));
+
+				assert(vid.getBindingDescription().size() == 1);
+				builder.setVertexBindingDescriptions( vid.getBindingDescription() );
+				builder.setVertexAttirbuteDescriptions( vid.getAttributeDescriptions() );
+			}
+
+			builder.setPolygonMode(vk::PolygonMode::eFill);
+
+			mGraphicsPipelines[i] = builder.createPipeline(mGlobalContext.rc().getDevice(), mRenderPass, 0);
 
-		builder.setPolygonMode(vk::PolygonMode::eLine);
+			builder.setPolygonMode(vk::PolygonMode::eLine);
 
-		mWireframePipeline = builder.createPipeline(mGlobalContext.rc().getDevice(), mRenderPass, 0);
+			mWireframePipelines[i] = builder.createPipeline(mGlobalContext.rc().getDevice(), mRenderPass, 0);
+		}
 	}
 
 	void Engine::createSyncObjects()
@@ -666,11 +677,15 @@ namespace gr
 		}
 
 
+		const vk::Extent2D extent(static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+		const vk::Format format = vk::Format::eR8G8B8A8Srgb;
+		// Without linear blits, the texture only has the first level
+		const bool blitMips = mGlobalContext.rc().isLinearBlitSupported(format);
 		mTexture = mGlobalContext.rc().createTexture2D(
-			{ static_cast<vk::DeviceSize>(width),
-				static_cast<vk::DeviceSize>(height)}, // extent
-			1, vk::SampleCountFlagBits::e1, // mip levels and samples
-			vk::Format::eR8G8B8A8Srgb,
+			extent, // extent
+			blitMips ? vkg::RenderContext::computeMipLevels(extent) : 1,
+			vk::SampleCountFlagBits::e1, // mip levels and samples
+			format,
 			vk::ImageAspectFlagBits::eColor
 		);
 
@@ -684,7 +699,7 @@ namespace gr
 			vk::AccessFlagBits::eShaderRead, // dst Access Mask
 			vk::ImageLayout::eShaderReadOnlyOptimal, // dst Image Layout
 			vk::PipelineStageFlagBits::eFragmentShader, // dstStage
-			true
+			true, blitMips
 		);
 
 		stbi_image_free(pix);
@@ -736,8 +751,14 @@ namespace gr
 		mGlobalContext.rc().safeDestroyImage(mColorImage);
 		mGlobalContext.rc().safeDestroyImage(mDepthImage);
 
-		mGlobalContext.rc().destroy(mGraphicsPipeline);
-		mGlobalContext.rc().destroy(mWireframePipeline);
+		for (vk::Pipeline pipeline : mGraphicsPipelines) {
+			mGlobalContext.rc().destroy(pipeline);
+		}
+		for (vk::Pipeline pipeline : mWireframePipelines) {
+			mGlobalContext.rc().destroy(pipeline);
+		}
+		mGraphicsPipelines.clear();
+		mWireframePipelines.clear();
 
 		mGlobalContext.rc().destroy(mRenderPass);
 	}
@@ -37,7 +37,8 @@ namespace gr
 
 		vk::PipelineLayout mPipLayout;
 		vk::ShaderModule mShaderModules[2];
-		vk::Pipeline mGraphicsPipeline, mWireframePipeline;
+		// One per mesh::VertexFormat
+		std::vector<vk::Pipeline> mGraphicsPipelines, mWireframePipelines;
 
 		uint32_t mCurrentFrame = 0;
 		vk::Semaphore mFrameAvailableTimelineSemaphore;
@@ -66,6 +66,7 @@ void gr::FrameContext::recreateCommandPools()
 
 void gr::FrameContext::destroy()
 {
+	mRenderSubmitter.destroy(this);
 	resetFrameResources();
 	destroyCommandPools();
 }
@@ -3,6 +3,9 @@
 #include "../graphics/RenderContext.h"
 #include "../graphics/Window.h"
 #include "../meshes/ResourceDictionary.h"
+#include "../meshes/ResourceLoader.h"
+#include "../meshes/TextureStreamer.h"
+#include "../meshes/BufferDefragmenter.h"
 
 #include <filesystem>
 
@@ -22,6 +25,14 @@ public:
 	const vkg::Window& getWindow() const { return mWindow; }
 	const ResourceDictionary& getDict() const { return mDict; }
 	ResourceDictionary& getDict() { return mDict; }
+	ResourceLoader& getLoader() { return mLoader; }
+	const ResourceLoader& getLoader() const { return mLoader; }
+	TextureStreamer& getTextureStreamer() { return mTextureStreamer; }
+	const TextureStreamer& getTextureStreamer() const { return mTextureStreamer; }
+	BufferDefragmenter& getDefragmenter() { return mDefragmenter; }
+	const BufferDefragmenter& getDefragmenter() const { return mDefragmenter; }
+	addon::AddonStorage& getAddonStorage() { return mAddonStorage; }
+	const addon::AddonStorage& getAddonStorage() const { return mAddonStorage; }
 
 	double_t getTime() const { return mGlobalTime; }
 	void setTime(double_t newTime);
@@ -45,7 +56,12 @@ private:
 
 	vkg::RenderContext mRenderContext;
 	vkg::Window mWindow;
+	// needs to outlive the GameObjects of the dictionary
+	addon::AddonStorage mAddonStorage;
 	ResourceDictionary mDict;
+	ResourceLoader mLoader;
+	TextureStreamer mTextureStreamer;
+	BufferDefragmenter mDefragmenter;
 
 	ResId mBoundScene;
 
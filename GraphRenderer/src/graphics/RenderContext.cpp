@@ -4,6 +4,7 @@
 #include "DebugVk.h"
 
 #include <glm/glm.hpp>
+#include <cstring>
 
 namespace gr
 {
@@ -24,7 +25,7 @@ namespace vkg
 		createLogicalDevice(surfaceToRequestSwapChain);
 		createQueues();
 
-		mMemManager = MemoryManager(mInstance, mPhysicalDevice, mDevice);
+		mMemManager = MemoryManager(mInstance, mPhysicalDevice, mDevice, mMemoryBudgetEnabled);
 
 		mGraphicsBufferTransferer.setUpTransferBlocks(this);
 
@@ -51,9 +52,14 @@ namespace vkg
 		vk::Image image;
 		VmaAllocation alloc;
 
+		vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eTransferDst |
+			vk::ImageUsageFlagBits::eSampled;
+		// The mips are blitted from the previous level
+		if (mipLevels > 1) {
+			usage |= vk::ImageUsageFlagBits::eTransferSrc;
+		}
 		createImage2D(extent, mipLevels, numSamples, format,
-			vk::ImageUsageFlagBits::eTransferDst |
-			vk::ImageUsageFlagBits::eSampled,
+			usage, MemoryCategory::eTextures,
 			&image, &alloc);
 
 		vk::ImageViewCreateInfo ivCreateInfo(
@@ -75,6 +81,8 @@ namespace vkg
 
 		Image2D r_image;
 		r_image.setExtent(extent);
+		r_image.setFormat(format);
+		r_image.setMipLevels(mipLevels);
 		r_image.setImage(image);
 		r_image.setAllocation(alloc);
 		r_image.setImageView(imageView);
@@ -82,6 +90,26 @@ namespace vkg
 		return r_image;
 	}
 
+	uint32_t RenderContext::computeMipLevels(const vk::Extent2D& extent)
+	{
+		uint32_t levels = 1;
+		uint32_t size = std::max(extent.width, extent.height);
+		while (size > 1) {
+			size >>= 1;
+			levels += 1;
+		}
+		return levels;
+	}
+
+	bool RenderContext::isLinearBlitSupported(vk::Format format) const
+	{
+		const vk::FormatFeatureFlags required = vk::FormatFeatureFlagBits::eBlitSrc |
+			vk::FormatFeatureFlagBits::eBlitDst |
+			vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+		const vk::FormatProperties props = mPhysicalDevice.getFormatProperties(format);
+		return (props.optimalTilingFeatures & required) == required;
+	}
+
 	Image2D RenderContext::createImage2DColorAttachment(
 		const vk::Extent2D& extent,
 		uint32_t mipLevels, 
@@ -95,6 +123,7 @@ namespace vkg
 		createImage2D(extent, mipLevels, numSamples, format,
 			vk::ImageUsageFlagBits::eColorAttachment |
 			vk::ImageUsageFlagBits::eTransientAttachment,
+			MemoryCategory::eRenderTargets,
 			&image, &alloc);
 
 		vk::ImageViewCreateInfo ivCreateInfo(
@@ -117,6 +146,7 @@ namespace vkg
 
 		Image2D r_image;
 		r_image.setExtent(extent);
+		r_image.setFormat(format);
 		r_image.setImage(image);
 		r_image.setAllocation(alloc);
 		r_image.setImageView(imageView);
@@ -132,6 +162,7 @@ namespace vkg
 		VmaAllocation alloc;
 		createImage2D(extent, 1, numSamples, getDepthFormat(),
 			vk::ImageUsageFlagBits::eDepthStencilAttachment,
+			MemoryCategory::eRenderTargets,
 			&image, &alloc);
 
 		vk::ImageViewCreateInfo ivCreateInfo(
@@ -154,6 +185,7 @@ namespace vkg
 
 		Image2D r_image;
 		r_image.setExtent(extent);
+		r_image.setFormat(getDepthFormat());
 		r_image.setImage(image);
 		r_image.setAllocation(alloc);
 		r_image.setImageView(imageView);
@@ -192,13 +224,27 @@ namespace vkg
 			vk::SamplerMipmapMode::eLinear,				// mip map
 			addressMode, addressMode, addressMode,		// address mode uvw
 			0,											// mip bias
-			true, 16									// anisotropy
+			mAnisotropySamplerEnabled, 16				// anisotropy
 			// ... compare ops
 		);
+		// all the levels of the texture
+		createInfo.setMinLod(0.0f)
+			.setMaxLod(VK_LOD_CLAMP_NONE);
 
 		return mDevice.createSampler(createInfo);
 	}
 
+	vk::MemoryPropertyFlags RenderContext::getDeviceBufferPreferredProperties() const
+	{
+		// Written directly by the loaders, without staging
+		if (isDeviceMemoryHostVisible()) {
+			return vk::MemoryPropertyFlagBits::eDeviceLocal |
+				vk::MemoryPropertyFlagBits::eHostVisible |
+				vk::MemoryPropertyFlagBits::eHostCoherent;
+		}
+		return vk::MemoryPropertyFlagBits::eDeviceLocal;
+	}
+
 	Buffer RenderContext::createIndexBuffer(size_t sizeInBytes) const
 	{
 		vk::BufferCreateInfo createInfo(
@@ -215,12 +261,13 @@ namespace vkg
 
 		mMemManager.createBufferAllocation(createInfo,
 			vk::MemoryPropertyFlagBits::eDeviceLocal,
-			vk::MemoryPropertyFlagBits::eDeviceLocal,
+			getDeviceBufferPreferredProperties(),
+			MemoryCategory::eMeshes,
 			&buffer,
 			&alloc);
 
 
-		return Buffer(buffer, alloc, sizeInBytes);
+		return Buffer(buffer, alloc, sizeInBytes, createInfo.usage);
 	}
 
 	Buffer RenderContext::createVertexBuffer(size_t sizeInBytes) const
@@ -239,12 +286,13 @@ namespace vkg
 
 		mMemManager.createBufferAllocation(createInfo,
 			vk::MemoryPropertyFlagBits::eDeviceLocal,
-			vk::MemoryPropertyFlagBits::eDeviceLocal,
+			getDeviceBufferPreferredProperties(),
+			MemoryCategory::eMeshes,
 			&buffer,
 			&alloc);
 
 
-		return Buffer(buffer, alloc, sizeInBytes);
+		return Buffer(buffer, alloc, sizeInBytes, createInfo.usage);
 	}
 
 	Buffer RenderContext::createStagingBuffer(size_t sizeInBytes) const
@@ -263,11 +311,12 @@ namespace vkg
 		mMemManager.createBufferAllocation(createInfo,
 			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
 			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+			MemoryCategory::eStaging,
 			&buffer,
 			&alloc);
 
 
-		return Buffer(buffer, alloc, sizeInBytes);
+		return Buffer(buffer, alloc, sizeInBytes, createInfo.usage);
 	}
 
 	Buffer RenderContext::createUniformBuffer(size_t sizeInBytes) const
@@ -288,11 +337,12 @@ namespace vkg
 		mMemManager.createBufferAllocation(createInfo,
 			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
 			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+			MemoryCategory::eUniforms,
 			&buffer,
 			&alloc);
 
 
-		return Buffer(buffer, alloc, sizeInBytes);
+		return Buffer(buffer, alloc, sizeInBytes, createInfo.usage);
 	}
 
 	Buffer RenderContext::createCpuVisibleBuffer(
@@ -312,11 +362,12 @@ namespace vkg
 		mMemManager.createBufferAllocation(createInfo,
 			vk::MemoryPropertyFlagBits::eHostVisible,
 			vk::MemoryPropertyFlagBits::eHostVisible,
+			MemoryCategory::eOther,
 			&buffer,
 			&alloc);
 
 
-		return Buffer(buffer, alloc, sizeInBytes);
+		return Buffer(buffer, alloc, sizeInBytes, createInfo.usage);
 	}
 
 
@@ -382,6 +433,19 @@ namespace vkg
 
 	}
 
+	bool RenderContext::isMappable(const Allocatable& allocatable) const
+	{
+		return mMemManager.isMemoryMappable(allocatable.getAllocation());
+	}
+
+	vk::DeviceSize RenderContext::getAllocationSize(const Allocatable& allocatable) const
+	{
+		vk::DeviceMemory memory;
+		vk::DeviceSize offset, size;
+		mMemManager.getAllocationInfo(allocatable.getAllocation(), &memory, &offset, &size);
+		return size;
+	}
+
 	void RenderContext::mapAllocatable(const Allocatable& allocatable, void** ptr) const
 	{
 		assert(ptr != nullptr);
@@ -397,7 +461,7 @@ namespace vkg
 		mMemManager.unmapMemory(allocatable.getAllocation());
 	}
 
-	void RenderContext::flushAllocations(const VmaAllocation* allocations, uint32_t num)
+	void RenderContext::flushAllocations(const VmaAllocation* allocations, uint32_t num) const
 	{
 		mMemManager.flushAllocations(allocations, num);
 	}
@@ -453,6 +517,64 @@ namespace vkg
 		getDevice().waitIdle();
 	}
 
+	VmaDefragmentationStats RenderContext::defragmentBuffers(Buffer* const* buffers, uint32_t numBuffers,
+		vk::DeviceSize maxBytesToMove, uint32_t maxBuffersToMove)
+	{
+		VmaDefragmentationStats stats = {};
+		if (numBuffers == 0) {
+			return stats;
+		}
+
+		std::vector<VmaAllocation> allocations(numBuffers);
+		for (uint32_t i = 0; i < numBuffers; ++i) {
+			allocations[i] = buffers[i]->getAllocation();
+		}
+		std::vector<VkBool32> changed(numBuffers, VK_FALSE);
+
+		// The frames in flight may be reading the buffers
+		waitIdle();
+
+		FreeCommandPool::FreeCommandBuffer cmd = mGraphicsCommandPool.newCommandBuffer();
+		cmd.buffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+		VmaDefragmentationContext context = mMemManager.beginDefragmentation(
+			allocations.data(), numBuffers,
+			maxBytesToMove, maxBuffersToMove,
+			cmd.buffer, changed.data(), &stats);
+		cmd.buffer.end();
+
+		// The copies have to finish before the defragmentation ends
+		vk::Fence fence = createFence(false);
+		vk::SubmitInfo submitInfo(0, nullptr, nullptr, 1, &cmd.buffer);
+		mGraphicsQueue.submit(submitInfo, fence);
+		vk::Result res = getDevice().waitForFences(fence, VK_TRUE, UINT64_MAX);
+		assert(res == vk::Result::eSuccess);
+		destroy(fence);
+		mGraphicsCommandPool.freeCommandBuffer(cmd);
+
+		mMemManager.endDefragmentation(context);
+
+		for (uint32_t i = 0; i < numBuffers; ++i) {
+			if (!changed[i]) {
+				continue;
+			}
+			// The old buffer is bound to the previous memory of the allocation
+			getDevice().destroyBuffer(buffers[i]->getVkBuffer());
+
+			vk::BufferCreateInfo createInfo(
+				vk::BufferCreateFlagBits(),	// flags
+				buffers[i]->getSize(),		// size of buffer
+				buffers[i]->getUsage(),
+				vk::SharingMode::eExclusive,
+				0, nullptr
+			);
+			vk::Buffer buffer = getDevice().createBuffer(createInfo);
+			mMemManager.bindBufferMemory(buffers[i]->getAllocation(), buffer);
+			buffers[i]->setVkBuffer(buffer);
+		}
+
+		return stats;
+	}
+
 	void RenderContext::destroy(const vk::RenderPass renderPass) const
 	{
 		getDevice().destroyRenderPass(renderPass);
@@ -628,6 +750,10 @@ namespace vkg
 		vk::PhysicalDeviceFeatures features;
 		features.samplerAnisotropy = mAnisotropySamplerEnabled;
 		features.fillModeNonSolid = true;
+		features.multiDrawIndirect = mPhysicalDevice.getFeatures().multiDrawIndirect;
+		mMultiDrawIndirectEnabled = features.multiDrawIndirect;
+		features.textureCompressionBC = mPhysicalDevice.getFeatures().textureCompressionBC;
+		mTextureCompressionBCEnabled = features.textureCompressionBC;
 		vk::PhysicalDeviceVulkan12Features features12;
 		features12.timelineSemaphore = true;
 
@@ -635,6 +761,15 @@ namespace vkg
 		if (mPresentQueueRequested) {
 			deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 		}
+		// Without it, the budget of the heaps is estimated from their size
+		mMemoryBudgetEnabled = false;
+		for (const vk::ExtensionProperties& ext : mPhysicalDevice.enumerateDeviceExtensionProperties()) {
+			if (std::strcmp(ext.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) {
+				deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+				mMemoryBudgetEnabled = true;
+				break;
+			}
+		}
 
 		vk::DeviceCreateInfo createInfo;
 		createInfo.queueCreateInfoCount = static_cast<uint32_t>(queuesCreateInfos.size());
@@ -804,6 +939,7 @@ namespace vkg
 		vk::SampleCountFlagBits numSamples,
 		vk::Format format,
 		vk::ImageUsageFlags usage,
+		MemoryCategory category,
 		vk::Image* outImage,
 		VmaAllocation* outAlloc) const
 	{
@@ -825,6 +961,7 @@ namespace vkg
 		mMemManager.createImageAllocation(createInfo,
 			vk::MemoryPropertyFlagBits::eDeviceLocal,
 			vk::MemoryPropertyFlagBits::eDeviceLocal,
+			category,
 			outImage,
 			outAlloc);
 	}
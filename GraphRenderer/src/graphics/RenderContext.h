@@ -42,12 +42,14 @@ namespace vkg
 
 
 		const vk::PhysicalDevice &getPhysicalDevice() const { return mPhysicalDevice; }
+		const vk::PhysicalDeviceProperties& getPhysicalDeviceProperties() const { return mPhysicalProperties; }
 		const vk::Device &getDevice() const { return mDevice; }
 		const vk::Instance &getInstance() const { return mInstance.getInstance(); }
 		explicit operator vk::Instance() const { return mInstance.getInstance(); }
 		explicit operator vk::PhysicalDevice() const { return mPhysicalDevice; }
 		explicit operator vk::Device() const { return mDevice; }
 
+		// The textures with more than one mip level can be blitted from
 		Image2D createTexture2D(const vk::Extent2D& extent,
 			uint32_t mipLevels,
 			vk::SampleCountFlagBits numSamples,
@@ -65,9 +67,17 @@ namespace vkg
 
 		static vk::Format getDepthFormat() { return vk::Format::eD32Sfloat; }
 
+		// Levels of the full mip chain, down to 1x1
+		static uint32_t computeMipLevels(const vk::Extent2D& extent);
+		// If the mips can be generated by blitting with a linear filter
+		bool isLinearBlitSupported(vk::Format format) const;
 
+
+		// Samples all the mip levels
 		vk::Sampler createSampler(vk::SamplerAddressMode addressMode) const;
 
+		// If isDeviceMemoryHostVisible, the vertex and index buffers are
+		// allocated in mappable device memory when possible
 		Buffer createVertexBuffer(size_t sizeInBytes) const;
 		Buffer createIndexBuffer(size_t sizeInBytes) const;
 		Buffer createStagingBuffer(size_t sizeInBytes) const;
@@ -79,9 +89,15 @@ namespace vkg
 		// Transfer sequentaly multiple pointers to the same allocatable resource
 		void transferDataToGPU(const Allocatable& allocatable, uint32_t numDatas, const void** datas, size_t* numBytes) const;
 
+		bool isMappable(const Allocatable& allocatable) const;
+		// Bytes of device memory of the allocation, including the alignment padding
+		vk::DeviceSize getAllocationSize(const Allocatable& allocatable) const;
+		bool isDeviceMemoryHostVisible() const { return mMemManager.isDeviceMemoryHostVisible(); }
+		// Budget of the heaps and usage of the categories
+		const MemoryManager& getMemoryManager() const { return mMemManager; }
 		void mapAllocatable(const Allocatable& allocatable, void** ptr) const;
 		void unmapAllocatable(const Allocatable& allocatable) const;
-		void flushAllocations(const VmaAllocation* allocations, uint32_t num);
+		void flushAllocations(const VmaAllocation* allocations, uint32_t num) const;
 
 		vk::Semaphore createSemaphore() const;
 		vk::Semaphore createTimelineSemaphore(uint64_t initialValue = 0) const;
@@ -94,6 +110,13 @@ namespace vkg
 
 		void waitIdle() const;
 
+		// Moves the memory of some of the buffers to compact the device memory, and
+		// replaces the moved ones with new buffers. Waits for the device to be idle,
+		// nothing can use the buffers while they are moved. The old buffers are
+		// destroyed, any descriptor that references them has to be written again
+		VmaDefragmentationStats defragmentBuffers(Buffer* const* buffers, uint32_t numBuffers,
+			vk::DeviceSize maxBytesToMove, uint32_t maxBuffersToMove);
+
 		struct FrameCommandPools
 		{
 			ResetCommandPool graphicsPool;
@@ -123,6 +146,10 @@ namespace vkg
 		}
 
 		bool isPresentQueueCreated() const { return mPresentQueueRequested; }
+		// Enabled if supported. Without it, indirect draws are issued one by one
+		bool isMultiDrawIndirectEnabled() const { return mMultiDrawIndirectEnabled; }
+		// Enabled if supported. Without it, the textures are not compressed
+		bool isTextureCompressionBCEnabled() const { return mTextureCompressionBCEnabled; }
 
 		size_t padUniformBuffer(size_t size) const;
 		vk::SampleCountFlagBits getMsaaSampleCount() const { return mMsaaSamples; }
@@ -205,6 +232,9 @@ namespace vkg
 		uint32_t mGraphicsFamilyIdx, mComputeFamilyIdx, mTransferFamilyIdx, mPresentFamilyIdx;
 		
 		bool mAnisotropySamplerEnabled, mPresentQueueRequested;
+		bool mMultiDrawIndirectEnabled = false;
+		bool mTextureCompressionBCEnabled = false;
+		bool mMemoryBudgetEnabled = false;
 		vk::SampleCountFlagBits mMsaaSamples = vk::SampleCountFlagBits::e1;
 		vk::PhysicalDeviceProperties mPhysicalProperties;
 
@@ -248,12 +278,16 @@ namespace vkg
 
 		vk::SampleCountFlagBits getMaxUsableSampleCount() const;
 
+		// Of the vertex and index buffers
+		vk::MemoryPropertyFlags getDeviceBufferPreferredProperties() const;
+
 		void createImage2D(
 			const vk::Extent2D& extent,
 			uint32_t mipLevels,
 			vk::SampleCountFlagBits numSamples,
 			vk::Format format,
 			vk::ImageUsageFlags usage,
+			MemoryCategory category,
 			vk::Image* outImage,
 			VmaAllocation* outAlloc) const;
 
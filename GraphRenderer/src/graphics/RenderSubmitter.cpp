@@ -1,5 +1,10 @@
 #include "RenderSubmitter.h"
 
+#include "../utils/grjob.h"
+#include "../control/FrameContext.h"
+
+#include <cstring>
+
 namespace gr
 {
 namespace vkg
@@ -16,28 +21,59 @@ bool RenderSubmitter::MaterialKey::operator==(const MaterialKey& o) const
 
 void RenderSubmitter::pushPredefinedDraw(const DrawData& drawData)
 {
-    assert(mDefaultMaterial.pipeline);
+    assert(drawData.vertexLayout < mDefaultMaterials.size());
 
-    mMaterialRenderList.at(mDefaultMaterial).renderList.push_back(drawData);
+    mMaterialRenderList.at(mDefaultMaterials[drawData.vertexLayout]).renderLists[grjob::getThreadId()].push_back(drawData);
+}
+
+void RenderSubmitter::pushIndirectDraw(const DrawData& drawData,
+    const vk::DrawIndexedIndirectCommand* commands, uint32_t numCommands)
+{
+    assert(numCommands > 0);
+    const uint32_t threadId = grjob::getThreadId();
+    std::vector<vk::DrawIndexedIndirectCommand>& threadCommands = mIndirectCommands[threadId];
+
+    DrawData indirectDrawData = drawData;
+    indirectDrawData.firstIndirectCommand = static_cast<uint32_t>(threadCommands.size());
+    indirectDrawData.numIndirectCommands = numCommands;
+    threadCommands.insert(threadCommands.end(), commands, commands + numCommands);
+
+    pushPredefinedDraw(indirectDrawData);
 }
 
 void RenderSubmitter::setDefaultMaterial(
-    const vk::Pipeline pipeline,
+    const std::vector<vk::Pipeline>& pipelines,
     const vk::PipelineLayout pipLayout,
     const vk::DescriptorSet descriptorSet)
 {
-    MaterialKey key{ pipeline, descriptorSet };
-    Material mat{ pipLayout };
-
-    if (mMaterialRenderList.count(mDefaultMaterial)) {
-        mMaterialRenderList.erase(mDefaultMaterial);
+    for (const MaterialKey& key : mDefaultMaterials) {
+        mMaterialRenderList.erase(key);
     }
+    mDefaultMaterials.clear();
+    // created with the lists of the materials, before any draw is pushed
+    mIndirectCommands.resize(grjob::getNumThreads());
+
+    for (const vk::Pipeline pipeline : pipelines) {
+        assert(pipeline);
+        MaterialKey key{ pipeline, descriptorSet };
+        Material mat{ pipLayout };
+        mat.renderLists.resize(grjob::getNumThreads());
+
+        mDefaultMaterials.push_back(key);
+        mMaterialRenderList.insert({ key, mat });
+    }
+}
 
-    mDefaultMaterial = key;
-
-
-
-    mMaterialRenderList.insert({ key, mat });
+void RenderSubmitter::destroy(FrameContext* fc)
+{
+    if (mIndirectBufferPtr) {
+        fc->rc().unmapAllocatable(mIndirectBuffer);
+        mIndirectBufferPtr = nullptr;
+    }
+    if (mIndirectBuffer) {
+        fc->scheduleToDestroy(mIndirectBuffer);
+        mIndirectBuffer = nullptr;
+    }
 }
 
 void RenderSubmitter::setSceneDescriptorSet(const vk::DescriptorSet descriptor)
@@ -45,7 +81,45 @@ void RenderSubmitter::setSceneDescriptorSet(const vk::DescriptorSet descriptor)
     mSceneDescriptorSet = descriptor;
 }
 
-void RenderSubmitter::flushDraws(vk::CommandBuffer cmd)
+std::vector<uint32_t> RenderSubmitter::uploadIndirectCommands(FrameContext* fc)
+{
+    std::vector<uint32_t> firstCommands(mIndirectCommands.size());
+    uint32_t numCommands = 0;
+    for (size_t i = 0; i < mIndirectCommands.size(); ++i) {
+        firstCommands[i] = numCommands;
+        numCommands += static_cast<uint32_t>(mIndirectCommands[i].size());
+    }
+    if (numCommands == 0) {
+        return firstCommands;
+    }
+
+    const vk::DeviceSize size = numCommands * sizeof(vk::DrawIndexedIndirectCommand);
+    if (!mIndirectBuffer || mIndirectBuffer.getSize() < size) {
+        if (mIndirectBufferPtr) {
+            fc->rc().unmapAllocatable(mIndirectBuffer);
+            mIndirectBufferPtr = nullptr;
+        }
+        fc->scheduleToDestroy(mIndirectBuffer);
+        mIndirectBuffer = fc->rc().createCpuVisibleBuffer(size,
+            vk::BufferUsageFlagBits::eIndirectBuffer);
+        fc->rc().mapAllocatable(mIndirectBuffer,
+            reinterpret_cast<void**>(&mIndirectBufferPtr));
+    }
+
+    for (size_t i = 0; i < mIndirectCommands.size(); ++i) {
+        std::memcpy(mIndirectBufferPtr + firstCommands[i] * sizeof(vk::DrawIndexedIndirectCommand),
+            mIndirectCommands[i].data(),
+            mIndirectCommands[i].size() * sizeof(vk::DrawIndexedIndirectCommand));
+        mIndirectCommands[i].clear();
+    }
+
+    VmaAllocation alloc = mIndirectBuffer.getAllocation();
+    fc->rc().flushAllocations(&alloc, 1);
+
+    return firstCommands;
+}
+
+void RenderSubmitter::flushDraws(FrameContext* fc, vk::CommandBuffer cmd)
 {
     assert(cmd);
 
@@ -53,6 +127,10 @@ void RenderSubmitter::flushDraws(vk::CommandBuffer cmd)
         return;
     }
 
+    const std::vector<uint32_t> firstCommands = uploadIndirectCommands(fc);
+    const bool multiDrawIndirect = fc->rc().isMultiDrawIndirectEnabled();
+    constexpr uint32_t commandStride = sizeof(vk::DrawIndexedIndirectCommand);
+
     bool firstBindDescriptors = true;
 
     for (auto& material : mMaterialRenderList) {
@@ -81,28 +159,47 @@ void RenderSubmitter::flushDraws(vk::CommandBuffer cmd)
                 );
         }
 
-        for (const DrawData& dd : material.second.renderList) {
-            if (dd.objectDescriptorSet) {
-                // bind to 2
-                cmd.bindDescriptorSets(
-                    vk::PipelineBindPoint::eGraphics,   // bind point
-                    material.second.pipelineLayout,     // pipeline layout
-                    2, 1,                               // set and number of sets
-                    &dd.objectDescriptorSet,// desc set
-                    0, nullptr                          // no dynamic offsets
-                );
+        for (size_t thread = 0; thread < material.second.renderLists.size(); ++thread) {
+            RenderList& renderList = material.second.renderLists[thread];
+            for (const DrawData& dd : renderList) {
+                if (dd.objectDescriptorSet) {
+                    // bind to 2
+                    cmd.bindDescriptorSets(
+                        vk::PipelineBindPoint::eGraphics,   // bind point
+                        material.second.pipelineLayout,     // pipeline layout
+                        2, 1,                               // set and number of sets
+                        &dd.objectDescriptorSet,// desc set
+                        0, nullptr                          // no dynamic offsets
+                    );
+                }
+
+                // bind to 0
+                vk::DeviceSize offsets = 0;
+                cmd.bindVertexBuffers(0, 1, &dd.vertexBuffer, &offsets);
+                cmd.bindIndexBuffer(dd.indexBuffer, 0, dd.indexType);
+
+                if (dd.numIndirectCommands == 0) {
+                    cmd.drawIndexed(dd.numIndices, 1, dd.firstIndex, dd.vertexOffset, 0);
+                    continue;
+                }
+
+                const vk::DeviceSize offset = static_cast<vk::DeviceSize>(
+                    firstCommands[thread] + dd.firstIndirectCommand) * commandStride;
+                if (multiDrawIndirect) {
+                    cmd.drawIndexedIndirect(mIndirectBuffer.getVkBuffer(), offset,
+                        dd.numIndirectCommands, commandStride);
+                }
+                else {
+                    for (uint32_t i = 0; i < dd.numIndirectCommands; ++i) {
+                        cmd.drawIndexedIndirect(mIndirectBuffer.getVkBuffer(),
+                            offset + i * commandStride, 1, commandStride);
+                    }
+                }
             }
 
-            // bind to 0
-            vk::DeviceSize offsets = 0;
-            cmd.bindVertexBuffers(0, 1, &dd.vertexBuffer, &offsets);
-            cmd.bindIndexBuffer(dd.indexBuffer, 0, vk::IndexType::eUint32);
-
-            cmd.drawIndexed(dd.numIndices, 1, 0, 0, 0);
+            renderList.clear();
         }
 
-        material.second.renderList.clear();
-
     }
 
 }
@@ -25,13 +25,28 @@ public:
 		vk::Buffer vertexBuffer;
 		vk::Buffer indexBuffer;
 		uint32_t numIndices;
+		uint32_t firstIndex = 0;
+		int32_t vertexOffset = 0;
+		vk::IndexType indexType = vk::IndexType::eUint32;
 		vk::DescriptorSet objectDescriptorSet;
+		// Selects the pipeline of the default material
+		uint32_t vertexLayout = 0;
+		// Set by pushIndirectDraw, the draw uses these commands instead of the index range
+		uint32_t firstIndirectCommand = 0;
+		uint32_t numIndirectCommands = 0;
 	};
 
+	// Thread safe, each thread of the job system has its own list
 	void pushPredefinedDraw(const DrawData& drawData);
 
+	// Thread safe. Draws the index buffer of drawData with the commands, that are
+	// copied to the indirect buffer of the frame on flushDraws
+	void pushIndirectDraw(const DrawData& drawData,
+		const vk::DrawIndexedIndirectCommand* commands, uint32_t numCommands);
+
+	// One pipeline per vertex layout, indexed by DrawData::vertexLayout
 	void setDefaultMaterial(
-		const vk::Pipeline pipeline,
+		const std::vector<vk::Pipeline>& pipelines,
 		const vk::PipelineLayout pipLayout,
 		const vk::DescriptorSet descriptorSet
 	);
@@ -40,7 +55,9 @@ public:
 		const vk::DescriptorSet descriptor
 	);
 
-	void flushDraws(vk::CommandBuffer cmd);
+	void flushDraws(FrameContext* fc, vk::CommandBuffer cmd);
+
+	void destroy(FrameContext* fc);
 
 private:
 
@@ -61,7 +78,8 @@ private:
 	};
 	struct Material {
 		vk::PipelineLayout pipelineLayout;
-		RenderList renderList;
+		// One list per thread of the job system
+		std::vector<RenderList> renderLists;
 	};
 
 	typedef std::unordered_map<MaterialKey, Material, HashMaterial> MaterialRenderList;
@@ -69,9 +87,19 @@ private:
 
 	MaterialRenderList mMaterialRenderList;
 
-	MaterialKey mDefaultMaterial;
+	std::vector<MaterialKey> mDefaultMaterials;
 
 	vk::DescriptorSet mSceneDescriptorSet;
+
+	// One list per thread of the job system
+	std::vector<std::vector<vk::DrawIndexedIndirectCommand>> mIndirectCommands;
+	// Only used by this frame, it grows to the commands of the largest frame
+	Buffer mIndirectBuffer;
+	uint8_t* mIndirectBufferPtr = nullptr;
+
+	// Copies the commands of all the threads to mIndirectBuffer, and returns
+	// the position of the first command of each thread
+	std::vector<uint32_t> uploadIndirectCommands(FrameContext* fc);
 };
 
 }
@@ -2,13 +2,26 @@
 
 #include "../RenderContext.h"
 
+#include <iterator>
+#include <algorithm>
+
 namespace gr
 {
 namespace vkg
 {
-BufferTransferer::BufferTransferer(const vk::DeviceSize minSize) :
-	mMinSize(minSize) 
+BufferTransferer::BufferTransferer(
+	const vk::DeviceSize stagingSize,
+	const vk::DeviceSize frameBudget) :
+	mStagingSize(stagingSize)
+{
+	setFrameBudget(frameBudget);
+}
+
+void BufferTransferer::setFrameBudget(vk::DeviceSize bytes)
 {
+	// A slice must always fit in the ring once the previous ones are freed
+	mFrameBudget.store(std::max<vk::DeviceSize>(1, std::min(bytes, mStagingSize / 2)),
+		std::memory_order_relaxed);
 }
 
 void BufferTransferer::setUpTransferBlocks(RenderContext* rc)
@@ -16,6 +29,14 @@ void BufferTransferer::setUpTransferBlocks(RenderContext* rc)
 	mGraphicsBlock = rc->getCommandFlusher()->createNewBlock(CommandFlusher::Type::eGRAPHICS);
 	mTransferBlock = rc->getCommandFlusher()->createNewBlock(CommandFlusher::Type::eTRANSFER);
 	mCurrentSpace = findOrCreateTransferSpace(*rc);
+
+	// Multiple of 4 and of the texel size, as required by copyBufferToImage
+	mStagingAlignment = std::max<vk::DeviceSize>(mStagingAlignment,
+		rc->getPhysicalDeviceProperties().limits.optimalBufferCopyOffsetAlignment);
+
+	mStagingBuffer = rc->createStagingBuffer(mStagingSize);
+	rc->mapAllocatable(mStagingBuffer, reinterpret_cast<void**>(&mStagingPtr));
+	mStagingRing.setCapacity(mStagingSize);
 }
 
 void BufferTransferer::updateAndFlushTransfers(
@@ -26,6 +47,8 @@ void BufferTransferer::updateAndFlushTransfers(
 	assert((outSemaphore == nullptr) == (outValue == nullptr));
 
 	TransferSpace& ts = mTransferSpaces[mCurrentSpace];
+	takeQueuedTransfers(&ts);
+	queueStreamSlices(&ts);
 
 	if (!ts.bufferTransferOps.empty() ||
 		!ts.imageTransfersFragmentOps.empty()) {
@@ -36,92 +59,94 @@ void BufferTransferer::updateAndFlushTransfers(
 		transferCmd.begin({ vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
 
 		// buffer transferences
-		vk::BufferCopy cpyInfo;
-		for (const TransferOp& op : ts.bufferTransferOps) {
-			cpyInfo.setSrcOffset(op.srcOffset)
-				.setDstOffset(op.dstOffset)
-				.setSize(op.bytes);
-
-			transferCmd.copyBuffer(mStagingBuffers[op.stageBuffIdx].buffer.getVkBuffer(),
-				op.dstBuffer, 1, &cpyInfo);
-		}
+		recordBufferCopies(transferCmd, ts);
 
 		// image transferences
-		// First transition image to dstOptimal
-		std::vector<vk::ImageMemoryBarrier> barriers(
-			ts.imageTransfersFragmentOps.size(),
-			vk::ImageMemoryBarrier(
+		// First transition image to dstOptimal, only before the first slice
+		std::vector<vk::ImageMemoryBarrier>& barriers = mBarriers;
+		barriers.clear();
+		const uint32_t numImgTransfers = static_cast<uint32_t>(ts.imageTransfersFragmentOps.size());
+		for (uint32_t i = 0; i < numImgTransfers; ++i) {		
+			const ImageTransferOp& op = ts.imageTransfersFragmentOps[i];
+			if (!op.firstSlice) {
+				continue;
+			}
+			barriers.push_back(vk::ImageMemoryBarrier(
 				vk::AccessFlags{}, // src AccessMask
 				vk::AccessFlagBits::eTransferWrite, // dst AccessMask
 				vk::ImageLayout::eUndefined,// old layout
 				vk::ImageLayout::eTransferDstOptimal,// new layout
 				VK_QUEUE_FAMILY_IGNORED,	// src queue family
 				VK_QUEUE_FAMILY_IGNORED,	// dst queue family
-				nullptr,					// image
-				{}							// range
-			));
-		const uint32_t numImgTransfers = static_cast<uint32_t>(ts.imageTransfersFragmentOps.size());
-		for (uint32_t i = 0; i < numImgTransfers; ++i) {		
-			const ImageTransferOp& op = ts.imageTransfersFragmentOps[i];
-			barriers[i].setImage(op.dstImage)
-				.setSubresourceRange(vk::ImageSubresourceRange(
+				op.dstImage,				// image
+				vk::ImageSubresourceRange(
 					op.layersInfo.aspectMask,
 					op.layersInfo.mipLevel,
-					VK_REMAINING_MIP_LEVELS,
+					1,
 					op.layersInfo.baseArrayLayer,
 					op.layersInfo.layerCount
-				));
+				)
+			));
 		}
 
-		transferCmd.pipelineBarrier(
-			vk::PipelineStageFlagBits::eTopOfPipe, // src stage mask
-			vk::PipelineStageFlagBits::eTransfer, // dst stage mask
-			vk::DependencyFlagBits{},
-			0, nullptr, 0, nullptr, // buffer and memory barrier
-			static_cast<uint32_t>(barriers.size()), barriers.data() // image memory barrier
-		);
-		// copy image data
-		for (uint32_t i = 0; i < numImgTransfers; ++i) {
-			const ImageTransferOp& op = ts.imageTransfersFragmentOps[i];
-
-			vk::BufferImageCopy regionInfo(
-				op.srcOffset, 0u, 0u,	// offset, row length, image height
-				op.layersInfo,		// subresource layers
-				vk::Offset3D(0),
-				op.extent
-			);
-			transferCmd.copyBufferToImage(
-				mStagingBuffers[op.stageBuffIdx].buffer.getVkBuffer(), // src buffer
-				op.dstImage,	// dst image
-				vk::ImageLayout::eTransferDstOptimal,			// dst image layout
-				1, &regionInfo									// regions
+		if (!barriers.empty()) {
+			transferCmd.pipelineBarrier(
+				vk::PipelineStageFlagBits::eTopOfPipe, // src stage mask
+				vk::PipelineStageFlagBits::eTransfer, // dst stage mask
+				vk::DependencyFlagBits{},
+				0, nullptr, 0, nullptr, // buffer and memory barrier
+				static_cast<uint32_t>(barriers.size()), barriers.data() // image memory barrier
 			);
 		}
+		// copy image data
+		recordImageCopies(transferCmd, ts);
 
-		// Second barriers to set final layout
+		// Second barriers to set final layout, only after the last slice.
+		// The barrier also waits for the slices of the previous submissions.
+		// The levels to generate are blitted from it in the graphics queue
+		barriers.clear();
 		uint32_t numGraphicsAcquire = 0;
+		uint32_t numMipGenerations = 0;
 		for (uint32_t i = 0; i < numImgTransfers; ++i) {
 			const ImageTransferOp& op = ts.imageTransfersFragmentOps[i];
-			barriers[i]
-				.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
-				.setDstAccessMask(op.dstAccessMask)
-				.setOldLayout(vk::ImageLayout::eTransferDstOptimal)
-				.setNewLayout(op.dstImageLayout);
+			if (!op.lastSlice) {
+				continue;
+			}
+			const bool generateMips = op.mipLevels > 1;
+			numMipGenerations += generateMips ? 1 : 0;
+			barriers.push_back(vk::ImageMemoryBarrier(
+				vk::AccessFlagBits::eTransferWrite, // src AccessMask
+				generateMips ? vk::AccessFlagBits::eTransferRead : op.dstAccessMask, // dst AccessMask
+				vk::ImageLayout::eTransferDstOptimal,// old layout
+				generateMips ? vk::ImageLayout::eTransferSrcOptimal : op.dstImageLayout,// new layout
+				VK_QUEUE_FAMILY_IGNORED,	// src queue family
+				VK_QUEUE_FAMILY_IGNORED,	// dst queue family
+				op.dstImage,				// image
+				vk::ImageSubresourceRange(
+					op.layersInfo.aspectMask,
+					op.layersInfo.mipLevel,
+					1,
+					op.layersInfo.baseArrayLayer,
+					op.layersInfo.layerCount
+				)
+			));
 
 			if (op.acquireGraphics) {
 				numGraphicsAcquire += 1;
-				barriers[i]
+				barriers.back()
 					.setSrcQueueFamilyIndex(rc->getTransferFamilyIdx())
 					.setDstQueueFamilyIndex(rc->getGraphicsFamilyIdx());
 			}
 		}
-		transferCmd.pipelineBarrier(
-			vk::PipelineStageFlagBits::eTransfer, // src stage mask
-			vk::PipelineStageFlagBits::eFragmentShader, // dst stage mask
-			vk::DependencyFlagBits{},
-			0, nullptr, 0, nullptr, // buffer and memory barrier
-			static_cast<uint32_t>(barriers.size()), barriers.data() // image memory barrier
-		);
+		if (!barriers.empty()) {
+			transferCmd.pipelineBarrier(
+				vk::PipelineStageFlagBits::eTransfer, // src stage mask
+				vk::PipelineStageFlagBits::eFragmentShader, // dst stage mask
+				vk::DependencyFlagBits{},
+				0, nullptr, 0, nullptr, // buffer and memory barrier
+				static_cast<uint32_t>(barriers.size()), barriers.data() // image memory barrier
+			);
+		}
 
 		transferCmd.end();
 
@@ -135,8 +160,7 @@ void BufferTransferer::updateAndFlushTransfers(
 			graphicsCmd.begin({ vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
 
 			for (uint32_t i = 0, k = 0; k < numGraphicsAcquire; ++i) {
-				const ImageTransferOp& op = ts.imageTransfersFragmentOps[i];
-				if (op.acquireGraphics) {
+				if (barriers[i].srcQueueFamilyIndex != VK_QUEUE_FAMILY_IGNORED) {
 					barriers[k++] = barriers[i];
 				}
 			}
@@ -145,12 +169,21 @@ void BufferTransferer::updateAndFlushTransfers(
 			
 			graphicsCmd.pipelineBarrier(
 				vk::PipelineStageFlagBits::eTransfer, // src stage mask
-				vk::PipelineStageFlagBits::eFragmentShader, // dst stage mask
+				vk::PipelineStageFlagBits::eFragmentShader |
+					vk::PipelineStageFlagBits::eTransfer, // dst stage mask
 				vk::DependencyFlagBits{},
 				0, nullptr, 0, nullptr, // buffer and memory barrier
 				numGraphicsAcquire, barriers.data() // image memory barrier
 			);
 
+			if (numMipGenerations > 0) {
+				for (const ImageTransferOp& op : ts.imageTransfersFragmentOps) {
+					if (op.lastSlice && op.mipLevels > 1) {
+						recordMipGeneration(graphicsCmd, op);
+					}
+				}
+			}
+
 			graphicsCmd.end();
 		}
 
@@ -178,8 +211,226 @@ void BufferTransferer::updateAndFlushTransfers(
 
 
 
+void BufferTransferer::recordMipGeneration(vk::CommandBuffer cmd, const ImageTransferOp& op)
+{
+	const uint32_t baseLevel = op.layersInfo.mipLevel;
+	vk::ImageMemoryBarrier barrier(
+		vk::AccessFlags{}, // src AccessMask
+		vk::AccessFlagBits::eTransferWrite, // dst AccessMask
+		vk::ImageLayout::eUndefined,// old layout
+		vk::ImageLayout::eTransferDstOptimal,// new layout
+		VK_QUEUE_FAMILY_IGNORED,	// src queue family
+		VK_QUEUE_FAMILY_IGNORED,	// dst queue family
+		op.dstImage,				// image
+		vk::ImageSubresourceRange(
+			op.layersInfo.aspectMask,
+			baseLevel + 1,
+			op.mipLevels - 1,
+			op.layersInfo.baseArrayLayer,
+			op.layersInfo.layerCount
+		)
+	);
+	// The levels after the uploaded one are only written here, they
+	// do not need a queue ownership transfer
+	cmd.pipelineBarrier(
+		vk::PipelineStageFlagBits::eTopOfPipe, // src stage mask
+		vk::PipelineStageFlagBits::eTransfer, // dst stage mask
+		vk::DependencyFlagBits{},
+		0, nullptr, 0, nullptr, // buffer and memory barrier
+		1, &barrier // image memory barrier
+	);
+
+	int32_t width = static_cast<int32_t>(op.mipExtent.width);
+	int32_t height = static_cast<int32_t>(op.mipExtent.height);
+	barrier.subresourceRange.setLevelCount(1);
+	for (uint32_t i = 1; i < op.mipLevels; ++i) {
+		const int32_t nextWidth = std::max(width / 2, 1);
+		const int32_t nextHeight = std::max(height / 2, 1);
+
+		vk::ImageBlit blit(
+			vk::ImageSubresourceLayers(op.layersInfo.aspectMask, baseLevel + i - 1,
+				op.layersInfo.baseArrayLayer, op.layersInfo.layerCount), // src subresource
+			{ vk::Offset3D(0, 0, 0), vk::Offset3D(width, height, 1) }, // src offsets
+			vk::ImageSubresourceLayers(op.layersInfo.aspectMask, baseLevel + i,
+				op.layersInfo.baseArrayLayer, op.layersInfo.layerCount), // dst subresource
+			{ vk::Offset3D(0, 0, 0), vk::Offset3D(nextWidth, nextHeight, 1) } // dst offsets
+		);
+		cmd.blitImage(
+			op.dstImage, vk::ImageLayout::eTransferSrcOptimal,
+			op.dstImage, vk::ImageLayout::eTransferDstOptimal,
+			1, &blit, vk::Filter::eLinear);
+
+		// The level is the source of the next one
+		barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+			.setDstAccessMask(vk::AccessFlagBits::eTransferRead)
+			.setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+			.setNewLayout(vk::ImageLayout::eTransferSrcOptimal);
+		barrier.subresourceRange.setBaseMipLevel(baseLevel + i);
+		cmd.pipelineBarrier(
+			vk::PipelineStageFlagBits::eTransfer, // src stage mask
+			vk::PipelineStageFlagBits::eTransfer, // dst stage mask
+			vk::DependencyFlagBits{},
+			0, nullptr, 0, nullptr, // buffer and memory barrier
+			1, &barrier // image memory barrier
+		);
+
+		width = nextWidth;
+		height = nextHeight;
+	}
+
+	// Final layout of all the levels
+	barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferRead)
+		.setDstAccessMask(op.dstAccessMask)
+		.setOldLayout(vk::ImageLayout::eTransferSrcOptimal)
+		.setNewLayout(op.dstImageLayout);
+	barrier.subresourceRange.setBaseMipLevel(baseLevel)
+		.setLevelCount(op.mipLevels);
+	cmd.pipelineBarrier(
+		vk::PipelineStageFlagBits::eTransfer, // src stage mask
+		vk::PipelineStageFlagBits::eFragmentShader, // dst stage mask
+		vk::DependencyFlagBits{},
+		0, nullptr, 0, nullptr, // buffer and memory barrier
+		1, &barrier // image memory barrier
+	);
+}
+
+void BufferTransferer::recordBufferCopies(vk::CommandBuffer cmd, const TransferSpace& ts)
+{
+	const std::vector<TransferOp>& ops = ts.bufferTransferOps;
+	const uint32_t numOps = static_cast<uint32_t>(ops.size());
+
+	// Grouped by destination buffer, in queue order inside each group,
+	// so that the ops that write the same bytes are recorded in order
+	mSortedBufferOps.resize(numOps);
+	for (uint32_t i = 0; i < numOps; ++i) {
+		mSortedBufferOps[i] = i;
+	}
+	std::stable_sort(mSortedBufferOps.begin(), mSortedBufferOps.end(),
+		[&ops](uint32_t a, uint32_t b) {
+			return ops[a].dstBuffer < ops[b].dstBuffer;
+		});
+
+	// The consecutive ops of a group with the same staging buffer are copied by a
+	// single command. The regions of a command can't overlap in the destination,
+	// and the commands that write the same bytes are ordered by a barrier, so an op
+	// that overlaps a region written since the last barrier starts a new command.
+	// The regions since the last barrier are in mBufferCopyRegions, the ones of the
+	// command being recorded from firstRegion
+	const vk::MemoryBarrier barrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eTransferWrite);
+	uint32_t i = 0;
+	while (i < numOps) {
+		const vk::Buffer dstBuffer = ops[mSortedBufferOps[i]].dstBuffer;
+		vk::Buffer srcBuffer = ops[mSortedBufferOps[i]].staging.srcBuffer;
+		mBufferCopyRegions.clear();
+		size_t firstRegion = 0;
+		// Bytes of the destination that contain all the regions since the last barrier
+		vk::DeviceSize writtenBegin = 0;
+		vk::DeviceSize writtenEnd = 0;
+
+		const auto recordCommand = [&]() {
+			if (firstRegion < mBufferCopyRegions.size()) {
+				cmd.copyBuffer(srcBuffer, dstBuffer,
+					static_cast<uint32_t>(mBufferCopyRegions.size() - firstRegion),
+					mBufferCopyRegions.data() + firstRegion);
+				firstRegion = mBufferCopyRegions.size();
+			}
+		};
+
+		for (; i < numOps && ops[mSortedBufferOps[i]].dstBuffer == dstBuffer; ++i) {
+			const TransferOp& op = ops[mSortedBufferOps[i]];
+			if (op.staging.srcBuffer != srcBuffer) {
+				recordCommand();
+				srcBuffer = op.staging.srcBuffer;
+			}
+
+			// The regions are only checked one by one if the op is within the written bytes
+			const vk::DeviceSize opEnd = op.dstOffset + op.bytes;
+			bool overlaps = false;
+			if (op.dstOffset < writtenEnd && writtenBegin < opEnd) {
+				for (const vk::BufferCopy& region : mBufferCopyRegions) {
+					if (op.dstOffset < region.dstOffset + region.size && region.dstOffset < opEnd) {
+						overlaps = true;
+						break;
+					}
+				}
+			}
+			if (overlaps) {
+				recordCommand();
+				cmd.pipelineBarrier(
+					vk::PipelineStageFlagBits::eTransfer, // src stage mask
+					vk::PipelineStageFlagBits::eTransfer, // dst stage mask
+					vk::DependencyFlagBits{},
+					1, &barrier, // memory barrier
+					0, nullptr, 0, nullptr // buffer and image memory barrier
+				);
+				mBufferCopyRegions.clear();
+				firstRegion = 0;
+			}
+
+			if (mBufferCopyRegions.empty()) {
+				writtenBegin = op.dstOffset;
+				writtenEnd = opEnd;
+			}
+			else {
+				writtenBegin = std::min(writtenBegin, op.dstOffset);
+				writtenEnd = std::max(writtenEnd, opEnd);
+			}
+
+			// Contiguous slices, as the ones of a stream, are merged in a region
+			if (firstRegion < mBufferCopyRegions.size()) {
+				vk::BufferCopy& last = mBufferCopyRegions.back();
+				if (last.srcOffset + last.size == op.staging.srcOffset &&
+					last.dstOffset + last.size == op.dstOffset) {
+					last.size += op.bytes;
+					continue;
+				}
+			}
+			mBufferCopyRegions.push_back(vk::BufferCopy(
+				op.staging.srcOffset, op.dstOffset, op.bytes));
+		}
+
+		recordCommand();
+	}
+}
+
+void BufferTransferer::recordImageCopies(vk::CommandBuffer cmd, const TransferSpace& ts)
+{
+	const std::vector<ImageTransferOp>& ops = ts.imageTransfersFragmentOps;
+	const uint32_t numOps = static_cast<uint32_t>(ops.size());
+
+	uint32_t i = 0;
+	while (i < numOps) {
+		const ImageTransferOp& first = ops[i];
+		mImageCopyRegions.clear();
+		for (; i < numOps; ++i) {
+			const ImageTransferOp& op = ops[i];
+			if (op.staging.srcBuffer != first.staging.srcBuffer ||
+				op.dstImage != first.dstImage) {
+				break;
+			}
+			mImageCopyRegions.push_back(vk::BufferImageCopy(
+				op.staging.srcOffset, 0u, 0u,	// offset, row length, image height
+				op.layersInfo,		// subresource layers
+				op.offset,
+				op.extent
+			));
+		}
+
+		cmd.copyBufferToImage(
+			first.staging.srcBuffer,	// src buffer
+			first.dstImage,	// dst image
+			vk::ImageLayout::eTransferDstOptimal,			// dst image layout
+			static_cast<uint32_t>(mImageCopyRegions.size()), mImageCopyRegions.data() // regions
+		);
+	}
+}
+
 void BufferTransferer::updateTransferStates(RenderContext* rc)
 {
+	StagingAllocation cancelled;
+	while (mCancelledReservations.try_dequeue(cancelled)) {
+		freeStaging(*rc, cancelled);
+	}
 
 	for (TransferSpace& ts : mTransferSpaces) {
 		if (ts.inUse) {
@@ -191,10 +442,16 @@ void BufferTransferer::updateTransferStates(RenderContext* rc)
 				bool finished = value >= ts.value;
 				if (finished) {
 					for (const TransferOp& op : ts.bufferTransferOps) {
-						mStagingBuffers[op.stageBuffIdx].free(op.srcOffset);
+						freeStaging(*rc, op.staging);
+						if (op.onFinished) {
+							op.onFinished();
+						}
 					}
 					for (const ImageTransferOp& op : ts.imageTransfersFragmentOps) {
-						mStagingBuffers[op.stageBuffIdx].free(op.srcOffset);
+						freeStaging(*rc, op.staging);
+						if (op.onFinished) {
+							op.onFinished();
+						}
 					}
 					ts.reset(rc);
 				}
@@ -209,28 +466,131 @@ void BufferTransferer::updateTransferStates(RenderContext* rc)
 void BufferTransferer::transferToBuffer(
 	const RenderContext& rc, const void* data,
 	const vk::DeviceSize numBytes, const Buffer& dstBuffer,
-	const vk::DeviceSize dstOffset)
+	const vk::DeviceSize dstOffset,
+	TransferCallback onFinished)
 {
-	mBufferMutex.lock();
+	if (numBytes > getFrameBudget()) {
+		Stream stream;
+		stream.data = static_cast<const uint8_t*>(data);
+		stream.numBytes = numBytes;
+		stream.dstBuffer = dstBuffer.getVkBuffer();
+		stream.dstOffset = dstOffset;
+		stream.onFinished = std::move(onFinished);
+		pushStream(std::move(stream), true);
+		return;
+	}
 
-	const uint32_t buffIdx = findOrCreateStageBuffer(rc, numBytes);
-	const vk::DeviceSize memPos = mStagingBuffers[buffIdx].getLastAvailableByte();
-	mStagingBuffers[buffIdx].reserve(numBytes);
-	
-	mTransferSpaces[mCurrentSpace].bufferTransferOps
-		.push_back(
-		TransferOp{ buffIdx, memPos,
+	StagingAllocation staging;
+	uint8_t* ptr = allocateStaging(rc, numBytes, &staging);
+	std::memcpy(ptr, data, numBytes);
+
+	// the data is written before the op is visible to the render thread
+	mQueuedBufferOps.enqueue(
+		TransferOp{ staging,
 					dstBuffer.getVkBuffer(), dstOffset,
-					numBytes });
+					numBytes, std::move(onFinished) });
 
-	mBufferMutex.unlock();
 
-	std::memcpy(mStagingBuffers[buffIdx].ptr + memPos, data, numBytes);
+}
+
+void BufferTransferer::transferToImage(const RenderContext& rc,
+	const void* data,
+	const vk::DeviceSize numBytes,
+	const Image2D& dstImage,
+	const vk::ImageSubresourceLayers& layerInfo,
+	const vk::AccessFlags dstAccessMask,
+	const vk::ImageLayout dstImageLayout,
+	const vk::PipelineStageFlags dstStageMask,
+	const bool transferToGraphics,
+	const bool generateMips,
+	TransferCallback onFinished)
+{
+	ImageTransferOp op = makeImageTransferOp(dstImage, layerInfo, dstAccessMask,
+		dstImageLayout, dstStageMask, transferToGraphics, generateMips);
+	op.bytes = numBytes;
+	op.onFinished = std::move(onFinished);
+
+	if (numBytes > getFrameBudget()) {
+		Stream stream;
+		stream.data = static_cast<const uint8_t*>(data);
+		stream.numBytes = numBytes;
+		stream.image = std::move(op);
+		pushStream(std::move(stream), true);
+		return;
+	}
+
+	uint8_t* ptr = allocateStaging(rc, numBytes, &op.staging);
+	std::memcpy(ptr, data, numBytes);
+
+	mQueuedImageOps.enqueue(std::move(op));
 
 
 }
 
-void BufferTransferer::transferToImage(const RenderContext& rc,
+void BufferTransferer::reserveStaging(
+	const RenderContext& rc,
+	const vk::DeviceSize numBytes,
+	StagingReservation* outReservation)
+{
+	assert(outReservation != nullptr && outReservation->mData == nullptr);
+	assert(numBytes > 0);
+
+	StagingAllocation* staging = &outReservation->mAllocation;
+	outReservation->mData = numBytes <= getFrameBudget() ?
+		allocateStaging(rc, numBytes, staging) : allocateDedicatedStaging(rc, numBytes, staging);
+	outReservation->mNumBytes = numBytes;
+}
+
+void BufferTransferer::transferReservedToImage(
+	StagingReservation&& reservation,
+	const Image2D& dstImage,
+	const vk::ImageSubresourceLayers& layerInfo,
+	const vk::AccessFlags dstAccessMask,
+	const vk::ImageLayout dstImageLayout,
+	const vk::PipelineStageFlags dstStageMask,
+	const bool transferToGraphics,
+	const bool generateMips,
+	TransferCallback onFinished)
+{
+	assert(reservation.mData != nullptr);
+
+	ImageTransferOp op = makeImageTransferOp(dstImage, layerInfo, dstAccessMask,
+		dstImageLayout, dstStageMask, transferToGraphics, generateMips);
+	op.staging = std::move(reservation.mAllocation);
+	op.bytes = reservation.mNumBytes;
+	op.onFinished = std::move(onFinished);
+	reservation.mData = nullptr;
+
+	// the data is written before the op is visible to the render thread
+	mQueuedImageOps.enqueue(std::move(op));
+}
+
+void BufferTransferer::cancelReservation(StagingReservation&& reservation)
+{
+	assert(reservation.mData != nullptr);
+	mCancelledReservations.enqueue(std::move(reservation.mAllocation));
+	reservation.mData = nullptr;
+}
+
+BufferTransferer::StreamId BufferTransferer::streamToBuffer(
+	const RenderContext& rc,
+	const void* data,
+	const vk::DeviceSize numBytes,
+	const Buffer& dstBuffer,
+	const vk::DeviceSize dstOffset,
+	TransferCallback onFinished)
+{
+	Stream stream;
+	stream.data = static_cast<const uint8_t*>(data);
+	stream.numBytes = numBytes;
+	stream.dstBuffer = dstBuffer.getVkBuffer();
+	stream.dstOffset = dstOffset;
+	stream.onFinished = std::move(onFinished);
+	return pushStream(std::move(stream), false);
+}
+
+BufferTransferer::StreamId BufferTransferer::streamToImage(
+	const RenderContext& rc,
 	const void* data,
 	const vk::DeviceSize numBytes,
 	const Image2D& dstImage,
@@ -238,65 +598,269 @@ void BufferTransferer::transferToImage(const RenderContext& rc,
 	const vk::AccessFlags dstAccessMask,
 	const vk::ImageLayout dstImageLayout,
 	const vk::PipelineStageFlags dstStageMask,
-	const bool transferToGraphics)
+	const bool transferToGraphics,
+	const bool generateMips,
+	TransferCallback onFinished)
 {
-	mImageMutex.lock();
-	const uint32_t buffIdx = findOrCreateStageBuffer(rc, numBytes);
-	const vk::DeviceSize memPos = mStagingBuffers[buffIdx].getLastAvailableByte();
-	mStagingBuffers[buffIdx].reserve(numBytes);
+	Stream stream;
+	stream.data = static_cast<const uint8_t*>(data);
+	stream.numBytes = numBytes;
+	stream.image = makeImageTransferOp(dstImage, layerInfo, dstAccessMask,
+		dstImageLayout, dstStageMask, transferToGraphics, generateMips);
+	stream.onFinished = std::move(onFinished);
+	return pushStream(std::move(stream), false);
+}
 
+BufferTransferer::ImageTransferOp BufferTransferer::makeImageTransferOp(
+	const Image2D& dstImage,
+	const vk::ImageSubresourceLayers& layerInfo,
+	const vk::AccessFlags dstAccessMask,
+	const vk::ImageLayout dstImageLayout,
+	const vk::PipelineStageFlags dstStageMask,
+	const bool transferToGraphics,
+	const bool generateMips)
+{
+	if (dstStageMask != vk::PipelineStageFlagBits::eFragmentShader) {
+		throw std::logic_error("Error: dst Pipeline Stage not supported!!");
+	}
+	if (generateMips && !transferToGraphics) {
+		throw std::logic_error("Error: the mips are generated in the graphics queue!!");
+	}
+	if (generateMips && dstImage.isBlockCompressed()) {
+		throw std::logic_error("Error: the mips of compressed images can not be blitted!!");
+	}
 
 	ImageTransferOp op;
-	op.stageBuffIdx = buffIdx;
-	op.srcOffset = memPos;
 	op.dstImage = dstImage.getVkImage();
 	op.layersInfo = layerInfo;
-	op.extent =  vk::Extent3D(dstImage.getExtent(), 1);
+	op.mipExtent = dstImage.getMipExtent(layerInfo.mipLevel);
+	op.mipLevels = generateMips ? dstImage.getMipLevels() - layerInfo.mipLevel : 1;
+	op.offset = vk::Offset3D(0);
+	op.extent = vk::Extent3D(op.mipExtent, 1);
+	op.blockHeight = dstImage.isBlockCompressed() ? 4 : 1;
 	op.dstAccessMask = dstAccessMask;
 	op.dstImageLayout = dstImageLayout;
 	op.acquireGraphics = transferToGraphics;
+	return op;
+}
+
+void BufferTransferer::cancelStream(StreamId id)
+{
+	takeQueuedStreams();
 
-	if (dstStageMask == vk::PipelineStageFlagBits::eFragmentShader) {
-		mTransferSpaces[mCurrentSpace].imageTransfersFragmentOps.push_back(op);
+	std::deque<Stream>::iterator it = std::find_if(mStreams.begin(), mStreams.end(),
+		[id](const Stream& stream) { return stream.id == id; });
+	if (it != mStreams.end()) {
+		mStreams.erase(it);
 	}
-	else {
-		mImageMutex.unlock();
-		throw std::logic_error("Error: dst Pipeline Stage not supported!!");
+}
+
+BufferTransferer::StreamId BufferTransferer::pushStream(Stream&& stream, bool copyData)
+{
+	assert(stream.numBytes > 0);
+	if (stream.image.dstImage) {
+		// The callback is called after the last slice
+		if (stream.image.onFinished) {
+			stream.onFinished = std::move(stream.image.onFinished);
+			stream.image.onFinished = nullptr;
+		}
+		if (stream.numBytes / getNumRows(stream.image) > getFrameBudget()) {
+			throw std::logic_error("Error: a row of the image is bigger than the frame budget!!");
+		}
 	}
-	mImageMutex.unlock();
+	if (copyData) {
+		stream.ownedData.reset(new uint8_t[stream.numBytes]);
+		std::memcpy(stream.ownedData.get(), stream.data, stream.numBytes);
+		stream.data = stream.ownedData.get();
+	}
+	stream.id = mNextStreamId.fetch_add(1, std::memory_order_relaxed);
+	const StreamId id = stream.id;
+	mQueuedStreams.enqueue(std::move(stream));
+	return id;
+}
+
+uint32_t BufferTransferer::getNumRows(const ImageTransferOp& op)
+{
+	return (op.extent.height + op.blockHeight - 1) / op.blockHeight;
+}
 
-	std::memcpy(mStagingBuffers[buffIdx].ptr + memPos, data, numBytes);
+void BufferTransferer::takeQueuedStreams()
+{
+	constexpr size_t MAX_STREAMS_PER_DEQUEUE = 256;
+	while (mQueuedStreams.try_dequeue_bulk(
+		std::back_inserter(mStreams), MAX_STREAMS_PER_DEQUEUE) != 0) {}
+}
 
+void BufferTransferer::queueStreamSlices(TransferSpace* ts)
+{
+	takeQueuedStreams();
 
+	// The transfers that are not streamed also count towards the budget
+	const vk::DeviceSize frameBudget = getFrameBudget();
+	vk::DeviceSize queuedBytes = 0;
+	for (const TransferOp& op : ts->bufferTransferOps) {
+		queuedBytes += op.bytes;
+	}
+	for (const ImageTransferOp& op : ts->imageTransfersFragmentOps) {
+		queuedBytes += op.bytes;
+	}
+
+	while (!mStreams.empty() && queuedBytes < frameBudget) {
+		Stream& stream = mStreams.front();
+		const vk::DeviceSize remainingBytes = stream.numBytes - stream.bytesQueued;
+		const vk::DeviceSize budget = frameBudget - queuedBytes;
+
+		vk::DeviceSize sliceBytes;
+		uint32_t sliceRows = 0;
+		if (stream.image.dstImage) {
+			const vk::DeviceSize rowBytes = stream.numBytes / getNumRows(stream.image);
+			const uint32_t remainingRows = getNumRows(stream.image) -
+				static_cast<uint32_t>(stream.bytesQueued / rowBytes);
+			// At least a row, so that the stream always advances
+			sliceRows = static_cast<uint32_t>(std::min<vk::DeviceSize>(
+				remainingRows, std::max<vk::DeviceSize>(1, budget / rowBytes)));
+			sliceBytes = sliceRows == remainingRows ? remainingBytes : sliceRows * rowBytes;
+		}
+		else {
+			sliceBytes = std::min(remainingBytes, budget);
+		}
+
+		// Only the ring is used, so that the staging memory stays bounded.
+		// If it is full, the slice is queued once the GPU frees it
+		StagingAllocation staging;
+		uint8_t* ptr = allocateRingStaging(sliceBytes, &staging);
+		if (ptr == nullptr) {
+			break;
+		}
+		std::memcpy(ptr, stream.data + stream.bytesQueued, sliceBytes);
+
+		const bool lastSlice = stream.bytesQueued + sliceBytes == stream.numBytes;
+		if (stream.image.dstImage) {
+			ImageTransferOp op = stream.image;
+			op.staging = staging;
+			// The last row of blocks may be cut by the edge of the image
+			const uint32_t firstRow = static_cast<uint32_t>(stream.bytesQueued /
+				(stream.numBytes / getNumRows(stream.image)));
+			op.offset.y = static_cast<int32_t>(firstRow * op.blockHeight);
+			op.extent.height = std::min(sliceRows * op.blockHeight,
+				stream.image.extent.height - firstRow * op.blockHeight);
+			op.bytes = sliceBytes;
+			op.firstSlice = stream.bytesQueued == 0;
+			op.lastSlice = lastSlice;
+			if (lastSlice) {
+				op.onFinished = std::move(stream.onFinished);
+			}
+			ts->imageTransfersFragmentOps.push_back(std::move(op));
+		}
+		else {
+			TransferOp op{ staging,
+				stream.dstBuffer, stream.dstOffset + stream.bytesQueued,
+				sliceBytes };
+			if (lastSlice) {
+				op.onFinished = std::move(stream.onFinished);
+			}
+			ts->bufferTransferOps.push_back(std::move(op));
+		}
+
+		stream.bytesQueued += sliceBytes;
+		queuedBytes += sliceBytes;
+		if (lastSlice) {
+			mStreams.pop_front();
+		}
+	}
+}
+
+void BufferTransferer::takeQueuedTransfers(TransferSpace* ts)
+{
+	// Bulk dequeues in chunks, the queue can not report its exact size
+	constexpr size_t MAX_OPS_PER_DEQUEUE = 256;
+	while (mQueuedBufferOps.try_dequeue_bulk(
+		std::back_inserter(ts->bufferTransferOps), MAX_OPS_PER_DEQUEUE) != 0) {}
+	while (mQueuedImageOps.try_dequeue_bulk(
+		std::back_inserter(ts->imageTransfersFragmentOps), MAX_OPS_PER_DEQUEUE) != 0) {}
 }
 
 void BufferTransferer::destroy(RenderContext* rc)
 {
-	for (StageBuffer& buff : mStagingBuffers) {
-		buff.destroy(*rc);
+	if (mCurrentSpace < mTransferSpaces.size()) {
+		takeQueuedTransfers(&mTransferSpaces[mCurrentSpace]);
+	}
+	// The streams not finished are discarded with their callbacks
+	takeQueuedStreams();
+	mStreams.clear();
+	StagingAllocation cancelled;
+	while (mCancelledReservations.try_dequeue(cancelled)) {
+		freeStaging(*rc, cancelled);
 	}
 	for (TransferSpace& sem : mTransferSpaces) {
+		for (const TransferOp& op : sem.bufferTransferOps) {
+			freeStaging(*rc, op.staging);
+		}
+		for (const ImageTransferOp& op : sem.imageTransfersFragmentOps) {
+			freeStaging(*rc, op.staging);
+		}
 		sem.reset(rc);
 		rc->destroy(sem.semaphore);
 	}
+	if (mStagingBuffer) {
+		rc->unmapAllocatable(mStagingBuffer);
+		rc->destroy(mStagingBuffer);
+		mStagingBuffer = nullptr;
+	}
 }
 
-uint32_t BufferTransferer::findOrCreateStageBuffer(
-	const RenderContext& rc, const vk::DeviceSize numBytes)
+uint8_t* BufferTransferer::allocateRingStaging(
+	const vk::DeviceSize numBytes,
+	StagingAllocation* outAllocation)
 {
-	const uint32_t num = static_cast<uint32_t>(mStagingBuffers.size());
-	for (uint32_t i = 0; i < num; ++i) {
-		const StageBuffer& buf = mStagingBuffers[i];
-		if (buf.size - buf.getLastAvailableByte()) {
-			return i;
-		}
+	if (!mStagingRing.allocate(numBytes, mStagingAlignment, &outAllocation->ringAllocation)) {
+		return nullptr;
 	}
+	outAllocation->srcBuffer = mStagingBuffer.getVkBuffer();
+	outAllocation->srcOffset = outAllocation->ringAllocation.offset;
+	return mStagingPtr + outAllocation->srcOffset;
+}
 
-	// Else create buffer with enough size
-	mStagingBuffers.push_back({});
-	mStagingBuffers.back().create(rc, std::max(mMinSize, numBytes));
+uint8_t* BufferTransferer::allocateStaging(
+	const RenderContext& rc,
+	const vk::DeviceSize numBytes,
+	StagingAllocation* outAllocation)
+{
+	uint8_t* ringPtr = allocateRingStaging(numBytes, outAllocation);
+	if (ringPtr != nullptr) {
+		return ringPtr;
+	}
 
-	return num;
+	// Bigger than the free space of the ring. The ring can not wait for
+	// its space to be freed, as it happens in the thread that flushes
+	return allocateDedicatedStaging(rc, numBytes, outAllocation);
+}
+
+uint8_t* BufferTransferer::allocateDedicatedStaging(
+	const RenderContext& rc,
+	const vk::DeviceSize numBytes,
+	StagingAllocation* outAllocation)
+{
+	outAllocation->dedicatedBuffer = rc.createStagingBuffer(numBytes);
+	outAllocation->srcBuffer = outAllocation->dedicatedBuffer.getVkBuffer();
+	outAllocation->srcOffset = 0;
+
+	uint8_t* ptr;
+	rc.mapAllocatable(outAllocation->dedicatedBuffer, reinterpret_cast<void**>(&ptr));
+	return ptr;
+}
+
+void BufferTransferer::freeStaging(
+	const RenderContext& rc,
+	const StagingAllocation& allocation)
+{
+	if (allocation.dedicatedBuffer) {
+		rc.unmapAllocatable(allocation.dedicatedBuffer);
+		rc.destroy(allocation.dedicatedBuffer);
+	}
+	else {
+		mStagingRing.free(allocation.ringAllocation);
+	}
 }
 
 uint32_t BufferTransferer::findOrCreateTransferSpace(const RenderContext& rc)
@@ -317,39 +881,6 @@ uint32_t BufferTransferer::findOrCreateTransferSpace(const RenderContext& rc)
 	return num;
 }
 
-void BufferTransferer::StageBuffer::create(const RenderContext& rc, vk::DeviceSize size)
-{
-	this->buffer = rc.createStagingBuffer(size);
-	this->size = size;
-
-
-	rc.mapAllocatable(this->buffer, reinterpret_cast<void**>(&this->ptr));
-}
-
-void BufferTransferer::StageBuffer::free(vk::DeviceSize addr)
-{
-	this->lastAvailableByte.erase(addr);
-}
-
-vk::DeviceSize BufferTransferer::StageBuffer::getLastAvailableByte() const
-{
-	return this->lastAvailableByte.begin() == this->lastAvailableByte.end() ? 
-		0 : this->lastAvailableByte.begin()->second;
-}
-
-void BufferTransferer::StageBuffer::reserve(vk::DeviceSize bytes)
-{
-	vk::DeviceSize src = this->getLastAvailableByte();
-	lastAvailableByte.emplace(src, src + bytes);
-}
-
-void BufferTransferer::StageBuffer::destroy(const RenderContext& rc)
-{
-	rc.unmapAllocatable(this->buffer);
-
-	rc.destroy(this->buffer);
-}
-
 void BufferTransferer::TransferSpace::reset(RenderContext* rc)
 {
 	this->inUse = false;
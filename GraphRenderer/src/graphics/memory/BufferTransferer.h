@@ -1,10 +1,16 @@
 #pragma once
 
 #include <map>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <concurrentqueue/concurrentqueue.h>
 
 #include "../command/FreeCommandPool.h"
 #include "../resources/Buffer.h"
 #include "../resources/Image2D.h"
+#include "RingAllocator.h"
 
 namespace gr
 {
@@ -16,20 +22,35 @@ class BufferTransferer
 {
 public:
 
-	BufferTransferer(const vk::DeviceSize minSize = 1 << 24);
+	// Called by the render thread once the transfer has finished,
+	// and the data is resident in the destination
+	typedef std::function<void()> TransferCallback;
+	typedef uint64_t StreamId;
 
+	// The staging memory is a ring of stagingSize bytes. Transfers that
+	// do not fit in its free space get a dedicated staging buffer.
+	// At most frameBudget bytes of the streamed transfers are queued per frame
+	BufferTransferer(const vk::DeviceSize stagingSize = 1 << 26,
+		const vk::DeviceSize frameBudget = 1 << 24);
+
+	// Also creates the staging ring
 	void setUpTransferBlocks(RenderContext* rc);
 
+	// Submits the transfers queued until now. Only called by the render thread
 	void updateAndFlushTransfers(RenderContext* rc,
 		vk::Semaphore* outSemaphore = nullptr,
 		uint64_t* outValue = nullptr);
 
+	// The transfers can be queued from any thread, without locking.
+	// The data is copied before returning. Transfers larger than the frame
+	// budget keep a copy of the data, and are streamed
 	void transferToBuffer(
 		const RenderContext& rc,
 		const void* data,
 		const vk::DeviceSize numBytes,
 		const Buffer& dstBuffer,
-		const vk::DeviceSize dstOffset = 0);
+		const vk::DeviceSize dstOffset = 0,
+		TransferCallback onFinished = nullptr);
 
 	// Transfer image into given dstImage
 	// If transferToGraphics == false, then the image is 
@@ -44,9 +65,71 @@ public:
 		const vk::AccessFlags dstAccessMask,
 		const vk::ImageLayout dstImageLayout,
 		const vk::PipelineStageFlags dstStageMask,
-		const bool transferToGraphics = true
+		const bool transferToGraphics = true,
+		const bool generateMips = false,
+		TransferCallback onFinished = nullptr
 	);
 
+	// The data is split in slices, queued over several frames without exceeding
+	// the frame budget or the staging ring. The data is read by the render thread,
+	// and must be valid until onFinished is called or the stream is cancelled
+	StreamId streamToBuffer(
+		const RenderContext& rc,
+		const void* data,
+		const vk::DeviceSize numBytes,
+		const Buffer& dstBuffer,
+		const vk::DeviceSize dstOffset,
+		TransferCallback onFinished);
+
+	// The slices are sets of rows of the image, of numBytes / height bytes each
+	StreamId streamToImage(
+		const RenderContext& rc,
+		const void* data,
+		const vk::DeviceSize numBytes,
+		const Image2D& dstImage,
+		const vk::ImageSubresourceLayers& layerInfo,
+		const vk::AccessFlags dstAccessMask,
+		const vk::ImageLayout dstImageLayout,
+		const vk::PipelineStageFlags dstStageMask,
+		const bool transferToGraphics,
+		const bool generateMips,
+		TransferCallback onFinished);
+
+	// The slices not queued yet are discarded, and onFinished is not called
+	// unless the last slice was already queued. Only called by the render thread
+	void cancelStream(StreamId id);
+
+	// Staging memory to write the data of a transfer in place, i.e. to decode
+	// an image straight to it, without an intermediate copy.
+	// Reservations bigger than the frame budget get a dedicated staging buffer,
+	// so that the ring is not held while they are written
+	class StagingReservation;
+	void reserveStaging(
+		const RenderContext& rc,
+		const vk::DeviceSize numBytes,
+		StagingReservation* outReservation);
+
+	// Transfers the data written in the reservation, that is consumed.
+	// The transfer is not streamed. Same parameters as transferToImage
+	void transferReservedToImage(
+		StagingReservation&& reservation,
+		const Image2D& dstImage,
+		const vk::ImageSubresourceLayers& layerInfo,
+		const vk::AccessFlags dstAccessMask,
+		const vk::ImageLayout dstImageLayout,
+		const vk::PipelineStageFlags dstStageMask,
+		const bool transferToGraphics = true,
+		const bool generateMips = false,
+		TransferCallback onFinished = nullptr
+	);
+
+	// The reservation is freed by the render thread, on the next flush
+	void cancelReservation(StagingReservation&& reservation);
+
+	// Clamped to half of the staging ring
+	void setFrameBudget(vk::DeviceSize bytes);
+	vk::DeviceSize getFrameBudget() const { return mFrameBudget.load(std::memory_order_relaxed); }
+
 
 	// Destroy before destroying command pools
 	void destroy(RenderContext* rc);
@@ -54,40 +137,90 @@ public:
 protected:
 
 
-	struct StageBuffer {
-		Buffer buffer;
-		vk::DeviceSize size;
-		std::map<vk::DeviceSize, vk::DeviceSize, std::greater<vk::DeviceSize>> lastAvailableByte;
-		uint8_t* ptr;
-
-		void create(const RenderContext& rc, vk::DeviceSize size);
-		void free(vk::DeviceSize addr);
+	// Staging memory of a transfer, freed once the transfer has finished
+	struct StagingAllocation {
+		RingAllocator::Allocation ringAllocation;
+		// Only if the transfer did not fit in the ring
+		Buffer dedicatedBuffer;
 
-		vk::DeviceSize getLastAvailableByte() const;
+		vk::Buffer srcBuffer;
+		vk::DeviceSize srcOffset;
+	};
 
-		void reserve(vk::DeviceSize bytes);
+public:
 
-		void destroy(const RenderContext& rc);
+	class StagingReservation
+	{
+	public:
+		StagingReservation() = default;
+		StagingReservation(const StagingReservation&) = delete;
+		StagingReservation& operator=(const StagingReservation&) = delete;
+		StagingReservation(StagingReservation&&) = default;
+		StagingReservation& operator=(StagingReservation&&) = default;
+
+		// Mapped memory of numBytes bytes, that can be written from any thread
+		uint8_t* getData() const { return mData; }
+		vk::DeviceSize getNumBytes() const { return mNumBytes; }
+
+	private:
+		friend class BufferTransferer;
+		StagingAllocation mAllocation;
+		uint8_t* mData = nullptr;
+		vk::DeviceSize mNumBytes = 0;
 	};
 
+protected:
+
 	struct TransferOp {
-		uint32_t stageBuffIdx;
-		vk::DeviceSize srcOffset;
+		StagingAllocation staging;
 		vk::Buffer dstBuffer;
 		vk::DeviceSize dstOffset;
 		vk::DeviceSize bytes;
+		// Of the last slice if streamed
+		TransferCallback onFinished;
 	};
 
 	struct ImageTransferOp {
-		uint32_t stageBuffIdx;
-		vk::DeviceSize srcOffset;
+		StagingAllocation staging;
 		vk::Image dstImage;
 		vk::ImageSubresourceLayers layersInfo;
+		// Rows of the image copied
+		vk::Offset3D offset;
 		vk::Extent3D extent;
+		// Texel rows of each row of the data, 4 in the block compressed
+		// formats. The slices are made of whole rows
+		uint32_t blockHeight = 1;
+		vk::DeviceSize bytes;
 		vk::AccessFlags dstAccessMask;
 		vk::ImageLayout dstImageLayout;
 
 		bool acquireGraphics = true;
+		// If more than one, the levels after the uploaded one are blitted
+		// from it in the graphics queue, after the last slice
+		uint32_t mipLevels = 1;
+		vk::Extent2D mipExtent;
+		// The layout is transitioned before the first slice, and after the last
+		bool firstSlice = true;
+		bool lastSlice = true;
+		TransferCallback onFinished;
+	};
+
+	// Transfer queued in slices over several frames
+	struct Stream {
+		StreamId id;
+		const uint8_t* data;
+		// Copy of the data, if the owner does not keep it
+		std::unique_ptr<uint8_t[]> ownedData;
+		vk::DeviceSize numBytes;
+		vk::DeviceSize bytesQueued = 0;
+
+		// Buffer destination if image.dstImage is null
+		vk::Buffer dstBuffer;
+		vk::DeviceSize dstOffset;
+		// The slices copy the rows after the ones already queued
+		ImageTransferOp image;
+
+		TransferCallback onFinished;
 	};
 
 	struct TransferSpace
@@ -110,9 +243,27 @@ protected:
 
 	
 
-	vk::DeviceSize mMinSize;
+	// Persistently mapped
+	Buffer mStagingBuffer;
+	uint8_t* mStagingPtr = nullptr;
+	vk::DeviceSize mStagingSize;
+	// Of the offsets of the copies, valid for buffers and images
+	vk::DeviceSize mStagingAlignment = 16;
+	RingAllocator mStagingRing;
+
+	std::atomic<vk::DeviceSize> mFrameBudget;
+	std::atomic<StreamId> mNextStreamId{ 1 };
+	// Queued by the producers, and moved to mStreams by the render thread
+	moodycamel::ConcurrentQueue<Stream> mQueuedStreams;
+	// In order, only accessed by the render thread
+	std::deque<Stream> mStreams;
+
+	// Scratch storage of the flush, reused every frame
+	std::vector<uint32_t> mSortedBufferOps;
+	std::vector<vk::BufferCopy> mBufferCopyRegions;
+	std::vector<vk::BufferImageCopy> mImageCopyRegions;
+	std::vector<vk::ImageMemoryBarrier> mBarriers;
 
-	std::vector<StageBuffer> mStagingBuffers;
 	std::vector<TransferSpace> mTransferSpaces;
 
 	uint32_t mCurrentSpace = std::numeric_limits<uint32_t>::max();
@@ -121,14 +272,64 @@ protected:
 	uint32_t mGraphicsBlock = std::numeric_limits<uint32_t>::max();
 	uint32_t mTransferBlock = std::numeric_limits<uint32_t>::max();
 
-	std::mutex mBufferMutex, mImageMutex;
+	// Transfers queued by the producers. The render thread moves them
+	// to the current transfer space when it flushes
+	moodycamel::ConcurrentQueue<TransferOp> mQueuedBufferOps;
+	moodycamel::ConcurrentQueue<ImageTransferOp> mQueuedImageOps;
+	// Freed by the render thread, the ring is not thread safe to free
+	moodycamel::ConcurrentQueue<StagingAllocation> mCancelledReservations;
 
-	uint32_t findOrCreateStageBuffer(
+	// Thread safe. Returns nullptr if the data does not fit in the free space of the ring
+	uint8_t* allocateRingStaging(
+		const vk::DeviceSize numBytes,
+		StagingAllocation* outAllocation);
+	// Thread safe. Returns the mapped memory to copy the data to
+	uint8_t* allocateStaging(
+		const RenderContext& rc,
+		const vk::DeviceSize numBytes,
+		StagingAllocation* outAllocation);
+	// Thread safe. A staging buffer for the allocation alone
+	uint8_t* allocateDedicatedStaging(
+		const RenderContext& rc,
+		const vk::DeviceSize numBytes,
+		StagingAllocation* outAllocation);
+	// Once the transfer has finished. Only called by the render thread
+	void freeStaging(
 		const RenderContext& rc,
-		const vk::DeviceSize numBytes);
+		const StagingAllocation& allocation);
 
 	uint32_t findOrCreateTransferSpace(const RenderContext& rc);
 
+	// Moves the queued transfers to the space. The transfers queued
+	// concurrently are taken by the next call
+	void takeQueuedTransfers(TransferSpace* ts);
+	// The consecutive ops to a destination buffer from the same staging buffer are
+	// copied by a single command, with a region each. The ops that overwrite the
+	// bytes of a previous op are copied after a barrier, in queue order
+	void recordBufferCopies(vk::CommandBuffer cmd, const TransferSpace& ts);
+	// Consecutive slices of the same image are copied by a single command
+	void recordImageCopies(vk::CommandBuffer cmd, const TransferSpace& ts);
+	// The extent is the one of the mip level
+	static ImageTransferOp makeImageTransferOp(
+		const Image2D& dstImage,
+		const vk::ImageSubresourceLayers& layerInfo,
+		const vk::AccessFlags dstAccessMask,
+		const vk::ImageLayout dstImageLayout,
+		const vk::PipelineStageFlags dstStageMask,
+		const bool transferToGraphics,
+		const bool generateMips);
+	// The uploaded level must be in eTransferSrcOptimal, owned by the graphics queue
+	void recordMipGeneration(vk::CommandBuffer cmd, const ImageTransferOp& op);
+	// Rows of the data of the whole op, of blocks if compressed
+	static uint32_t getNumRows(const ImageTransferOp& op);
+
+	// Only called by the render thread
+	void takeQueuedStreams();
+	// Queues the next slices of the streams to the space, within the frame budget
+	void queueStreamSlices(TransferSpace* ts);
+	// Copies the data if the owner does not keep it
+	StreamId pushStream(Stream&& stream, bool copyData);
+
 	void updateTransferStates(RenderContext* rc);
 
 
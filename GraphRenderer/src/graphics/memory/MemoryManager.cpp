@@ -1,19 +1,64 @@
 #include "MemoryManager.h"
 
+#include <cassert>
+
 namespace gr
 {
 namespace vkg
 {
 
-MemoryManager::MemoryManager(vk::Instance instance, vk::PhysicalDevice physicalDevice, vk::Device logicalDevice)
+MemoryManager::MemoryManager(vk::Instance instance, vk::PhysicalDevice physicalDevice,
+	vk::Device logicalDevice, bool memoryBudgetExtensionEnabled)
 {
 	VmaAllocatorCreateInfo createInfo = {};
 	createInfo.instance = instance;
 	createInfo.physicalDevice = physicalDevice;
 	createInfo.device = logicalDevice;
+	// The instance is created with Vulkan 1.2, that has the properties2 queries
+	createInfo.vulkanApiVersion = VK_API_VERSION_1_2;
+	if (memoryBudgetExtensionEnabled) {
+		createInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+	}
+	mMemoryBudgetEnabled = memoryBudgetExtensionEnabled;
 	// TODO: lost allocations
 
 	vmaCreateAllocator(&createInfo, &mAllocator);
+
+	mCategoryBytes = std::make_unique<std::atomic<vk::DeviceSize>[]>(NUM_MEMORY_CATEGORIES);
+	for (uint32_t i = 0; i < NUM_MEMORY_CATEGORIES; ++i) {
+		mCategoryBytes[i].store(0, std::memory_order_relaxed);
+	}
+
+	findHostVisibleDeviceMemory();
+}
+
+void MemoryManager::findHostVisibleDeviceMemory()
+{
+	const VkPhysicalDeviceMemoryProperties* props;
+	vmaGetMemoryProperties(mAllocator, &props);
+
+	// The biggest device local heap holds the vertex and index buffers
+	uint32_t deviceHeap = VK_MAX_MEMORY_HEAPS;
+	for (uint32_t i = 0; i < props->memoryHeapCount; ++i) {
+		if ((props->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0 &&
+			(deviceHeap == VK_MAX_MEMORY_HEAPS ||
+				props->memoryHeaps[i].size > props->memoryHeaps[deviceHeap].size)) {
+			deviceHeap = i;
+		}
+	}
+
+	// Without resizable BAR, the host visible device memory is a small
+	// heap of 256MB, that is not worth using for the meshes
+	const VkMemoryPropertyFlags directFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	mDeviceMemoryHostVisible = false;
+	for (uint32_t i = 0; i < props->memoryTypeCount; ++i) {
+		if (props->memoryTypes[i].heapIndex == deviceHeap &&
+			(props->memoryTypes[i].propertyFlags & directFlags) == directFlags) {
+			mDeviceMemoryHostVisible = true;
+			break;
+		}
+	}
 }
 
 
@@ -28,17 +73,24 @@ void MemoryManager::createImageAllocation(const vk::ImageCreateInfo& imageInfo,
 	VmaAllocationCreateInfo createInfo = {};
 	createInfo.requiredFlags = static_cast<VkMemoryPropertyFlags>(requiredProperties);
 	createInfo.preferredFlags = static_cast<VkMemoryPropertyFlags>(preferredProperties);
+	createInfo.pUserData = reinterpret_cast<void*>(static_cast<uintptr_t>(category));
 
+	VmaAllocationInfo allocInfo;
 	VkResult res = vmaCreateImage(mAllocator,
 		reinterpret_cast<const VkImageCreateInfo*>(&imageInfo),
 		&createInfo,
 		reinterpret_cast<VkImage*>(outImage),
 		allocation,
-		outAllocInfo);
+		&allocInfo);
 
 	if (res != VK_SUCCESS) {
 		throw std::runtime_error("Can't create image!!");
 	}
+
+	mCategoryBytes[static_cast<uint32_t>(category)].fetch_add(allocInfo.size, std::memory_order_relaxed);
+	if (outAllocInfo != nullptr) {
+		*outAllocInfo = allocInfo;
+	}
 }
 
 void MemoryManager::createBufferAllocation(const vk::BufferCreateInfo& bufferInfo, 
@@ -52,21 +104,47 @@ void MemoryManager::createBufferAllocation(const vk::BufferCreateInfo& bufferInf
 	VmaAllocationCreateInfo createInfo = {};
 	createInfo.requiredFlags = static_cast<VkMemoryPropertyFlags>(requiredProperties);
 	createInfo.preferredFlags = static_cast<VkMemoryPropertyFlags>(preferredProperties);
+	createInfo.pUserData = reinterpret_cast<void*>(static_cast<uintptr_t>(category));
 
+	VmaAllocationInfo allocInfo;
 	VkResult res = vmaCreateBuffer(mAllocator,
 		reinterpret_cast<const VkBufferCreateInfo*>(&bufferInfo),
 		&createInfo,
 		reinterpret_cast<VkBuffer*>(outBuffer),
 		outAllocation,
-		outAllocInfo);
+		&allocInfo);
 
 	if (res != VK_SUCCESS) {
 		throw std::runtime_error("Can't create buffer!!");
 	}
+
+	mCategoryBytes[static_cast<uint32_t>(category)].fetch_add(allocInfo.size, std::memory_order_relaxed);
+	if (outAllocInfo != nullptr) {
+		*outAllocInfo = allocInfo;
+	}
+}
+
+void MemoryManager::bindBufferMemory(VmaAllocation allocation, vk::Buffer buffer) const
+{
+	VkResult res = vmaBindBufferMemory(mAllocator, allocation, static_cast<VkBuffer>(buffer));
+
+	if (res != VK_SUCCESS) {
+		throw std::runtime_error("Error! Can't bind buffer memory!");
+	}
 }
 
 void MemoryManager::freeAllocation(VmaAllocation allocation) const
 {
+	if (allocation == VK_NULL_HANDLE) {
+		return;
+	}
+
+	VmaAllocationInfo info;
+	vmaGetAllocationInfo(mAllocator, allocation, &info);
+	const uint32_t category = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(info.pUserData));
+	assert(category < NUM_MEMORY_CATEGORIES);
+	mCategoryBytes[category].fetch_sub(info.size, std::memory_order_relaxed);
+
 	vmaFreeMemory(mAllocator, allocation);
 }
 
@@ -115,6 +193,74 @@ void MemoryManager::flushAllocations(const VmaAllocation* allocations, uint32_t
 	}
 }
 
+void MemoryManager::getHeapBudgets(std::vector<HeapBudget>* outBudgets) const
+{
+	const VkPhysicalDeviceMemoryProperties* props;
+	vmaGetMemoryProperties(mAllocator, &props);
+
+	VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+	vmaGetBudget(mAllocator, budgets);
+
+	outBudgets->resize(props->memoryHeapCount);
+	for (uint32_t i = 0; i < props->memoryHeapCount; ++i) {
+		HeapBudget& budget = (*outBudgets)[i];
+		budget.blockBytes = budgets[i].blockBytes;
+		budget.allocationBytes = budgets[i].allocationBytes;
+		budget.usage = budgets[i].usage;
+		budget.budget = budgets[i].budget;
+		budget.heapSize = props->memoryHeaps[i].size;
+		budget.deviceLocal = (props->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+	}
+}
+
+const char* MemoryManager::s_getCategoryName(MemoryCategory category)
+{
+	switch (category)
+	{
+	case MemoryCategory::eMeshes: return "Meshes";
+	case MemoryCategory::eTextures: return "Textures";
+	case MemoryCategory::eUniforms: return "Uniform buffers";
+	case MemoryCategory::eStaging: return "Staging";
+	case MemoryCategory::eRenderTargets: return "Render targets";
+	case MemoryCategory::eOther: return "Other";
+	default: return "Unknown";
+	}
+}
+
+VmaDefragmentationContext MemoryManager::beginDefragmentation(const VmaAllocation* allocations,
+	uint32_t numAllocations, vk::DeviceSize maxBytesToMove, uint32_t maxAllocationsToMove,
+	vk::CommandBuffer commandBuffer, VkBool32* outAllocationsChanged,
+	VmaDefragmentationStats* outStats) const
+{
+	VmaDefragmentationInfo2 info = {};
+	info.allocationCount = numAllocations;
+	info.pAllocations = allocations;
+	info.pAllocationsChanged = outAllocationsChanged;
+	// Only moved with the copies of the command buffer, the data is not read by the CPU
+	info.maxCpuBytesToMove = 0;
+	info.maxCpuAllocationsToMove = 0;
+	info.maxGpuBytesToMove = maxBytesToMove;
+	info.maxGpuAllocationsToMove = maxAllocationsToMove;
+	info.commandBuffer = static_cast<VkCommandBuffer>(commandBuffer);
+
+	VmaDefragmentationContext context = VK_NULL_HANDLE;
+	VkResult res = vmaDefragmentationBegin(mAllocator, &info, outStats, &context);
+
+	if (res < 0) {
+		throw std::runtime_error("Error! Can't defragment the memory!");
+	}
+	return context;
+}
+
+void MemoryManager::endDefragmentation(VmaDefragmentationContext context) const
+{
+	VkResult res = vmaDefragmentationEnd(mAllocator, context);
+
+	if (res < 0) {
+		throw std::runtime_error("Error! Can't end the defragmentation!");
+	}
+}
+
 void MemoryManager::destroy()
 {
 	vmaDestroyAllocator(mAllocator);
@@ -2,34 +2,67 @@
 
 #include <vulkan/vulkan.hpp>
 #include <vk_mem_alloc/vk_mem_alloc.h>
+#include <atomic>
+#include <memory>
+#include <vector>
 
 namespace gr
 {
 namespace vkg
 {
+	// What the memory of an allocation is used for, to track the usage
+	enum class MemoryCategory : uint32_t {
+		eMeshes = 0,
+		eTextures,
+		eUniforms,
+		eStaging,
+		eRenderTargets,
+		eOther
+	};
+	constexpr uint32_t NUM_MEMORY_CATEGORIES = 6;
+
 	class MemoryManager
 	{
 	public:
 
+		// Memory of a heap used by the application, and available to it
+		struct HeapBudget {
+			// Of the device memory blocks, and of the allocations inside them.
+			// The difference is free, or wasted by the fragmentation
+			vk::DeviceSize blockBytes;
+			vk::DeviceSize allocationBytes;
+			// Reported by VK_EXT_memory_budget, or estimated without it
+			vk::DeviceSize usage;
+			vk::DeviceSize budget;
+			vk::DeviceSize heapSize;
+			bool deviceLocal;
+		};
+
 		MemoryManager() = default;
 
 		MemoryManager(vk::Instance instance,
 			vk::PhysicalDevice physicalDevice,
-			vk::Device logicalDevice);
+			vk::Device logicalDevice,
+			bool memoryBudgetExtensionEnabled);
 
 
 		void createImageAllocation(const vk::ImageCreateInfo& imageInfo,
 			vk::MemoryPropertyFlags requiredProperties,
 			vk::MemoryPropertyFlags preferredProperties,
+			MemoryCategory category,
 			vk::Image* outImage, VmaAllocation* outAllocation,
 			VmaAllocationInfo* outAllocInfo = nullptr) const;
 
 		void createBufferAllocation(const vk::BufferCreateInfo& bufferInfo,
 			vk::MemoryPropertyFlags requiredProperties,
 			vk::MemoryPropertyFlags preferredProperties,
+			MemoryCategory category,
 			vk::Buffer* outBuffer, VmaAllocation* outAllocation,
 			VmaAllocationInfo* outAllocInfo = nullptr) const;
 
+		// Binds a new buffer to the memory of the allocation, i.e. after it has been moved
+		void bindBufferMemory(VmaAllocation allocation, vk::Buffer buffer) const;
+
 		void freeAllocation(VmaAllocation allocation) const;
 
 		void getAllocationInfo(VmaAllocation allocation,
@@ -39,16 +72,49 @@ namespace vkg
 
 		bool isMemoryMappable(VmaAllocation allocation) const;
 
+		// True on integrated GPUs and with resizable BAR, where the biggest device
+		// local heap is also host visible. The buffers can be written directly,
+		// without staging
+		bool isDeviceMemoryHostVisible() const { return mDeviceMemoryHostVisible; }
+
 		[[nodiscard]] void* mapMemory(VmaAllocation allocation) const;
 		
 		void unmapMemory(VmaAllocation allocation) const;
 
 		void flushAllocations(const VmaAllocation* allocations, uint32_t num) const;
 
+		// Thread safe, cheap enough to be called every frame
+		void getHeapBudgets(std::vector<HeapBudget>* outBudgets) const;
+		bool isMemoryBudgetEnabled() const { return mMemoryBudgetEnabled; }
+		// Bytes of the allocations of the category, including the alignment padding
+		vk::DeviceSize getCategoryBytes(MemoryCategory category) const {
+			return mCategoryBytes[static_cast<uint32_t>(category)].load(std::memory_order_relaxed);
+		}
+		static const char* s_getCategoryName(MemoryCategory category);
+
+		// Moves some of the allocations to compact the device memory, with copies
+		// recorded in the command buffer. It has to be submitted and finished before
+		// endDefragmentation. The allocations can not be used in between.
+		// The moved ones are set in outAllocationsChanged, and need new buffers.
+		// The outputs are written by endDefragmentation
+		VmaDefragmentationContext beginDefragmentation(const VmaAllocation* allocations,
+			uint32_t numAllocations, vk::DeviceSize maxBytesToMove, uint32_t maxAllocationsToMove,
+			vk::CommandBuffer commandBuffer, VkBool32* outAllocationsChanged,
+			VmaDefragmentationStats* outStats) const;
+		void endDefragmentation(VmaDefragmentationContext context) const;
+
 		void destroy();
 
 	private:
 		VmaAllocator mAllocator = {};
+		bool mDeviceMemoryHostVisible = false;
+		bool mMemoryBudgetEnabled = false;
+
+		// Allocations are created and freed from the jobs. The category
+		// of each allocation is kept in its user data
+		std::unique_ptr<std::atomic<vk::DeviceSize>[]> mCategoryBytes;
+
+		void findHostVisibleDeviceMemory();
 	};
 }; // namespace vkg
 }; // namespace gr
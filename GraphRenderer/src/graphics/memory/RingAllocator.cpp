@@ -0,0 +1,82 @@
+#include "RingAllocator.h"
+
+#include <cassert>
+
+namespace gr
+{
+namespace vkg
+{
+
+void RingAllocator::setCapacity(uint64_t capacity)
+{
+	assert(getUsedBytes() == 0);
+	mCapacity = capacity;
+}
+
+bool RingAllocator::allocate(uint64_t numBytes, uint64_t alignment, Allocation* outAllocation)
+{
+	assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+	assert(outAllocation != nullptr);
+	assert(numBytes > 0);
+
+	if (numBytes > mCapacity) {
+		return false;
+	}
+
+	uint64_t head = mHead.load(std::memory_order_relaxed);
+	uint64_t offset, end;
+	do {
+		const uint64_t headOffset = head % mCapacity;
+		offset = (headOffset + alignment - 1) & ~(alignment - 1);
+		// does not fit before the end, skip to the start of the ring
+		if (offset + numBytes > mCapacity) {
+			offset = 0;
+			end = head + (mCapacity - headOffset) + numBytes;
+		}
+		else {
+			end = head + (offset - headOffset) + numBytes;
+		}
+
+		// The freed space is published with release
+		if (end - mTail.load(std::memory_order_acquire) > mCapacity) {
+			return false;
+		}
+	} while (!mHead.compare_exchange_weak(head, end,
+		std::memory_order_relaxed, std::memory_order_relaxed));
+
+	outAllocation->offset = offset;
+	outAllocation->begin = head;
+	outAllocation->end = end;
+	return true;
+}
+
+void RingAllocator::free(const Allocation& allocation)
+{
+	assert(allocation.begin < allocation.end);
+	uint64_t tail = mTail.load(std::memory_order_relaxed);
+	assert(allocation.begin >= tail);
+
+	if (allocation.begin != tail) {
+		// previous allocations are still in use
+		mFreedRanges.emplace(allocation.begin, allocation.end);
+		return;
+	}
+
+	// The allocations are contiguous, advance over the freed ones
+	tail = allocation.end;
+	std::map<uint64_t, uint64_t>::iterator it = mFreedRanges.begin();
+	while (it != mFreedRanges.end() && it->first == tail) {
+		tail = it->second;
+		it = mFreedRanges.erase(it);
+	}
+
+	mTail.store(tail, std::memory_order_release);
+}
+
+uint64_t RingAllocator::getUsedBytes() const
+{
+	return mHead.load(std::memory_order_relaxed) - mTail.load(std::memory_order_relaxed);
+}
+
+} // namespace vkg
+} // namespace gr
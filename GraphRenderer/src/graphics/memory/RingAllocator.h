@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <stdint.h>
+
+namespace gr
+{
+namespace vkg
+{
+
+// Allocates ranges of a ring of bytes, i.e. of a persistently mapped staging buffer.
+// Allocations are lock free and can be done from any thread. They are freed in
+// any order, but their space is only reused once all the previous ones are freed.
+class RingAllocator
+{
+public:
+
+	struct Allocation {
+		// Offset of the data in the ring
+		uint64_t offset;
+		// Positions in the ring since its creation, they never wrap. The range
+		// includes the padding skipped for the alignment and at the end of the ring
+		uint64_t begin;
+		uint64_t end;
+	};
+
+	RingAllocator() = default;
+	RingAllocator(const RingAllocator&) = delete;
+	RingAllocator& operator=(const RingAllocator&) = delete;
+
+	void setCapacity(uint64_t capacity);
+	uint64_t getCapacity() const { return mCapacity; }
+
+	// Lock free. The alignment must be a power of two.
+	// Returns false if there is no contiguous free range
+	bool allocate(uint64_t numBytes, uint64_t alignment, Allocation* outAllocation);
+
+	// Not thread safe with other calls to free. Can run concurrently with allocate
+	void free(const Allocation& allocation);
+
+	// Bytes allocated and not reclaimed yet, including the padding
+	uint64_t getUsedBytes() const;
+
+private:
+	uint64_t mCapacity = 0;
+
+	std::atomic<uint64_t> mHead{ 0 };
+	// All the bytes before the tail are free
+	std::atomic<uint64_t> mTail{ 0 };
+
+	// Freed allocations after the tail, begin to end.
+	// Only accessed by the thread that frees
+	std::map<uint64_t, uint64_t> mFreedRanges;
+};
+
+} // namespace vkg
+} // namespace gr
@@ -12,7 +12,8 @@ class Buffer : public Allocatable
 {
 public:
 	Buffer() = default;
-	Buffer(vk::Buffer buffer, VmaAllocation alloc, vk::DeviceSize bytesSize) : Allocatable(alloc), mBuffer(buffer), mBytesSize(bytesSize) {}
+	Buffer(vk::Buffer buffer, VmaAllocation alloc, vk::DeviceSize bytesSize, vk::BufferUsageFlags usage = {}) :
+		Allocatable(alloc), mBuffer(buffer), mBytesSize(bytesSize), mUsage(usage) {}
 
 	void setVkBuffer(vk::Buffer buff) { mBuffer = buff; }
 
@@ -21,6 +22,9 @@ public:
 	void setSize(vk::DeviceSize bytesSize) { mBytesSize = bytesSize; }
 	vk::DeviceSize getSize() const { return mBytesSize; }
 
+	// To create the buffer again, if its memory is moved
+	vk::BufferUsageFlags getUsage() const { return mUsage; }
+
 	operator bool() const { return mBuffer; }
 
 	Buffer& operator=(std::nullptr_t) { mBuffer = nullptr; mBytesSize = 0; return *this; }
@@ -29,6 +33,7 @@ protected:
 
 	vk::Buffer mBuffer;
 	vk::DeviceSize mBytesSize;
+	vk::BufferUsageFlags mUsage;
 };
 
 }
@@ -1,5 +1,7 @@
 #include "Image2D.h"
 
+#include <algorithm>
+
 
 namespace gr
 {
@@ -11,5 +13,17 @@ Image2D::Image2D(uint32_t width, uint32_t height) :
 {
 }
 
+vk::Extent2D Image2D::getMipExtent(uint32_t mipLevel) const
+{
+	return vk::Extent2D(
+		std::max(mExtent.width >> mipLevel, 1u),
+		std::max(mExtent.height >> mipLevel, 1u));
+}
+
+bool Image2D::isBlockCompressed() const
+{
+	return mFormat >= vk::Format::eBc1RgbUnormBlock && mFormat <= vk::Format::eBc7SrgbBlock;
+}
+
 }; // namespace vkg
 }; // namespace gr
\ No newline at end of file
@@ -16,8 +16,20 @@ namespace vkg
 		void setExtent(vk::Extent2D extent) { mExtent = extent; }
 		const vk::Extent2D& getExtent() const { return mExtent; }
 
+		void setFormat(vk::Format format) { mFormat = format; }
+		vk::Format getFormat() const { return mFormat; }
+		// Block compressed formats are copied in blocks of 4x4 texels
+		bool isBlockCompressed() const;
+
+		void setMipLevels(uint32_t mipLevels) { mMipLevels = mipLevels; }
+		uint32_t getMipLevels() const { return mMipLevels; }
+		// Extent of a mip level, at least 1x1
+		vk::Extent2D getMipExtent(uint32_t mipLevel) const;
+
 	protected:
 		vk::Extent2D mExtent;
+		vk::Format mFormat = vk::Format::eUndefined;
+		uint32_t mMipLevels = 1;
 	};
 
 }; // namespace vkg
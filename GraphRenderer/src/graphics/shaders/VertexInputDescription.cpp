@@ -55,6 +55,84 @@ gr::vkg::VertexInputDescription::Binding& gr::vkg::VertexInputDescription::Bindi
 	return *this;
 }
 
+gr::vkg::VertexInputDescription::Binding& gr::vkg::VertexInputDescription::Binding::addAttribute8SNORM(uint32_t location, uint32_t numSigned, uint32_t offset)
+{
+	vk::Format format;
+	switch (numSigned)
+	{
+	case 1:
+		format = vk::Format::eR8Snorm;
+		break;
+	case 2:
+		format = vk::Format::eR8G8Snorm;
+		break;
+	case 3:
+		format = vk::Format::eR8G8B8Snorm;
+		break;
+	case 4:
+		format = vk::Format::eR8G8B8A8Snorm;
+		break;
+	default:
+		throw std::runtime_error("Binding attribute with non supported format");
+		break;
+	}
+
+	mAttributes.emplace_back(location, format, offset);
+	return *this;
+}
+
+gr::vkg::VertexInputDescription::Binding& gr::vkg::VertexInputDescription::Binding::addAttribute16UNORM(uint32_t location, uint32_t numUnsigned, uint32_t offset)
+{
+	vk::Format format;
+	switch (numUnsigned)
+	{
+	case 1:
+		format = vk::Format::eR16Unorm;
+		break;
+	case 2:
+		format = vk::Format::eR16G16Unorm;
+		break;
+	case 3:
+		format = vk::Format::eR16G16B16Unorm;
+		break;
+	case 4:
+		format = vk::Format::eR16G16B16A16Unorm;
+		break;
+	default:
+		throw std::runtime_error("Binding attribute with non supported format");
+		break;
+	}
+
+	mAttributes.emplace_back(location, format, offset);
+	return *this;
+}
+
+gr::vkg::VertexInputDescription::Binding& gr::vkg::VertexInputDescription::Binding::addAttributeHalf(uint32_t location, uint32_t numHalfs, uint32_t offset)
+{
+	vk::Format format;
+	switch (numHalfs)
+	{
+	case 1:
+		format = vk::Format::eR16Sfloat;
+		break;
+	case 2:
+		format = vk::Format::eR16G16Sfloat;
+		break;
+	case 3:
+		format = vk::Format::eR16G16B16Sfloat;
+		break;
+	case 4:
+		format = vk::Format::eR16G16B16A16Sfloat;
+		break;
+	default:
+		throw std::runtime_error("Binding attribute with non supported format");
+		break;
+	}
+
+	mAttributes.emplace_back(location, format, offset);
+	return *this;
+}
+
 gr::vkg::VertexInputDescription::Binding& gr::vkg::VertexInputDescription::addBinding(uint32_t bindId, uint32_t stride)
 {
 
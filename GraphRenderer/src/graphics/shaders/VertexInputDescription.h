@@ -58,6 +58,9 @@ public:
 
 		Binding& addAttributeFloat(uint32_t location, uint32_t numFloats, uint32_t offset);
 		Binding& addAttribute8UNORM(uint32_t location, uint32_t numUnsigned, uint32_t offset);
+		Binding& addAttribute8SNORM(uint32_t location, uint32_t numSigned, uint32_t offset);
+		Binding& addAttribute16UNORM(uint32_t location, uint32_t numUnsigned, uint32_t offset);
+		Binding& addAttributeHalf(uint32_t location, uint32_t numHalfs, uint32_t offset);
 
 	private:
 		uint32_t mBindId;
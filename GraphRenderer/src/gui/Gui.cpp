@@ -6,6 +6,8 @@
 #include <imgui/imgui.h>
 #include <ImGuiFileDialog/ImGuiFileDialog.h>
 #include <iostream>
+#include <algorithm>
+#include <cstdio>
 
 namespace gr
 {
@@ -572,6 +574,12 @@ void Gui::drawWindows(FrameContext* fc)
         ImGui::End();
     }
 
+    if (mWindowMemoryOpen) {
+        ImGui::Begin("Memory", &this->mWindowMemoryOpen);
+        drawMemoryWindow(fc);
+        ImGui::End();
+    }
+
     drawResourcesWindows(fc);
 
     drawSceneWindow(fc);
@@ -647,18 +655,25 @@ void Gui::drawMainMenuBar(FrameContext* fc)
                 );
 
             }
-            if (ImGui::MenuItem("Import image", nullptr,
-                nullptr, !mFilePickerInUse && projectLoaded)) {
-
-                mFilePickerInUse = true;
-                // open dialog
-                ImGuiFileDialog::Instance()->OpenDialog(
-                    IMPORT_TEX_STRING_KEY,
-                    "Choose image to load",
-                    ".png", // filter
-                    "." // directory
-                );
-
+            // The compression is chosen on import, it can be changed in the inspector
+            if (ImGui::BeginMenu("Import image", !mFilePickerInUse && projectLoaded)) {
+                for (uint32_t i = 0; i < Texture::NUM_COMPRESSIONS; ++i) {
+                    const Texture::Compression compression = static_cast<Texture::Compression>(i);
+                    if (ImGui::MenuItem(Texture::s_getCompressionName(compression))) {
+                        mImportTextureCompression = compression;
+                        mFilePickerInUse = true;
+                        // open dialog
+                        // The images are decoded concurrently, several can be selected
+                        ImGuiFileDialog::Instance()->OpenDialog(
+                            IMPORT_TEX_STRING_KEY,
+                            "Choose images to load",
+                            ".png,.jpg,.jpeg,.tga,.bmp,.hdr", // filter
+                            ".", // directory
+                            0 // any number of files
+                        );
+                    }
+                }
+                ImGui::EndMenu();
             }
             if (ImGui::MenuItem("Import SPIR-V", nullptr,
                 nullptr, !mFilePickerInUse && projectLoaded)) {
@@ -720,6 +735,7 @@ void Gui::drawMainMenuBar(FrameContext* fc)
             ImGui::MenuItem("Inspector", nullptr, &this->mWindowInspectorOpen);
             ImGui::MenuItem("Metrics", nullptr, &this->mWindowImGuiMetricsOpen);
             ImGui::MenuItem("Style", nullptr, &this->mWindowStyleEditor);
+            ImGui::MenuItem("Memory", nullptr, &this->mWindowMemoryOpen);
             ImGui::EndMenu();
         }
 
@@ -832,15 +848,17 @@ void Gui::drawFilePicker(FrameContext* fc)
         {
             std::map<std::string, std::string> map =
                 ImGuiFileDialog::Instance()->GetSelection();
-            assert(map.size() == 1);
 
-            Texture* tex;
-            fc->gc().getDict().allocateObject(
-                fc,
-                map.begin()->first,
-                &tex
-            );
-            tex->load(fc, map.begin()->second.c_str());
+            for (const std::pair<const std::string, std::string>& file : map) {
+                Texture* tex;
+                fc->gc().getDict().allocateObject(
+                    fc,
+                    file.first,
+                    &tex
+                );
+                tex->setCompression(mImportTextureCompression);
+                tex->load(fc, file.second.c_str());
+            }
         }
 
         // close
@@ -1009,7 +1027,7 @@ void Gui::drawSceneWindow(FrameContext* fc)
 
 }
 
-bool Gui::appendRenamePopupItem(FrameContext* fc, const std::string& name)
+bool Gui::appendRenamePopupItem(FrameContext* fc, std::string_view name)
 {
     bool retValue = false;
 
@@ -1018,7 +1036,7 @@ bool Gui::appendRenamePopupItem(FrameContext* fc, const std::string& name)
     if (ImGui::BeginPopupContextItem()) {
         bool closePopup = false;
         if (mRenameId != id) {
-            mRenameString = name;
+            mRenameString.assign(name);
             mRenameId = id;
         }
         const bool canRenamePre = mRenameString == fc->gc().getDict().getName(mRenameId);
@@ -1112,6 +1130,128 @@ int Gui::s_stringTextCallback(void* data_) {
 }
 
 
+void Gui::drawMeshMemorySummary(FrameContext* fc)
+{
+    vk::DeviceSize indexSaved = 0, vertexSaved = 0;
+    std::vector<ResId> ids;
+    fc->gc().getDict().getAllObjectsOfType<Mesh>(&ids);
+    for (const ResId& id : ids) {
+        if (const Mesh* mesh = fc->gc().getDict().get(ResHandle<Mesh>(id))) {
+            indexSaved += mesh->getIndexMemorySaved();
+            vertexSaved += mesh->getVertexMemorySaved();
+        }
+    }
+
+    constexpr float MB = 1024.0f * 1024.0f;
+    ImGui::Text("Memory saved: %.2f MB indices, %.2f MB vertices",
+        static_cast<float>(indexSaved) / MB, static_cast<float>(vertexSaved) / MB);
+    ImGui::SameLine();
+    helpMarker("Saved by the 16 bit indices and the compact vertex formats,\n"
+        "compared to 32 bit indices and float vertices");
+
+    const uint32_t numLoading = fc->gc().getLoader().getNumLoading();
+    if (numLoading > 0) {
+        ImGui::Text("Loading %u resources", numLoading);
+    }
+}
+
+void Gui::drawMeshLoadState(FrameContext* fc, ResId id)
+{
+    const Mesh* mesh = fc->gc().getDict().get(ResHandle<Mesh>(id));
+    if (mesh == nullptr) {
+        return;
+    }
+
+    const Mesh::LoadStage stage = mesh->getLoadStage();
+    if (mesh->isLoading()) {
+        ImGui::SameLine();
+        ImGui::ProgressBar(mesh->getLoadProgress(), ImVec2(-1.0f, 0.0f),
+            Mesh::s_getLoadStageName(stage));
+    }
+    else if (stage == Mesh::LoadStage::eFailed) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("(failed)");
+    }
+}
+
+void Gui::drawMemoryWindow(FrameContext* fc)
+{
+    const vkg::MemoryManager& memory = fc->rc().getMemoryManager();
+    constexpr float MB = 1024.0f * 1024.0f;
+
+    std::vector<vkg::MemoryManager::HeapBudget> budgets;
+    memory.getHeapBudgets(&budgets);
+
+    ImGui::TextDisabled("Heaps");
+    ImGui::SameLine();
+    helpMarker(memory.isMemoryBudgetEnabled() ?
+        "Usage and budget reported by VK_EXT_memory_budget" :
+        "VK_EXT_memory_budget not supported,\nthe usage and budget are estimated");
+    for (uint32_t i = 0; i < budgets.size(); ++i) {
+        const vkg::MemoryManager::HeapBudget& budget = budgets[i];
+        ImGui::Text("Heap %u (%s), %.0f MB", i, budget.deviceLocal ? "device" : "host",
+            static_cast<float>(budget.heapSize) / MB);
+
+        char overlay[64];
+        std::snprintf(overlay, sizeof(overlay), "%.2f / %.2f MB",
+            static_cast<float>(budget.usage) / MB, static_cast<float>(budget.budget) / MB);
+        const float fraction = budget.budget > 0 ?
+            static_cast<float>(budget.usage) / static_cast<float>(budget.budget) : 0.0f;
+        ImGui::ProgressBar(std::min(fraction, 1.0f), ImVec2(-1.0f, 0.0f), overlay);
+
+        ImGui::Text("Allocated %.2f MB in blocks of %.2f MB",
+            static_cast<float>(budget.allocationBytes) / MB,
+            static_cast<float>(budget.blockBytes) / MB);
+    }
+
+    ImGui::Separator();
+    ImGui::TextDisabled("Usage");
+    for (uint32_t i = 0; i < vkg::NUM_MEMORY_CATEGORIES; ++i) {
+        const vkg::MemoryCategory category = static_cast<vkg::MemoryCategory>(i);
+        ImGui::Text("%s: %.2f MB", vkg::MemoryManager::s_getCategoryName(category),
+            static_cast<float>(memory.getCategoryBytes(category)) / MB);
+    }
+
+    ImGui::Separator();
+    BufferDefragmenter& defragmenter = fc->gc().getDefragmenter();
+    bool enabled = defragmenter.isEnabled();
+    if (ImGui::Checkbox("Defragment mesh buffers", &enabled)) {
+        defragmenter.setEnabled(enabled);
+    }
+    ImGui::SameLine();
+    helpMarker("In the frames without loads, the mesh buffers are moved\n"
+        "to compact the device memory. Each pass waits for the GPU");
+    const VmaDefragmentationStats& stats = defragmenter.getTotalStats();
+    ImGui::Text("Passes: %u, moved %u buffers, %.2f MB",
+        defragmenter.getNumPasses(), stats.allocationsMoved,
+        static_cast<float>(stats.bytesMoved) / MB);
+    ImGui::Text("Freed %u blocks, %.2f MB",
+        stats.deviceMemoryBlocksFreed, static_cast<float>(stats.bytesFreed) / MB);
+}
+
+void Gui::drawTextureStreamingSummary(FrameContext* fc)
+{
+    TextureStreamer& streamer = fc->gc().getTextureStreamer();
+
+    constexpr float MB = 1024.0f * 1024.0f;
+    ImGui::Text("Texture memory: %.2f / %.2f MB",
+        static_cast<float>(streamer.getUsedBytes()) / MB,
+        static_cast<float>(streamer.getBudget()) / MB);
+    if (streamer.getNumStreaming() > 0) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("(streaming %u)", streamer.getNumStreaming());
+    }
+
+    int budgetMB = static_cast<int>(streamer.getBudget() >> 20);
+    if (ImGui::SliderInt("Budget (MB)", &budgetMB, 16, 4096)) {
+        streamer.setBudget(static_cast<vk::DeviceSize>(budgetMB) << 20);
+    }
+    ImGui::SameLine();
+    helpMarker("The compressed textures are loaded with their smallest mips, and the bigger ones\n"
+        "are streamed by their size on screen. Once over the budget, the mips\n"
+        "of the least recently used textures are evicted");
+}
+
 void Gui::helpMarker(const char* text)
 {
     ImGui::TextDisabled("(?)");
@@ -1140,15 +1280,26 @@ inline void Gui::drawResourcesWindows_t(FrameContext* fc)
                 fc->gc().getDict().allocateObject<Type>(fc, name);
             }
 
+            if constexpr (std::is_same<Type, Mesh>::value) {
+                drawMeshMemorySummary(fc);
+            }
+            else if constexpr (std::is_same<Type, Texture>::value) {
+                drawTextureStreamingSummary(fc);
+            }
+
             ImGui::Separator();
 
-            for (const ResId& id :
-                fc->gc().getDict().getAllObjectsOfType<Type>()) {
+            // the objects may be erased while they are listed
+            std::vector<ResId> ids;
+            fc->gc().getDict().getAllObjectsOfType<Type>(&ids);
+            for (const ResId& id : ids) {
 
                 std::string idStr = std::to_string(id);
                 ImGui::PushID(idStr.c_str());
-                std::string name = fc->gc().getDict().getName(id);
-                std::string label = name + "###" + idStr;
+                std::string_view name = fc->gc().getDict().getName(id);
+                std::string label;
+                label.reserve(name.size() + 3 + idStr.size());
+                label.append(name).append("###").append(idStr);
                 if (ImGui::Button(label.c_str())) {
 
                     // if is scene...
@@ -1166,12 +1317,16 @@ inline void Gui::drawResourcesWindows_t(FrameContext* fc)
                     ImGui::SetDragDropPayload(windowName,
                         &id, sizeof(ResId));
                     // Display preview text
-                    ImGui::Text(name.c_str());
+                    ImGui::TextUnformatted(name.data(), name.data() + name.size());
                     ImGui::EndDragDropSource();
                 }
 
                 appendRenamePopupItem(fc, name);
 
+                if constexpr (std::is_same<Type, Mesh>::value) {
+                    drawMeshLoadState(fc, id);
+                }
+
                 ImGui::PopID();
 
             }
@@ -35,7 +35,7 @@ public:
 
 	// make sure to push id before
 	// returns true if need to reload resId and check for existance
-	bool appendRenamePopupItem(FrameContext* fc, const std::string& name);
+	bool appendRenamePopupItem(FrameContext* fc, std::string_view name);
 
 protected:
 
@@ -55,10 +55,12 @@ protected:
 	bool mWireframeModeEnabled = false;
 
 	bool mFilePickerInUse = false;
+	Texture::Compression mImportTextureCompression = Texture::Compression::eNone;
 
 	bool mCloseAppFlag = false;
 	bool mWindowImGuiMetricsOpen = false;
 	bool mWindowStyleEditor = false;
+	bool mWindowMemoryOpen = false;
 	bool mWindowMeshesOpen = false;
 	bool mWindowTexturesOpen = false;
 	bool mWindowInspectorOpen = true;
@@ -79,6 +81,15 @@ protected:
 	void drawResourcesWindows(FrameContext* fc);
 	void drawInspectorWindow(FrameContext* fc);
 	void drawSceneWindow(FrameContext* fc);
+	// Budget of the memory heaps, usage by category, and defragmentation
+	void drawMemoryWindow(FrameContext* fc);
+	// Memory saved by the compact formats of all the meshes of the project,
+	// and number of resources loading
+	void drawMeshMemorySummary(FrameContext* fc);
+	// Progress of the mesh while it loads in the background
+	void drawMeshLoadState(FrameContext* fc, ResId id);
+	// Memory of the textures respect the budget of the streamer
+	void drawTextureStreamingSummary(FrameContext* fc);
 
 	void helpMarker(const char* text);
 
@@ -0,0 +1,67 @@
+#include "BufferDefragmenter.h"
+
+#include "Mesh.h"
+#include "ResourceDictionary.h"
+#include "../control/FrameContext.h"
+
+namespace gr
+{
+
+// Frames between passes, each pass waits for the device to be idle
+constexpr uint64_t PASS_INTERVAL_FRAMES = 120;
+// The copies of a pass are kept short
+constexpr vk::DeviceSize MAX_BYTES_PER_PASS = 32ull << 20;
+constexpr uint32_t MAX_BUFFERS_PER_PASS = 64;
+// Free space inside the device memory blocks worth compacting
+constexpr vk::DeviceSize MIN_FREE_BYTES = 16ull << 20;
+
+void BufferDefragmenter::update(FrameContext* fc)
+{
+	const uint64_t frame = fc->getFrameCount();
+	if (!mEnabled || frame - mLastPassFrame < PASS_INTERVAL_FRAMES) {
+		return;
+	}
+
+	// Nothing is allocating device memory in the background
+	if (fc->gc().getLoader().getNumLoading() > 0 ||
+		fc->gc().getTextureStreamer().getNumStreaming() > 0) {
+		return;
+	}
+
+	fc->rc().getMemoryManager().getHeapBudgets(&mBudgets);
+	vk::DeviceSize blockBytes = 0;
+	vk::DeviceSize allocationBytes = 0;
+	for (const vkg::MemoryManager::HeapBudget& budget : mBudgets) {
+		if (budget.deviceLocal) {
+			blockBytes += budget.blockBytes;
+			allocationBytes += budget.allocationBytes;
+		}
+	}
+	if (allocationBytes == mCompactedBytes || blockBytes - allocationBytes < MIN_FREE_BYTES) {
+		return;
+	}
+
+	ResourceDictionary& dict = fc->gc().getDict();
+	mBuffers.clear();
+	dict.getAllObjectsOfType<Mesh>(&mMeshes);
+	for (const ResId& id : mMeshes) {
+		dict.get(ResHandle<Mesh>(id))->getMovableBuffers(&mBuffers);
+	}
+
+	mLastPassFrame = frame;
+	const VmaDefragmentationStats stats = fc->rc().defragmentBuffers(
+		mBuffers.data(), static_cast<uint32_t>(mBuffers.size()),
+		MAX_BYTES_PER_PASS, MAX_BUFFERS_PER_PASS);
+
+	mNumPasses += 1;
+	mTotalStats.bytesMoved += stats.bytesMoved;
+	mTotalStats.bytesFreed += stats.bytesFreed;
+	mTotalStats.allocationsMoved += stats.allocationsMoved;
+	mTotalStats.deviceMemoryBlocksFreed += stats.deviceMemoryBlocksFreed;
+
+	if (stats.allocationsMoved == 0) {
+		mCompactedBytes = allocationBytes;
+	}
+}
+
+} // namespace gr
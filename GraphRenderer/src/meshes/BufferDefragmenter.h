@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include <vulkan/vulkan.hpp>
+
+#include "ResourcesHeader.h"
+#include "../graphics/memory/MemoryManager.h"
+
+namespace gr
+{
+
+class FrameContext;
+namespace vkg { class Buffer; }
+
+// Compacts the device memory of the mesh buffers, that gets fragmented as the
+// meshes are loaded and erased. In idle frames, without resources loading or
+// textures streaming, a pass moves a few buffers, stalling the GPU for the copies.
+// Once a pass moves nothing, they stop until the allocated memory changes.
+// Only used from the main thread.
+class BufferDefragmenter
+{
+public:
+
+	BufferDefragmenter() = default;
+	BufferDefragmenter(const BufferDefragmenter&) = delete;
+	BufferDefragmenter& operator=(const BufferDefragmenter&) = delete;
+
+	// Called once per frame, before the scene is updated,
+	// so that the draws use the moved buffers
+	void update(FrameContext* fc);
+
+	void setEnabled(bool enabled) { mEnabled = enabled; }
+	bool isEnabled() const { return mEnabled; }
+
+	// Of all the passes
+	const VmaDefragmentationStats& getTotalStats() const { return mTotalStats; }
+	uint32_t getNumPasses() const { return mNumPasses; }
+
+private:
+
+	bool mEnabled = true;
+	uint64_t mLastPassFrame = 0;
+	// Allocated bytes of the device local heaps when the last pass moved nothing
+	vk::DeviceSize mCompactedBytes = 0;
+
+	uint32_t mNumPasses = 0;
+	VmaDefragmentationStats mTotalStats = {};
+
+	// Scratch storage of the update, reused every pass
+	std::vector<ResId> mMeshes;
+	std::vector<vkg::Buffer*> mBuffers;
+	std::vector<vkg::MemoryManager::HeapBudget> mBudgets;
+};
+
+} // namespace gr
@@ -16,13 +16,34 @@
 namespace gr
 {
 
-void GameObject::scheduleDestroy(FrameContext* fc)
+GameObject::GameObject(GameObject&& o) :
+    IObject(o),
+    mLoadedTransform(std::move(o.mLoadedTransform)),
+    mLoadedAddons(std::move(o.mLoadedAddons))
 {
-    mTransform.destroy(fc);
+    assert(o.mStorage == nullptr);
+}
+
+GameObject::~GameObject()
+{
+    if (mStorage != nullptr) {
+        mStorage->destroyEntity(mEntity);
+    }
+}
 
-    for (decltype(mAddons)::iterator it = mAddons.begin(); it != mAddons.end(); ++it) {
-        it->second->destroy(fc);
+void GameObject::scheduleDestroy(FrameContext* fc)
+{
+    if (mStorage == nullptr) {
+        return;
     }
+
+    mStorage->forEachAddonOf(mEntity, [fc](addon::IAddon& addon) {
+        addon.destroy(fc);
+    });
+
+    mStorage->destroyEntity(mEntity);
+    mStorage = nullptr;
+    mEntity = addon::NULL_ENTITY;
 }
 
 void GameObject::renderImGui(FrameContext* fc, Gui* gui)
@@ -33,32 +54,25 @@ void GameObject::renderImGui(FrameContext* fc, Gui* gui)
     // ADDONS
     ImGui::Separator();
 
-    mTransform.drawImGuiInspector(fc, this);
-
-    for (decltype(mAddons)::iterator it = mAddons.begin(); it != mAddons.end(); ++it) {
-        it->second->drawImGuiInspector(fc, this);
-    }
+    mStorage->forEachAddonOf(mEntity, [fc, this](addon::IAddon& addon) {
+        addon.drawImGuiInspector(fc, this);
+    });
 
     ImGui::Separator();
     ImGui::Button("Append addon");
     if (ImGui::BeginPopupContextItem(0, ImGuiPopupFlags_MouseButtonLeft)) {
-        std::pair<decltype(mAddons)::iterator, bool> insertRes;
         if (ImGui::Button(addon::Camera::s_getAddonName())) {
-            insertRes = mAddons.emplace(addon::Camera::s_getAddonName(), new addon::Camera());
+            addAddon<addon::Camera>(fc);
             ImGui::CloseCurrentPopup();
         }
         if (ImGui::Button(addon::Renderable::s_getAddonName())) {
-            insertRes = mAddons.emplace(addon::Renderable::s_getAddonName(), new addon::Renderable());
+            addAddon<addon::Renderable>(fc);
             ImGui::CloseCurrentPopup();
         }
         if (ImGui::Button(addon::SimplePlayerControl::s_getAddonName())) {
-            insertRes = mAddons.emplace(addon::SimplePlayerControl::s_getAddonName(), new addon::SimplePlayerControl());
+            addAddon<addon::SimplePlayerControl>(fc);
             ImGui::CloseCurrentPopup();
         }
-        
-        if (insertRes.second) {
-            insertRes.first->second->start(fc);
-        }
 
         ImGui::EndPopup();
     }
@@ -66,28 +80,35 @@ void GameObject::renderImGui(FrameContext* fc, Gui* gui)
 
 void GameObject::start(FrameContext* fc)
 {
-    for (decltype(mAddons)::iterator it = mAddons.begin(); it != mAddons.end(); ++it) {
-        it->second->start(fc);
+    if (mStorage == nullptr) {
+        // move the loaded addons into the storage
+        mStorage = &fc->gc().getAddonStorage();
+        mEntity = mStorage->createEntity(this);
+
+        mStorage->emplace<addon::Transform>(mEntity, std::move(mLoadedTransform));
+        for (std::unique_ptr<addon::IAddon>& addon : mLoadedAddons) {
+            mStorage->emplace(mEntity, std::move(addon));
+        }
+        mLoadedAddons.clear();
     }
-    mTransform.start(fc);
+
+    mStorage->forEachAddonOf(mEntity, [fc](addon::IAddon& addon) {
+        addon.start(fc);
+    });
 }
 
 void GameObject::graphicsUpdate(FrameContext* fc, const SceneRenderContext& src)
 {
-    mTransform.updateBeforeRender(fc, this, src);
-
-    for (decltype(mAddons)::iterator it = mAddons.begin(); it != mAddons.end(); ++it) {
-        it->second->updateBeforeRender(fc, this, src);
-    }
+    mStorage->forEachAddonOf(mEntity, [fc, &src, this](addon::IAddon& addon) {
+        addon.updateBeforeRender(fc, this, src);
+    });
 }
 
 void GameObject::logicUpdate(FrameContext* fc)
 {
-    mTransform.update(fc, this);
-
-    for (decltype(mAddons)::iterator it = mAddons.begin(); it != mAddons.end(); ++it) {
-        it->second->update(fc, this);
-    }
+    mStorage->forEachAddonOf(mEntity, [fc, this](addon::IAddon& addon) {
+        addon.update(fc, this);
+    });
 }
 
 
@@ -2,12 +2,13 @@
 #include "IObject.h"
 
 #include <glm/glm.hpp>
-#include <map>
+#include <vector>
 
 #include "../graphics/resources/Buffer.h"
 
 #include "GameObjectAddons/IAddon.h"
 #include "GameObjectAddons/Transform.h"
+#include "GameObjectAddons/AddonStorage.h"
 
 namespace gr
 {
@@ -16,7 +17,12 @@ class GameObject :
 {
 public:
     GameObject() = default;
+    GameObject(const GameObject&) = delete;
+    GameObject& operator=(const GameObject&) = delete;
+    // Only GameObjects not started can be moved, the AddonStorage points to its owners
+    GameObject(GameObject&& o);
 
+    ~GameObject();
 
     void scheduleDestroy(FrameContext* fc) override;
     void renderImGui(FrameContext* fc, Gui* gui) override;
@@ -24,10 +30,14 @@ public:
 
     static constexpr const char* s_getClassName() { return "GameObjects"; }
 
+    // Per object update through the IAddon interface.
+    // The scene updates the addons in bulk from the AddonStorage instead.
     void graphicsUpdate(FrameContext* fc, const SceneRenderContext& src);
 
     void logicUpdate(FrameContext* fc);
 
+    addon::EntityId getEntity() const { return mEntity; }
+
     template <typename Addon>
     Addon* getAddon();
     template <typename Addon>
@@ -38,23 +48,48 @@ public:
 
 protected:
 
-    // addons
-    addon::Transform mTransform;
+    // addons, stored in the AddonStorage once started
+    addon::AddonStorage* mStorage = nullptr;
+    addon::EntityId mEntity = addon::NULL_ENTITY;
 
-    std::map<const char*, std::unique_ptr<addon::IAddon>> mAddons;
+    // addons loaded before the object is started
+    addon::Transform mLoadedTransform;
+    std::vector<std::unique_ptr<addon::IAddon>> mLoadedAddons;
 
     // Serialization functions
 
+    // cereal only needs a pointer to save polymorphic addons
+    struct NonOwningAddonDeleter {
+        void operator()(addon::IAddon*) const {}
+    };
+
     template<class Archive>
     void save(Archive& ar) const
     {
         ar(cereal::base_class<IObject>(this));
-        ar(GR_SERIALIZE_NVP_MEMBER(mTransform));
 
-        uint32_t numAddons = static_cast<uint32_t>(mAddons.size());
+        if (mStorage == nullptr) {
+            ar(cereal::make_nvp("Transform", mLoadedTransform));
+            uint32_t numAddons = static_cast<uint32_t>(mLoadedAddons.size());
+            ar(numAddons);
+            for (const std::unique_ptr<addon::IAddon>& ty : mLoadedAddons) {
+                ar(ty);
+            }
+            return;
+        }
+
+        ar(cereal::make_nvp("Transform", *getAddon<addon::Transform>()));
+
+        std::vector<std::unique_ptr<addon::IAddon, NonOwningAddonDeleter>> addons;
+        mStorage->forEachAddonOf(mEntity, [&addons](const addon::IAddon& a) {
+            addons.emplace_back(const_cast<addon::IAddon*>(&a));
+        });
+
+        // transform is always the first
+        uint32_t numAddons = static_cast<uint32_t>(addons.size()) - 1;
         ar(numAddons);
-        for (decltype(mAddons)::const_iterator it = mAddons.begin(); it != mAddons.end(); ++it) {
-            ar(it->second);
+        for (uint32_t i = 1; i < static_cast<uint32_t>(addons.size()); ++i) {
+            ar(addons[i]);
         }
     }
 
@@ -62,15 +97,14 @@ protected:
     void load(Archive& ar)
     {
         ar(cereal::base_class<IObject>(this));
-        ar(GR_SERIALIZE_NVP_MEMBER(mTransform));
+        ar(cereal::make_nvp("Transform", mLoadedTransform));
 
         uint32_t numAddons;
         ar(numAddons);
-        decltype(mAddons)::mapped_type ty;
+        std::unique_ptr<addon::IAddon> ty;
         while (numAddons-- > 0) {
             ar(ty);
-            const char* name = ty->getAddonName();
-            mAddons.emplace(name, std::move(ty));
+            mLoadedAddons.push_back(std::move(ty));
         }
 
     }
@@ -81,39 +115,31 @@ protected:
 template<typename Addon>
 inline Addon* gr::GameObject::getAddon()
 {
-
-    decltype(mAddons)::iterator it = mAddons.find(Addon::s_getAddonName());
-    if (it != mAddons.end()) {
-        return reinterpret_cast<Addon*>(it->second.get());
+    if (mStorage == nullptr) {
+        return nullptr;
     }
-    return nullptr;
+    return mStorage->get<Addon>(mEntity);
 }
 
 template<typename Addon>
 inline const Addon* gr::GameObject::getAddon() const
 {
-    decltype(mAddons)::const_iterator it = mAddons.find(Addon::s_getAddonName());
-    if (it != mAddons.end()) {
-        return it->second.get();
+    if (mStorage == nullptr) {
+        return nullptr;
     }
-    return nullptr;
-}
-
-template<>
-inline addon::Transform* gr::GameObject::getAddon<addon::Transform>() {
-    return &mTransform;
-}
-template<>
-inline const addon::Transform* gr::GameObject::getAddon<addon::Transform>() const {
-    return &mTransform;
+    return const_cast<const addon::AddonStorage*>(mStorage)->get<Addon>(mEntity);
 }
 
 template<typename Addon>
 inline bool gr::GameObject::addAddon(FrameContext* fc)
 {
-    auto it = mAddons.emplace(Addon::s_getAddonName(), new Addon());
-    it.first->second->start(fc);
-    return it.second;
+    assert(mStorage != nullptr);
+    Addon* addon = mStorage->emplace<Addon>(mEntity);
+    if (addon == nullptr) {
+        return false;
+    }
+    addon->start(fc);
+    return true;
 }
 
 template<>
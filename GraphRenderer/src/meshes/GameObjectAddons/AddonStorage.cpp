@@ -0,0 +1,63 @@
+#include "AddonStorage.h"
+
+namespace gr {
+namespace addon {
+
+EntityId AddonStorage::createEntity(GameObject* owner)
+{
+	std::unique_lock lock(mStructureMutex);
+
+	EntityId e;
+	if (!mFreeEntities.empty()) {
+		e = mFreeEntities.back();
+		mFreeEntities.pop_back();
+		mOwners[e] = owner;
+		mActiveStamps[e] = std::numeric_limits<uint64_t>::max();
+	}
+	else {
+		e = static_cast<EntityId>(mOwners.size());
+		mOwners.push_back(owner);
+		mActiveStamps.push_back(std::numeric_limits<uint64_t>::max());
+	}
+
+	return e;
+}
+
+void AddonStorage::destroyEntity(EntityId e)
+{
+	std::unique_lock lock(mStructureMutex);
+	assert(e < mOwners.size() && mOwners[e] != nullptr);
+
+	forEachPool([e](auto& pool) { pool.erase(e); });
+
+	mOwners[e] = nullptr;
+	mActiveStamps[e] = std::numeric_limits<uint64_t>::max();
+	mFreeEntities.push_back(e);
+}
+
+IAddon* AddonStorage::emplace(EntityId e, std::unique_ptr<IAddon>&& addon)
+{
+	assert(addon);
+	std::unique_lock lock(mStructureMutex);
+
+	IAddon* res = nullptr;
+	bool found = false;
+	forEachPool([&](auto& pool) {
+		using Addon = std::remove_reference_t<decltype(*pool.data())>;
+		if (found) {
+			return;
+		}
+		if (Addon* casted = dynamic_cast<Addon*>(addon.get())) {
+			found = true;
+			res = pool.emplace(e, mOwners[e], std::move(*casted));
+		}
+	});
+
+	assert(found); // Addon type not added to the storage
+	addon.reset();
+
+	return res;
+}
+
+} // namespace addon
+} // namespace gr
@@ -0,0 +1,310 @@
+#pragma once
+
+#include <vector>
+#include <tuple>
+#include <mutex>
+#include <memory>
+#include <limits>
+#include <cassert>
+
+#include "IAddon.h"
+#include "Transform.h"
+#include "Camera.h"
+#include "Renderable.h"
+#include "SimplePlayerControl.h"
+#include "../../utils/ConstExprHelp.h"
+#include "../../utils/JobGraph.h"
+
+namespace gr {
+
+class GameObject;
+
+namespace addon {
+
+// Index of a GameObject inside the AddonStorage
+typedef uint32_t EntityId;
+constexpr EntityId NULL_ENTITY = std::numeric_limits<EntityId>::max();
+
+// Add here new addon types, in the same order as the pools of AddonStorage
+using AddonTypesList =
+typename ctools::TypelistBuilder<Transform, Camera, Renderable, SimplePlayerControl>::typelist;
+
+// Set of addon types accessed by a system, one bit per type
+typedef grjob::JobGraph::ResourceMask AddonMask;
+
+template<typename ...Addons>
+constexpr AddonMask addonMask() {
+	static_assert(((ctools::indexOf<AddonTypesList, Addons>() != static_cast<size_t>(-1)) && ...),
+		"Addon type not in AddonTypesList");
+	return (AddonMask(0) | ... | (AddonMask(1) << ctools::indexOf<AddonTypesList, Addons>()));
+}
+
+// Sparse set of addons of the same type.
+// The addons are kept packed in a contiguous array, so that systems
+// can iterate them linearly. The sparse array maps an entity to its
+// position in the packed array.
+template<typename Addon>
+class AddonPool
+{
+public:
+
+	bool contains(EntityId e) const {
+		return e < mSparse.size() && mSparse[e] != NULL_ENTITY;
+	}
+
+	// The pointers to the addons are only valid until the next emplace or erase
+	// of the pool, that move them in the packed array. The entity is the handle
+	// to keep, and get the addon again
+	Addon* get(EntityId e) {
+		return contains(e) ? &mDense[mSparse[e]] : nullptr;
+	}
+	const Addon* get(EntityId e) const {
+		return contains(e) ? &mDense[mSparse[e]] : nullptr;
+	}
+
+	// Returns nullptr if the entity already has an addon of this type.
+	// The pointer is only valid until the next emplace or erase, see get
+	Addon* emplace(EntityId e, GameObject* owner, Addon&& addon);
+
+	// Moves the last addon into the freed slot
+	void erase(EntityId e);
+
+	uint32_t size() const { return static_cast<uint32_t>(mDense.size()); }
+
+	Addon* data() { return mDense.data(); }
+	const Addon* data() const { return mDense.data(); }
+	GameObject* const* owners() const { return mOwners.data(); }
+	const EntityId* entities() const { return mEntities.data(); }
+
+private:
+	std::vector<uint32_t> mSparse;
+
+	// packed arrays, all of the same size
+	std::vector<Addon> mDense;
+	std::vector<GameObject*> mOwners;
+	std::vector<EntityId> mEntities;
+};
+
+// Data oriented storage of all the addons of the GameObjects.
+// Reads are lock free, but adding or removing entities/addons must not
+// overlap with the update of the scene.
+class AddonStorage
+{
+public:
+
+	AddonStorage() = default;
+	AddonStorage& operator=(const AddonStorage&) = delete;
+
+	EntityId createEntity(GameObject* owner);
+	// Removes the entity and all its addons, without calling IAddon::destroy
+	void destroyEntity(EntityId e);
+
+	GameObject* getOwner(EntityId e) const { return mOwners[e]; }
+
+	template<typename Addon>
+	AddonPool<Addon>& getPool() { return std::get<AddonPool<Addon>>(mPools); }
+	template<typename Addon>
+	const AddonPool<Addon>& getPool() const { return std::get<AddonPool<Addon>>(mPools); }
+
+	template<typename Addon>
+	Addon* get(EntityId e) { return getPool<Addon>().get(e); }
+	template<typename Addon>
+	const Addon* get(EntityId e) const { return getPool<Addon>().get(e); }
+
+	// The returned addons are only valid until the next emplace or erase of
+	// their pool, i.e. by destroyEntity or another emplace.
+	// Keep the EntityId instead, and get the addon each time
+	template<typename Addon>
+	Addon* emplace(EntityId e, Addon&& addon = Addon());
+
+	// Move a type erased addon into its pool. Returns nullptr if
+	// the entity already had an addon of the same type
+	IAddon* emplace(EntityId e, std::unique_ptr<IAddon>&& addon);
+
+	// Calls f(IAddon&) for every addon of the entity, Transform first
+	template<typename F>
+	void forEachAddonOf(EntityId e, F&& f);
+	template<typename F>
+	void forEachAddonOf(EntityId e, F&& f) const;
+
+	// Calls f(AddonPool<Addon>&) for every pool
+	template<typename F>
+	void forEachPool(F&& f) { std::apply([&f](auto&... pool) { (f(pool), ...); }, mPools); }
+
+	// Entities are only updated by the systems if they were marked on the same stamp
+	void markActive(EntityId e, uint64_t stamp) { mActiveStamps[e] = stamp; }
+	bool isActive(EntityId e, uint64_t stamp) const { return mActiveStamps[e] == stamp; }
+
+	// Add to the graph a system that updates all the active addons of type Addon,
+	// in chunks of SYSTEM_CHUNK_SIZE. The masks are the addon types that the
+	// update function reads and writes, the own type must be included
+	template<typename Addon>
+	void addLogicSystem(grjob::JobGraph* graph, FrameContext* fc, uint64_t stamp,
+		AddonMask reads, AddonMask writes);
+	template<typename Addon>
+	void addGraphicsSystem(grjob::JobGraph* graph, FrameContext* fc, const SceneRenderContext& src,
+		uint64_t stamp, AddonMask reads, AddonMask writes);
+
+	// Bulk updates over the addons [begin, end) of the pool of type Addon
+	template<typename Addon>
+	void logicUpdate(FrameContext* fc, uint64_t stamp, uint32_t begin, uint32_t end);
+	template<typename Addon>
+	void graphicsUpdate(FrameContext* fc, const SceneRenderContext& src,
+		uint64_t stamp, uint32_t begin, uint32_t end);
+
+	// Number of addons updated by each job of a system
+	static constexpr uint32_t SYSTEM_CHUNK_SIZE = 256;
+
+private:
+
+	// Add here new addon types, also in AddonTypesList
+	std::tuple<
+		AddonPool<Transform>,
+		AddonPool<Camera>,
+		AddonPool<Renderable>,
+		AddonPool<SimplePlayerControl>
+	> mPools;
+	static_assert(std::tuple_size_v<decltype(mPools)> == ctools::length<AddonTypesList>(),
+		"AddonTypesList and the pools must match");
+
+	std::vector<GameObject*> mOwners;
+	std::vector<uint64_t> mActiveStamps;
+	std::vector<EntityId> mFreeEntities;
+
+	std::mutex mStructureMutex;
+};
+
+
+template<typename Addon>
+inline Addon* AddonPool<Addon>::emplace(EntityId e, GameObject* owner, Addon&& addon)
+{
+	if (contains(e)) {
+		return nullptr;
+	}
+	if (e >= mSparse.size()) {
+		mSparse.resize(static_cast<size_t>(e) + 1, NULL_ENTITY);
+	}
+
+	mSparse[e] = size();
+	mDense.push_back(std::move(addon));
+	mOwners.push_back(owner);
+	mEntities.push_back(e);
+
+	return &mDense.back();
+}
+
+template<typename Addon>
+inline void AddonPool<Addon>::erase(EntityId e)
+{
+	if (!contains(e)) {
+		return;
+	}
+
+	const uint32_t idx = mSparse[e];
+	const uint32_t last = size() - 1;
+	if (idx != last) {
+		mDense[idx] = std::move(mDense[last]);
+		mOwners[idx] = mOwners[last];
+		mEntities[idx] = mEntities[last];
+		mSparse[mEntities[idx]] = idx;
+	}
+
+	mDense.pop_back();
+	mOwners.pop_back();
+	mEntities.pop_back();
+	mSparse[e] = NULL_ENTITY;
+}
+
+template<typename Addon>
+inline Addon* AddonStorage::emplace(EntityId e, Addon&& addon)
+{
+	std::unique_lock lock(mStructureMutex);
+	return getPool<Addon>().emplace(e, mOwners[e], std::move(addon));
+}
+
+template<typename F>
+inline void AddonStorage::forEachAddonOf(EntityId e, F&& f)
+{
+	std::apply([e, &f](auto&... pool) {
+		auto visit = [e, &f](auto& p) {
+			if (IAddon* addon = p.get(e)) {
+				f(*addon);
+			}
+		};
+		(visit(pool), ...);
+	}, mPools);
+}
+
+template<typename F>
+inline void AddonStorage::forEachAddonOf(EntityId e, F&& f) const
+{
+	std::apply([e, &f](const auto&... pool) {
+		auto visit = [e, &f](const auto& p) {
+			if (const IAddon* addon = p.get(e)) {
+				f(*addon);
+			}
+		};
+		(visit(pool), ...);
+	}, mPools);
+}
+
+template<typename Addon>
+inline void AddonStorage::addLogicSystem(grjob::JobGraph* graph, FrameContext* fc, uint64_t stamp,
+	AddonMask reads, AddonMask writes)
+{
+	assert(((reads | writes) & addonMask<Addon>()) != 0);
+	graph->addNode(Addon::s_getAddonName(), reads, writes,
+		getPool<Addon>().size(), SYSTEM_CHUNK_SIZE,
+		[this, fc, stamp](uint32_t begin, uint32_t end) {
+			this->logicUpdate<Addon>(fc, stamp, begin, end);
+		});
+}
+
+template<typename Addon>
+inline void AddonStorage::addGraphicsSystem(grjob::JobGraph* graph, FrameContext* fc, const SceneRenderContext& src,
+	uint64_t stamp, AddonMask reads, AddonMask writes)
+{
+	assert(((reads | writes) & addonMask<Addon>()) != 0);
+	graph->addNode(Addon::s_getAddonName(), reads, writes,
+		getPool<Addon>().size(), SYSTEM_CHUNK_SIZE,
+		[this, fc, src, stamp](uint32_t begin, uint32_t end) {
+			this->graphicsUpdate<Addon>(fc, src, stamp, begin, end);
+		});
+}
+
+template<typename Addon>
+inline void AddonStorage::logicUpdate(FrameContext* fc, uint64_t stamp, uint32_t begin, uint32_t end)
+{
+	AddonPool<Addon>& pool = getPool<Addon>();
+	assert(end <= pool.size());
+
+	Addon* addons = pool.data();
+	GameObject* const* owners = pool.owners();
+	const EntityId* entities = pool.entities();
+	for (uint32_t i = begin; i < end; ++i) {
+		if (isActive(entities[i], stamp)) {
+			// qualified call to avoid the virtual dispatch
+			addons[i].Addon::update(fc, owners[i]);
+		}
+	}
+}
+
+template<typename Addon>
+inline void AddonStorage::graphicsUpdate(FrameContext* fc, const SceneRenderContext& src,
+	uint64_t stamp, uint32_t begin, uint32_t end)
+{
+	AddonPool<Addon>& pool = getPool<Addon>();
+	assert(end <= pool.size());
+
+	Addon* addons = pool.data();
+	GameObject* const* owners = pool.owners();
+	const EntityId* entities = pool.entities();
+	for (uint32_t i = begin; i < end; ++i) {
+		if (isActive(entities[i], stamp)) {
+			addons[i].Addon::updateBeforeRender(fc, owners[i], src);
+		}
+	}
+}
+
+} // namespace addon
+} // namespace gr
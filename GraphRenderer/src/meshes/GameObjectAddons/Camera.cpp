@@ -40,12 +40,8 @@ void Camera::updateBeforeRender(FrameContext* fc, GameObject* parent, const Scen
 
     vkg::RenderContext::BasicCameraTransformUBO ubo;
 
-    ubo.V = glm::lookAt(transform->getPos(), transform->getPos() + transform->forward(),
-		transform->up());
-    ubo.P = glm::perspective( glm::radians(mFov),
-		mAspectRatio.x / mAspectRatio.y,
-		mNear, mFar);
-    ubo.P[1][1] *= -1.0;
+    ubo.V = s_computeView(*transform);
+    ubo.P = getProjection();
 
 
     size_t sizePadd = fc->rc().padUniformBuffer(sizeof(vkg::RenderContext::BasicCameraTransformUBO));
@@ -54,6 +50,21 @@ void Camera::updateBeforeRender(FrameContext* fc, GameObject* parent, const Scen
 
 }
 
+glm::mat4 Camera::getProjection() const
+{
+    glm::mat4 P = glm::perspective(glm::radians(mFov),
+        mAspectRatio.x / mAspectRatio.y,
+        mNear, mFar);
+    P[1][1] *= -1.0;
+    return P;
+}
+
+glm::mat4 Camera::s_computeView(const Transform& transform)
+{
+    return glm::lookAt(transform.getPos(), transform.getPos() + transform.forward(),
+        transform.up());
+}
+
 void Camera::destroy(FrameContext* fc)
 {
     if (mUbosGpuPtr) {
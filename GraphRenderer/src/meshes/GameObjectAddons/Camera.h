@@ -9,6 +9,8 @@
 namespace gr {
 namespace addon {
 
+class Transform;
+
 class Camera : public IAddon
 {
 public:
@@ -27,6 +29,13 @@ public:
 
 	static const char* s_getAddonName() { return "Camera"; }
 
+	// Fraction of the viewport height covered by an object of size 1 at distance 1
+	float getProjectionScale() const { return 0.5f / glm::tan(glm::radians(0.5f * mFov)); }
+
+	glm::mat4 getProjection() const;
+	// View matrix of a camera with the transform
+	static glm::mat4 s_computeView(const Transform& transform);
+
 protected:
 
 	float mFov = 90.0f;
@@ -1,9 +1,14 @@
 #include "Renderable.h"
 
+#include <algorithm>
+#include <limits>
+#include <cmath>
 #include <imgui/imgui.h>
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "../Mesh.h"
+#include "../Texture.h"
+#include "../Scene.h"
 #include "../../control/FrameContext.h"
 
 
@@ -12,6 +17,12 @@ namespace gr
 namespace addon
 {
 
+// Maximum error of the selected LOD on screen, as a fraction of the viewport height
+constexpr float LOD_MAX_SCREEN_ERROR = 1.0f / 1080.0f;
+// A coarser LOD is only selected once its error is below this fraction of the
+// maximum, so that an object near a threshold does not alternate between LODs
+constexpr float LOD_HYSTERESIS = 0.75f;
+
 void Renderable::drawImGuiInspector(FrameContext* fc, GameObject* parent)
 {
     ImGui::PushID(Renderable::s_getAddonName());
@@ -42,6 +53,35 @@ void Renderable::drawImGuiInspector(FrameContext* fc, GameObject* parent)
         ImGui::EndDragDropTarget();
     }
 
+    std::string textureName = "Undefined";
+    if (mTexture) {
+        if (fc->gc().getDict().exists(mTexture)) {
+            textureName = fc->gc().getDict().getName(mTexture);
+        }
+        else {
+            mTexture.reset();
+        }
+    }
+
+    ImGui::Text("Texture:");
+    ImGui::Button(textureName.c_str());
+    if (ImGui::BeginDragDropTarget()) {
+        if (const ImGuiPayload* payload = ImGui::AcceptDragDropPayload(Texture::s_getClassName()))
+        {
+            assert(payload->DataSize == sizeof(ResId));
+            ResId id = *reinterpret_cast<ResId*>(payload->Data);
+
+            this->setTexture(id);
+        }
+        ImGui::EndDragDropTarget();
+    }
+
+    ImGui::Text("LOD: %u", mLod);
+    ImGui::Checkbox("Meshlet culling", &mMeshletCulling);
+    if (mMeshletCulling) {
+        ImGui::Text("Visible meshlets: %u", mNumVisibleMeshlets);
+    }
+
 
     ImGui::PopID();
 }
@@ -52,36 +92,96 @@ void Renderable::updateBeforeRender(FrameContext* fc, GameObject* parent, const
     Transform* transf = parent->getAddon<Transform>();
     assert(transf != nullptr);
 
+    // returns nullptr if the mesh has been erased
+    const Mesh* mesh = this->mMesh ? fc->gc().getDict().get(mMesh) : nullptr;
+
+    glm::mat4 modelMatrix(1.0f);
+    modelMatrix = glm::translate(modelMatrix, transf->getPos());
+    modelMatrix = modelMatrix * glm::mat4_cast(transf->getRotation());
+    modelMatrix = glm::scale(modelMatrix, transf->getScale());
+
     // update UBO
     {
         vkg::RenderContext::BasicTransformUBO ubo;
-        ubo.M = glm::mat4(1.0);
-
-        ubo.M = glm::translate(ubo.M, transf->getPos());
-        ubo.M = ubo.M * glm::mat4_cast(transf->getRotation());
-        ubo.M = glm::scale(ubo.M, transf->getScale());
+        ubo.M = modelMatrix;
+        if (mesh != nullptr && *mesh) {
+            ubo.M = ubo.M * mesh->getPositionDequantization();
+        }
 
         size_t sizePadd = fc->rc().padUniformBuffer(sizeof(vkg::RenderContext::BasicTransformUBO));
 
         std::memcpy(mUbosGpuPtr + sizePadd * fc->getIdx(), &ubo, sizeof(vkg::RenderContext::BasicTransformUBO));
     }
 
-    // get mesh and schedule draw
-    if (this->mMesh) {
-        Mesh* mesh;
-        fc->gc().getDict().get(mMesh, &mesh);
+    // schedule draw
+    if (mesh != nullptr && *mesh) {
+
+        const float screenSize = src.projectionScale > 0.0f ?
+            computeScreenSize(*mesh, modelMatrix, transf->getScale(), src) : 0.0f;
+        mLod = selectLod(*mesh, screenSize);
+
+        if (mTexture && src.projectionScale > 0.0f) {
+            fc->gc().getTextureStreamer().requestScreenSize(mTexture,
+                screenSize * static_cast<float>(fc->getWindow().getFrameBufferHeigth()));
+        }
 
-        if (*mesh) {
+        vkg::RenderSubmitter::DrawData drawData;
+        drawData.vertexBuffer = mesh->getVB();
+        drawData.indexBuffer = mesh->getIB();
+        drawData.indexType = mesh->getIndexType();
+        drawData.objectDescriptorSet = mObjectDescriptorSets[fc->getIdx()];
+        drawData.vertexLayout = static_cast<uint32_t>(mesh->getVertexFormat());
 
-            vkg::RenderSubmitter::DrawData drawData;
-            drawData.vertexBuffer = mesh->getVB();
-            drawData.indexBuffer = mesh->getIB();
-            drawData.numIndices = mesh->getNumIndices();
-            drawData.objectDescriptorSet = mObjectDescriptorSets[fc->getIdx()];
+        if (mMeshletCulling && mesh->getLodFirstMeshlet(mLod) < mesh->getLodFirstMeshlet(mLod + 1)) {
+            pushVisibleMeshlets(fc, *mesh, modelMatrix, src, drawData);
+            return;
+        }
 
+        const std::vector<mesh::Submesh>& submeshes = mesh->getSubmeshes();
+        for (uint32_t i = mesh->getLodFirstSubmesh(mLod); i < mesh->getLodFirstSubmesh(mLod + 1); ++i) {
+            const mesh::Submesh& submesh = submeshes[i];
+            drawData.firstIndex = submesh.firstIndex;
+            drawData.numIndices = submesh.numIndices;
+            drawData.vertexOffset = submesh.vertexOffset;
             fc->renderSubmitter().pushPredefinedDraw(drawData);
         }
+    }
+}
+
+void Renderable::pushVisibleMeshlets(FrameContext* fc, const Mesh& mesh, const glm::mat4& modelMatrix,
+    const SceneRenderContext& src, const vkg::RenderSubmitter::DrawData& drawData)
+{
+    // The meshlets are culled in object space
+    const mesh::MeshletCullingView view = mesh::makeMeshletCullingView(
+        src.viewProjection * modelMatrix,
+        glm::vec3(glm::inverse(modelMatrix) * glm::vec4(src.cameraPosition, 1.0f)));
+
+    mIndirectCommands.clear();
+    mNumVisibleMeshlets = 0;
+    for (uint32_t m = mesh.getLodFirstMeshlet(mLod); m < mesh.getLodFirstMeshlet(mLod + 1); ++m) {
+        if (!mesh::isMeshletVisible(mesh.getMeshlet(m), view)) {
+            continue;
+        }
+        mNumVisibleMeshlets += 1;
+
+        uint32_t numDraws;
+        const vk::DrawIndexedIndirectCommand* draws = mesh.getMeshletDraws(m, &numDraws);
+        for (uint32_t i = 0; i < numDraws; ++i) {
+            // consecutive visible meshlets are merged in a single draw
+            if (!mIndirectCommands.empty() &&
+                mIndirectCommands.back().firstIndex + mIndirectCommands.back().indexCount == draws[i].firstIndex &&
+                mIndirectCommands.back().vertexOffset == draws[i].vertexOffset) {
+                mIndirectCommands.back().indexCount += draws[i].indexCount;
+            }
+            else {
+                mIndirectCommands.push_back(draws[i]);
+            }
+        }
+    }
 
+    if (!mIndirectCommands.empty()) {
+        fc->renderSubmitter().pushIndirectDraw(drawData,
+            mIndirectCommands.data(), static_cast<uint32_t>(mIndirectCommands.size()));
     }
 }
 
@@ -108,7 +208,61 @@ void Renderable::start(FrameContext* fc)
 
 void Renderable::setMesh(ResId meshId)
 {
-	mMesh = meshId;
+	mMesh = ResHandle<Mesh>(meshId);
+}
+
+void Renderable::setTexture(ResId textureId)
+{
+    mTexture = ResHandle<Texture>(textureId);
+}
+
+float Renderable::computeScreenSize(const Mesh& mesh, const glm::mat4& modelMatrix,
+    const glm::vec3& scale, const SceneRenderContext& src) const
+{
+    assert(src.projectionScale > 0.0f);
+
+    // Bounding sphere of the bbox in world space
+    const mth::AABBox& bbox = mesh.getBBox();
+    const glm::vec3 absScale = glm::abs(scale);
+    const float maxScale = std::max(absScale.x, std::max(absScale.y, absScale.z));
+    const float diameter = glm::length(bbox.getSize()) * maxScale;
+    const glm::vec3 center = glm::vec3(
+        modelMatrix * glm::vec4(0.5f * (bbox.getMin() + bbox.getMax()), 1.0f));
+
+    const float distance = glm::length(center - src.cameraPosition) - 0.5f * diameter;
+    if (distance <= 0.0f) {
+        return std::numeric_limits<float>::infinity();
+    }
+    return diameter * src.projectionScale / distance;
+}
+
+uint32_t Renderable::selectLod(const Mesh& mesh, float screenSize) const
+{
+    const uint32_t numLods = mesh.getNumLods();
+    // without camera the size is 0
+    if (numLods <= 1 || screenSize <= 0.0f || std::isinf(screenSize)) {
+        return 0;
+    }
+    // the mesh may have changed since the last frame
+    const uint32_t currentLod = std::min(mLod, numLods - 1);
+
+    // The errors of the LODs are relative to the diagonal of the bbox
+
+    // Coarsest LOD with an error on screen below maxError
+    auto coarsestLod = [&mesh, numLods, screenSize](float maxError) {
+        uint32_t lod = 0;
+        while (lod + 1 < numLods && mesh.getLod(lod + 1).error * screenSize <= maxError) {
+            ++lod;
+        }
+        return lod;
+    };
+
+    const uint32_t lod = coarsestLod(LOD_MAX_SCREEN_ERROR);
+    if (lod <= currentLod) {
+        return lod;
+    }
+    // The error of the current LOD is below the maximum, so it can be kept
+    return std::max(currentLod, coarsestLod(LOD_MAX_SCREEN_ERROR * LOD_HYSTERESIS));
 }
 
 void Renderable::createUbos(FrameContext* fc)
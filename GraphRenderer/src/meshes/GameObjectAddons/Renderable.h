@@ -3,8 +3,10 @@
 
 #include "../ResourcesHeader.h"
 #include "../../graphics/resources/Buffer.h"
+#include "../../graphics/RenderSubmitter.h"
 
 #include <vulkan/vulkan.hpp>
+#include <glm/glm.hpp>
 
 namespace gr
 {
@@ -25,16 +27,30 @@ public:
     void start(FrameContext* fc) override;
 
     void setMesh(ResId meshId);
+    void setTexture(ResId textureId);
 
     const char* getAddonName() override { return Renderable::s_getAddonName(); }
 
 
     static const char* s_getAddonName() { return "Renderable"; }
 
+    // Level of detail of the mesh drawn in the last frame
+    uint32_t getLod() const { return mLod; }
+
 
 private:
 
-    ResId mMesh;
+    ResHandle<Mesh> mMesh;
+    // The mips of the texture are streamed according to the size of the object on screen
+    ResHandle<Texture> mTexture;
+
+    uint32_t mLod = 0;
+
+    // Draw only the meshlets that pass the culling test
+    bool mMeshletCulling = true;
+    uint32_t mNumVisibleMeshlets = 0;
+    // Kept to reuse the allocation
+    std::vector<vk::DrawIndexedIndirectCommand> mIndirectCommands;
 
     vkg::Buffer mUbos;
     uint8_t* mUbosGpuPtr = nullptr;
@@ -42,11 +58,28 @@ private:
 
     void createUbos(FrameContext* fc);
 
+    // Projected diameter of the bounding box of the mesh, as a fraction of the
+    // viewport height. Infinite if the camera is inside of it
+    float computeScreenSize(const Mesh& mesh, const glm::mat4& modelMatrix,
+        const glm::vec3& scale, const SceneRenderContext& src) const;
+
+    // LOD from the projected size of the bounding box of the mesh,
+    // with hysteresis respect the current one
+    uint32_t selectLod(const Mesh& mesh, float screenSize) const;
+
+    void pushVisibleMeshlets(FrameContext* fc, const Mesh& mesh, const glm::mat4& modelMatrix,
+        const SceneRenderContext& src, const vkg::RenderSubmitter::DrawData& drawData);
+
     // Serialization functions
     template<class Archive>
     void serialize(Archive& ar)
     {
         ar(GR_SERIALIZE_NVP_MEMBER(mMesh));
+        // scenes saved before the textures have none
+        try {
+            ar(GR_SERIALIZE_NVP_MEMBER(mTexture));
+        }
+        catch (const cereal::Exception&) {}
     }
 
     GR_SERIALIZE_PRIVATE_MEMBERS
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <stdint.h>
 
 #include <vulkan/vulkan.hpp>
@@ -23,7 +24,7 @@ public:
 	virtual ~IObject() = default;
 
 	const std::string& getObjectName() const { return mObjectName; }
-	void setObjectName(const std::string& newName) { mObjectName = newName; }
+	void setObjectName(std::string_view newName) { mObjectName.assign(newName); }
 
 	virtual void scheduleDestroy(FrameContext* fc) = 0;
 
@@ -31,6 +32,10 @@ public:
 
 	virtual void start(FrameContext* fc) {}
 
+	// Called each frame in the main thread while the object is in the
+	// ResourceLoader. Returns true once the object has finished loading
+	virtual bool updateLoad(FrameContext* fc) { return true; }
+
 	static constexpr const char* s_getClassName() { return "IObject"; }
 
 private:
@@ -1,24 +1,84 @@
 
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
-
 #include "Mesh.h"
 #include "../control/FrameContext.h"
 #include "../graphics/RenderContext.h"
+#include "MeshProcessing/ObjParser.h"
+#include "MeshProcessing/CornerDedup.h"
+#include "MeshProcessing/PlyReader.h"
+#include "../utils/grjob.h"
 
-#include <fstream>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+#include <iostream>
 #include <imgui/imgui.h>
-#include <tiny_obj_loader/tiny_obj_loader.h>
-#include <tiny_ply_loader/tinyply.h>
-#include <unordered_map>
 #include <filesystem>
 
 namespace gr
 {
 
+// Vertices converted by each job
+constexpr uint32_t ENCODE_CHUNK_SIZE = 1 << 16;
+// Limit of the draws of each LOD with 16 bit indices, the regions of big meshes
+// are drawn separately, and are a bit smaller than 65536 vertices
+constexpr uint32_t MAX_SUBMESHES_PER_65536_VERTICES = 2;
+// Vertices of each region of the meshes that do not fit in 16 bit indices. The rest
+// of the block that they address is left for the vertices of the LODs that cross regions
+constexpr uint32_t REGION_MAX_VERTICES = 57344;
+
+// Each LOD is simplified from the previous one, to a ratio of its indices
+constexpr uint32_t MAX_LODS = 6;
+constexpr float LOD_INDEX_RATIO = 0.5f;
+// Relative to the diagonal of the bounding box
+constexpr float LOD_MAX_ERROR = 0.02f;
+// The chain stops when a LOD does not reduce the indices enough, or is small
+constexpr float LOD_MIN_REDUCTION = 0.8f;
+constexpr uint32_t LOD_MIN_INDICES = 3 * 128;
+
+// State of a load, shared by its job and the main thread
+struct Mesh::LoadJob {
+	std::atomic<LoadStage> stage{ LoadStage::eQueued };
+	std::atomic<bool> cancelled{ false };
+	grjob::Counter* counter = nullptr;
+
+	std::filesystem::path absolutePath;
+	std::filesystem::path cachePath;
+	std::string error;
+
+	// Region of each triangle of mIndices, while importing a mesh with more than
+	// 65536 vertices, until its vertices are laid out by region
+	std::vector<uint32_t> triangleRegions;
+	uint32_t numRegions = 0;
+
+	// Kept mapped until resident, the data is streamed from the file to the staging ring
+	mesh::MeshCacheReader cache;
+
+	// Data to upload in the layout of the buffers. Points to the cache,
+	// to mVertices and mIndices, or to the encoded copies below
+	const void* vertexData = nullptr;
+	const void* indexData = nullptr;
+	std::vector<uint8_t> encodedVertices;
+	std::vector<uint16_t> indices16;
+
+	// The buffers are streamed in slices, within the frame budget of the transferer.
+	// The callbacks, in the main thread, decrement pendingUploads
+	// Set if the device memory is host visible, then the job writes the buffers
+	const vkg::RenderContext* directWriteContext = nullptr;
+	bool uploaded = false;
+	uint32_t pendingUploads = 0;
+	vkg::BufferTransferer::StreamId vertexStream = 0;
+	vkg::BufferTransferer::StreamId indexStream = 0;
+};
+
 void Mesh::load(FrameContext* fc,
 	const char* filePath)
 {
+	// discard the previous mesh, and any load in progress
+	scheduleDestroy(fc);
 
 	std::filesystem::path path(filePath);
 	if (path.is_absolute()) {
@@ -26,48 +86,532 @@ void Mesh::load(FrameContext* fc,
 	}
 
 	mPath.assign(path.string());
-	
-	std::filesystem::path absolutePath = fc->gc().getProjectPath() / path;
 
-	vkg::RenderContext* rc = &fc->rc();
+	mLoadJob = std::make_shared<LoadJob>();
+	mLoadJob->absolutePath = fc->gc().getProjectPath() / path;
+	mLoadJob->cachePath = mesh::getMeshCachePath(fc->gc().getProjectPath(), path);
+	if (fc->rc().isDeviceMemoryHostVisible()) {
+		mLoadJob->directWriteContext = &fc->rc();
+	}
+	mLoadError.clear();
+
+	// Parsing may recurse deeply, as when it was done in the main fiber
+	grjob::runJob(grjob::Priority::eLow, grjob::Job(&Mesh::runLoadJob, this),
+		&mLoadJob->counter, true);
+
+	fc->gc().getLoader().push(this);
+}
+
+void Mesh::runLoadJob()
+{
+	LoadJob& job = *mLoadJob;
 
-	mVertices.clear();
-	mIndices.clear();
-	mBBox.reset();
+	// Returns false if the load has been cancelled
+	auto setStage = [&job](LoadStage stage) {
+		job.stage.store(stage, std::memory_order_relaxed);
+		return !job.cancelled.load(std::memory_order_relaxed);
+	};
 
-	if (mPath.find(".obj") != std::string::npos) {
-		parseObj(absolutePath.string().c_str());
+	try {
+		mVertices.clear();
+		mIndices.clear();
+		mBBox.reset();
+
+		if (!setStage(LoadStage::eReading)) {
+			return;
+		}
+		mLoadedFromCache = job.cache.open(job.cachePath, job.absolutePath) &&
+			loadFromCache(job.cache);
+
+		if (!mLoadedFromCache) {
+			if (mPath.find(".obj") != std::string::npos) {
+				parseObj(job.absolutePath.string().c_str());
+			}
+			else if (mPath.find(".ply") != std::string::npos) {
+				parsePly(job.absolutePath.string().c_str());
+			}
+			else {
+				throw std::runtime_error("Error: Mesh format not supported " + mPath);
+			}
+
+			if (!setStage(LoadStage::eOptimizing)) {
+				return;
+			}
+			optimize();
+			if (!setStage(LoadStage::eSimplifying)) {
+				return;
+			}
+			generateLods();
+			layoutVertices();
+			if (!setStage(LoadStage::eBuildingMeshlets)) {
+				return;
+			}
+			buildMeshlets();
+		}
+
+		// Imported, or cached in another vertex format. The buffers are
+		// prepared from the members, and the cache is written again
+		if (!mVertices.empty()) {
+			job.cache.close();
+			if (!setStage(LoadStage::eEncoding)) {
+				return;
+			}
+			prepareBuffers();
+			// the encoded vertices are incomplete
+			if (job.cancelled.load(std::memory_order_relaxed)) {
+				return;
+			}
+			writeCache(job.cachePath, job.absolutePath);
+		}
+
+		if (job.directWriteContext != nullptr) {
+			if (job.cancelled.load(std::memory_order_relaxed)) {
+				return;
+			}
+			writeBuffersDirectly(*job.directWriteContext);
+		}
+	}
+	catch (const std::exception& e) {
+		job.error = e.what();
+		job.stage.store(LoadStage::eFailed, std::memory_order_release);
+		return;
+	}
+
+	// publish the members to the main thread
+	job.stage.store(LoadStage::eUploading, std::memory_order_release);
+}
+
+bool Mesh::updateLoad(FrameContext* fc)
+{
+	assert(mLoadJob);
+	LoadJob& job = *mLoadJob;
+
+	LoadStage stage = job.stage.load(std::memory_order_acquire);
+	if (stage != LoadStage::eUploading && stage != LoadStage::eFailed) {
+		return false;
+	}
+
+	// The job has finished, or is about to
+	if (job.counter != nullptr) {
+		grjob::waitForCounterAndFree(job.counter, 0);
+		job.counter = nullptr;
 	}
-	else if (mPath.find(".ply") != std::string::npos) {
-		parsePly(absolutePath.string().c_str());
+
+	if (stage == LoadStage::eUploading && !job.uploaded) {
+		try {
+			// The data is read until the streams finish, it is freed by finishLoad
+			createAndUploadBuffers(fc);
+			job.uploaded = true;
+			return false;
+		}
+		catch (const std::exception& e) {
+			job.error = e.what();
+			stage = LoadStage::eFailed;
+		}
 	}
 
+	if (stage == LoadStage::eFailed) {
+		std::cerr << "Error: mesh " << mPath << " not loaded. " << job.error << std::endl;
+		mLoadError = job.error;
+		destroyBuffers(fc);
+		finishLoad();
+		mLoadStage = LoadStage::eFailed;
+		return true;
+	}
+
+	if (job.pendingUploads != 0) {
+		return false;
+	}
+
+	finishLoad();
+	mLoadStage = LoadStage::eReady;
+	mReady = true;
+	return true;
+}
+
+void Mesh::cancelLoad(FrameContext* fc)
+{
+	if (!mLoadJob) {
+		return;
+	}
+
+	fc->gc().getLoader().remove(this);
+
+	// the job writes the members of the mesh
+	mLoadJob->cancelled.store(true, std::memory_order_relaxed);
+	if (mLoadJob->counter != nullptr) {
+		grjob::waitForCounterAndFree(mLoadJob->counter, 0);
+		mLoadJob->counter = nullptr;
+	}
+	// the streams read the data freed by finishLoad
+	if (mLoadJob->uploaded) {
+		fc->rc().getTransferer()->cancelStream(mLoadJob->vertexStream);
+		fc->rc().getTransferer()->cancelStream(mLoadJob->indexStream);
+	}
+
+	finishLoad();
+	mLoadStage = LoadStage::eNone;
+}
+
+void Mesh::finishLoad()
+{
+	assert(mLoadJob && mLoadJob->counter == nullptr);
+	mLoadJob.reset();
 
-	// create buffers
+	std::vector<Vertex>().swap(mVertices);
+	std::vector<uint32_t>().swap(mIndices);
+}
+
+Mesh::LoadStage Mesh::getLoadStage() const
+{
+	return mLoadJob ? mLoadJob->stage.load(std::memory_order_relaxed) : mLoadStage;
+}
+
+float Mesh::getLoadProgress() const
+{
+	const LoadStage stage = getLoadStage();
+	if (stage == LoadStage::eFailed) {
+		return 0.0f;
+	}
+	return static_cast<float>(stage) / static_cast<float>(LoadStage::eReady);
+}
+
+const char* Mesh::s_getLoadStageName(LoadStage stage)
+{
+	switch (stage)
 	{
-		if (mIndexBuffer) {
-			throw std::logic_error("Error! Buffer previously alocated");
+	case LoadStage::eNone: return "Not loaded";
+	case LoadStage::eQueued: return "Queued";
+	case LoadStage::eReading: return "Reading";
+	case LoadStage::eOptimizing: return "Optimizing";
+	case LoadStage::eSimplifying: return "Simplifying";
+	case LoadStage::eBuildingMeshlets: return "Building meshlets";
+	case LoadStage::eEncoding: return "Encoding";
+	case LoadStage::eUploading: return "Uploading";
+	case LoadStage::eReady: return "Ready";
+	case LoadStage::eFailed: return "Failed";
+	default: return "Unknown";
+	}
+}
+
+bool Mesh::loadFromCache(const mesh::MeshCacheReader& cache)
+{
+	const mesh::MeshCacheSection* vertices = cache.findSection(mesh::MeshCacheSectionType::eVertices);
+	const mesh::MeshCacheSection* indices = cache.findSection(mesh::MeshCacheSectionType::eIndices);
+	if (vertices == nullptr || vertices->elementSize != sizeof(Vertex) ||
+		indices == nullptr || indices->elementSize != sizeof(uint32_t)) {
+		return false;
+	}
+
+	const mesh::MeshCacheSection* lods = cache.findSection(mesh::MeshCacheSectionType::eLods);
+	if (lods == nullptr || lods->elementSize != sizeof(mesh::LodRange) || lods->count == 0) {
+		return false;
+	}
+	const mesh::LodRange* lodData = reinterpret_cast<const mesh::LodRange*>(cache.getSectionData(*lods));
+	for (uint64_t i = 0; i < lods->count; ++i) {
+		if (static_cast<uint64_t>(lodData[i].firstIndex) + lodData[i].numIndices > indices->count) {
+			return false;
+		}
+	}
+	mLods.assign(lodData, lodData + lods->count);
+
+	const mesh::MeshCacheSection* meshlets = cache.findSection(mesh::MeshCacheSectionType::eMeshlets);
+	if (meshlets == nullptr || meshlets->elementSize != sizeof(mesh::Meshlet)) {
+		return false;
+	}
+	const mesh::Meshlet* meshletData = reinterpret_cast<const mesh::Meshlet*>(cache.getSectionData(*meshlets));
+	for (uint64_t i = 0; i < meshlets->count; ++i) {
+		if (static_cast<uint64_t>(meshletData[i].firstIndex) + meshletData[i].numIndices > indices->count ||
+			(i > 0 && meshletData[i].firstIndex < meshletData[i - 1].firstIndex)) {
+			return false;
+		}
+	}
+	mMeshlets.assign(meshletData, meshletData + meshlets->count);
+
+	const mesh::MeshCacheHeader& header = cache.getHeader();
+	mBBox = mth::AABBox(header.bboxMin, header.bboxMax);
+
+	const mesh::MeshCacheSection* stats = cache.findSection(mesh::MeshCacheSectionType::eVertexCacheStatistics);
+	if (stats != nullptr && stats->elementSize == sizeof(mesh::VertexCacheStatistics) && stats->count == 2) {
+		const mesh::VertexCacheStatistics* data =
+			reinterpret_cast<const mesh::VertexCacheStatistics*>(cache.getSectionData(*stats));
+		mImportedCacheStats = data[0];
+		mOptimizedCacheStats = data[1];
+	}
+
+	if (prepareBuffersFromCache(cache)) {
+		return true;
+	}
+
+	// the full precision data is encoded again
+	const Vertex* vertexData = reinterpret_cast<const Vertex*>(cache.getSectionData(*vertices));
+	mVertices.assign(vertexData, vertexData + vertices->count);
+	const uint32_t* indexData = reinterpret_cast<const uint32_t*>(cache.getSectionData(*indices));
+	mIndices.assign(indexData, indexData + indices->count);
+	return true;
+}
+
+bool Mesh::prepareBuffersFromCache(const mesh::MeshCacheReader& cache)
+{
+	LoadJob& job = *mLoadJob;
+	const mesh::MeshCacheHeader& header = cache.getHeader();
+	if (header.vertexFormat != static_cast<uint32_t>(mVertexFormat)) {
+		return false;
+	}
+
+	const mesh::MeshCacheSection* vertices = cache.findSection(
+		mVertexFormat == mesh::VertexFormat::eFloat ?
+		mesh::MeshCacheSectionType::eVertices : mesh::MeshCacheSectionType::eEncodedVertices);
+	if (vertices == nullptr || vertices->elementSize != s_getVertexStride(mVertexFormat)) {
+		return false;
+	}
+
+	// 16 bit indices if they were used when the cache was written
+	const mesh::MeshCacheSection* indices = cache.findSection(mesh::MeshCacheSectionType::eIndices16);
+	vk::IndexType indexType = vk::IndexType::eUint16;
+	if (indices == nullptr) {
+		indices = cache.findSection(mesh::MeshCacheSectionType::eIndices);
+		indexType = vk::IndexType::eUint32;
+	}
+	if (indices == nullptr || indices->elementSize !=
+		(indexType == vk::IndexType::eUint16 ? sizeof(uint16_t) : sizeof(uint32_t))) {
+		return false;
+	}
+
+	const mesh::MeshCacheSection* submeshes = cache.findSection(mesh::MeshCacheSectionType::eSubmeshes);
+	const mesh::MeshCacheSection* lodFirstSubmeshes = cache.findSection(mesh::MeshCacheSectionType::eLodFirstSubmeshes);
+	if (submeshes == nullptr || submeshes->elementSize != sizeof(mesh::Submesh) ||
+		lodFirstSubmeshes == nullptr || lodFirstSubmeshes->elementSize != sizeof(uint32_t) ||
+		lodFirstSubmeshes->count != mLods.size() + 1) {
+		return false;
+	}
+	const mesh::Submesh* submeshData = reinterpret_cast<const mesh::Submesh*>(cache.getSectionData(*submeshes));
+	for (uint64_t i = 0; i < submeshes->count; ++i) {
+		if (static_cast<uint64_t>(submeshData[i].firstIndex) + submeshData[i].numIndices > indices->count) {
+			return false;
 		}
-		mIndexBufferSize = sizeof(uint32_t) * mIndices.size();
-		mIndexBuffer = rc->createIndexBuffer(mIndexBufferSize);
-		if (mVertexBuffer) {
-			throw std::logic_error("Error! Buffer previously alocated");
+	}
+	const uint32_t* lodFirstSubmeshData = reinterpret_cast<const uint32_t*>(cache.getSectionData(*lodFirstSubmeshes));
+	for (uint64_t i = 0; i < lodFirstSubmeshes->count; ++i) {
+		if (lodFirstSubmeshData[i] > submeshes->count ||
+			(i > 0 && lodFirstSubmeshData[i] < lodFirstSubmeshData[i - 1])) {
+			return false;
 		}
-		mVertexBufferSize = sizeof(Vertex) * mVertices.size();
-		mVertexBuffer = rc->createVertexBuffer(mVertexBufferSize);
+	}
+	if (lodFirstSubmeshData[mLods.size()] != submeshes->count) {
+		return false;
 	}
 
-	// upload to gpu
-	rc->getTransferer()->transferToBuffer(*rc,
-		mVertices.data(), mVertices.size() * sizeof(mVertices[0]),
-		mVertexBuffer);
-	rc->getTransferer()->transferToBuffer(*rc,
-		mIndices.data(), mIndices.size() * sizeof(mIndices[0]),
-		mIndexBuffer);
+	mIndexType = indexType;
+	mSubmeshes.assign(submeshData, submeshData + submeshes->count);
+	mLodFirstSubmesh.assign(lodFirstSubmeshData, lodFirstSubmeshData + lodFirstSubmeshes->count);
+	job.vertexData = cache.getSectionData(*vertices);
+	job.indexData = cache.getSectionData(*indices);
+	setBufferLayout(static_cast<uint32_t>(vertices->count), static_cast<uint32_t>(indices->count));
+	return true;
+}
+
+void Mesh::writeCache(const std::filesystem::path& cachePath,
+	const std::filesystem::path& sourcePath) const
+{
+	try {
+		mesh::MeshCacheHeader header;
+		if (!mesh::getSourceInfo(sourcePath, &header)) {
+			return;
+		}
+		header.sourceHash = mesh::hashFile(sourcePath);
+		header.bboxMin = mBBox.getMin();
+		header.bboxMax = mBBox.getMax();
+		header.vertexFormat = static_cast<uint32_t>(mVertexFormat);
+
+		mesh::MeshCacheWriter writer;
+		writer.addSection(mesh::MeshCacheSectionType::eVertices,
+			sizeof(Vertex), mVertices.size(), mVertices.data());
+		writer.addSection(mesh::MeshCacheSectionType::eIndices,
+			sizeof(uint32_t), mIndices.size(), mIndices.data());
+		const mesh::VertexCacheStatistics stats[2] = { mImportedCacheStats, mOptimizedCacheStats };
+		writer.addSection(mesh::MeshCacheSectionType::eVertexCacheStatistics,
+			sizeof(mesh::VertexCacheStatistics), 2, stats);
+		writer.addSection(mesh::MeshCacheSectionType::eLods,
+			sizeof(mesh::LodRange), mLods.size(), mLods.data());
+		writer.addSection(mesh::MeshCacheSectionType::eMeshlets,
+			sizeof(mesh::Meshlet), mMeshlets.size(), mMeshlets.data());
+
+		// the buffers as they are uploaded, in the current vertex format
+		const LoadJob& job = *mLoadJob;
+		if (mVertexFormat != mesh::VertexFormat::eFloat) {
+			writer.addSection(mesh::MeshCacheSectionType::eEncodedVertices,
+				s_getVertexStride(mVertexFormat), mVertices.size(), job.encodedVertices.data());
+		}
+		if (mIndexType == vk::IndexType::eUint16) {
+			writer.addSection(mesh::MeshCacheSectionType::eIndices16,
+				sizeof(uint16_t), job.indices16.size(), job.indices16.data());
+		}
+		writer.addSection(mesh::MeshCacheSectionType::eSubmeshes,
+			sizeof(mesh::Submesh), mSubmeshes.size(), mSubmeshes.data());
+		writer.addSection(mesh::MeshCacheSectionType::eLodFirstSubmeshes,
+			sizeof(uint32_t), mLodFirstSubmesh.size(), mLodFirstSubmesh.data());
+
+		writer.write(cachePath, header);
+	}
+	catch (const std::exception& e) {
+		std::cerr << "Warning: mesh cache not written. " << e.what() << std::endl;
+	}
+}
+
+void Mesh::prepareBuffers()
+{
+	LoadJob& job = *mLoadJob;
+	const uint32_t numVertices = static_cast<uint32_t>(mVertices.size());
+	const uint32_t* indices = mIndices.data();
+
+	job.vertexData = mVertices.data();
+	if (mVertexFormat != mesh::VertexFormat::eFloat) {
+		encodeVertices(mVertices.data(), numVertices, &job.encodedVertices);
+		job.vertexData = job.encodedVertices.data();
+	}
+
+	// 16 bit indices if the vertices of every LOD can be addressed with few submeshes,
+	// as they can once the vertices of big meshes are laid out by region
+	assert(!mLods.empty());
+	const uint32_t maxSubmeshes = MAX_SUBMESHES_PER_65536_VERTICES *
+		(numVertices / (std::numeric_limits<uint16_t>::max() + 1) + 1);
+	if (mesh::splitIndices16(indices, mLods.data(), mLods.size(),
+		maxSubmeshes, &mSubmeshes, &mLodFirstSubmesh, &job.indices16)) {
+		mIndexType = vk::IndexType::eUint16;
+		job.indexData = job.indices16.data();
+	}
+	else {
+		mIndexType = vk::IndexType::eUint32;
+		job.indexData = indices;
+		std::vector<uint16_t>().swap(job.indices16);
+		mSubmeshes.clear();
+		mLodFirstSubmesh.clear();
+		for (const mesh::LodRange& lod : mLods) {
+			mLodFirstSubmesh.push_back(static_cast<uint32_t>(mSubmeshes.size()));
+			mSubmeshes.push_back(mesh::Submesh{ lod.firstIndex, lod.numIndices, 0 });
+		}
+		mLodFirstSubmesh.push_back(static_cast<uint32_t>(mSubmeshes.size()));
+	}
+
+	setBufferLayout(numVertices, static_cast<uint32_t>(mIndices.size()));
+}
+
+void Mesh::setBufferLayout(uint32_t numVertices, uint32_t numIndices)
+{
+	mNumVertices = numVertices;
+	mNumIndices = numIndices;
+
+	// positions are quantized in the unit cube of the bbox
+	mPositionDequantization = glm::mat4(1.0f);
+	if (mVertexFormat == mesh::VertexFormat::eCompactQuantized) {
+		mPositionDequantization = glm::translate(mPositionDequantization, mBBox.getMin());
+		mPositionDequantization = glm::scale(mPositionDequantization, mBBox.getSize());
+	}
+
+	createMeshletDraws();
+
+	mIndexBufferSize = static_cast<vk::DeviceSize>(numIndices) *
+		(mIndexType == vk::IndexType::eUint16 ? sizeof(uint16_t) : sizeof(uint32_t));
+	mVertexBufferSize = static_cast<vk::DeviceSize>(s_getVertexStride(mVertexFormat)) * numVertices;
+}
+
+void Mesh::createBuffers(const vkg::RenderContext& rc)
+{
+	if (mIndexBuffer) {
+		throw std::logic_error("Error! Buffer previously alocated");
+	}
+	mIndexBuffer = rc.createIndexBuffer(mIndexBufferSize);
+	if (mVertexBuffer) {
+		throw std::logic_error("Error! Buffer previously alocated");
+	}
+	mVertexBuffer = rc.createVertexBuffer(mVertexBufferSize);
+}
+
+void Mesh::writeBuffersDirectly(const vkg::RenderContext& rc)
+{
+	LoadJob& job = *mLoadJob;
+	createBuffers(rc);
+
+	// The heap may be full, then they are in memory that is not host visible
+	if (!rc.isMappable(mVertexBuffer) || !rc.isMappable(mIndexBuffer)) {
+		return;
+	}
+
+	void* ptr;
+	rc.mapAllocatable(mVertexBuffer, &ptr);
+	std::memcpy(ptr, job.vertexData, mVertexBufferSize);
+	rc.unmapAllocatable(mVertexBuffer);
+	rc.mapAllocatable(mIndexBuffer, &ptr);
+	std::memcpy(ptr, job.indexData, mIndexBufferSize);
+	rc.unmapAllocatable(mIndexBuffer);
+
+	// In case the memory is not coherent. The writes are visible
+	// to the first submission that uses the buffers
+	const VmaAllocation allocs[2] = { mVertexBuffer.getAllocation(), mIndexBuffer.getAllocation() };
+	rc.flushAllocations(allocs, 2);
+	job.uploaded = true;
+}
+
+void Mesh::createAndUploadBuffers(FrameContext* fc)
+{
+	vkg::RenderContext* rc = &fc->rc();
+	LoadJob& job = *mLoadJob;
+
+	// The job may have created them already
+	if (!mVertexBuffer) {
+		createBuffers(*rc);
+	}
+
+	// upload to gpu, over several frames if the mesh is big.
+	// The callbacks keep the state alive if the load is cancelled after the last slice
+	std::shared_ptr<LoadJob> sharedJob = mLoadJob;
+	job.pendingUploads = 2;
+	job.vertexStream = rc->getTransferer()->streamToBuffer(*rc,
+		job.vertexData, mVertexBufferSize,
+		mVertexBuffer, 0,
+		[sharedJob]() { sharedJob->pendingUploads -= 1; });
+	job.indexStream = rc->getTransferer()->streamToBuffer(*rc,
+		job.indexData, mIndexBufferSize,
+		mIndexBuffer, 0,
+		[sharedJob]() { sharedJob->pendingUploads -= 1; });
+}
+
+vk::DeviceSize Mesh::getIndexMemorySaved() const
+{
+	if (!mReady) {
+		return 0;
+	}
+	return static_cast<vk::DeviceSize>(mNumIndices) * sizeof(uint32_t) - mIndexBufferSize;
+}
+
+vk::DeviceSize Mesh::getVertexMemorySaved() const
+{
+	if (!mReady) {
+		return 0;
+	}
+	return static_cast<vk::DeviceSize>(mNumVertices) * sizeof(Vertex) - mVertexBufferSize;
+}
+
+void Mesh::getMovableBuffers(std::vector<vkg::Buffer*>* outBuffers)
+{
+	// the buffers are written until the mesh is ready
+	if (!mReady) {
+		return;
+	}
+	outBuffers->push_back(&mVertexBuffer);
+	outBuffers->push_back(&mIndexBuffer);
 }
 
 void Mesh::scheduleDestroy(FrameContext* fc)
 {
+	cancelLoad(fc);
+	destroyBuffers(fc);
+}
+
+void Mesh::destroyBuffers(FrameContext* fc)
+{
+	mReady = false;
 	if (mIndexBuffer) {
 		fc->scheduleToDestroy(mIndexBuffer);
 		mIndexBuffer = nullptr;
@@ -80,186 +624,338 @@ void Mesh::scheduleDestroy(FrameContext* fc)
 
 
 
+void Mesh::encodeVertices(const Vertex* vertices, uint32_t numVertices,
+	std::vector<uint8_t>* outData)
+{
+	assert(mVertexFormat != mesh::VertexFormat::eFloat);
+	outData->resize(static_cast<size_t>(s_getVertexStride(mVertexFormat)) * numVertices);
+
+	const glm::vec3 bboxMin = mBBox.getMin();
+	const glm::vec3 bboxSize = mBBox.getSize();
+	// flat axes are quantized to 0
+	const glm::vec3 invSize(
+		bboxSize.x > 0.0f ? 1.0f / bboxSize.x : 0.0f,
+		bboxSize.y > 0.0f ? 1.0f / bboxSize.y : 0.0f,
+		bboxSize.z > 0.0f ? 1.0f / bboxSize.z : 0.0f);
+
+	const mesh::VertexFormat format = mVertexFormat;
+	uint8_t* const out = outData->data();
+	const std::atomic<bool>* cancelled = &mLoadJob->cancelled;
+	auto encodeRange = [=](uint32_t begin, uint32_t end) {
+		if (cancelled->load(std::memory_order_relaxed)) {
+			return;
+		}
+		for (uint32_t i = begin; i < end; ++i) {
+			const Vertex& v = vertices[i];
+			const uint32_t normal = glm::packSnorm4x8(glm::vec4(v.normal, 0.0f));
+			const uint32_t color = glm::packUnorm4x8(glm::vec4(v.color, 1.0f));
+			const uint32_t texCoord = glm::packHalf2x16(v.texCoord);
+
+			if (format == mesh::VertexFormat::eCompact) {
+				mesh::CompactVertex* dst = reinterpret_cast<mesh::CompactVertex*>(out) + i;
+				dst->pos = v.pos;
+				dst->normal = normal;
+				dst->color = color;
+				dst->texCoord = texCoord;
+			}
+			else {
+				mesh::QuantizedVertex* dst = reinterpret_cast<mesh::QuantizedVertex*>(out) + i;
+				dst->pos = glm::packUnorm<uint16_t>(glm::vec4((v.pos - bboxMin) * invSize, 0.0f));
+				dst->normal = normal;
+				dst->color = color;
+				dst->texCoord = texCoord;
+			}
+		}
+	};
+
+	if (numVertices <= ENCODE_CHUNK_SIZE) {
+		encodeRange(0, numVertices);
+		return;
+	}
+
+	std::vector<grjob::Job> jobs;
+	for (uint32_t begin = 0; begin < numVertices; begin += ENCODE_CHUNK_SIZE) {
+		const uint32_t end = std::min(numVertices, begin + ENCODE_CHUNK_SIZE);
+		const decltype(encodeRange)* pEncode = &encodeRange;
+		jobs.push_back(grjob::Job([pEncode, begin, end]() { (*pEncode)(begin, end); }));
+	}
+	grjob::Counter* c = nullptr;
+	grjob::runJobBatch(grjob::Priority::eLow, jobs.data(), static_cast<uint32_t>(jobs.size()), &c);
+	grjob::waitForCounterAndFree(c, 0);
+}
+
 void Mesh::addToVertexInputDescription(
 	uint32_t binding,
-	vkg::VertexInputDescription* vid)
+	vkg::VertexInputDescription* vid,
+	mesh::VertexFormat format)
 {
 	if (vid->existsBinding(binding)) {
 		throw std::logic_error("Error, already exists binding with such id!");
 	}
 
-	vid->addBinding(binding, sizeof(Vertex))
-		.addAttributeFloat(0, 3, offsetof(Vertex, Vertex::pos))
-		.addAttributeFloat(1, 3, offsetof(Vertex, Vertex::normal))
-		.addAttributeFloat(2, 3, offsetof(Vertex, Vertex::color))
-		.addAttributeFloat(3, 2, offsetof(Vertex, Vertex::texCoord));
+	switch (format) {
+	case mesh::VertexFormat::eFloat:
+		vid->addBinding(binding, sizeof(Vertex))
+			.addAttributeFloat(0, 3, offsetof(Vertex, Vertex::pos))
+			.addAttributeFloat(1, 3, offsetof(Vertex, Vertex::normal))
+			.addAttributeFloat(2, 3, offsetof(Vertex, Vertex::color))
+			.addAttributeFloat(3, 2, offsetof(Vertex, Vertex::texCoord));
+		break;
+	case mesh::VertexFormat::eCompact:
+		vid->addBinding(binding, sizeof(mesh::CompactVertex))
+			.addAttributeFloat(0, 3, offsetof(mesh::CompactVertex, pos))
+			.addAttribute8SNORM(1, 4, offsetof(mesh::CompactVertex, normal))
+			.addAttribute8UNORM(2, 4, offsetof(mesh::CompactVertex, color))
+			.addAttributeHalf(3, 2, offsetof(mesh::CompactVertex, texCoord));
+		break;
+	case mesh::VertexFormat::eCompactQuantized:
+		vid->addBinding(binding, sizeof(mesh::QuantizedVertex))
+			.addAttribute16UNORM(0, 4, offsetof(mesh::QuantizedVertex, pos))
+			.addAttribute8SNORM(1, 4, offsetof(mesh::QuantizedVertex, normal))
+			.addAttribute8UNORM(2, 4, offsetof(mesh::QuantizedVertex, color))
+			.addAttributeHalf(3, 2, offsetof(mesh::QuantizedVertex, texCoord));
+		break;
+	default:
+		throw std::logic_error("Error, unknown vertex format");
+	}
 }
 
-void Mesh::parseObj(const char* fileName)
+uint32_t Mesh::s_getVertexStride(mesh::VertexFormat format)
 {
-
-	tinyobj::ObjReader reader;
-	tinyobj::ObjReaderConfig readerConfig;
-	readerConfig.triangulate = true;
-	readerConfig.vertex_color = true;
-
-	if (!reader.ParseFromFile(fileName, readerConfig)) {
-		throw std::runtime_error("Mesh Load Error: " +
-			reader.Error() + "\n" + reader.Warning());
+	switch (format) {
+	case mesh::VertexFormat::eCompact:
+		return sizeof(mesh::CompactVertex);
+	case mesh::VertexFormat::eCompactQuantized:
+		return sizeof(mesh::QuantizedVertex);
+	default:
+		return sizeof(Vertex);
 	}
+}
 
-	std::unordered_map<Vertex, uint32_t, VertexHash> mVerticesCache;
-
-	const tinyobj::attrib_t& vertAttribs = reader.GetAttrib();
-	const std::vector<tinyobj::shape_t>& shapes = reader.GetShapes();
-	const std::vector<tinyobj::material_t>& materials = reader.GetMaterials();
+void Mesh::parseObj(const char* fileName)
+{
+	mesh::ObjData obj;
+	mesh::parseObj(fileName, &obj, &mLoadJob->cancelled);
+	if (mLoadJob->cancelled.load(std::memory_order_relaxed)) {
+		return;
+	}
 
-	for (const tinyobj::shape_t& shape : shapes) {
-		const tinyobj::mesh_t& mesh = shape.mesh;
+	std::vector<mesh::ObjCorner> uniqueCorners;
+	mesh::deduplicateCornersParallel(obj.corners.data(),
+		static_cast<uint32_t>(obj.corners.size()), &uniqueCorners, &mIndices);
 
-		for (const tinyobj::index_t& idx : mesh.indices) {
-			Vertex v;
-			v.pos = {
-				vertAttribs.vertices[3 * idx.vertex_index + 0],
-				vertAttribs.vertices[3 * idx.vertex_index + 1],
-				vertAttribs.vertices[3 * idx.vertex_index + 2]
-			};
-			if (idx.texcoord_index >= 0) {
-				v.texCoord = {
-					vertAttribs.texcoords[2 * idx.texcoord_index + 0],
-					vertAttribs.texcoords[2 * idx.texcoord_index + 1]
-				};
-			}
-			if (idx.normal_index >= 0) {
-				v.normal = {
-					vertAttribs.normals[3 * idx.normal_index + 0],
-					vertAttribs.normals[3 * idx.normal_index + 1],
-					vertAttribs.normals[3 * idx.normal_index + 2]
-				};
-			}
-			v.color = {
-				vertAttribs.colors[3 * idx.vertex_index + 0],
-				vertAttribs.colors[3 * idx.vertex_index + 1],
-				vertAttribs.colors[3 * idx.vertex_index + 2]
-			};
-
-			const decltype(mVerticesCache)::const_iterator it =
-				mVerticesCache.find(v);
-			if (it != mVerticesCache.end()) {
-				mIndices.push_back(it->second);
-			}
-			else {
-				mIndices.push_back(static_cast<uint32_t>(mVertices.size()));
-				mVertices.push_back(v);
-				mVerticesCache.emplace(v, mIndices.back());
-				mBBox.addPoint(v.pos);
-			}
+	mVertices.resize(uniqueCorners.size());
+	for (size_t i = 0; i < uniqueCorners.size(); ++i) {
+		const mesh::ObjCorner& idx = uniqueCorners[i];
+		Vertex& v = mVertices[i];
+		v.pos = obj.positions[idx.vertex];
+		if (idx.texCoord >= 0) {
+			v.texCoord = obj.texCoords[idx.texCoord];
 		}
+		if (idx.normal >= 0) {
+			v.normal = obj.normals[idx.normal];
+		}
+		v.color = obj.colors.empty() ? glm::vec3(1.0f) : obj.colors[idx.vertex];
+		mBBox.addPoint(v.pos);
 	}
 }
 
 void Mesh::parsePly(const char* fileName)
 {
+	mesh::PlyReader reader;
+	reader.open(fileName);
+	reader.setCancelFlag(&mLoadJob->cancelled);
 
-	std::ifstream stream(fileName, std::ios::binary);
+	mesh::PlyVertexLayout layout;
+	layout.stride = sizeof(Vertex);
+	layout.positionOffset = offsetof(Vertex, pos);
+	layout.colorOffset = offsetof(Vertex, color);
+	layout.normalOffset = offsetof(Vertex, normal);
+	layout.texCoordOffset = offsetof(Vertex, texCoord);
 
-	if (!stream) {
-		throw std::runtime_error("Error: Can't open file " + std::string(fileName));
+	mVertices.resize(reader.getNumVertices());
+	reader.readVertices(mVertices.data(), layout);
+	reader.readTriangles(&mIndices);
+	// the vertices and indices are incomplete
+	if (mLoadJob->cancelled.load(std::memory_order_relaxed)) {
+		return;
 	}
 
-	tinyply::PlyFile file;
-	bool res = file.parse_header(stream);
-	if (!res) {
-		throw std::runtime_error("Error: Can't parse ply header.");
+	for (const Vertex& v : mVertices) {
+		mBBox.addPoint(v.pos);
 	}
+}
 
-	std::shared_ptr<tinyply::PlyData> vertices, normals, texcoords, faces;
-	try { vertices = file.request_properties_from_element("vertex", { "x", "y", "z" }); }
-	catch (const std::exception&) {}
+void Mesh::optimize()
+{
+	const uint32_t numVertices = static_cast<uint32_t>(mVertices.size());
+	mImportedCacheStats = mesh::analyzeVertexCache(mIndices.data(), mIndices.size(), numVertices);
 
-	try { normals = file.request_properties_from_element("vertex", { "nx", "ny", "nz" }); }
-	catch (const std::exception&) {}
+	std::vector<uint32_t> clusters;
+	mesh::optimizeVertexCache(mIndices.data(), mIndices.size(), numVertices,
+		mesh::VERTEX_CACHE_SIZE, &clusters);
+	mesh::optimizeOverdraw(mIndices.data(), mIndices.size(), clusters,
+		mVertices.data(), sizeof(Vertex), numVertices);
 
-	try { texcoords = file.request_properties_from_element("vertex", { "u", "v" }); }
-	catch (const std::exception&) {}
-	try { texcoords = file.request_properties_from_element("vertex", { "s", "t" }); }
-	catch (const std::exception&) {}
+	// Big meshes are drawn by regions, to use 16 bit indices
+	LoadJob& job = *mLoadJob;
+	job.triangleRegions.clear();
+	job.numRegions = 0;
+	if (numVertices > std::numeric_limits<uint16_t>::max() + 1u) {
+		job.numRegions = mesh::partitionTriangles(mIndices.data(), mIndices.size(),
+			mVertices.data(), sizeof(Vertex), numVertices, REGION_MAX_VERTICES, &job.triangleRegions);
+	}
 
-	try { faces = file.request_properties_from_element("face", { "vertex_indices" }, 3); }
-	catch (const std::exception&) {}
+	std::vector<uint32_t> remap;
+	const uint32_t numUsed = mesh::optimizeVertexFetchRemap(
+		mIndices.data(), mIndices.size(), numVertices, &remap);
+	std::vector<Vertex> vertices(numUsed);
+	for (uint32_t v = 0; v < numVertices; ++v) {
+		if (remap[v] != ~0u) {
+			vertices[remap[v]] = mVertices[v];
+		}
+	}
+	mVertices.swap(vertices);
+
+	mOptimizedCacheStats = mesh::analyzeVertexCache(mIndices.data(), mIndices.size(), numUsed);
+}
 
-	file.read(stream);
+void Mesh::generateLods()
+{
+	const uint32_t numVertices = static_cast<uint32_t>(mVertices.size());
+	mLods.assign(1, mesh::LodRange{ 0, static_cast<uint32_t>(mIndices.size()), 0.0f });
 
-	if (!vertices || !faces) {
-		throw std::runtime_error("Error: Can't load faces of ply.");
+	// The triangles of the LODs go to the regions of their vertices
+	LoadJob& job = *mLoadJob;
+	std::vector<uint32_t> vertexRegions;
+	if (job.numRegions > 0) {
+		mesh::getVertexRegions(mIndices.data(), mIndices.size(), job.triangleRegions.data(),
+			numVertices, &vertexRegions);
 	}
 
-	assert(vertices->t == tinyply::Type::FLOAT32);
-	assert(!normals || normals->t == tinyply::Type::FLOAT32);
-	assert(!texcoords || texcoords->t == tinyply::Type::FLOAT32);
+	std::vector<uint32_t> lodIndices;
+	std::vector<uint32_t> lodRegions;
+	while (mLods.size() < MAX_LODS) {
+		const mesh::LodRange prev = mLods.back();
+		if (prev.numIndices < LOD_MIN_INDICES || job.cancelled.load(std::memory_order_relaxed)) {
+			break;
+		}
 
+		const size_t targetIndices = static_cast<size_t>(prev.numIndices * LOD_INDEX_RATIO);
+		// the errors of the chain are accumulated, as an upper bound
+		const float error = prev.error + mesh::simplify(
+			mIndices.data() + prev.firstIndex, prev.numIndices,
+			mVertices.data(), sizeof(Vertex), numVertices,
+			targetIndices, LOD_MAX_ERROR - prev.error, &lodIndices, &job.cancelled);
 
-	// copy vertices
-	mVertices.resize(vertices->count);
-	for (size_t i = 0; i < vertices->count; ++i) {
-		std::memcpy(&mVertices[i].pos, vertices->buffer.get() + i * 3 * sizeof(float), 3 * sizeof(float));
-		if (texcoords) {
-			std::memcpy(&mVertices[i].texCoord, texcoords->buffer.get() + i * 2 * sizeof(float), 2 * sizeof(float));
+		if (job.cancelled.load(std::memory_order_relaxed) || lodIndices.empty() ||
+			lodIndices.size() > static_cast<size_t>(prev.numIndices * LOD_MIN_REDUCTION)) {
+			break;
 		}
-		if (normals) {
-			std::memcpy(&mVertices[i].normal, normals->buffer.get() + i * 3 * sizeof(float), 3 * sizeof(float));
+
+		// The vertices are shared with the full mesh, only the triangles are reordered
+		mesh::optimizeVertexCache(lodIndices.data(), lodIndices.size(), numVertices);
+		if (job.numRegions > 0) {
+			mesh::sortTrianglesByRegion(lodIndices.data(), lodIndices.size(),
+				vertexRegions.data(), job.numRegions, &lodRegions);
+			job.triangleRegions.insert(job.triangleRegions.end(), lodRegions.begin(), lodRegions.end());
 		}
 
-		mBBox.addPoint(mVertices[i].pos);
+		mLods.push_back(mesh::LodRange{
+			static_cast<uint32_t>(mIndices.size()),
+			static_cast<uint32_t>(lodIndices.size()),
+			error });
+		mIndices.insert(mIndices.end(), lodIndices.begin(), lodIndices.end());
 	}
+}
 
-	mIndices.resize(faces->count * 3);
-	if (faces->t == tinyply::Type::UINT32 || faces->t == tinyply::Type::INT32) {
-		std::memcpy(mIndices.data(), faces->buffer.get(), faces->buffer.size_bytes());
+void Mesh::layoutVertices()
+{
+	LoadJob& job = *mLoadJob;
+	if (job.numRegions == 0) {
+		return;
 	}
-	else if (faces->t == tinyply::Type::UINT16 || faces->t == tinyply::Type::INT16) {
-		for (size_t i = 0; i < faces->count; ++i) {
-			glm::i16vec3 tmp;
-			std::memcpy(&tmp, faces->buffer.get() + i * 3 * sizeof(uint16_t), 3 * sizeof(uint16_t));
-			mIndices[3 * i + 0] = static_cast<uint32_t>(tmp.x);
-			mIndices[3 * i + 1] = static_cast<uint32_t>(tmp.y);
-			mIndices[3 * i + 2] = static_cast<uint32_t>(tmp.z);
+
+	// The vertices of each region, and the ones that its LODs share with
+	// other regions, are in a block that 16 bit indices can address
+	std::vector<uint32_t> source;
+	if (mesh::layoutRegionVertices(mIndices.data(), mIndices.size(), job.triangleRegions.data(),
+		job.numRegions, static_cast<uint32_t>(mVertices.size()), &source)) {
+		std::vector<Vertex> vertices(source.size());
+		for (size_t v = 0; v < source.size(); ++v) {
+			vertices[v] = mVertices[source[v]];
 		}
-	}
-	else {
-		throw std::runtime_error("Error: Cant read face format");
+		mVertices.swap(vertices);
 	}
 
+	std::vector<uint32_t>().swap(job.triangleRegions);
+	job.numRegions = 0;
 }
 
-bool Mesh::Vertex::operator==(const Vertex& o) const
+void Mesh::buildMeshlets()
 {
-	return this->pos == o.pos &&
-		this->normal == o.normal &&
-		this->color == o.color &&
-		this->texCoord == o.texCoord;
+	mMeshlets.clear();
+	for (const mesh::LodRange& lod : mLods) {
+		mesh::buildMeshlets(mIndices.data(), lod.firstIndex, lod.numIndices,
+			mVertices.data(), sizeof(Vertex), static_cast<uint32_t>(mVertices.size()),
+			&mMeshlets);
+	}
 }
 
-std::size_t Mesh::VertexHash::operator()(const Vertex& o) const
+void Mesh::createMeshletDraws()
 {
-	return ((std::hash<glm::vec3>()(o.pos) ^
-		(std::hash<glm::vec3>()(o.normal)) ^
-		(std::hash<glm::vec3>()(o.color) << 1)) >> 1) ^
-		(std::hash<glm::vec2>()(o.texCoord) << 1);
+	mLodFirstMeshlet.clear();
+	for (const mesh::LodRange& lod : mLods) {
+		const auto it = std::lower_bound(mMeshlets.begin(), mMeshlets.end(), lod.firstIndex,
+			[](const mesh::Meshlet& m, uint32_t firstIndex) { return m.firstIndex < firstIndex; });
+		mLodFirstMeshlet.push_back(static_cast<uint32_t>(it - mMeshlets.begin()));
+	}
+	mLodFirstMeshlet.push_back(static_cast<uint32_t>(mMeshlets.size()));
+
+	// The submeshes are sorted and do not overlap, a meshlet is drawn
+	// once for each submesh that it intersects
+	mMeshletDraws.clear();
+	mMeshletFirstDraw.clear();
+	size_t submesh = 0;
+	for (const mesh::Meshlet& meshlet : mMeshlets) {
+		mMeshletFirstDraw.push_back(static_cast<uint32_t>(mMeshletDraws.size()));
+		const uint32_t end = meshlet.firstIndex + meshlet.numIndices;
+		while (submesh < mSubmeshes.size() &&
+			mSubmeshes[submesh].firstIndex + mSubmeshes[submesh].numIndices <= meshlet.firstIndex) {
+			++submesh;
+		}
+		for (size_t s = submesh; s < mSubmeshes.size() && mSubmeshes[s].firstIndex < end; ++s) {
+			const uint32_t first = std::max(meshlet.firstIndex, mSubmeshes[s].firstIndex);
+			const uint32_t last = std::min(end, mSubmeshes[s].firstIndex + mSubmeshes[s].numIndices);
+			mMeshletDraws.push_back(vk::DrawIndexedIndirectCommand(
+				last - first,				// index count
+				1,							// instance count
+				first,						// first index
+				mSubmeshes[s].vertexOffset,	// vertex offset
+				0));						// first instance
+		}
+	}
+	mMeshletFirstDraw.push_back(static_cast<uint32_t>(mMeshletDraws.size()));
 }
 
 void Mesh::renderImGui(FrameContext* fc, Gui* gui)
 {
 	ImGui::TextDisabled("Triangle Mesh");
 	ImGui::Separator();
-	ImGui::Text("Num vertices: %u", mVertices.size());
-	ImGui::Text("Num indices: %u", mIndices.size());
-
-	ImGui::Text("BBox\n\t(%.2f,%.2f,%.2f)\n\t(%.2f,%.2f,%.2f)", 
-		mBBox.getMin().x, mBBox.getMin().y, mBBox.getMin().z,
-		mBBox.getMax().x, mBBox.getMax().y, mBBox.getMax().z);
-	ImGui::Text("BBox size (%.2f, %.2f, %.2f)",
-		mBBox.getSize().x, mBBox.getSize().y, mBBox.getSize().z);
+	if (mReady) {
+		renderImGuiMeshInfo(fc);
+	}
+	else if (isLoading()) {
+		const LoadStage stage = getLoadStage();
+		ImGui::Text("Loading: %s", s_getLoadStageName(stage));
+		ImGui::ProgressBar(getLoadProgress());
+	}
+	else if (!mLoadError.empty()) {
+		ImGui::TextWrapped("Error loading the mesh: %s", mLoadError.c_str());
+	}
+	else {
+		ImGui::Text("No mesh loaded");
+	}
 
 	ImGui::Separator();
 	ImGui::Text("Path of model:");
@@ -272,6 +968,60 @@ void Mesh::renderImGui(FrameContext* fc, Gui* gui)
 
 }
 
+void Mesh::renderImGuiMeshInfo(FrameContext* fc)
+{
+	ImGui::Text("Num vertices: %u", mNumVertices);
+	ImGui::Text("Num indices: %u", mNumIndices);
+	ImGui::Text("Index memory: %.2f MB (%s, %u draws)",
+		static_cast<float>(mIndexBufferSize) / (1024.0f * 1024.0f),
+		mIndexType == vk::IndexType::eUint16 ? "16 bit" : "32 bit",
+		static_cast<uint32_t>(mSubmeshes.size()));
+	ImGui::Text(mLoadedFromCache ? "Loaded from mesh cache" : "Imported from source");
+	ImGui::Text("Vertex memory: %.2f MB (%u bytes per vertex)",
+		static_cast<float>(mVertexBufferSize) / (1024.0f * 1024.0f), s_getVertexStride(mVertexFormat));
+	bool reload = false;
+	if (ImGui::BeginCombo("Vertex format", mesh::getVertexFormatName(mVertexFormat))) {
+		for (uint32_t i = 0; i < mesh::NUM_VERTEX_FORMATS; ++i) {
+			const mesh::VertexFormat format = static_cast<mesh::VertexFormat>(i);
+			if (ImGui::Selectable(mesh::getVertexFormatName(format), format == mVertexFormat) &&
+				format != mVertexFormat) {
+				// the cache holds the full precision vertices
+				mVertexFormat = format;
+				reload = true;
+			}
+		}
+		ImGui::EndCombo();
+	}
+	if (reload) {
+		// the members are written by the load job from now on
+		try {
+			this->load(fc, mPath.c_str());
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+		}
+		return;
+	}
+	if (ImGui::TreeNode("Levels of detail")) {
+		for (uint32_t i = 0; i < getNumLods(); ++i) {
+			ImGui::Text("LOD %u: %u triangles, %u meshlets, error %.4f",
+				i, mLods[i].numIndices / 3,
+				mLodFirstMeshlet[i + 1] - mLodFirstMeshlet[i], mLods[i].error);
+		}
+		ImGui::TreePop();
+	}
+	ImGui::Text("Vertex cache ACMR: %.3f -> %.3f",
+		mImportedCacheStats.acmr, mOptimizedCacheStats.acmr);
+	ImGui::Text("Vertex cache ATVR: %.3f -> %.3f",
+		mImportedCacheStats.atvr, mOptimizedCacheStats.atvr);
+
+	ImGui::Text("BBox\n\t(%.2f,%.2f,%.2f)\n\t(%.2f,%.2f,%.2f)", 
+		mBBox.getMin().x, mBBox.getMin().y, mBBox.getMin().z,
+		mBBox.getMax().x, mBBox.getMax().y, mBBox.getMax().z);
+	ImGui::Text("BBox size (%.2f, %.2f, %.2f)",
+		mBBox.getSize().x, mBBox.getSize().y, mBBox.getSize().z);
+}
+
 void Mesh::start(FrameContext* fc)
 {
 	if (!mPath.empty()) {
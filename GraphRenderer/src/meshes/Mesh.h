@@ -2,11 +2,17 @@
 
 #include <glm/glm.hpp>
 #include <vector>
+#include <memory>
 
 #include "../graphics/resources/Buffer.h"
 #include "../graphics/shaders/VertexInputDescription.h"
 #include "IObject.h"
 #include "../utils/math/BBox.h"
+#include "MeshProcessing/MeshCache.h"
+#include "MeshProcessing/MeshOptimizer.h"
+#include "MeshProcessing/MeshSimplifier.h"
+#include "MeshProcessing/MeshletBuilder.h"
+#include "MeshProcessing/VertexFormat.h"
 
 namespace gr
 {
@@ -24,38 +30,96 @@ public:
 
 	Mesh() = default;
 
-	Mesh(const Mesh&) = default;
+	// Not copied, a load in progress would be shared
+	Mesh(const Mesh&) = delete;
 	Mesh(Mesh&&) = default;
-	Mesh& operator=(const Mesh&) = default;
+	Mesh& operator=(const Mesh&) = delete;
 	Mesh& operator=(Mesh&&) = default;
 
-	// Catch exception if it can fail
+	// Stages of the load, in order
+	enum class LoadStage : uint32_t {
+		eNone,
+		eQueued,
+		eReading,
+		eOptimizing,
+		eSimplifying,
+		eBuildingMeshlets,
+		eEncoding,
+		eUploading,
+		eReady,
+		eFailed
+	};
+
+	// Starts loading the mesh in the background, discarding the previous one.
+	// The mesh is parsed by a low priority job, and uploaded by the ResourceLoader.
+	// It can be drawn once the transfer has finished
 	void load(FrameContext* fc,
 		const char* filePath);
 
 	void scheduleDestroy(FrameContext* fc) override final;
 	void renderImGui(FrameContext* fc, Gui* gui) override final;
 	void start(FrameContext* fc) override final;
+	bool updateLoad(FrameContext* fc) override final;
+
+	LoadStage getLoadStage() const;
+	// From 0 to 1
+	float getLoadProgress() const;
+	bool isLoading() const { return mLoadJob != nullptr; }
+	static const char* s_getLoadStageName(LoadStage stage);
 
 	static constexpr const char* s_getClassName() { return "Mesh"; }
 
 
 	const vk::Buffer& getVB() const { return mVertexBuffer.getVkBuffer(); }
 	const vk::Buffer& getIB() const { return mIndexBuffer.getVkBuffer(); }
+	// The buffers of the uploaded mesh, that the defragmentation can move
+	void getMovableBuffers(std::vector<vkg::Buffer*>* outBuffers);
+
+	uint32_t getNumIndices() const { return mNumIndices; }
+	vk::IndexType getIndexType() const { return mIndexType; }
+	// Draws of the mesh, one unless the 16 bit indices need several vertex offsets
+	const std::vector<mesh::Submesh>& getSubmeshes() const { return mSubmeshes; }
+
+	// Levels of detail, from the full mesh to the coarsest. At least one if loaded
+	uint32_t getNumLods() const { return static_cast<uint32_t>(mLods.size()); }
+	const mesh::LodRange& getLod(uint32_t lod) const { return mLods[lod]; }
+	// The submeshes of a LOD are [getLodFirstSubmesh(lod), getLodFirstSubmesh(lod + 1))
+	uint32_t getLodFirstSubmesh(uint32_t lod) const { return mLodFirstSubmesh[lod]; }
+
+	uint32_t getNumMeshlets() const { return static_cast<uint32_t>(mMeshlets.size()); }
+	const mesh::Meshlet& getMeshlet(uint32_t meshlet) const { return mMeshlets[meshlet]; }
+	// The meshlets of a LOD are [getLodFirstMeshlet(lod), getLodFirstMeshlet(lod + 1))
+	uint32_t getLodFirstMeshlet(uint32_t lod) const { return mLodFirstMeshlet[lod]; }
+	// Indirect draws of the triangles of a meshlet, two if it spans two submeshes
+	const vk::DrawIndexedIndirectCommand* getMeshletDraws(uint32_t meshlet, uint32_t* numDraws) const {
+		*numDraws = mMeshletFirstDraw[meshlet + 1] - mMeshletFirstDraw[meshlet];
+		return mMeshletDraws.data() + mMeshletFirstDraw[meshlet];
+	}
 
-	uint32_t getNumIndices() const { return static_cast<uint32_t>(mIndices.size()); }
+	// Bytes of GPU memory saved by the compact index and vertex formats
+	vk::DeviceSize getIndexMemorySaved() const;
+	vk::DeviceSize getVertexMemorySaved() const;
 
 	const mth::AABBox& getBBox() const { return mBBox; }
 
-	// add binding with locations:
+	mesh::VertexFormat getVertexFormat() const { return mVertexFormat; }
+	// Transforms the positions in the vertex buffer to object space.
+	// Identity unless the positions are quantized
+	const glm::mat4& getPositionDequantization() const { return mPositionDequantization; }
+
+	// add binding with locations, decoded to float by the vertex input:
 	// (location = 0) float3 vertexPosition
 	// (location = 1) float3 normal
 	// (location = 2) float3 vertexColor
 	// (location = 3) float2 texCoord
 	static void addToVertexInputDescription(uint32_t binding,
-		vkg::VertexInputDescription* vid);
+		vkg::VertexInputDescription* vid,
+		mesh::VertexFormat format = mesh::VertexFormat::eFloat);
 
-	operator bool()const { return mIndexBuffer; }
+	static uint32_t s_getVertexStride(mesh::VertexFormat format);
+
+	// True once the buffers have been uploaded, and the mesh can be drawn
+	operator bool()const { return mReady; }
 
 protected:
 
@@ -64,18 +128,41 @@ protected:
 		glm::vec3 color = glm::vec3(0.0f);
 		glm::vec3 normal = glm::vec3(0.0f);
 		glm::vec2 texCoord = glm::vec2(0.0f);
-
-		bool operator==(const Vertex&) const;
-	};
-
-	struct VertexHash {
-		std::size_t operator()(const Vertex& o) const;
 	};
 
 
+	// Only kept while importing, the data lives in the GPU and in the mesh cache
 	std::vector<Vertex> mVertices;
 	std::vector<uint32_t> mIndices;
 
+	uint32_t mNumVertices = 0;
+	uint32_t mNumIndices = 0;
+	bool mLoadedFromCache = false;
+
+	mesh::VertexFormat mVertexFormat = mesh::VertexFormat::eCompact;
+	glm::mat4 mPositionDequantization = glm::mat4(1.0f);
+
+	vk::IndexType mIndexType = vk::IndexType::eUint32;
+	std::vector<mesh::Submesh> mSubmeshes;
+
+	// Index ranges of the LODs, the first one is the full mesh
+	std::vector<mesh::LodRange> mLods;
+	// Size of mLods + 1
+	std::vector<uint32_t> mLodFirstSubmesh;
+
+	// Clusters of triangles of every LOD, to cull them
+	std::vector<mesh::Meshlet> mMeshlets;
+	// Size of mLods + 1
+	std::vector<uint32_t> mLodFirstMeshlet;
+	// Draw commands of the meshlets, with the vertex offset of their submeshes
+	std::vector<vk::DrawIndexedIndirectCommand> mMeshletDraws;
+	// Size of mMeshlets + 1
+	std::vector<uint32_t> mMeshletFirstDraw;
+
+	// Of the indices in file order, and after optimize
+	mesh::VertexCacheStatistics mImportedCacheStats;
+	mesh::VertexCacheStatistics mOptimizedCacheStats;
+
 	vkg::Buffer mIndexBuffer;
 	vkg::Buffer mVertexBuffer;
 
@@ -86,17 +173,102 @@ protected:
 
 	std::string mPath;
 
+	// State shared with the job that loads the mesh
+	struct LoadJob;
+	std::shared_ptr<LoadJob> mLoadJob;
+	// Stage once the load has finished, or if there is no load
+	LoadStage mLoadStage = LoadStage::eNone;
+	std::string mLoadError;
+	bool mReady = false;
+
+
+	// Runs in a job. Parses the mesh, or reads it from the cache, and prepares
+	// the data to upload. It only writes the members of the mesh until it
+	// finishes, and the main thread does not read them until then
+	void runLoadJob();
+	// Waits for the job, and discards the data loaded
+	void cancelLoad(FrameContext* fc);
+	// Frees the data only needed while loading
+	void finishLoad();
+	void destroyBuffers(FrameContext* fc);
+
+	// Statistics and options of the loaded mesh
+	void renderImGuiMeshInfo(FrameContext* fc);
 
 	void parseObj(const char* fileName);
 	void parsePly(const char* fileName);
 
+	// Reorders the triangles for the vertex cache and overdraw,
+	// and the vertices for the vertex fetch. Big meshes are split in regions
+	void optimize();
+
+	// Appends the indices of the simplified LODs to mIndices
+	void generateLods();
+
+	// Duplicates the vertices of big meshes in a block for each region, so that
+	// every LOD can be drawn with 16 bit indices
+	void layoutVertices();
+
+	// Splits every LOD in meshlets
+	void buildMeshlets();
+
+	// Finds the meshlets of each LOD, and the draws of each meshlet. After the submeshes
+	void createMeshletDraws();
+
+	// Returns false if the cache does not contain a valid mesh. If it was
+	// written with another vertex format, fills mVertices and mIndices to encode them
+	bool loadFromCache(const mesh::MeshCacheReader& cache);
+	// Errors writing the cache are not fatal
+	void writeCache(const std::filesystem::path& cachePath,
+		const std::filesystem::path& sourcePath) const;
+
+	// mVertices are converted to mVertexFormat. The indices of each of mLods
+	// are split in submeshes independently. The data to upload is kept in mLoadJob,
+	// it may point to mVertices and mIndices
+	void prepareBuffers();
+	// Points the data to upload to the buffers in the cache, without any conversion.
+	// Returns false if the cache was written with another vertex format
+	bool prepareBuffersFromCache(const mesh::MeshCacheReader& cache);
+	// The sizes of the buffers and the draws, once the submeshes are known
+	void setBufferLayout(uint32_t numVertices, uint32_t numIndices);
+
+	void createBuffers(const vkg::RenderContext& rc);
+	// In the job, if the device memory is host visible. The buffers are created
+	// and written without staging. They are uploaded by the main thread if they
+	// can not be mapped
+	void writeBuffersDirectly(const vkg::RenderContext& rc);
+
+	// In the main thread, once the job has prepared the buffers.
+	// The buffers are streamed, the mesh is ready once both callbacks are called
+	void createAndUploadBuffers(FrameContext* fc);
+
+	// Returns the encoded vertices, in the layout of mVertexFormat
+	void encodeVertices(const Vertex* vertices, uint32_t numVertices,
+		std::vector<uint8_t>* outData);
+
 
 	// Serialization functions
 	template<class Archive>
-	void serialize(Archive& archive)
+	void save(Archive& archive) const
+	{
+		archive(cereal::base_class<IObject>(this));
+		archive(GR_SERIALIZE_NVP_MEMBER(mPath));
+		archive(GR_SERIALIZE_NVP_MEMBER(mVertexFormat));
+	}
+
+	template<class Archive>
+	void load(Archive& archive)
 	{
 		archive(cereal::base_class<IObject>(this));
 		archive(GR_SERIALIZE_NVP_MEMBER(mPath));
+		// projects saved before the vertex formats used float vertices,
+		// the compact default is for the meshes imported from now on
+		try {
+			archive(GR_SERIALIZE_NVP_MEMBER(mVertexFormat));
+		}
+		catch (const cereal::Exception&) {
+			mVertexFormat = mesh::VertexFormat::eFloat;
+		}
 	}
 
 	GR_SERIALIZE_PRIVATE_MEMBERS
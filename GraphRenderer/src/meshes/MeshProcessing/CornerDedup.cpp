@@ -0,0 +1,213 @@
+#include "CornerDedup.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "../../utils/grjob.h"
+
+namespace gr
+{
+namespace mesh
+{
+
+namespace
+{
+
+// Below this the job overhead is larger than the gain
+constexpr uint32_t MIN_PARALLEL_CORNERS = 1 << 16;
+// Corners hashed and scattered by each job
+constexpr uint32_t CORNER_CHUNK_SIZE = 1 << 16;
+constexpr uint32_t NUM_PARTITIONS = 64;
+
+constexpr uint32_t EMPTY_SLOT = ~0u;
+
+inline uint32_t hashCorner(const ObjCorner& c)
+{
+	// 64 bit multiply-xorshift mix of the three indices
+	uint64_t h = static_cast<uint32_t>(c.vertex);
+	h = h * 0x9E3779B97F4A7C15ull ^ static_cast<uint32_t>(c.texCoord);
+	h = h * 0x9E3779B97F4A7C15ull ^ static_cast<uint32_t>(c.normal);
+	h ^= h >> 32;
+	h *= 0xD6E8FEB86659FD93ull;
+	h ^= h >> 32;
+	return static_cast<uint32_t>(h);
+}
+
+inline bool operator==(const ObjCorner& a, const ObjCorner& b)
+{
+	return a.vertex == b.vertex && a.texCoord == b.texCoord && a.normal == b.normal;
+}
+
+// Open addressing table with linear probing of the positions of the unique corners.
+// Never grows: the capacity is at least twice the maximum number of unique corners
+class CornerTable
+{
+public:
+	CornerTable(uint32_t maxElements, std::vector<ObjCorner>* uniqueCorners) :
+		mUniqueCorners(uniqueCorners)
+	{
+		uint64_t capacity = 16;
+		mShift = 64 - 4;
+		while (capacity < 2 * static_cast<uint64_t>(maxElements)) {
+			capacity <<= 1;
+			mShift -= 1;
+		}
+		mMask = capacity - 1;
+		mSlots.resize(capacity, EMPTY_SLOT);
+	}
+
+	// Returns the position of the corner in the unique corners, adding it if it is new
+	uint32_t findOrInsert(const ObjCorner& corner, uint32_t hash)
+	{
+		// fibonacci hashing, as the low bits are shared in a partition
+		uint64_t slot = (hash * 0x9E3779B97F4A7C15ull) >> mShift;
+		while (true) {
+			const uint32_t idx = mSlots[slot];
+			if (idx == EMPTY_SLOT) {
+				const uint32_t newIdx = static_cast<uint32_t>(mUniqueCorners->size());
+				mSlots[slot] = newIdx;
+				mUniqueCorners->push_back(corner);
+				return newIdx;
+			}
+			if ((*mUniqueCorners)[idx] == corner) {
+				return idx;
+			}
+			slot = (slot + 1) & mMask;
+		}
+	}
+
+private:
+	std::vector<uint32_t> mSlots;
+	uint64_t mMask;
+	uint32_t mShift;
+	std::vector<ObjCorner>* mUniqueCorners;
+};
+
+inline uint32_t partitionOf(uint32_t hash)
+{
+	return hash & (NUM_PARTITIONS - 1);
+}
+
+template<typename F>
+void runChunks(uint32_t numElements, uint32_t chunkSize, F&& f)
+{
+	const uint32_t numChunks = (numElements + chunkSize - 1) / chunkSize;
+	std::vector<grjob::Job> jobs;
+	jobs.reserve(numChunks);
+	for (uint32_t i = 0; i < numChunks; ++i) {
+		F* pF = &f;
+		jobs.push_back(grjob::Job([pF, i]() { (*pF)(i); }));
+	}
+	grjob::Counter* c = nullptr;
+	grjob::runJobBatch(grjob::Priority::eLow, jobs.data(), numChunks, &c);
+	grjob::waitForCounterAndFree(c, 0);
+}
+
+} // namespace
+
+
+void deduplicateCorners(const ObjCorner* corners, uint32_t numCorners,
+	std::vector<ObjCorner>* outUniqueCorners,
+	std::vector<uint32_t>* outIndices)
+{
+	assert(outUniqueCorners != nullptr && outIndices != nullptr);
+	outUniqueCorners->clear();
+	outUniqueCorners->reserve(numCorners / 4);
+	outIndices->resize(numCorners);
+
+	CornerTable table(numCorners, outUniqueCorners);
+	for (uint32_t i = 0; i < numCorners; ++i) {
+		(*outIndices)[i] = table.findOrInsert(corners[i], hashCorner(corners[i]));
+	}
+}
+
+void deduplicateCornersParallel(const ObjCorner* corners, uint32_t numCorners,
+	std::vector<ObjCorner>* outUniqueCorners,
+	std::vector<uint32_t>* outIndices)
+{
+	if (numCorners < MIN_PARALLEL_CORNERS) {
+		deduplicateCorners(corners, numCorners, outUniqueCorners, outIndices);
+		return;
+	}
+	assert(outUniqueCorners != nullptr && outIndices != nullptr);
+
+	const uint32_t numChunks = (numCorners + CORNER_CHUNK_SIZE - 1) / CORNER_CHUNK_SIZE;
+	std::vector<uint32_t> hashes(numCorners);
+	// number of corners of each partition in each chunk, becomes the offsets
+	std::vector<uint32_t> histograms(static_cast<size_t>(numChunks) * NUM_PARTITIONS, 0);
+
+	// hash and count
+	runChunks(numCorners, CORNER_CHUNK_SIZE, [&](uint32_t chunk) {
+		uint32_t* histogram = histograms.data() + static_cast<size_t>(chunk) * NUM_PARTITIONS;
+		const uint32_t end = std::min(numCorners, (chunk + 1) * CORNER_CHUNK_SIZE);
+		for (uint32_t i = chunk * CORNER_CHUNK_SIZE; i < end; ++i) {
+			hashes[i] = hashCorner(corners[i]);
+			histogram[partitionOf(hashes[i])] += 1;
+		}
+	});
+
+	// offsets sorted by partition, and then by chunk to keep the order of the corners
+	std::vector<uint32_t> partitionBegin(NUM_PARTITIONS + 1);
+	{
+		uint32_t offset = 0;
+		for (uint32_t p = 0; p < NUM_PARTITIONS; ++p) {
+			partitionBegin[p] = offset;
+			for (uint32_t chunk = 0; chunk < numChunks; ++chunk) {
+				uint32_t& count = histograms[static_cast<size_t>(chunk) * NUM_PARTITIONS + p];
+				const uint32_t n = count;
+				count = offset;
+				offset += n;
+			}
+		}
+		partitionBegin[NUM_PARTITIONS] = offset;
+	}
+
+	// scatter the corner positions by partition
+	std::vector<uint32_t> sortedCorners(numCorners);
+	runChunks(numCorners, CORNER_CHUNK_SIZE, [&](uint32_t chunk) {
+		uint32_t* offsets = histograms.data() + static_cast<size_t>(chunk) * NUM_PARTITIONS;
+		const uint32_t end = std::min(numCorners, (chunk + 1) * CORNER_CHUNK_SIZE);
+		for (uint32_t i = chunk * CORNER_CHUNK_SIZE; i < end; ++i) {
+			sortedCorners[offsets[partitionOf(hashes[i])]++] = i;
+		}
+	});
+
+	// deduplicate each partition, the indices are local to the partition
+	outIndices->resize(numCorners);
+	std::vector<std::vector<ObjCorner>> uniquePerPartition(NUM_PARTITIONS);
+	runChunks(NUM_PARTITIONS, 1, [&](uint32_t p) {
+		const uint32_t begin = partitionBegin[p];
+		const uint32_t end = partitionBegin[p + 1];
+		std::vector<ObjCorner>& unique = uniquePerPartition[p];
+		unique.reserve((end - begin) / 4);
+
+		CornerTable table(end - begin, &unique);
+		for (uint32_t i = begin; i < end; ++i) {
+			const uint32_t c = sortedCorners[i];
+			(*outIndices)[c] = table.findOrInsert(corners[c], hashes[c]);
+		}
+	});
+
+	// concatenate the partitions
+	std::vector<uint32_t> uniqueOffsets(NUM_PARTITIONS);
+	uint32_t numUnique = 0;
+	for (uint32_t p = 0; p < NUM_PARTITIONS; ++p) {
+		uniqueOffsets[p] = numUnique;
+		numUnique += static_cast<uint32_t>(uniquePerPartition[p].size());
+	}
+	outUniqueCorners->resize(numUnique);
+
+	runChunks(NUM_PARTITIONS, 1, [&](uint32_t p) {
+		std::copy(uniquePerPartition[p].begin(), uniquePerPartition[p].end(),
+			outUniqueCorners->begin() + uniqueOffsets[p]);
+	});
+	runChunks(numCorners, CORNER_CHUNK_SIZE, [&](uint32_t chunk) {
+		const uint32_t end = std::min(numCorners, (chunk + 1) * CORNER_CHUNK_SIZE);
+		for (uint32_t i = chunk * CORNER_CHUNK_SIZE; i < end; ++i) {
+			(*outIndices)[i] += uniqueOffsets[partitionOf(hashes[i])];
+		}
+	});
+}
+
+} // namespace mesh
+} // namespace gr
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "ObjParser.h"
+
+namespace gr
+{
+namespace mesh
+{
+
+// Finds the unique (vertex, texCoord, normal) triples of the corners.
+// outIndices[i] is the position of corners[i] in outUniqueCorners, which are
+// ordered by first appearance. Uses an open addressing hash table sized
+// from the number of corners, so there is no allocation per unique corner.
+void deduplicateCorners(const ObjCorner* corners, uint32_t numCorners,
+	std::vector<ObjCorner>* outUniqueCorners,
+	std::vector<uint32_t>* outIndices);
+
+// Same as deduplicateCorners, but the corners are partitioned by hash and
+// each partition is deduplicated concurrently in the job system.
+// The unique corners are ordered by partition, and then by first appearance.
+// Falls back to the sequential version for small inputs.
+void deduplicateCornersParallel(const ObjCorner* corners, uint32_t numCorners,
+	std::vector<ObjCorner>* outUniqueCorners,
+	std::vector<uint32_t>* outIndices);
+
+} // namespace mesh
+} // namespace gr
@@ -0,0 +1,249 @@
+#include "MeshCache.h"
+
+#include <fstream>
+#include <chrono>
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+#include <system_error>
+
+namespace gr
+{
+namespace mesh
+{
+
+namespace
+{
+
+uint64_t fnv1a(const uint8_t* data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= data[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+// Resolution of the write times of the coarsest file systems, i.e. FAT
+constexpr std::chrono::seconds WRITE_TIME_RESOLUTION(2);
+
+} // namespace
+
+
+bool getSourceInfo(const std::filesystem::path& sourcePath, MeshCacheHeader* header)
+{
+	std::error_code ec;
+	const uintmax_t size = std::filesystem::file_size(sourcePath, ec);
+	if (ec) {
+		return false;
+	}
+	const std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(sourcePath, ec);
+	if (ec) {
+		return false;
+	}
+
+	header->sourceSize = static_cast<uint64_t>(size);
+	header->sourceWriteTime = static_cast<int64_t>(writeTime.time_since_epoch().count());
+	return true;
+}
+
+uint64_t hashFile(const std::filesystem::path& path)
+{
+	tools::MappedFile file;
+	if (!file.open(path.string().c_str())) {
+		throw std::runtime_error("Error: Can't open file " + path.string());
+	}
+
+	return fnv1a(file.data(), file.size());
+}
+
+uint64_t hashBytes(const void* data, size_t size)
+{
+	return fnv1a(reinterpret_cast<const uint8_t*>(data), size);
+}
+
+std::filesystem::path getMeshCachePath(
+	const std::filesystem::path& projectPath,
+	const std::filesystem::path& relativeSourcePath)
+{
+	const std::string source = relativeSourcePath.generic_string();
+	const uint64_t hash = hashBytes(source.data(), source.size());
+
+	char hashStr[17];
+	std::snprintf(hashStr, sizeof(hashStr), "%016llx", static_cast<unsigned long long>(hash));
+
+	std::filesystem::path path = projectPath / "cache" / "meshes";
+	path /= relativeSourcePath.stem().string() + "_" + hashStr + ".grmesh";
+	return path;
+}
+
+
+void MeshCacheWriter::addSection(MeshCacheSectionType type, uint32_t elementSize,
+	uint64_t count, const void* data)
+{
+	assert(count == 0 || data != nullptr);
+	PendingSection s;
+	s.section.type = type;
+	s.section.elementSize = elementSize;
+	s.section.offset = 0;
+	s.section.count = count;
+	s.data = data;
+	mSections.push_back(s);
+}
+
+void MeshCacheWriter::write(const std::filesystem::path& path, MeshCacheHeader header) const
+{
+	header.magic = MeshCacheHeader::MAGIC;
+	header.version = MeshCacheHeader::VERSION;
+	header.numSections = static_cast<uint32_t>(mSections.size());
+
+	std::vector<MeshCacheSection> table;
+	table.reserve(mSections.size());
+	uint64_t offset = sizeof(MeshCacheHeader) + sizeof(MeshCacheSection) * mSections.size();
+	for (const PendingSection& s : mSections) {
+		offset = alignUp(offset, SECTION_ALIGNMENT);
+		table.push_back(s.section);
+		table.back().offset = offset;
+		offset += s.section.count * s.section.elementSize;
+	}
+
+	std::error_code ec;
+	std::filesystem::create_directories(path.parent_path(), ec);
+
+	std::filesystem::path tmpPath = path;
+	tmpPath += ".tmp";
+	{
+		std::ofstream stream(tmpPath, std::ios::binary | std::ios::trunc);
+		if (!stream) {
+			throw std::runtime_error("Error: Can't write mesh cache " + tmpPath.string());
+		}
+
+		stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		stream.write(reinterpret_cast<const char*>(table.data()), sizeof(MeshCacheSection) * table.size());
+
+		const char padding[SECTION_ALIGNMENT] = {};
+		for (size_t i = 0; i < mSections.size(); ++i) {
+			const uint64_t pos = static_cast<uint64_t>(stream.tellp());
+			stream.write(padding, static_cast<std::streamsize>(table[i].offset - pos));
+			stream.write(reinterpret_cast<const char*>(mSections[i].data),
+				static_cast<std::streamsize>(table[i].count * table[i].elementSize));
+		}
+
+		if (!stream) {
+			throw std::runtime_error("Error: Can't write mesh cache " + tmpPath.string());
+		}
+	}
+
+	std::filesystem::rename(tmpPath, path, ec);
+	if (ec) {
+		std::filesystem::remove(tmpPath, ec);
+		throw std::runtime_error("Error: Can't write mesh cache " + path.string());
+	}
+}
+
+
+bool MeshCacheReader::open(const std::filesystem::path& cachePath,
+	const std::filesystem::path& sourcePath)
+{
+	if (!mFile.open(cachePath.string().c_str())) {
+		return false;
+	}
+
+	if (!this->validate()) {
+		mFile.close();
+		return false;
+	}
+
+	// a missing source is not an error, the cache can be used alone
+	MeshCacheHeader source;
+	if (getSourceInfo(sourcePath, &source) && !matchesSource(cachePath, sourcePath, source)) {
+		mFile.close();
+		return false;
+	}
+
+	return true;
+}
+
+bool MeshCacheReader::matchesSource(const std::filesystem::path& cachePath,
+	const std::filesystem::path& sourcePath, const MeshCacheHeader& source) const
+{
+	const MeshCacheHeader& header = getHeader();
+	if (header.sourceSize != source.sourceSize) {
+		return false;
+	}
+
+	// The write time is enough, unless it changed with the same size, as when the file
+	// is copied or checked out again, or the source was written so close to the cache
+	// that an edit after it could keep the same time. Then the content decides
+	const int64_t resolution = std::chrono::duration_cast<std::filesystem::file_time_type::duration>(
+		WRITE_TIME_RESOLUTION).count();
+	std::error_code ec;
+	const std::filesystem::file_time_type cacheWriteTime = std::filesystem::last_write_time(cachePath, ec);
+	const bool ambiguous = ec ||
+		static_cast<int64_t>(cacheWriteTime.time_since_epoch().count()) - header.sourceWriteTime < resolution;
+	if (header.sourceWriteTime == source.sourceWriteTime && !ambiguous) {
+		return true;
+	}
+
+	try {
+		return hashFile(sourcePath) == header.sourceHash;
+	}
+	catch (const std::exception&) {
+		return false;
+	}
+}
+
+const MeshCacheHeader& MeshCacheReader::getHeader() const
+{
+	assert(mFile.isOpen());
+	return *reinterpret_cast<const MeshCacheHeader*>(mFile.data());
+}
+
+const MeshCacheSection* MeshCacheReader::findSection(MeshCacheSectionType type) const
+{
+	const MeshCacheSection* table = reinterpret_cast<const MeshCacheSection*>(
+		mFile.data() + sizeof(MeshCacheHeader));
+	for (uint32_t i = 0; i < getHeader().numSections; ++i) {
+		if (table[i].type == type) {
+			return table + i;
+		}
+	}
+	return nullptr;
+}
+
+bool MeshCacheReader::validate() const
+{
+	if (mFile.size() < sizeof(MeshCacheHeader)) {
+		return false;
+	}
+
+	const MeshCacheHeader& header = getHeader();
+	if (header.magic != MeshCacheHeader::MAGIC || header.version != MeshCacheHeader::VERSION) {
+		return false;
+	}
+
+	const uint64_t tableEnd = sizeof(MeshCacheHeader) +
+		static_cast<uint64_t>(header.numSections) * sizeof(MeshCacheSection);
+	if (tableEnd > mFile.size()) {
+		return false;
+	}
+
+	const MeshCacheSection* table = reinterpret_cast<const MeshCacheSection*>(
+		mFile.data() + sizeof(MeshCacheHeader));
+	for (uint32_t i = 0; i < header.numSections; ++i) {
+		const uint64_t end = table[i].offset + table[i].count * table[i].elementSize;
+		if (table[i].offset < tableEnd || end > mFile.size()) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+} // namespace mesh
+} // namespace gr
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <filesystem>
+#include <glm/glm.hpp>
+
+#include "../../utils/MappedFile.h"
+
+namespace gr
+{
+namespace mesh
+{
+
+// Binary container of a processed mesh, that is memory mapped on load
+// and uploaded to the GPU without any parsing. The file contains a
+// MeshCacheHeader, followed by the table of MeshCacheSection, followed by
+// the data of each section aligned to SECTION_ALIGNMENT.
+
+enum class MeshCacheSectionType : uint32_t {
+	eVertices = 0,
+	eIndices = 1,
+	// VertexCacheStatistics of the imported and of the optimized indices
+	eVertexCacheStatistics = 2,
+	// LodRange of each level of detail, in the index section
+	eLods = 3,
+	// Meshlet of all the LODs, sorted by first index
+	eMeshlets = 4,
+	// Vertices in the vertex format of the header, unless it is float
+	eEncodedVertices = 5,
+	// 16 bit indices relative to the vertex offset of their submesh, if they are used
+	eIndices16 = 6,
+	// Submesh of every LOD, for the indices that are uploaded
+	eSubmeshes = 7,
+	// uint32_t first submesh of each LOD, and the number of submeshes at the end
+	eLodFirstSubmeshes = 8
+};
+
+struct MeshCacheSection {
+	MeshCacheSectionType type;
+	uint32_t elementSize;
+	uint64_t offset; // from the start of the file
+	uint64_t count;
+};
+
+struct MeshCacheHeader {
+	static constexpr uint32_t MAGIC = 0x434d5247; // "GRMC"
+	static constexpr uint32_t VERSION = 6;
+
+	uint32_t magic = MAGIC;
+	uint32_t version = VERSION;
+	uint32_t numSections = 0;
+	// VertexFormat of the buffers that are uploaded as they are
+	uint32_t vertexFormat = 0;
+
+	glm::vec3 bboxMin = glm::vec3(0.0f);
+	glm::vec3 bboxMax = glm::vec3(0.0f);
+
+	// Source file, to know if the cache is outdated. The hash of its content
+	// decides when the size and write time are ambiguous
+	uint64_t sourceSize = 0;
+	int64_t sourceWriteTime = 0;
+	uint64_t sourceHash = 0;
+};
+
+static_assert(sizeof(MeshCacheHeader) == 64, "MeshCacheHeader must not have padding");
+static_assert(sizeof(MeshCacheSection) == 24, "MeshCacheSection must not have padding");
+
+constexpr uint64_t SECTION_ALIGNMENT = 64;
+
+// Fills the source members of the header. Returns false if the file does not exist
+bool getSourceInfo(const std::filesystem::path& sourcePath, MeshCacheHeader* header);
+
+// FNV-1a hash of the content of the file
+uint64_t hashFile(const std::filesystem::path& path);
+// FNV-1a hash of the bytes
+uint64_t hashBytes(const void* data, size_t size);
+
+// Cache file for a source path relative to the project
+std::filesystem::path getMeshCachePath(
+	const std::filesystem::path& projectPath,
+	const std::filesystem::path& relativeSourcePath);
+
+
+class MeshCacheWriter
+{
+public:
+
+	// The data is not copied, it must be alive until write
+	void addSection(MeshCacheSectionType type, uint32_t elementSize,
+		uint64_t count, const void* data);
+
+	// Writes to a temporary file that is renamed once completed.
+	// Throws std::runtime_error if the file can't be written
+	void write(const std::filesystem::path& path, MeshCacheHeader header) const;
+
+private:
+
+	struct PendingSection {
+		MeshCacheSection section;
+		const void* data;
+	};
+
+	std::vector<PendingSection> mSections;
+};
+
+
+class MeshCacheReader
+{
+public:
+
+	// Maps the cache. Returns false if it does not exist, is from another
+	// version, or the source file has changed since it was written.
+	// The source is hashed only if its size and write time are not conclusive
+	bool open(const std::filesystem::path& cachePath,
+		const std::filesystem::path& sourcePath);
+
+	void close() { mFile.close(); }
+
+	const MeshCacheHeader& getHeader() const;
+
+	// Returns nullptr if the section is not in the cache
+	const MeshCacheSection* findSection(MeshCacheSectionType type) const;
+
+	const uint8_t* getSectionData(const MeshCacheSection& section) const {
+		return mFile.data() + section.offset;
+	}
+
+	uint64_t getSectionBytes(const MeshCacheSection& section) const {
+		return section.count * section.elementSize;
+	}
+
+private:
+
+	tools::MappedFile mFile;
+
+	bool validate() const;
+	bool matchesSource(const std::filesystem::path& cachePath,
+		const std::filesystem::path& sourcePath, const MeshCacheHeader& source) const;
+};
+
+} // namespace mesh
+} // namespace gr
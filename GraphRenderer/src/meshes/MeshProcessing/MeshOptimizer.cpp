@@ -0,0 +1,574 @@
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <glm/glm.hpp>
+
+namespace gr
+{
+namespace mesh
+{
+
+namespace
+{
+
+constexpr uint32_t INVALID_INDEX = ~0u;
+
+// Minimum number of triangles of a cluster split in optimizeOverdraw
+constexpr uint32_t MIN_SOFT_CLUSTER_TRIANGLES = 32;
+
+// FIFO cache simulation, a vertex is in the cache if it was
+// transformed less than cacheSize misses ago
+class FifoCache
+{
+public:
+	FifoCache(uint32_t numVertices, uint32_t cacheSize) :
+		mTimestamps(numVertices, 0), mCacheSize(cacheSize), mMisses(cacheSize + 1) {}
+
+	// Returns true on miss
+	bool access(uint32_t v) {
+		if (mMisses - mTimestamps[v] > mCacheSize) {
+			mTimestamps[v] = mMisses++;
+			return true;
+		}
+		return false;
+	}
+
+	// Evicts all the vertices
+	void flush() {
+		mMisses += mCacheSize + 1;
+	}
+
+private:
+	std::vector<uint64_t> mTimestamps;
+	uint64_t mCacheSize;
+	uint64_t mMisses;
+};
+
+glm::vec3 loadPosition(const void* positions, size_t stride, uint32_t v)
+{
+	glm::vec3 p;
+	std::memcpy(&p, reinterpret_cast<const uint8_t*>(positions) + v * stride, sizeof(glm::vec3));
+	return p;
+}
+
+// Interleaves the 10 lower bits with two zeros each, for Morton codes
+uint32_t spreadBits10(uint32_t v)
+{
+	v &= 0x3ff;
+	v = (v | (v << 16)) & 0x030000ff;
+	v = (v | (v << 8)) & 0x0300f00f;
+	v = (v | (v << 4)) & 0x030c30c3;
+	v = (v | (v << 2)) & 0x09249249;
+	return v;
+}
+
+// Stable counting sort of the triangles by their region
+void sortByRegion(uint32_t* indices, size_t numIndices,
+	const std::vector<uint32_t>& regions, uint32_t numRegions,
+	std::vector<uint32_t>* outTriangleRegions)
+{
+	const uint32_t numTriangles = static_cast<uint32_t>(numIndices / 3);
+	std::vector<uint32_t> regionStarts(numRegions + 1, 0);
+	for (uint32_t t = 0; t < numTriangles; ++t) {
+		regionStarts[regions[t] + 1] += 1;
+	}
+	for (uint32_t r = 0; r < numRegions; ++r) {
+		regionStarts[r + 1] += regionStarts[r];
+	}
+
+	std::vector<uint32_t> output(numIndices);
+	outTriangleRegions->resize(numTriangles);
+	for (uint32_t t = 0; t < numTriangles; ++t) {
+		const uint32_t dst = regionStarts[regions[t]]++;
+		std::copy(indices + 3 * t, indices + 3 * t + 3, output.begin() + 3 * dst);
+		(*outTriangleRegions)[dst] = regions[t];
+	}
+	std::copy(output.begin(), output.end(), indices);
+}
+
+} // namespace
+
+
+VertexCacheStatistics analyzeVertexCache(const uint32_t* indices, size_t numIndices,
+	uint32_t numVertices, uint32_t cacheSize)
+{
+	VertexCacheStatistics stats;
+	if (numIndices < 3 || numVertices == 0) {
+		return stats;
+	}
+
+	FifoCache cache(numVertices, cacheSize);
+	uint64_t misses = 0;
+	for (size_t i = 0; i < numIndices; ++i) {
+		assert(indices[i] < numVertices);
+		misses += cache.access(indices[i]) ? 1 : 0;
+	}
+
+	stats.acmr = static_cast<float>(misses) / static_cast<float>(numIndices / 3);
+	stats.atvr = static_cast<float>(misses) / static_cast<float>(numVertices);
+	return stats;
+}
+
+void optimizeVertexCache(uint32_t* indices, size_t numIndices, uint32_t numVertices,
+	uint32_t cacheSize, std::vector<uint32_t>* outClusters)
+{
+	assert(numIndices % 3 == 0);
+	const uint32_t numTriangles = static_cast<uint32_t>(numIndices / 3);
+	if (outClusters) {
+		outClusters->clear();
+	}
+	if (numTriangles == 0) {
+		return;
+	}
+
+	// triangles adjacent to each vertex, and the number of them not emitted yet
+	std::vector<uint32_t> liveTriangles(numVertices, 0);
+	for (size_t i = 0; i < numIndices; ++i) {
+		liveTriangles[indices[i]] += 1;
+	}
+	std::vector<uint32_t> adjacencyOffsets(static_cast<size_t>(numVertices) + 1, 0);
+	for (uint32_t v = 0; v < numVertices; ++v) {
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+	}
+	std::vector<uint32_t> adjacency(numIndices);
+	{
+		std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (uint32_t t = 0; t < numTriangles; ++t) {
+			for (uint32_t k = 0; k < 3; ++k) {
+				adjacency[fill[indices[3 * t + k]]++] = t;
+			}
+		}
+	}
+
+	std::vector<uint32_t> output;
+	output.reserve(numIndices);
+	std::vector<uint8_t> emitted(numTriangles, 0);
+	std::vector<uint32_t> cacheTimestamps(numVertices, 0);
+	std::vector<uint32_t> deadEnd;
+	std::vector<uint32_t> candidates;
+	uint32_t timestamp = cacheSize + 1;
+	uint32_t cursor = 0;
+
+	// when there are no candidates, continue from the last vertices used,
+	// or else from the next vertex in the input with live triangles
+	auto skipDeadEnd = [&]() -> uint32_t {
+		while (!deadEnd.empty()) {
+			const uint32_t v = deadEnd.back();
+			deadEnd.pop_back();
+			if (liveTriangles[v] > 0) {
+				return v;
+			}
+		}
+		for (; cursor < numVertices; ++cursor) {
+			if (liveTriangles[cursor] > 0) {
+				return cursor;
+			}
+		}
+		return INVALID_INDEX;
+	};
+
+	uint32_t fanning = skipDeadEnd();
+	while (fanning != INVALID_INDEX) {
+		candidates.clear();
+		for (uint32_t a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; ++a) {
+			const uint32_t t = adjacency[a];
+			if (emitted[t]) {
+				continue;
+			}
+			for (uint32_t k = 0; k < 3; ++k) {
+				const uint32_t v = indices[3 * t + k];
+				output.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				liveTriangles[v] -= 1;
+				if (timestamp - cacheTimestamps[v] > cacheSize) {
+					cacheTimestamps[v] = timestamp++;
+				}
+			}
+			emitted[t] = 1;
+		}
+
+		// the best candidate is the one that will still be in the cache
+		// after fanning it, and that was the longest time in the cache
+		uint32_t next = INVALID_INDEX;
+		int64_t bestPriority = -1;
+		for (uint32_t v : candidates) {
+			if (liveTriangles[v] == 0) {
+				continue;
+			}
+			int64_t priority = 0;
+			const int64_t age = static_cast<int64_t>(timestamp) - cacheTimestamps[v];
+			if (age + 2 * static_cast<int64_t>(liveTriangles[v]) <= cacheSize) {
+				priority = age;
+			}
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				next = v;
+			}
+		}
+
+		if (next == INVALID_INDEX) {
+			next = skipDeadEnd();
+			// a jump is a hard boundary between clusters
+			if (outClusters && next != INVALID_INDEX) {
+				outClusters->push_back(static_cast<uint32_t>(output.size() / 3));
+			}
+		}
+		fanning = next;
+	}
+
+	assert(output.size() == numIndices);
+	std::copy(output.begin(), output.end(), indices);
+
+	if (outClusters && (outClusters->empty() || outClusters->front() != 0)) {
+		outClusters->insert(outClusters->begin(), 0);
+	}
+}
+
+void optimizeOverdraw(uint32_t* indices, size_t numIndices,
+	const std::vector<uint32_t>& clusters,
+	const void* positions, size_t positionStride, uint32_t numVertices,
+	float threshold, uint32_t cacheSize)
+{
+	assert(numIndices % 3 == 0);
+	const uint32_t numTriangles = static_cast<uint32_t>(numIndices / 3);
+	if (numTriangles == 0 || clusters.empty()) {
+		return;
+	}
+
+	// split the clusters where their miss ratio, starting with an empty cache,
+	// is already good enough, as they will be drawn in another order
+	const float targetAcmr = threshold *
+		analyzeVertexCache(indices, numIndices, numVertices, cacheSize).acmr;
+	std::vector<uint32_t> splitClusters;
+	{
+		FifoCache cache(numVertices, cacheSize);
+		for (size_t c = 0; c < clusters.size(); ++c) {
+			const uint32_t begin = clusters[c];
+			const uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : numTriangles;
+			splitClusters.push_back(begin);
+			cache.flush();
+
+			uint32_t start = begin;
+			uint32_t misses = 0;
+			for (uint32_t t = begin; t < end; ++t) {
+				for (uint32_t k = 0; k < 3; ++k) {
+					misses += cache.access(indices[3 * t + k]) ? 1 : 0;
+				}
+				const uint32_t size = t + 1 - start;
+				if (t + 1 < end && size >= MIN_SOFT_CLUSTER_TRIANGLES &&
+					static_cast<float>(misses) <= targetAcmr * size) {
+					splitClusters.push_back(t + 1);
+					cache.flush();
+					start = t + 1;
+					misses = 0;
+				}
+			}
+		}
+	}
+
+	// centroid of the mesh
+	glm::dvec3 meshCentroid(0.0);
+	for (size_t i = 0; i < numIndices; ++i) {
+		meshCentroid += glm::dvec3(loadPosition(positions, positionStride, indices[i]));
+	}
+	meshCentroid /= static_cast<double>(numIndices);
+
+	// sort by how much each cluster faces outwards
+	struct ClusterSort {
+		float score;
+		uint32_t cluster;
+	};
+	std::vector<ClusterSort> sorted(splitClusters.size());
+	for (size_t c = 0; c < splitClusters.size(); ++c) {
+		const uint32_t begin = splitClusters[c];
+		const uint32_t end = c + 1 < splitClusters.size() ? splitClusters[c + 1] : numTriangles;
+
+		glm::vec3 centroid(0.0f);
+		glm::vec3 normal(0.0f);
+		for (uint32_t t = begin; t < end; ++t) {
+			const glm::vec3 p0 = loadPosition(positions, positionStride, indices[3 * t + 0]);
+			const glm::vec3 p1 = loadPosition(positions, positionStride, indices[3 * t + 1]);
+			const glm::vec3 p2 = loadPosition(positions, positionStride, indices[3 * t + 2]);
+			centroid += p0 + p1 + p2;
+			// area weighted
+			normal += glm::cross(p1 - p0, p2 - p0);
+		}
+		centroid /= static_cast<float>(3 * (end - begin));
+		const float length = glm::length(normal);
+		if (length > 0.0f) {
+			normal /= length;
+		}
+
+		sorted[c].score = glm::dot(centroid - glm::vec3(meshCentroid), normal);
+		sorted[c].cluster = static_cast<uint32_t>(c);
+	}
+	std::stable_sort(sorted.begin(), sorted.end(), [](const ClusterSort& a, const ClusterSort& b) {
+		return a.score > b.score;
+	});
+
+	std::vector<uint32_t> output;
+	output.reserve(numIndices);
+	for (const ClusterSort& s : sorted) {
+		const uint32_t begin = splitClusters[s.cluster];
+		const uint32_t end = s.cluster + 1 < splitClusters.size() ? splitClusters[s.cluster + 1] : numTriangles;
+		output.insert(output.end(), indices + 3 * begin, indices + 3 * end);
+	}
+	std::copy(output.begin(), output.end(), indices);
+}
+
+bool splitIndices16(const uint32_t* indices, size_t numIndices, uint32_t maxSubmeshes,
+	std::vector<Submesh>* outSubmeshes, std::vector<uint16_t>* outIndices)
+{
+	assert(numIndices % 3 == 0);
+	constexpr uint32_t MAX_RANGE = std::numeric_limits<uint16_t>::max();
+
+	std::vector<Submesh> submeshes;
+	size_t begin = 0;
+	while (begin < numIndices) {
+		uint32_t minIdx = indices[begin];
+		uint32_t maxIdx = indices[begin];
+		size_t end = begin;
+		// whole triangles only
+		while (end < numIndices) {
+			const uint32_t triMin = std::min({ minIdx, indices[end], indices[end + 1], indices[end + 2] });
+			const uint32_t triMax = std::max({ maxIdx, indices[end], indices[end + 1], indices[end + 2] });
+			if (triMax - triMin > MAX_RANGE) {
+				break;
+			}
+			minIdx = triMin;
+			maxIdx = triMax;
+			end += 3;
+		}
+		// a triangle whose vertices are too far apart
+		if (end == begin) {
+			return false;
+		}
+
+		if (submeshes.size() == maxSubmeshes || minIdx > static_cast<uint32_t>(std::numeric_limits<int32_t>::max())) {
+			return false;
+		}
+		submeshes.push_back({ static_cast<uint32_t>(begin),
+			static_cast<uint32_t>(end - begin), static_cast<int32_t>(minIdx) });
+		begin = end;
+	}
+
+	outIndices->resize(numIndices);
+	for (const Submesh& s : submeshes) {
+		for (uint32_t i = s.firstIndex; i < s.firstIndex + s.numIndices; ++i) {
+			(*outIndices)[i] = static_cast<uint16_t>(indices[i] - static_cast<uint32_t>(s.vertexOffset));
+		}
+	}
+	outSubmeshes->swap(submeshes);
+	return true;
+}
+
+bool splitIndices16(const uint32_t* indices, const LodRange* lods, size_t numLods,
+	uint32_t maxSubmeshesPerLod, std::vector<Submesh>* outSubmeshes,
+	std::vector<uint32_t>* outLodFirstSubmesh, std::vector<uint16_t>* outIndices)
+{
+	std::vector<Submesh> submeshes;
+	std::vector<uint32_t> lodFirstSubmesh;
+	std::vector<uint16_t> indices16;
+
+	std::vector<Submesh> lodSubmeshes;
+	std::vector<uint16_t> lodIndices16;
+	for (size_t l = 0; l < numLods; ++l) {
+		const LodRange& lod = lods[l];
+		assert(lod.firstIndex == indices16.size());
+		if (!splitIndices16(indices + lod.firstIndex, lod.numIndices, maxSubmeshesPerLod,
+			&lodSubmeshes, &lodIndices16)) {
+			return false;
+		}
+		lodFirstSubmesh.push_back(static_cast<uint32_t>(submeshes.size()));
+		for (Submesh submesh : lodSubmeshes) {
+			submesh.firstIndex += lod.firstIndex;
+			submeshes.push_back(submesh);
+		}
+		indices16.insert(indices16.end(), lodIndices16.begin(), lodIndices16.end());
+	}
+	lodFirstSubmesh.push_back(static_cast<uint32_t>(submeshes.size()));
+
+	outSubmeshes->swap(submeshes);
+	outLodFirstSubmesh->swap(lodFirstSubmesh);
+	outIndices->swap(indices16);
+	return true;
+}
+
+uint32_t partitionTriangles(uint32_t* indices, size_t numIndices,
+	const void* positions, size_t positionStride, uint32_t numVertices,
+	uint32_t maxVertices, std::vector<uint32_t>* outTriangleRegions)
+{
+	assert(numIndices % 3 == 0 && maxVertices >= 3);
+	const uint32_t numTriangles = static_cast<uint32_t>(numIndices / 3);
+	outTriangleRegions->clear();
+	if (numTriangles == 0) {
+		return 0;
+	}
+
+	// the same scale in every axis, so that the regions are compact
+	glm::vec3 minPos(std::numeric_limits<float>::max());
+	glm::vec3 maxPos(std::numeric_limits<float>::lowest());
+	for (size_t i = 0; i < numIndices; ++i) {
+		const glm::vec3 p = loadPosition(positions, positionStride, indices[i]);
+		minPos = glm::min(minPos, p);
+		maxPos = glm::max(maxPos, p);
+	}
+	const glm::vec3 extent = maxPos - minPos;
+	const float maxExtent = std::max({ extent.x, extent.y, extent.z });
+	const float scale = maxExtent > 0.0f ? 1023.0f / maxExtent : 0.0f;
+
+	// Morton code in the high bits, triangle in the low bits
+	std::vector<uint64_t> sorted(numTriangles);
+	for (uint32_t t = 0; t < numTriangles; ++t) {
+		const glm::vec3 centroid = (loadPosition(positions, positionStride, indices[3 * t + 0]) +
+			loadPosition(positions, positionStride, indices[3 * t + 1]) +
+			loadPosition(positions, positionStride, indices[3 * t + 2])) / 3.0f;
+		const glm::uvec3 q = glm::uvec3((centroid - minPos) * scale + 0.5f);
+		const uint32_t code = spreadBits10(q.x) | (spreadBits10(q.y) << 1) | (spreadBits10(q.z) << 2);
+		sorted[t] = (static_cast<uint64_t>(code) << 32) | t;
+	}
+	std::sort(sorted.begin(), sorted.end());
+
+	// the curve is cut when the region runs out of vertices
+	std::vector<uint32_t> regions(numTriangles);
+	std::vector<uint32_t> regionStamps(numVertices, INVALID_INDEX);
+	uint32_t region = 0;
+	uint32_t regionVertices = 0;
+	for (const uint64_t s : sorted) {
+		const uint32_t t = static_cast<uint32_t>(s);
+		const uint32_t* tri = indices + 3 * t;
+		uint32_t newVertices = 0;
+		for (uint32_t k = 0; k < 3; ++k) {
+			const bool repeated = (k > 0 && tri[k] == tri[0]) || (k > 1 && tri[k] == tri[1]);
+			if (!repeated && regionStamps[tri[k]] != region) {
+				newVertices += 1;
+			}
+		}
+		if (regionVertices + newVertices > maxVertices) {
+			region += 1;
+			regionVertices = 0;
+		}
+		for (uint32_t k = 0; k < 3; ++k) {
+			if (regionStamps[tri[k]] != region) {
+				regionStamps[tri[k]] = region;
+				regionVertices += 1;
+			}
+		}
+		regions[t] = region;
+	}
+
+	const uint32_t numRegions = region + 1;
+	sortByRegion(indices, numIndices, regions, numRegions, outTriangleRegions);
+	return numRegions;
+}
+
+void getVertexRegions(const uint32_t* indices, size_t numIndices,
+	const uint32_t* triangleRegions, uint32_t numVertices,
+	std::vector<uint32_t>* outVertexRegions)
+{
+	outVertexRegions->assign(numVertices, INVALID_INDEX);
+	for (size_t i = 0; i < numIndices; ++i) {
+		uint32_t& region = (*outVertexRegions)[indices[i]];
+		if (region == INVALID_INDEX) {
+			region = triangleRegions[i / 3];
+		}
+	}
+}
+
+void sortTrianglesByRegion(uint32_t* indices, size_t numIndices,
+	const uint32_t* vertexRegions, uint32_t numRegions,
+	std::vector<uint32_t>* outTriangleRegions)
+{
+	assert(numIndices % 3 == 0);
+	const uint32_t numTriangles = static_cast<uint32_t>(numIndices / 3);
+	std::vector<uint32_t> regions(numTriangles);
+	for (uint32_t t = 0; t < numTriangles; ++t) {
+		const uint32_t r0 = vertexRegions[indices[3 * t + 0]];
+		const uint32_t r1 = vertexRegions[indices[3 * t + 1]];
+		const uint32_t r2 = vertexRegions[indices[3 * t + 2]];
+		assert(r0 < numRegions && r1 < numRegions && r2 < numRegions);
+		regions[t] = r1 == r2 ? r1 : r0;
+	}
+	sortByRegion(indices, numIndices, regions, numRegions, outTriangleRegions);
+}
+
+bool layoutRegionVertices(uint32_t* indices, size_t numIndices,
+	const uint32_t* triangleRegions, uint32_t numRegions, uint32_t numVertices,
+	std::vector<uint32_t>* outVertexSource)
+{
+	assert(numIndices % 3 == 0);
+	constexpr size_t MAX_BLOCK_VERTICES = static_cast<size_t>(std::numeric_limits<uint16_t>::max()) + 1;
+	const uint32_t numTriangles = static_cast<uint32_t>(numIndices / 3);
+
+	// the triangles of each region, in order, from every LOD
+	std::vector<uint32_t> regionStarts(numRegions + 1, 0);
+	for (uint32_t t = 0; t < numTriangles; ++t) {
+		assert(triangleRegions[t] < numRegions);
+		regionStarts[triangleRegions[t] + 1] += 1;
+	}
+	for (uint32_t r = 0; r < numRegions; ++r) {
+		regionStarts[r + 1] += regionStarts[r];
+	}
+	std::vector<uint32_t> regionTriangles(numTriangles);
+	{
+		std::vector<uint32_t> next(regionStarts.begin(), regionStarts.end() - 1);
+		for (uint32_t t = 0; t < numTriangles; ++t) {
+			regionTriangles[next[triangleRegions[t]]++] = t;
+		}
+	}
+
+	std::vector<uint32_t> source;
+	source.reserve(numVertices);
+	std::vector<uint32_t> newIndices(numIndices);
+	std::vector<uint32_t> blockStamps(numVertices, INVALID_INDEX);
+	std::vector<uint32_t> blockIndices(numVertices);
+	for (uint32_t r = 0; r < numRegions; ++r) {
+		const size_t blockStart = source.size();
+		for (uint32_t i = regionStarts[r]; i < regionStarts[r + 1]; ++i) {
+			const uint32_t t = regionTriangles[i];
+			for (uint32_t k = 0; k < 3; ++k) {
+				const uint32_t v = indices[3 * t + k];
+				if (blockStamps[v] != r) {
+					blockStamps[v] = r;
+					blockIndices[v] = static_cast<uint32_t>(source.size());
+					source.push_back(v);
+				}
+				newIndices[3 * t + k] = blockIndices[v];
+			}
+		}
+		if (source.size() - blockStart > MAX_BLOCK_VERTICES ||
+			source.size() > static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+			return false;
+		}
+	}
+
+	std::copy(newIndices.begin(), newIndices.end(), indices);
+	outVertexSource->swap(source);
+	return true;
+}
+
+uint32_t optimizeVertexFetchRemap(uint32_t* indices, size_t numIndices, uint32_t numVertices,
+	std::vector<uint32_t>* outRemap)
+{
+	assert(outRemap != nullptr);
+	outRemap->assign(numVertices, INVALID_INDEX);
+
+	uint32_t next = 0;
+	for (size_t i = 0; i < numIndices; ++i) {
+		uint32_t& newIndex = (*outRemap)[indices[i]];
+		if (newIndex == INVALID_INDEX) {
+			newIndex = next++;
+		}
+		indices[i] = newIndex;
+	}
+
+	return next;
+}
+
+} // namespace mesh
+} // namespace gr
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace gr
+{
+namespace mesh
+{
+
+struct LodRange;
+
+// Size of the FIFO post-transform cache assumed by the optimizations
+constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+
+struct VertexCacheStatistics {
+	// Average cache miss ratio: transformed vertices per triangle, 0.5 at best
+	float acmr = 0.0f;
+	// Average transform to vertex ratio: transformed vertices per vertex, 1 at best
+	float atvr = 0.0f;
+};
+
+// Simulates a FIFO post-transform cache of cacheSize vertices
+VertexCacheStatistics analyzeVertexCache(const uint32_t* indices, size_t numIndices,
+	uint32_t numVertices, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+// Reorders the triangles in place for the post-transform cache, with Tipsify
+// [Sander et al. 2007, Fast Triangle Reordering for Vertex Locality and Reduced Overdraw].
+// If outClusters is not null, it is filled with the first triangle of each
+// cluster of triangles, to be used by optimizeOverdraw.
+void optimizeVertexCache(uint32_t* indices, size_t numIndices, uint32_t numVertices,
+	uint32_t cacheSize = VERTEX_CACHE_SIZE, std::vector<uint32_t>* outClusters = nullptr);
+
+// Sorts the clusters of triangles so that the ones that face outwards of the mesh
+// are drawn first, and occlude the rest. The clusters are split further where
+// it keeps the cache miss ratio below threshold times the current one.
+// The positions are 3 floats, every positionStride bytes.
+void optimizeOverdraw(uint32_t* indices, size_t numIndices,
+	const std::vector<uint32_t>& clusters,
+	const void* positions, size_t positionStride, uint32_t numVertices,
+	float threshold = 1.05f, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+// Range of indices drawn with a vertex offset
+struct Submesh {
+	uint32_t firstIndex;
+	uint32_t numIndices;
+	int32_t vertexOffset;
+};
+
+// Splits the triangles in consecutive submeshes whose vertices are in a range
+// of 65536, and writes the indices relative to the vertex offset of its submesh.
+// Works best after optimizeVertexFetchRemap, or layoutRegionVertices for meshes
+// with more vertices. Returns false, without writing anything, if more than
+// maxSubmeshes would be needed.
+bool splitIndices16(const uint32_t* indices, size_t numIndices, uint32_t maxSubmeshes,
+	std::vector<Submesh>* outSubmeshes, std::vector<uint16_t>* outIndices);
+
+// Splits each LOD independently, with at most maxSubmeshesPerLod each. The submeshes
+// are relative to the start of the indices. outLodFirstSubmesh has the first submesh
+// of each LOD, and the number of submeshes at the end.
+bool splitIndices16(const uint32_t* indices, const LodRange* lods, size_t numLods,
+	uint32_t maxSubmeshesPerLod, std::vector<Submesh>* outSubmeshes,
+	std::vector<uint32_t>* outLodFirstSubmesh, std::vector<uint16_t>* outIndices);
+
+// Splits the triangles in regions of nearby triangles that use at most maxVertices
+// vertices, so that meshes with more than 65536 vertices can be drawn with 16 bit
+// indices. The triangles are cut along a Morton curve of their centroids, and
+// stably sorted by region, which keeps the order of the previous optimizations
+// inside each region. The positions are 3 floats, every positionStride bytes.
+// outTriangleRegions[t] is the region of the triangle t, after sorting.
+// Returns the number of regions.
+uint32_t partitionTriangles(uint32_t* indices, size_t numIndices,
+	const void* positions, size_t positionStride, uint32_t numVertices,
+	uint32_t maxVertices, std::vector<uint32_t>* outTriangleRegions);
+
+// outVertexRegions[v] is the region of the first triangle that uses the vertex v,
+// or ~0u if it is not used
+void getVertexRegions(const uint32_t* indices, size_t numIndices,
+	const uint32_t* triangleRegions, uint32_t numVertices,
+	std::vector<uint32_t>* outVertexRegions);
+
+// Stably sorts by region other triangles of the same vertices, i.e. a LOD.
+// A triangle goes to the region of two of its vertices, or else of its first one.
+void sortTrianglesByRegion(uint32_t* indices, size_t numIndices,
+	const uint32_t* vertexRegions, uint32_t numRegions,
+	std::vector<uint32_t>* outTriangleRegions);
+
+// Lays out the vertices in a block for each region, with the vertices used by all
+// the triangles of the region, in order of first use. The vertices used by several
+// regions, as the borders and the LODs that cross them, are duplicated in each block.
+// The indices are rewritten, and outVertexSource[newIndex] is the previous index.
+// Returns false, without writing anything, if a block has more than 65536 vertices.
+bool layoutRegionVertices(uint32_t* indices, size_t numIndices,
+	const uint32_t* triangleRegions, uint32_t numRegions, uint32_t numVertices,
+	std::vector<uint32_t>* outVertexSource);
+
+// Renumbers the vertices in the order of first use, for the locality of the vertex fetch.
+// Unused vertices are dropped. outRemap[oldIndex] is the new index, or ~0u if unused.
+// Returns the number of vertices used.
+uint32_t optimizeVertexFetchRemap(uint32_t* indices, size_t numIndices, uint32_t numVertices,
+	std::vector<uint32_t>* outRemap);
+
+} // namespace mesh
+} // namespace gr
@@ -0,0 +1,496 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <glm/glm.hpp>
+
+#include "../../utils/grjob.h"
+
+namespace gr
+{
+namespace mesh
+{
+
+namespace
+{
+
+// Vertices evaluated by each job of a pass
+constexpr uint32_t CANDIDATES_CHUNK_SIZE = 1 << 14;
+
+// A collapse is rejected if it turns a triangle more than ~90 degrees,
+// or makes it degenerate
+constexpr float MIN_NORMAL_COSINE = 1e-2f;
+
+constexpr float INVALID_COST = std::numeric_limits<float>::infinity();
+
+// Q(p) = p'Ap + 2b'p + c, the sum of the squared distances to a set of planes.
+// Each plane is weighted by the area of its triangle.
+struct Quadric {
+	double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+	double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+	double c = 0.0;
+	double weight = 0.0;
+
+	// Plane n'p + d = 0, with n normalized
+	void addPlane(const glm::dvec3& n, double d, double w) {
+		a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z;
+		a11 += w * n.y * n.y; a12 += w * n.y * n.z; a22 += w * n.z * n.z;
+		b0 += w * d * n.x; b1 += w * d * n.y; b2 += w * d * n.z;
+		c += w * d * d;
+		weight += w;
+	}
+
+	Quadric& operator+=(const Quadric& q) {
+		a00 += q.a00; a01 += q.a01; a02 += q.a02;
+		a11 += q.a11; a12 += q.a12; a22 += q.a22;
+		b0 += q.b0; b1 += q.b1; b2 += q.b2;
+		c += q.c;
+		weight += q.weight;
+		return *this;
+	}
+
+	// Weighted mean of the squared distances of p to the planes
+	double evaluate(const glm::vec3& p) const {
+		if (weight <= 0.0) {
+			return 0.0;
+		}
+		const double x = p.x, y = p.y, z = p.z;
+		const double r =
+			a00 * x * x + a11 * y * y + a22 * z * z +
+			2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+			2.0 * (b0 * x + b1 * y + b2 * z) + c;
+		return std::max(r, 0.0) / weight;
+	}
+};
+
+// Collapse of a vertex into one of its neighbours
+struct Collapse {
+	// canonical vertex that is kept
+	uint32_t target;
+	// the vertex that replaces the one collapsed in the index buffer
+	uint32_t targetWedge;
+	// the only vertex at the position of the collapsed one
+	uint32_t wedge;
+	float cost = INVALID_COST;
+};
+
+// The vertices are welded by position: all the vertices with the same position
+// share a canonical vertex, and its different attributes are wedges of it.
+// The topology and the quadrics are of the canonical vertices.
+struct SimplifyContext {
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> canonical;
+	// Border, non manifold, or with several wedges
+	std::vector<uint8_t> locked;
+	std::vector<Quadric> quadrics;
+
+	// Of the current pass
+	const uint32_t* indices = nullptr;
+	std::vector<uint32_t> canonicalIndices;
+	// triangles around each canonical vertex
+	std::vector<uint32_t> fanOffsets;
+	std::vector<uint32_t> fans;
+};
+
+glm::vec3 loadPosition(const void* positions, size_t stride, uint32_t v)
+{
+	glm::vec3 p;
+	std::memcpy(&p, reinterpret_cast<const uint8_t*>(positions) + v * stride, sizeof(glm::vec3));
+	return p;
+}
+
+void weldPositions(SimplifyContext* ctx, uint32_t numVertices)
+{
+	std::vector<uint32_t> order(numVertices);
+	std::iota(order.begin(), order.end(), 0u);
+	const std::vector<glm::vec3>& pos = ctx->positions;
+	std::sort(order.begin(), order.end(), [&pos](uint32_t a, uint32_t b) {
+		if (pos[a].x != pos[b].x) return pos[a].x < pos[b].x;
+		if (pos[a].y != pos[b].y) return pos[a].y < pos[b].y;
+		return pos[a].z < pos[b].z;
+	});
+
+	ctx->canonical.resize(numVertices);
+	for (uint32_t i = 0; i < numVertices; ++i) {
+		const uint32_t v = order[i];
+		const bool same = i > 0 && pos[order[i - 1]] == pos[v];
+		ctx->canonical[v] = same ? ctx->canonical[order[i - 1]] : v;
+	}
+}
+
+// Locks the canonical vertices with several wedges, and the ones
+// in edges that do not have exactly two triangles
+void lockVertices(SimplifyContext* ctx, const std::vector<uint32_t>& indices, uint32_t numVertices)
+{
+	ctx->locked.assign(numVertices, 0);
+
+	std::vector<uint32_t> wedgeOf(numVertices, ~0u);
+	for (uint32_t i : indices) {
+		const uint32_t c = ctx->canonical[i];
+		if (wedgeOf[c] == ~0u) {
+			wedgeOf[c] = i;
+		}
+		else if (wedgeOf[c] != i) {
+			ctx->locked[c] = 1;
+		}
+	}
+
+	std::vector<uint64_t> edges;
+	edges.reserve(indices.size());
+	for (size_t t = 0; t < indices.size(); t += 3) {
+		for (uint32_t k = 0; k < 3; ++k) {
+			const uint64_t a = ctx->canonical[indices[t + k]];
+			const uint64_t b = ctx->canonical[indices[t + (k + 1) % 3]];
+			edges.push_back(a < b ? (a << 32) | b : (b << 32) | a);
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+	for (size_t begin = 0; begin < edges.size();) {
+		size_t end = begin + 1;
+		while (end < edges.size() && edges[end] == edges[begin]) {
+			++end;
+		}
+		if (end - begin != 2) {
+			ctx->locked[static_cast<uint32_t>(edges[begin] >> 32)] = 1;
+			ctx->locked[static_cast<uint32_t>(edges[begin])] = 1;
+		}
+		begin = end;
+	}
+}
+
+void computeQuadrics(SimplifyContext* ctx, const std::vector<uint32_t>& indices, uint32_t numVertices)
+{
+	ctx->quadrics.assign(numVertices, Quadric());
+	for (size_t t = 0; t < indices.size(); t += 3) {
+		const uint32_t c[3] = {
+			ctx->canonical[indices[t]],
+			ctx->canonical[indices[t + 1]],
+			ctx->canonical[indices[t + 2]] };
+		const glm::dvec3 p0(ctx->positions[c[0]]);
+		const glm::dvec3 n = glm::cross(
+			glm::dvec3(ctx->positions[c[1]]) - p0,
+			glm::dvec3(ctx->positions[c[2]]) - p0);
+		const double length = glm::length(n);
+		if (length <= 0.0) {
+			continue;
+		}
+		const glm::dvec3 normal = n / length;
+		const double d = -glm::dot(normal, p0);
+		for (uint32_t k = 0; k < 3; ++k) {
+			ctx->quadrics[c[k]].addPlane(normal, d, 0.5 * length);
+		}
+	}
+}
+
+void buildFans(SimplifyContext* ctx, const std::vector<uint32_t>& indices, uint32_t numVertices)
+{
+	ctx->indices = indices.data();
+	ctx->canonicalIndices.resize(indices.size());
+	for (size_t i = 0; i < indices.size(); ++i) {
+		ctx->canonicalIndices[i] = ctx->canonical[indices[i]];
+	}
+
+	ctx->fanOffsets.assign(static_cast<size_t>(numVertices) + 1, 0);
+	for (uint32_t c : ctx->canonicalIndices) {
+		ctx->fanOffsets[c + 1] += 1;
+	}
+	for (uint32_t v = 0; v < numVertices; ++v) {
+		ctx->fanOffsets[v + 1] += ctx->fanOffsets[v];
+	}
+
+	std::vector<uint32_t> cursor(ctx->fanOffsets.begin(), ctx->fanOffsets.end() - 1);
+	ctx->fans.resize(indices.size());
+	for (size_t i = 0; i < indices.size(); ++i) {
+		ctx->fans[cursor[ctx->canonicalIndices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+}
+
+// Sorted canonical neighbours of v
+void gatherNeighbours(const SimplifyContext& ctx, uint32_t v, std::vector<uint32_t>* out)
+{
+	out->clear();
+	for (uint32_t f = ctx.fanOffsets[v]; f < ctx.fanOffsets[v + 1]; ++f) {
+		const uint32_t* tri = &ctx.canonicalIndices[3 * static_cast<size_t>(ctx.fans[f])];
+		for (uint32_t k = 0; k < 3; ++k) {
+			if (tri[k] != v) {
+				out->push_back(tri[k]);
+			}
+		}
+	}
+	std::sort(out->begin(), out->end());
+	out->erase(std::unique(out->begin(), out->end()), out->end());
+}
+
+struct CollapseScratch {
+	std::vector<uint32_t> neighboursU;
+	std::vector<uint32_t> neighboursV;
+	std::vector<std::pair<float, uint32_t>> candidates;
+};
+
+// Returns false if the collapse of u into v changes the topology, flips a
+// triangle or needs a wedge of v that does not exist
+bool validateCollapse(const SimplifyContext& ctx, uint32_t u, uint32_t v,
+	CollapseScratch* scratch, uint32_t* outTargetWedge)
+{
+	uint32_t targetWedge = ~0u;
+	uint32_t sharedTriangles = 0;
+	const glm::vec3& pv = ctx.positions[v];
+
+	for (uint32_t f = ctx.fanOffsets[u]; f < ctx.fanOffsets[u + 1]; ++f) {
+		const size_t t = 3 * static_cast<size_t>(ctx.fans[f]);
+		const uint32_t* tri = &ctx.canonicalIndices[t];
+
+		const uint32_t kv = tri[0] == v ? 0 : (tri[1] == v ? 1 : (tri[2] == v ? 2 : 3));
+		if (kv != 3) {
+			// the triangles removed with the edge decide the wedge of v
+			const uint32_t wedge = ctx.indices[t + kv];
+			if (targetWedge != ~0u && targetWedge != wedge) {
+				return false;
+			}
+			targetWedge = wedge;
+			sharedTriangles += 1;
+			continue;
+		}
+
+		glm::vec3 p[3] = { ctx.positions[tri[0]], ctx.positions[tri[1]], ctx.positions[tri[2]] };
+		const glm::vec3 n0 = glm::cross(p[1] - p[0], p[2] - p[0]);
+		for (uint32_t k = 0; k < 3; ++k) {
+			if (tri[k] == u) {
+				p[k] = pv;
+			}
+		}
+		const glm::vec3 n1 = glm::cross(p[1] - p[0], p[2] - p[0]);
+		if (glm::dot(n0, n1) <= MIN_NORMAL_COSINE * glm::length(n0) * glm::length(n1)) {
+			return false;
+		}
+	}
+
+	if (sharedTriangles != 2) {
+		return false;
+	}
+
+	// Link condition: u and v only share the two vertices opposite to the edge
+	gatherNeighbours(ctx, v, &scratch->neighboursV);
+	uint32_t common = 0;
+	auto itV = scratch->neighboursV.begin();
+	for (uint32_t w : scratch->neighboursU) {
+		itV = std::lower_bound(itV, scratch->neighboursV.end(), w);
+		if (itV != scratch->neighboursV.end() && *itV == w) {
+			common += 1;
+		}
+	}
+	if (common != 2) {
+		return false;
+	}
+
+	*outTargetWedge = targetWedge;
+	return true;
+}
+
+// Cheapest valid collapse of u, with a cost below maxCost
+Collapse findCollapse(const SimplifyContext& ctx, uint32_t u, float maxCost, CollapseScratch* scratch)
+{
+	Collapse collapse;
+	if (ctx.locked[u] || ctx.fanOffsets[u] == ctx.fanOffsets[u + 1]) {
+		return collapse;
+	}
+
+	const size_t firstCorner = 3 * static_cast<size_t>(ctx.fans[ctx.fanOffsets[u]]);
+	for (uint32_t k = 0; k < 3; ++k) {
+		if (ctx.canonicalIndices[firstCorner + k] == u) {
+			collapse.wedge = ctx.indices[firstCorner + k];
+		}
+	}
+
+	gatherNeighbours(ctx, u, &scratch->neighboursU);
+	scratch->candidates.clear();
+	for (uint32_t v : scratch->neighboursU) {
+		Quadric q = ctx.quadrics[u];
+		q += ctx.quadrics[v];
+		const float cost = static_cast<float>(q.evaluate(ctx.positions[v]));
+		if (cost <= maxCost) {
+			scratch->candidates.push_back({ cost, v });
+		}
+	}
+	std::sort(scratch->candidates.begin(), scratch->candidates.end());
+
+	for (const std::pair<float, uint32_t>& candidate : scratch->candidates) {
+		uint32_t targetWedge;
+		if (validateCollapse(ctx, u, candidate.second, scratch, &targetWedge)) {
+			collapse.target = candidate.second;
+			collapse.targetWedge = targetWedge;
+			collapse.cost = candidate.first;
+			break;
+		}
+	}
+
+	return collapse;
+}
+
+void findCollapses(const SimplifyContext& ctx, uint32_t numVertices, float maxCost,
+	std::vector<Collapse>* outCollapses)
+{
+	outCollapses->assign(numVertices, Collapse());
+	Collapse* collapses = outCollapses->data();
+	const SimplifyContext* pCtx = &ctx;
+	auto findRange = [pCtx, collapses, maxCost](uint32_t begin, uint32_t end) {
+		CollapseScratch scratch;
+		for (uint32_t u = begin; u < end; ++u) {
+			collapses[u] = findCollapse(*pCtx, u, maxCost, &scratch);
+		}
+	};
+
+	if (numVertices <= CANDIDATES_CHUNK_SIZE) {
+		findRange(0, numVertices);
+		return;
+	}
+
+	std::vector<grjob::Job> jobs;
+	for (uint32_t begin = 0; begin < numVertices; begin += CANDIDATES_CHUNK_SIZE) {
+		const uint32_t end = std::min(numVertices, begin + CANDIDATES_CHUNK_SIZE);
+		jobs.push_back(grjob::Job([findRange, begin, end]() { findRange(begin, end); }));
+	}
+	grjob::Counter* c = nullptr;
+	grjob::runJobBatch(grjob::Priority::eLow, jobs.data(), static_cast<uint32_t>(jobs.size()), &c);
+	grjob::waitForCounterAndFree(c, 0);
+}
+
+} // namespace
+
+
+float simplify(const uint32_t* indices, size_t numIndices,
+	const void* positions, size_t positionStride, uint32_t numVertices,
+	size_t targetIndices, float maxError,
+	std::vector<uint32_t>* outIndices,
+	const std::atomic<bool>* cancelled)
+{
+	assert(numIndices % 3 == 0);
+	assert(outIndices != nullptr);
+
+	SimplifyContext ctx;
+
+	// Normalized to the diagonal of the bounding box, so that the errors are relative
+	{
+		glm::vec3 min(std::numeric_limits<float>::max());
+		glm::vec3 max(-std::numeric_limits<float>::max());
+		for (size_t i = 0; i < numIndices; ++i) {
+			assert(indices[i] < numVertices);
+			const glm::vec3 p = loadPosition(positions, positionStride, indices[i]);
+			min = glm::min(min, p);
+			max = glm::max(max, p);
+		}
+		const float diagonal = numIndices > 0 ? glm::length(max - min) : 0.0f;
+		const float invDiagonal = diagonal > 0.0f ? 1.0f / diagonal : 0.0f;
+
+		ctx.positions.resize(numVertices);
+		for (uint32_t v = 0; v < numVertices; ++v) {
+			ctx.positions[v] = (loadPosition(positions, positionStride, v) - min) * invDiagonal;
+		}
+	}
+
+	weldPositions(&ctx, numVertices);
+
+	std::vector<uint32_t>& current = *outIndices;
+	current.clear();
+	current.reserve(numIndices);
+	for (size_t t = 0; t < numIndices; t += 3) {
+		const uint32_t c0 = ctx.canonical[indices[t]];
+		const uint32_t c1 = ctx.canonical[indices[t + 1]];
+		const uint32_t c2 = ctx.canonical[indices[t + 2]];
+		if (c0 != c1 && c1 != c2 && c2 != c0) {
+			current.insert(current.end(), indices + t, indices + t + 3);
+		}
+	}
+
+	lockVertices(&ctx, current, numVertices);
+	computeQuadrics(&ctx, current, numVertices);
+
+	const float maxCost = maxError * maxError;
+	float error = 0.0f;
+
+	std::vector<Collapse> collapses;
+	std::vector<uint32_t> order;
+	std::vector<uint32_t> wedgeRemap(numVertices);
+	std::iota(wedgeRemap.begin(), wedgeRemap.end(), 0u);
+	std::vector<uint32_t> touchedPass(numVertices, 0);
+
+	// Each pass collapses the cheapest edges whose neighbourhoods do not overlap,
+	// so that the costs and the validations of the pass stay valid
+	for (uint32_t pass = 1; current.size() > targetIndices; ++pass) {
+		if (cancelled != nullptr && cancelled->load(std::memory_order_relaxed)) {
+			break;
+		}
+		buildFans(&ctx, current, numVertices);
+		findCollapses(ctx, numVertices, maxCost, &collapses);
+
+		order.clear();
+		for (uint32_t u = 0; u < numVertices; ++u) {
+			if (collapses[u].cost != INVALID_COST) {
+				order.push_back(u);
+			}
+		}
+		std::sort(order.begin(), order.end(), [&collapses](uint32_t a, uint32_t b) {
+			return collapses[a].cost < collapses[b].cost;
+		});
+
+		const size_t trianglesToRemove = (current.size() - targetIndices + 2) / 3;
+		size_t trianglesRemoved = 0;
+		for (uint32_t u : order) {
+			const Collapse& collapse = collapses[u];
+
+			bool overlaps = touchedPass[u] == pass;
+			for (uint32_t f = ctx.fanOffsets[u]; f < ctx.fanOffsets[u + 1] && !overlaps; ++f) {
+				const uint32_t* tri = &ctx.canonicalIndices[3 * static_cast<size_t>(ctx.fans[f])];
+				overlaps = touchedPass[tri[0]] == pass || touchedPass[tri[1]] == pass ||
+					touchedPass[tri[2]] == pass;
+			}
+			if (overlaps) {
+				continue;
+			}
+			for (uint32_t f = ctx.fanOffsets[u]; f < ctx.fanOffsets[u + 1]; ++f) {
+				const uint32_t* tri = &ctx.canonicalIndices[3 * static_cast<size_t>(ctx.fans[f])];
+				touchedPass[tri[0]] = touchedPass[tri[1]] = touchedPass[tri[2]] = pass;
+			}
+
+			wedgeRemap[collapse.wedge] = collapse.targetWedge;
+			ctx.quadrics[collapse.target] += ctx.quadrics[u];
+			error = std::max(error, collapse.cost);
+
+			trianglesRemoved += 2;
+			if (trianglesRemoved >= trianglesToRemove) {
+				break;
+			}
+		}
+
+		if (trianglesRemoved == 0) {
+			break;
+		}
+
+		// Remap and remove the triangles of the collapsed edges
+		size_t numKept = 0;
+		for (size_t t = 0; t < current.size(); t += 3) {
+			const uint32_t i0 = wedgeRemap[current[t]];
+			const uint32_t i1 = wedgeRemap[current[t + 1]];
+			const uint32_t i2 = wedgeRemap[current[t + 2]];
+			const uint32_t c0 = ctx.canonical[i0];
+			const uint32_t c1 = ctx.canonical[i1];
+			const uint32_t c2 = ctx.canonical[i2];
+			if (c0 != c1 && c1 != c2 && c2 != c0) {
+				current[numKept] = i0;
+				current[numKept + 1] = i1;
+				current[numKept + 2] = i2;
+				numKept += 3;
+			}
+		}
+		current.resize(numKept);
+	}
+
+	return std::sqrt(error);
+}
+
+} // namespace mesh
+} // namespace gr
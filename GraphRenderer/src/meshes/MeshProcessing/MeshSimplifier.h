@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+namespace gr
+{
+namespace mesh
+{
+
+// Level of detail of a mesh, a range of its index buffer.
+// All the LODs share the vertices of the mesh.
+struct LodRange {
+	uint32_t firstIndex;
+	uint32_t numIndices;
+	// Geometric error relative to the diagonal of the bounding box of the mesh
+	float error;
+};
+
+// Simplifies the triangles with quadric error metrics
+// [Garland and Heckbert 1997, Surface Simplification Using Quadric Error Metrics].
+// The edges are collapsed into one of their vertices, so the result indexes
+// the same vertices, and no new vertex is created. Vertices in borders and
+// in attribute seams are not moved.
+// Stops when the number of indices is below targetIndices, or when the next
+// collapse exceeds maxError. Errors are relative to the diagonal of the
+// bounding box of the mesh. The positions are 3 floats, every positionStride bytes.
+// Returns the error of the simplified mesh.
+// If cancelled is set while simplifying, stops after the current pass
+float simplify(const uint32_t* indices, size_t numIndices,
+	const void* positions, size_t positionStride, uint32_t numVertices,
+	size_t targetIndices, float maxError,
+	std::vector<uint32_t>* outIndices,
+	const std::atomic<bool>* cancelled = nullptr);
+
+} // namespace mesh
+} // namespace gr
@@ -0,0 +1,186 @@
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace gr
+{
+namespace mesh
+{
+
+namespace
+{
+
+glm::vec3 loadPosition(const void* positions, size_t stride, uint32_t v)
+{
+	glm::vec3 p;
+	std::memcpy(&p, reinterpret_cast<const uint8_t*>(positions) + v * stride, sizeof(glm::vec3));
+	return p;
+}
+
+void computeBounds(const uint32_t* indices, const void* positions, size_t stride, Meshlet* meshlet)
+{
+	const uint32_t* tris = indices + meshlet->firstIndex;
+
+	glm::vec3 min(std::numeric_limits<float>::max());
+	glm::vec3 max(-std::numeric_limits<float>::max());
+	for (uint32_t i = 0; i < meshlet->numIndices; ++i) {
+		const glm::vec3 p = loadPosition(positions, stride, tris[i]);
+		min = glm::min(min, p);
+		max = glm::max(max, p);
+	}
+	meshlet->center = 0.5f * (min + max);
+	float radius2 = 0.0f;
+	for (uint32_t i = 0; i < meshlet->numIndices; ++i) {
+		const glm::vec3 d = loadPosition(positions, stride, tris[i]) - meshlet->center;
+		radius2 = std::max(radius2, glm::dot(d, d));
+	}
+	meshlet->radius = std::sqrt(radius2);
+
+	// The axis is the mean of the normals weighted by area,
+	// and the cone is opened up to the furthest normal
+	glm::vec3 normalSum(0.0f);
+	for (uint32_t t = 0; t < meshlet->numIndices; t += 3) {
+		const glm::vec3 p0 = loadPosition(positions, stride, tris[t]);
+		const glm::vec3 p1 = loadPosition(positions, stride, tris[t + 1]);
+		const glm::vec3 p2 = loadPosition(positions, stride, tris[t + 2]);
+		normalSum += glm::cross(p1 - p0, p2 - p0);
+	}
+
+	meshlet->coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+	meshlet->coneCutoff = 1.0f;
+	const float sumLength = glm::length(normalSum);
+	if (sumLength <= 0.0f) {
+		return;
+	}
+	const glm::vec3 axis = normalSum / sumLength;
+
+	float minCosine = 1.0f;
+	for (uint32_t t = 0; t < meshlet->numIndices; t += 3) {
+		const glm::vec3 p0 = loadPosition(positions, stride, tris[t]);
+		const glm::vec3 p1 = loadPosition(positions, stride, tris[t + 1]);
+		const glm::vec3 p2 = loadPosition(positions, stride, tris[t + 2]);
+		const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+		const float length = glm::length(n);
+		if (length > 0.0f) {
+			minCosine = std::min(minCosine, glm::dot(n, axis) / length);
+		}
+	}
+
+	meshlet->coneAxis = axis;
+	// Wider than a half space, never back facing as a whole
+	if (minCosine > 0.0f) {
+		meshlet->coneCutoff = std::sqrt(1.0f - minCosine * minCosine);
+	}
+}
+
+} // namespace
+
+
+void buildMeshlets(const uint32_t* indices, uint32_t firstIndex, uint32_t numIndices,
+	const void* positions, size_t positionStride, uint32_t numVertices,
+	std::vector<Meshlet>* outMeshlets)
+{
+	assert(numIndices % 3 == 0);
+
+	// Meshlet in which each vertex was last added
+	std::vector<uint32_t> vertexMeshlet(numVertices, ~0u);
+
+	Meshlet meshlet = {};
+	meshlet.firstIndex = firstIndex;
+	uint32_t meshletId = static_cast<uint32_t>(outMeshlets->size());
+
+	const uint32_t endIndex = firstIndex + numIndices;
+	for (uint32_t t = firstIndex; t < endIndex; t += 3) {
+		uint32_t newVertices = 0;
+		for (uint32_t k = 0; k < 3; ++k) {
+			assert(indices[t + k] < numVertices);
+			newVertices += vertexMeshlet[indices[t + k]] != meshletId ? 1 : 0;
+		}
+		// repeated vertices in a degenerate triangle are counted twice, it is conservative
+
+		if (meshlet.numVertices + newVertices > MAX_MESHLET_VERTICES ||
+			meshlet.numIndices / 3 == MAX_MESHLET_TRIANGLES) {
+			computeBounds(indices, positions, positionStride, &meshlet);
+			outMeshlets->push_back(meshlet);
+
+			meshlet = {};
+			meshlet.firstIndex = t;
+			meshletId += 1;
+		}
+
+		for (uint32_t k = 0; k < 3; ++k) {
+			if (vertexMeshlet[indices[t + k]] != meshletId) {
+				vertexMeshlet[indices[t + k]] = meshletId;
+				meshlet.numVertices += 1;
+			}
+		}
+		meshlet.numIndices += 3;
+	}
+
+	if (meshlet.numIndices > 0) {
+		computeBounds(indices, positions, positionStride, &meshlet);
+		outMeshlets->push_back(meshlet);
+	}
+}
+
+MeshletCullingView makeMeshletCullingView(const glm::mat4& modelViewProjection,
+	const glm::vec3& objectSpaceCameraPosition)
+{
+	// [Gribb and Hartmann 2001, Fast Extraction of Viewing Frustum Planes
+	// from the World-View-Projection Matrix]. With the clip depth in [-1, 1],
+	// that is conservative if the depth is in [0, 1]
+	const glm::mat4& m = modelViewProjection;
+	const glm::vec4 rows[4] = {
+		glm::vec4(m[0][0], m[1][0], m[2][0], m[3][0]),
+		glm::vec4(m[0][1], m[1][1], m[2][1], m[3][1]),
+		glm::vec4(m[0][2], m[1][2], m[2][2], m[3][2]),
+		glm::vec4(m[0][3], m[1][3], m[2][3], m[3][3]) };
+
+	MeshletCullingView view;
+	view.planes[0] = rows[3] + rows[0];
+	view.planes[1] = rows[3] - rows[0];
+	view.planes[2] = rows[3] + rows[1];
+	view.planes[3] = rows[3] - rows[1];
+	view.planes[4] = rows[3] + rows[2];
+	view.planes[5] = rows[3] - rows[2];
+
+	// Normalized, to compare the distances with the radius of the spheres
+	for (glm::vec4& plane : view.planes) {
+		const float length = glm::length(glm::vec3(plane));
+		if (length > 0.0f) {
+			plane /= length;
+		}
+	}
+
+	view.cameraPosition = objectSpaceCameraPosition;
+	view.padding = 0.0f;
+
+	return view;
+}
+
+bool isMeshletVisible(const Meshlet& meshlet, const MeshletCullingView& view)
+{
+	for (const glm::vec4& plane : view.planes) {
+		if (glm::dot(glm::vec3(plane), meshlet.center) + plane.w < -meshlet.radius) {
+			return false;
+		}
+	}
+
+	// All the triangles are back facing if, from every point of the sphere, the
+	// direction to it is within 90 degrees minus the angle of the cone from the axis
+	const glm::vec3 toCenter = meshlet.center - view.cameraPosition;
+	const float distance = glm::length(toCenter);
+	if (glm::dot(toCenter, meshlet.coneAxis) >=
+		meshlet.coneCutoff * distance + meshlet.radius * (1.0f + meshlet.coneCutoff)) {
+		return false;
+	}
+
+	return true;
+}
+
+} // namespace mesh
+} // namespace gr
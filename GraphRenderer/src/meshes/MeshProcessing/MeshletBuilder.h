@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace gr
+{
+namespace mesh
+{
+
+constexpr uint32_t MAX_MESHLET_VERTICES = 64;
+constexpr uint32_t MAX_MESHLET_TRIANGLES = 124;
+
+// Cluster of consecutive triangles of the index buffer, with the bounds to cull it.
+// The layout follows std430, so that the meshlets can be read by the GPU as they are.
+struct Meshlet {
+	// Bounding sphere
+	glm::vec3 center;
+	float radius;
+	// The normals of all the triangles are inside the cone around coneAxis.
+	// coneCutoff is the sine of the half angle of the cone, 1 if it can't be culled
+	glm::vec3 coneAxis;
+	float coneCutoff;
+
+	uint32_t firstIndex;
+	uint32_t numIndices;
+	uint32_t numVertices;
+	uint32_t padding;
+};
+
+static_assert(sizeof(Meshlet) == 48, "Meshlet must not have padding");
+
+// Splits the triangles of [firstIndex, firstIndex + numIndices) in meshlets of at most
+// MAX_MESHLET_VERTICES vertices and MAX_MESHLET_TRIANGLES triangles, and appends them.
+// The triangles are not reordered, so the order of optimizeVertexCache and
+// optimizeOverdraw is kept. The positions are 3 floats, every positionStride bytes.
+void buildMeshlets(const uint32_t* indices, uint32_t firstIndex, uint32_t numIndices,
+	const void* positions, size_t positionStride, uint32_t numVertices,
+	std::vector<Meshlet>* outMeshlets);
+
+
+// Frustum and camera in the object space of a mesh, to cull its meshlets
+struct MeshletCullingView {
+	// A point p is inside the frustum if dot(plane, vec4(p, 1)) >= 0 for all the planes
+	glm::vec4 planes[6];
+	glm::vec3 cameraPosition;
+	float padding;
+};
+
+// modelViewProjection transforms from the object space of the mesh to clip space
+MeshletCullingView makeMeshletCullingView(const glm::mat4& modelViewProjection,
+	const glm::vec3& objectSpaceCameraPosition);
+
+// Reference culling test. A meshlet is culled if its bounding sphere is outside
+// of the frustum, or if all its triangles are back facing from the camera.
+// Conservative: a visible meshlet is never culled.
+bool isMeshletVisible(const Meshlet& meshlet, const MeshletCullingView& view);
+
+} // namespace mesh
+} // namespace gr
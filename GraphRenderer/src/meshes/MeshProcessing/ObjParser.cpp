@@ -0,0 +1,440 @@
+#include "ObjParser.h"
+
+#include <charconv>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+#include <limits>
+#include <cassert>
+
+#include "../../utils/MappedFile.h"
+#include "../../utils/grjob.h"
+
+namespace gr
+{
+namespace mesh
+{
+
+namespace
+{
+
+// Bytes of the file parsed by each job
+constexpr size_t MIN_CHUNK_SIZE = 1 << 20;
+
+constexpr int32_t NO_INDEX = -1;
+
+// Attributes of a corner, to reference them in the relative indices
+enum CornerAttribute : uint32_t {
+	eVertex = 0,
+	eTexCoord = 1,
+	eNormal = 2
+};
+
+struct ChunkData {
+	const char* begin;
+	const char* end;
+
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> colors;
+	std::vector<glm::vec3> normals;
+	std::vector<glm::vec2> texCoords;
+	std::vector<ObjCorner> corners;
+	// Indices in the file are 1-based, or negative relative to the last element
+	// defined. The relative ones can't be resolved until the offset of the chunk
+	// is known, so they are stored relative to the chunk and listed here
+	// as 3 * cornerIndex + CornerAttribute
+	std::vector<uint32_t> relativeIndices;
+
+	// offsets of the chunk in the merged data
+	size_t positionsOffset = 0;
+	size_t colorsOffset = 0;
+	size_t normalsOffset = 0;
+	size_t texCoordsOffset = 0;
+	size_t cornersOffset = 0;
+
+	uint32_t firstLine = 0;
+	std::string error;
+};
+
+inline bool isBlank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char* skipBlanks(const char* p, const char* end)
+{
+	while (p < end && isBlank(*p)) {
+		++p;
+	}
+	return p;
+}
+
+inline const char* skipLine(const char* p, const char* end)
+{
+	const char* nl = std::find(p, end, '\n');
+	return nl == end ? end : nl + 1;
+}
+
+// Returns false if there is no number before the end of the line
+inline bool parseFloat(const char*& p, const char* end, float* out)
+{
+	p = skipBlanks(p, end);
+	if (p < end && *p == '+') {
+		++p;
+	}
+	const std::from_chars_result res = std::from_chars(p, end, *out);
+	if (res.ec != std::errc()) {
+		return false;
+	}
+	p = res.ptr;
+	return true;
+}
+
+inline bool parseInt(const char*& p, const char* end, int32_t* out)
+{
+	if (p < end && *p == '+') {
+		++p;
+	}
+	const std::from_chars_result res = std::from_chars(p, end, *out);
+	if (res.ec != std::errc()) {
+		return false;
+	}
+	p = res.ptr;
+	return true;
+}
+
+// Converts an index of the file to 0-based. The negative ones are made local to the chunk
+inline int32_t toIndex(int32_t fileIdx, size_t numDefined, uint32_t attribute,
+	uint32_t cornerIdx, ChunkData* chunk)
+{
+	if (fileIdx > 0) {
+		return fileIdx - 1;
+	}
+	chunk->relativeIndices.push_back(3 * cornerIdx + attribute);
+	return static_cast<int32_t>(numDefined) + fileIdx;
+}
+
+// The corner index is the one that it will have once the polygon is triangulated
+bool parseCorner(const char*& p, const char* end, uint32_t cornerIdx, ChunkData* chunk, ObjCorner* corner)
+{
+	int32_t idx;
+	if (!parseInt(p, end, &idx) || idx == 0) {
+		return false;
+	}
+	corner->vertex = toIndex(idx, chunk->positions.size(), eVertex, cornerIdx, chunk);
+	corner->texCoord = NO_INDEX;
+	corner->normal = NO_INDEX;
+
+	if (p < end && *p == '/') {
+		++p;
+		if (p < end && *p != '/') {
+			if (!parseInt(p, end, &idx) || idx == 0) {
+				return false;
+			}
+			corner->texCoord = toIndex(idx, chunk->texCoords.size(), eTexCoord, cornerIdx, chunk);
+		}
+		if (p < end && *p == '/') {
+			++p;
+			if (!parseInt(p, end, &idx) || idx == 0) {
+				return false;
+			}
+			corner->normal = toIndex(idx, chunk->normals.size(), eNormal, cornerIdx, chunk);
+		}
+	}
+
+	return true;
+}
+
+void parseChunk(ChunkData* chunk)
+{
+	const char* p = chunk->begin;
+	const char* const end = chunk->end;
+	uint32_t line = chunk->firstLine;
+
+	std::vector<ObjCorner> polygon;
+
+	while (p < end) {
+		line += 1;
+		const char* lineEnd = std::find(p, end, '\n');
+		p = skipBlanks(p, lineEnd);
+
+		if (lineEnd - p >= 2 && p[0] == 'v' && isBlank(p[1])) {
+			p += 2;
+			glm::vec3 pos, color;
+			if (!parseFloat(p, lineEnd, &pos.x) ||
+				!parseFloat(p, lineEnd, &pos.y) ||
+				!parseFloat(p, lineEnd, &pos.z)) {
+				chunk->error = "Bad vertex in line " + std::to_string(line);
+				return;
+			}
+			// optional vertex colors
+			if (parseFloat(p, lineEnd, &color.x)) {
+				if (!parseFloat(p, lineEnd, &color.y) ||
+					!parseFloat(p, lineEnd, &color.z)) {
+					chunk->error = "Bad vertex color in line " + std::to_string(line);
+					return;
+				}
+				chunk->colors.resize(chunk->positions.size(), glm::vec3(1.0f));
+				chunk->colors.push_back(color);
+			}
+			else if (!chunk->colors.empty()) {
+				chunk->colors.push_back(glm::vec3(1.0f));
+			}
+			chunk->positions.push_back(pos);
+		}
+		else if (lineEnd - p >= 3 && p[0] == 'v' && p[1] == 'n' && isBlank(p[2])) {
+			p += 3;
+			glm::vec3 n;
+			if (!parseFloat(p, lineEnd, &n.x) ||
+				!parseFloat(p, lineEnd, &n.y) ||
+				!parseFloat(p, lineEnd, &n.z)) {
+				chunk->error = "Bad normal in line " + std::to_string(line);
+				return;
+			}
+			chunk->normals.push_back(n);
+		}
+		else if (lineEnd - p >= 3 && p[0] == 'v' && p[1] == 't' && isBlank(p[2])) {
+			p += 3;
+			glm::vec2 t(0.0f);
+			if (!parseFloat(p, lineEnd, &t.x)) {
+				chunk->error = "Bad texture coordinate in line " + std::to_string(line);
+				return;
+			}
+			// v is optional
+			parseFloat(p, lineEnd, &t.y);
+			chunk->texCoords.push_back(t);
+		}
+		else if (lineEnd - p >= 2 && p[0] == 'f' && isBlank(p[1])) {
+			p += 2;
+			polygon.clear();
+			ObjCorner corner;
+			const size_t numRelative = chunk->relativeIndices.size();
+			while ((p = skipBlanks(p, lineEnd)) < lineEnd) {
+				const uint32_t cornerIdx = static_cast<uint32_t>(polygon.size());
+				if (!parseCorner(p, lineEnd, cornerIdx, chunk, &corner)) {
+					chunk->error = "Bad face in line " + std::to_string(line);
+					return;
+				}
+				polygon.push_back(corner);
+			}
+			if (polygon.size() < 3) {
+				chunk->error = "Face with less than 3 vertices in line " + std::to_string(line);
+				return;
+			}
+
+			// triangulate as a fan
+			const uint32_t firstCorner = static_cast<uint32_t>(chunk->corners.size());
+			for (size_t i = 2; i < polygon.size(); ++i) {
+				chunk->corners.push_back(polygon[0]);
+				chunk->corners.push_back(polygon[i - 1]);
+				chunk->corners.push_back(polygon[i]);
+			}
+
+			// the relative indices refer to the polygon, move them to the triangles
+			if (chunk->relativeIndices.size() != numRelative) {
+				std::vector<uint32_t> polygonRelative(
+					chunk->relativeIndices.begin() + numRelative, chunk->relativeIndices.end());
+				chunk->relativeIndices.resize(numRelative);
+				for (uint32_t ref : polygonRelative) {
+					const uint32_t polyCorner = ref / 3;
+					const uint32_t attribute = ref % 3;
+					// corner 0 is in all the triangles, the others in up to two
+					for (uint32_t t = 0; t + 2 < polygon.size(); ++t) {
+						for (uint32_t k = 0; k < 3; ++k) {
+							const uint32_t usedCorner = k == 0 ? 0 : t + k;
+							if (usedCorner == polyCorner) {
+								chunk->relativeIndices.push_back(3 * (firstCorner + 3 * t + k) + attribute);
+							}
+						}
+					}
+				}
+			}
+		}
+
+		p = lineEnd == end ? end : lineEnd + 1;
+	}
+
+	// all chunks must have colors if one has them, filled at merge
+	if (!chunk->colors.empty()) {
+		chunk->colors.resize(chunk->positions.size(), glm::vec3(1.0f));
+	}
+}
+
+inline void checkIndex(int32_t idx, size_t numElements)
+{
+	if (idx < NO_INDEX || idx >= static_cast<int64_t>(numElements)) {
+		throw std::runtime_error("Index out of range");
+	}
+}
+
+void mergeChunk(const ChunkData* chunk, ObjData* data)
+{
+	std::copy(chunk->positions.begin(), chunk->positions.end(),
+		data->positions.begin() + chunk->positionsOffset);
+	std::copy(chunk->normals.begin(), chunk->normals.end(),
+		data->normals.begin() + chunk->normalsOffset);
+	std::copy(chunk->texCoords.begin(), chunk->texCoords.end(),
+		data->texCoords.begin() + chunk->texCoordsOffset);
+	if (!data->colors.empty()) {
+		if (chunk->colors.empty()) {
+			std::fill_n(data->colors.begin() + chunk->positionsOffset,
+				chunk->positions.size(), glm::vec3(1.0f));
+		}
+		else {
+			std::copy(chunk->colors.begin(), chunk->colors.end(),
+				data->colors.begin() + chunk->positionsOffset);
+		}
+	}
+
+	ObjCorner* out = data->corners.data() + chunk->cornersOffset;
+	std::copy(chunk->corners.begin(), chunk->corners.end(), out);
+
+	// The other attributes of a corner may be relative too, so only the
+	// resolved one is checked, as a relative index can't end as NO_INDEX
+	for (uint32_t ref : chunk->relativeIndices) {
+		ObjCorner& c = out[ref / 3];
+		int32_t* idx = nullptr;
+		switch (ref % 3) {
+		case eVertex:
+			c.vertex += static_cast<int32_t>(chunk->positionsOffset);
+			idx = &c.vertex;
+			break;
+		case eTexCoord:
+			c.texCoord += static_cast<int32_t>(chunk->texCoordsOffset);
+			idx = &c.texCoord;
+			break;
+		case eNormal:
+			c.normal += static_cast<int32_t>(chunk->normalsOffset);
+			idx = &c.normal;
+			break;
+		}
+		if (idx == nullptr || *idx < 0) {
+			throw std::runtime_error("Relative index out of range");
+		}
+	}
+
+	for (size_t i = 0; i < chunk->corners.size(); ++i) {
+		if (out[i].vertex < 0) {
+			throw std::runtime_error("Index out of range");
+		}
+		checkIndex(out[i].vertex, data->positions.size());
+		checkIndex(out[i].texCoord, data->texCoords.size());
+		checkIndex(out[i].normal, data->normals.size());
+	}
+}
+
+} // namespace
+
+
+void parseObj(const char* fileName, ObjData* outData,
+	const std::atomic<bool>* cancelled)
+{
+	assert(outData != nullptr);
+
+	tools::MappedFile file;
+	if (!file.open(fileName)) {
+		throw std::runtime_error("Error: Can't open file " + std::string(fileName));
+	}
+
+	const char* const data = reinterpret_cast<const char*>(file.data());
+	const char* const dataEnd = data + file.size();
+
+	// split in chunks at line boundaries
+	const size_t chunkSize = std::max(MIN_CHUNK_SIZE,
+		file.size() / (static_cast<size_t>(grjob::getNumThreads()) * 4));
+	std::vector<ChunkData> chunks;
+	for (const char* p = data; p < dataEnd; ) {
+		chunks.emplace_back();
+		chunks.back().begin = p;
+		p = p + std::min(chunkSize, static_cast<size_t>(dataEnd - p));
+		p = p < dataEnd ? skipLine(p, dataEnd) : dataEnd;
+		chunks.back().end = p;
+	}
+
+	// parse
+	{
+		std::vector<grjob::Job> jobs;
+		jobs.reserve(chunks.size());
+		for (ChunkData& chunk : chunks) {
+			ChunkData* pChunk = &chunk;
+			jobs.push_back(grjob::Job([pChunk, cancelled]() {
+				if (cancelled == nullptr || !cancelled->load(std::memory_order_relaxed)) {
+					parseChunk(pChunk);
+				}
+			}));
+		}
+		grjob::Counter* c = nullptr;
+		grjob::runJobBatch(grjob::Priority::eLow, jobs.data(), static_cast<uint32_t>(jobs.size()), &c);
+		grjob::waitForCounterAndFree(c, 0);
+	}
+	if (cancelled != nullptr && cancelled->load(std::memory_order_relaxed)) {
+		return;
+	}
+
+	// line numbers of the errors are relative to the chunk
+	bool hasColors = false;
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		if (!chunks[i].error.empty()) {
+			const size_t linesBefore = std::count(data, chunks[i].begin, '\n');
+			throw std::runtime_error("Mesh Load Error: " + chunks[i].error +
+				" of chunk starting at line " + std::to_string(linesBefore + 1) +
+				" in " + std::string(fileName));
+		}
+		hasColors = hasColors || !chunks[i].colors.empty();
+	}
+
+	// offsets of each chunk
+	size_t numPositions = 0, numNormals = 0, numTexCoords = 0, numCorners = 0;
+	for (ChunkData& chunk : chunks) {
+		chunk.positionsOffset = numPositions;
+		chunk.normalsOffset = numNormals;
+		chunk.texCoordsOffset = numTexCoords;
+		chunk.cornersOffset = numCorners;
+		numPositions += chunk.positions.size();
+		numNormals += chunk.normals.size();
+		numTexCoords += chunk.texCoords.size();
+		numCorners += chunk.corners.size();
+	}
+
+	if (numPositions > static_cast<size_t>(std::numeric_limits<int32_t>::max()) ||
+		numCorners > static_cast<size_t>(std::numeric_limits<uint32_t>::max())) {
+		throw std::runtime_error("Mesh Load Error: too many elements in " + std::string(fileName));
+	}
+
+	outData->positions.resize(numPositions);
+	outData->colors.resize(hasColors ? numPositions : 0);
+	outData->normals.resize(numNormals);
+	outData->texCoords.resize(numTexCoords);
+	outData->corners.resize(numCorners);
+
+	// merge
+	{
+		std::vector<std::string> errors(chunks.size());
+		std::vector<grjob::Job> jobs;
+		jobs.reserve(chunks.size());
+		for (size_t i = 0; i < chunks.size(); ++i) {
+			const ChunkData* pChunk = &chunks[i];
+			std::string* pError = &errors[i];
+			jobs.push_back(grjob::Job([pChunk, outData, pError]() {
+				try {
+					mergeChunk(pChunk, outData);
+				}
+				catch (const std::exception& e) {
+					*pError = e.what();
+				}
+			}));
+		}
+		grjob::Counter* c = nullptr;
+		grjob::runJobBatch(grjob::Priority::eLow, jobs.data(), static_cast<uint32_t>(jobs.size()), &c);
+		grjob::waitForCounterAndFree(c, 0);
+
+		for (const std::string& error : errors) {
+			if (!error.empty()) {
+				throw std::runtime_error("Mesh Load Error: " + error + " in " + std::string(fileName));
+			}
+		}
+	}
+}
+
+} // namespace mesh
+} // namespace gr
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace gr
+{
+namespace mesh
+{
+
+// Indices of the attributes of a corner of a face, -1 if not present
+struct ObjCorner {
+	int32_t vertex;
+	int32_t texCoord;
+	int32_t normal;
+};
+
+struct ObjData {
+	std::vector<glm::vec3> positions;
+	// Empty if the file has no vertex colors
+	std::vector<glm::vec3> colors;
+	std::vector<glm::vec3> normals;
+	std::vector<glm::vec2> texCoords;
+
+	// 3 corners per triangle, polygons are triangulated as fans
+	std::vector<ObjCorner> corners;
+};
+
+// Memory maps the file and parses it in chunks split at line boundaries,
+// concurrently in the job system. Only geometry is read, materials, groups
+// and smoothing are ignored. Throws std::runtime_error on malformed files.
+// If cancelled is set while parsing, the remaining chunks are skipped and
+// outData is left empty
+void parseObj(const char* fileName, ObjData* outData,
+	const std::atomic<bool>* cancelled = nullptr);
+
+} // namespace mesh
+} // namespace gr
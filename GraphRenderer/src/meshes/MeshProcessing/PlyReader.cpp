@@ -0,0 +1,716 @@
+#include "PlyReader.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <limits>
+#include <cassert>
+
+#include "../../utils/grjob.h"
+
+namespace gr
+{
+namespace mesh
+{
+
+namespace
+{
+
+// Records decoded by each job
+constexpr uint64_t BINARY_CHUNK_RECORDS = 1 << 16;
+constexpr uint64_t ASCII_CHUNK_RECORDS = 1 << 14;
+
+constexpr size_t NO_TARGET = std::numeric_limits<size_t>::max();
+
+PlyType parseType(const std::string& name)
+{
+	if (name == "char" || name == "int8") return PlyType::eInt8;
+	if (name == "uchar" || name == "uint8") return PlyType::eUint8;
+	if (name == "short" || name == "int16") return PlyType::eInt16;
+	if (name == "ushort" || name == "uint16") return PlyType::eUint16;
+	if (name == "int" || name == "int32") return PlyType::eInt32;
+	if (name == "uint" || name == "uint32") return PlyType::eUint32;
+	if (name == "float" || name == "float32") return PlyType::eFloat32;
+	if (name == "double" || name == "float64") return PlyType::eFloat64;
+	return PlyType::eInvalid;
+}
+
+uint32_t typeSize(PlyType type)
+{
+	switch (type) {
+	case PlyType::eInt8:
+	case PlyType::eUint8:
+		return 1;
+	case PlyType::eInt16:
+	case PlyType::eUint16:
+		return 2;
+	case PlyType::eInt32:
+	case PlyType::eUint32:
+	case PlyType::eFloat32:
+		return 4;
+	case PlyType::eFloat64:
+		return 8;
+	default:
+		return 0;
+	}
+}
+
+// Scale to normalize integer colors to [0, 1]
+float colorScale(PlyType type)
+{
+	switch (type) {
+	case PlyType::eInt8: return 1.0f / std::numeric_limits<int8_t>::max();
+	case PlyType::eUint8: return 1.0f / std::numeric_limits<uint8_t>::max();
+	case PlyType::eInt16: return 1.0f / std::numeric_limits<int16_t>::max();
+	case PlyType::eUint16: return 1.0f / std::numeric_limits<uint16_t>::max();
+	case PlyType::eInt32: return 1.0f / static_cast<float>(std::numeric_limits<int32_t>::max());
+	case PlyType::eUint32: return 1.0f / static_cast<float>(std::numeric_limits<uint32_t>::max());
+	default: return 1.0f;
+	}
+}
+
+template<typename T, bool Swap>
+inline T loadBinary(const char* p)
+{
+	char bytes[sizeof(T)];
+	if constexpr (Swap) {
+		for (size_t i = 0; i < sizeof(T); ++i) {
+			bytes[i] = p[sizeof(T) - 1 - i];
+		}
+	}
+	else {
+		std::memcpy(bytes, p, sizeof(T));
+	}
+	T value;
+	std::memcpy(&value, bytes, sizeof(T));
+	return value;
+}
+
+template<bool Swap>
+inline double loadBinary(const char* p, PlyType type)
+{
+	switch (type) {
+	case PlyType::eInt8: return loadBinary<int8_t, Swap>(p);
+	case PlyType::eUint8: return loadBinary<uint8_t, Swap>(p);
+	case PlyType::eInt16: return loadBinary<int16_t, Swap>(p);
+	case PlyType::eUint16: return loadBinary<uint16_t, Swap>(p);
+	case PlyType::eInt32: return loadBinary<int32_t, Swap>(p);
+	case PlyType::eUint32: return loadBinary<uint32_t, Swap>(p);
+	case PlyType::eFloat32: return loadBinary<float, Swap>(p);
+	case PlyType::eFloat64: return loadBinary<double, Swap>(p);
+	default: return 0.0;
+	}
+}
+
+// Reads the values of the records one by one, returns false at the end of the data
+template<bool Swap>
+struct BinaryDecoder {
+	const char* p;
+	const char* end;
+
+	bool read(PlyType type, double* value) {
+		const uint32_t size = typeSize(type);
+		if (static_cast<size_t>(end - p) < size) {
+			return false;
+		}
+		*value = loadBinary<Swap>(p, type);
+		p += size;
+		return true;
+	}
+};
+
+struct AsciiDecoder {
+	const char* p;
+	const char* end;
+
+	bool read(PlyType, double* value) {
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+			++p;
+		}
+		if (p < end && *p == '+') {
+			++p;
+		}
+		const std::from_chars_result res = std::from_chars(p, end, *value);
+		if (res.ec != std::errc()) {
+			return false;
+		}
+		p = res.ptr;
+		return true;
+	}
+};
+
+// Where a property is written in a vertex
+struct VertexTarget {
+	size_t offset = NO_TARGET;
+	float scale = 1.0f;
+};
+
+template<typename Decoder>
+bool decodeVertices(Decoder d, const std::vector<PlyType>& types, const std::vector<PlyType>& countTypes,
+	const VertexTarget* targets, uint64_t numRecords, char* dst, size_t stride)
+{
+	double value;
+	for (uint64_t r = 0; r < numRecords; ++r) {
+		char* vertex = dst + r * stride;
+		for (size_t k = 0; k < types.size(); ++k) {
+			if (countTypes[k] != PlyType::eInvalid) {
+				if (!d.read(countTypes[k], &value)) {
+					return false;
+				}
+				for (uint64_t i = static_cast<uint64_t>(value); i > 0; --i) {
+					if (!d.read(types[k], &value)) {
+						return false;
+					}
+				}
+				continue;
+			}
+			if (!d.read(types[k], &value)) {
+				return false;
+			}
+			if (targets[k].offset != NO_TARGET) {
+				const float f = static_cast<float>(value) * targets[k].scale;
+				std::memcpy(vertex + targets[k].offset, &f, sizeof(float));
+			}
+		}
+	}
+	return true;
+}
+
+// Appends the faces triangulated as fans. Returns an error message, empty on success
+template<typename Decoder>
+std::string decodeFaces(Decoder d, const std::vector<PlyType>& types, const std::vector<PlyType>& countTypes,
+	uint32_t indicesProperty, uint64_t numRecords, uint32_t numVertices, std::vector<uint32_t>* out)
+{
+	std::vector<uint32_t> polygon;
+	double value;
+	for (uint64_t r = 0; r < numRecords; ++r) {
+		for (size_t k = 0; k < types.size(); ++k) {
+			if (countTypes[k] == PlyType::eInvalid) {
+				if (!d.read(types[k], &value)) {
+					return "Unexpected end of faces";
+				}
+				continue;
+			}
+			if (!d.read(countTypes[k], &value)) {
+				return "Unexpected end of faces";
+			}
+			const uint64_t count = static_cast<uint64_t>(value);
+			if (k != indicesProperty) {
+				for (uint64_t i = 0; i < count; ++i) {
+					if (!d.read(types[k], &value)) {
+						return "Unexpected end of faces";
+					}
+				}
+				continue;
+			}
+
+			polygon.clear();
+			for (uint64_t i = 0; i < count; ++i) {
+				if (!d.read(types[k], &value)) {
+					return "Unexpected end of faces";
+				}
+				if (value < 0.0 || value >= numVertices) {
+					return "Face index out of range";
+				}
+				polygon.push_back(static_cast<uint32_t>(value));
+			}
+			// faces with less than 3 vertices are ignored
+			for (size_t i = 2; i < polygon.size(); ++i) {
+				out->push_back(polygon[0]);
+				out->push_back(polygon[i - 1]);
+				out->push_back(polygon[i]);
+			}
+		}
+	}
+	return std::string();
+}
+
+template<bool Swap>
+const char* skipBinaryRecords(const char* p, const char* end, const std::vector<PlyType>& types,
+	const std::vector<PlyType>& countTypes, uint64_t numRecords)
+{
+	BinaryDecoder<Swap> d{ p, end };
+	double value;
+	for (uint64_t r = 0; r < numRecords; ++r) {
+		for (size_t k = 0; k < types.size(); ++k) {
+			if (countTypes[k] != PlyType::eInvalid) {
+				if (!d.read(countTypes[k], &value)) {
+					return nullptr;
+				}
+				const size_t listSize = static_cast<size_t>(value) * typeSize(types[k]);
+				if (static_cast<size_t>(end - d.p) < listSize) {
+					return nullptr;
+				}
+				d.p += listSize;
+			}
+			else if (!d.read(types[k], &value)) {
+				return nullptr;
+			}
+		}
+	}
+	return d.p;
+}
+
+template<typename F>
+void runChunks(uint32_t numChunks, const std::atomic<bool>* cancelled, F&& f)
+{
+	std::vector<grjob::Job> jobs;
+	jobs.reserve(numChunks);
+	for (uint32_t i = 0; i < numChunks; ++i) {
+		F* pF = &f;
+		jobs.push_back(grjob::Job([pF, i, cancelled]() {
+			if (cancelled == nullptr || !cancelled->load(std::memory_order_relaxed)) {
+				(*pF)(i);
+			}
+		}));
+	}
+	grjob::Counter* c = nullptr;
+	grjob::runJobBatch(grjob::Priority::eLow, jobs.data(), numChunks, &c);
+	grjob::waitForCounterAndFree(c, 0);
+}
+
+} // namespace
+
+
+void PlyReader::open(const char* fileName)
+{
+	mFileName = fileName;
+	mElements.clear();
+	mElementBegins.clear();
+	mVertexElement = ~0u;
+	mFaceElement = ~0u;
+	mFaceIndicesProperty = ~0u;
+	mHasColors = mHasNormals = mHasTexCoords = false;
+
+	if (!mFile.open(fileName)) {
+		throw std::runtime_error("Error: Can't open file " + mFileName);
+	}
+
+	const char* p = reinterpret_cast<const char*>(mFile.data());
+	const char* const fileEnd = end();
+
+	bool formatFound = false;
+	bool headerEnded = false;
+	bool first = true;
+	while (p < fileEnd && !headerEnded) {
+		const char* lineEnd = std::find(p, fileEnd, '\n');
+		std::istringstream line(std::string(p, lineEnd));
+		p = lineEnd == fileEnd ? fileEnd : lineEnd + 1;
+
+		std::string keyword;
+		line >> keyword;
+		if (first) {
+			if (keyword != "ply") {
+				throwError("Not a ply file");
+			}
+			first = false;
+		}
+		else if (keyword == "format") {
+			std::string format;
+			line >> format;
+			if (format == "ascii") {
+				mFormat = Format::eAscii;
+			}
+			else if (format == "binary_little_endian") {
+				mFormat = Format::eBinaryLittleEndian;
+			}
+			else if (format == "binary_big_endian") {
+				mFormat = Format::eBinaryBigEndian;
+			}
+			else {
+				throwError("Unknown format " + format);
+			}
+			formatFound = true;
+		}
+		else if (keyword == "element") {
+			Element element;
+			line >> element.name >> element.count;
+			if (!line) {
+				throwError("Bad element");
+			}
+			mElements.push_back(std::move(element));
+		}
+		else if (keyword == "property") {
+			if (mElements.empty()) {
+				throwError("Property without element");
+			}
+			Property prop;
+			std::string type;
+			line >> type;
+			if (type == "list") {
+				std::string countType;
+				line >> countType >> type;
+				prop.countType = parseType(countType);
+				if (prop.countType == PlyType::eInvalid ||
+					prop.countType == PlyType::eFloat32 || prop.countType == PlyType::eFloat64) {
+					throwError("Bad list count type " + countType);
+				}
+			}
+			prop.type = parseType(type);
+			line >> prop.name;
+			if (!line || prop.type == PlyType::eInvalid) {
+				throwError("Bad property");
+			}
+			mElements.back().properties.push_back(std::move(prop));
+		}
+		else if (keyword == "end_header") {
+			headerEnded = true;
+		}
+		else if (keyword != "comment" && keyword != "obj_info" && !keyword.empty()) {
+			throwError("Unknown header keyword " + keyword);
+		}
+	}
+
+	if (!headerEnded || !formatFound) {
+		throwError("Bad header");
+	}
+
+	mElementBegins.resize(mElements.size(), nullptr);
+	if (!mElements.empty()) {
+		mElementBegins[0] = p;
+	}
+
+	for (uint32_t i = 0; i < static_cast<uint32_t>(mElements.size()); ++i) {
+		Element& element = mElements[i];
+		element.stride = 0;
+		bool hasList = false;
+		for (const Property& prop : element.properties) {
+			hasList = hasList || prop.isList();
+			element.stride += typeSize(prop.type);
+		}
+		if (hasList) {
+			element.stride = 0;
+		}
+
+		if (element.name == "vertex") {
+			mVertexElement = i;
+			for (const Property& prop : element.properties) {
+				const std::string& n = prop.name;
+				mHasColors = mHasColors || n == "red" || n == "r" || n == "diffuse_red";
+				mHasNormals = mHasNormals || n == "nx";
+				mHasTexCoords = mHasTexCoords || n == "u" || n == "s" || n == "texture_u";
+			}
+		}
+		else if (element.name == "face") {
+			mFaceElement = i;
+			for (uint32_t k = 0; k < static_cast<uint32_t>(element.properties.size()); ++k) {
+				const Property& prop = element.properties[k];
+				if (prop.isList() && (prop.name == "vertex_indices" || prop.name == "vertex_index")) {
+					mFaceIndicesProperty = k;
+				}
+			}
+		}
+	}
+
+	if (mVertexElement == ~0u) {
+		throwError("No vertices");
+	}
+	if (mElements[mVertexElement].count > std::numeric_limits<uint32_t>::max()) {
+		throwError("Too many vertices");
+	}
+}
+
+uint32_t PlyReader::getNumVertices() const
+{
+	assert(mVertexElement != ~0u);
+	return static_cast<uint32_t>(mElements[mVertexElement].count);
+}
+
+void PlyReader::readVertices(void* dst, const PlyVertexLayout& layout)
+{
+	assert(mVertexElement != ~0u);
+	const Element& element = mElements[mVertexElement];
+
+	std::vector<VertexTarget> targets(element.properties.size());
+	std::vector<PlyType> types(element.properties.size());
+	std::vector<PlyType> countTypes(element.properties.size());
+	for (size_t k = 0; k < element.properties.size(); ++k) {
+		const Property& prop = element.properties[k];
+		const std::string& n = prop.name;
+		types[k] = prop.type;
+		countTypes[k] = prop.countType;
+		if (prop.isList()) {
+			continue;
+		}
+
+		VertexTarget& t = targets[k];
+		if (n == "x") t.offset = layout.positionOffset;
+		else if (n == "y") t.offset = layout.positionOffset + sizeof(float);
+		else if (n == "z") t.offset = layout.positionOffset + 2 * sizeof(float);
+		else if (n == "nx") t.offset = layout.normalOffset;
+		else if (n == "ny") t.offset = layout.normalOffset + sizeof(float);
+		else if (n == "nz") t.offset = layout.normalOffset + 2 * sizeof(float);
+		else if (n == "u" || n == "s" || n == "texture_u") t.offset = layout.texCoordOffset;
+		else if (n == "v" || n == "t" || n == "texture_v") t.offset = layout.texCoordOffset + sizeof(float);
+		else if (n == "red" || n == "r" || n == "diffuse_red") t.offset = layout.colorOffset;
+		else if (n == "green" || n == "g" || n == "diffuse_green") t.offset = layout.colorOffset + sizeof(float);
+		else if (n == "blue" || n == "b" || n == "diffuse_blue") t.offset = layout.colorOffset + 2 * sizeof(float);
+
+		if (t.offset != NO_TARGET && t.offset >= layout.colorOffset &&
+			t.offset < layout.colorOffset + 3 * sizeof(float)) {
+			t.scale = colorScale(prop.type);
+		}
+	}
+
+	std::vector<Chunk> chunks;
+	splitElement(mVertexElement, &chunks);
+
+	char* const out = reinterpret_cast<char*>(dst);
+	const char* const fileEnd = end();
+	std::vector<uint8_t> failed(chunks.size(), 0);
+	runChunks(static_cast<uint32_t>(chunks.size()), mCancelled, [&](uint32_t i) {
+		const Chunk& c = chunks[i];
+		char* chunkDst = out + c.firstRecord * layout.stride;
+		bool ok;
+		switch (mFormat) {
+		case Format::eAscii:
+			ok = decodeVertices(AsciiDecoder{ c.begin, fileEnd }, types, countTypes,
+				targets.data(), c.numRecords, chunkDst, layout.stride);
+			break;
+		case Format::eBinaryLittleEndian:
+			ok = decodeVertices(BinaryDecoder<false>{ c.begin, fileEnd }, types, countTypes,
+				targets.data(), c.numRecords, chunkDst, layout.stride);
+			break;
+		default:
+			ok = decodeVertices(BinaryDecoder<true>{ c.begin, fileEnd }, types, countTypes,
+				targets.data(), c.numRecords, chunkDst, layout.stride);
+			break;
+		}
+		failed[i] = ok ? 0 : 1;
+	});
+
+	if (std::find(failed.begin(), failed.end(), 1) != failed.end()) {
+		throwError("Bad vertex data");
+	}
+}
+
+void PlyReader::readTriangles(std::vector<uint32_t>* outIndices)
+{
+	assert(outIndices != nullptr);
+	if (mFaceElement == ~0u || mFaceIndicesProperty == ~0u) {
+		throwError("No faces");
+	}
+
+	const char* begin = getElementBegin(mFaceElement);
+	if (mFormat != Format::eAscii && readTrianglesBinaryFixed(begin, outIndices)) {
+		return;
+	}
+
+	const Element& element = mElements[mFaceElement];
+	std::vector<PlyType> types(element.properties.size());
+	std::vector<PlyType> countTypes(element.properties.size());
+	for (size_t k = 0; k < element.properties.size(); ++k) {
+		types[k] = element.properties[k].type;
+		countTypes[k] = element.properties[k].countType;
+	}
+
+	std::vector<Chunk> chunks;
+	splitElement(mFaceElement, &chunks);
+
+	// the number of triangles of a chunk is unknown until it is decoded
+	const uint32_t numVertices = getNumVertices();
+	const char* const fileEnd = end();
+	std::vector<std::vector<uint32_t>> chunkIndices(chunks.size());
+	std::vector<std::string> errors(chunks.size());
+	runChunks(static_cast<uint32_t>(chunks.size()), mCancelled, [&](uint32_t i) {
+		const Chunk& c = chunks[i];
+		chunkIndices[i].reserve(3 * c.numRecords);
+		switch (mFormat) {
+		case Format::eAscii:
+			errors[i] = decodeFaces(AsciiDecoder{ c.begin, fileEnd }, types, countTypes,
+				mFaceIndicesProperty, c.numRecords, numVertices, &chunkIndices[i]);
+			break;
+		case Format::eBinaryLittleEndian:
+			errors[i] = decodeFaces(BinaryDecoder<false>{ c.begin, fileEnd }, types, countTypes,
+				mFaceIndicesProperty, c.numRecords, numVertices, &chunkIndices[i]);
+			break;
+		default:
+			errors[i] = decodeFaces(BinaryDecoder<true>{ c.begin, fileEnd }, types, countTypes,
+				mFaceIndicesProperty, c.numRecords, numVertices, &chunkIndices[i]);
+			break;
+		}
+	});
+
+	std::vector<size_t> offsets(chunks.size());
+	size_t numIndices = 0;
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		if (!errors[i].empty()) {
+			throwError(errors[i]);
+		}
+		offsets[i] = numIndices;
+		numIndices += chunkIndices[i].size();
+	}
+	if (numIndices > std::numeric_limits<uint32_t>::max()) {
+		throwError("Too many faces");
+	}
+
+	outIndices->resize(numIndices);
+	runChunks(static_cast<uint32_t>(chunks.size()), mCancelled, [&](uint32_t i) {
+		std::copy(chunkIndices[i].begin(), chunkIndices[i].end(), outIndices->begin() + offsets[i]);
+		std::vector<uint32_t>().swap(chunkIndices[i]);
+	});
+}
+
+bool PlyReader::readTrianglesBinaryFixed(const char* begin, std::vector<uint32_t>* outIndices)
+{
+	// Only possible if all the faces are triangles and the other properties are not lists,
+	// then all the records have the same size
+	const Element& element = mElements[mFaceElement];
+	size_t listOffset = 0;
+	size_t stride = 0;
+	for (uint32_t k = 0; k < static_cast<uint32_t>(element.properties.size()); ++k) {
+		const Property& prop = element.properties[k];
+		if (k == mFaceIndicesProperty) {
+			listOffset = stride;
+			stride += typeSize(prop.countType) + 3 * typeSize(prop.type);
+		}
+		else if (prop.isList()) {
+			return false;
+		}
+		else {
+			stride += typeSize(prop.type);
+		}
+	}
+
+	const uint64_t numFaces = element.count;
+	if (static_cast<uint64_t>(end() - begin) / stride < numFaces ||
+		3 * numFaces > std::numeric_limits<uint32_t>::max()) {
+		return false;
+	}
+
+	const Property& indices = element.properties[mFaceIndicesProperty];
+	const uint32_t countSize = typeSize(indices.countType);
+	const uint32_t indexSize = typeSize(indices.type);
+	const uint32_t numVertices = getNumVertices();
+	const bool swap = mFormat == Format::eBinaryBigEndian;
+
+	outIndices->resize(3 * numFaces);
+	const uint32_t numChunks = static_cast<uint32_t>((numFaces + BINARY_CHUNK_RECORDS - 1) / BINARY_CHUNK_RECORDS);
+	// 1 if not all triangles, 2 if an index is out of range
+	std::vector<uint8_t> failed(numChunks, 0);
+	runChunks(numChunks, mCancelled, [&](uint32_t chunk) {
+		const uint64_t first = chunk * BINARY_CHUNK_RECORDS;
+		const uint64_t last = std::min(numFaces, first + BINARY_CHUNK_RECORDS);
+		uint32_t* out = outIndices->data() + 3 * first;
+		for (uint64_t r = first; r < last; ++r) {
+			const char* p = begin + r * stride + listOffset;
+			const double count = swap ? loadBinary<true>(p, indices.countType) :
+				loadBinary<false>(p, indices.countType);
+			if (count != 3.0) {
+				failed[chunk] = 1;
+				return;
+			}
+			p += countSize;
+			for (uint32_t i = 0; i < 3; ++i, p += indexSize) {
+				const double idx = swap ? loadBinary<true>(p, indices.type) :
+					loadBinary<false>(p, indices.type);
+				if (idx < 0.0 || idx >= numVertices) {
+					failed[chunk] = 2;
+					return;
+				}
+				*out++ = static_cast<uint32_t>(idx);
+			}
+		}
+	});
+
+	if (std::find(failed.begin(), failed.end(), 2) != failed.end()) {
+		throwError("Face index out of range");
+	}
+	if (std::find(failed.begin(), failed.end(), 1) != failed.end()) {
+		outIndices->clear();
+		return false;
+	}
+	return true;
+}
+
+const char* PlyReader::end() const
+{
+	return reinterpret_cast<const char*>(mFile.data()) + mFile.size();
+}
+
+const char* PlyReader::splitElement(uint32_t elementIdx, std::vector<Chunk>* chunks)
+{
+	const char* blockEnd = splitElementBlock(elementIdx, chunks);
+	// the end is the begin of the next element
+	if (blockEnd != nullptr && elementIdx + 1 < mElementBegins.size()) {
+		mElementBegins[elementIdx + 1] = blockEnd;
+	}
+	return blockEnd;
+}
+
+const char* PlyReader::splitElementBlock(uint32_t elementIdx, std::vector<Chunk>* chunks)
+{
+	const Element& element = mElements[elementIdx];
+	const char* const begin = getElementBegin(elementIdx);
+	const char* const fileEnd = end();
+	chunks->clear();
+
+	if (mFormat == Format::eAscii) {
+		// one record per line
+		const char* p = begin;
+		for (uint64_t r = 0; r < element.count; ++r) {
+			if (r % ASCII_CHUNK_RECORDS == 0) {
+				chunks->push_back({ p, r, std::min(ASCII_CHUNK_RECORDS, element.count - r) });
+			}
+			if (p >= fileEnd) {
+				throwError("Unexpected end of file in " + element.name);
+			}
+			const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', fileEnd - p));
+			p = lineEnd == nullptr ? fileEnd : lineEnd + 1;
+		}
+		return p;
+	}
+
+	if (element.stride == 0) {
+		// the records have lists, they can't be located without decoding
+		chunks->push_back({ begin, 0, element.count });
+		return nullptr;
+	}
+
+	if (static_cast<uint64_t>(fileEnd - begin) / element.stride < element.count) {
+		throwError("Unexpected end of file in " + element.name);
+	}
+	for (uint64_t r = 0; r < element.count; r += BINARY_CHUNK_RECORDS) {
+		chunks->push_back({ begin + r * element.stride, r, std::min(BINARY_CHUNK_RECORDS, element.count - r) });
+	}
+	return begin + element.count * element.stride;
+}
+
+const char* PlyReader::getElementBegin(uint32_t elementIdx)
+{
+	if (mElementBegins[elementIdx] != nullptr) {
+		return mElementBegins[elementIdx];
+	}
+
+	assert(elementIdx > 0);
+	const uint32_t prevIdx = elementIdx - 1;
+	std::vector<Chunk> chunks;
+	const char* begin = splitElement(prevIdx, &chunks);
+	if (begin == nullptr) {
+		const Element& prev = mElements[prevIdx];
+		std::vector<PlyType> types, countTypes;
+		for (const Property& prop : prev.properties) {
+			types.push_back(prop.type);
+			countTypes.push_back(prop.countType);
+		}
+		begin = mFormat == Format::eBinaryBigEndian ?
+			skipBinaryRecords<true>(getElementBegin(prevIdx), end(), types, countTypes, prev.count) :
+			skipBinaryRecords<false>(getElementBegin(prevIdx), end(), types, countTypes, prev.count);
+		if (begin == nullptr) {
+			throwError("Unexpected end of file in " + prev.name);
+		}
+	}
+
+	mElementBegins[elementIdx] = begin;
+	return begin;
+}
+
+void PlyReader::throwError(const std::string& msg) const
+{
+	throw std::runtime_error("Ply Load Error: " + msg + " in " + mFileName);
+}
+
+} // namespace mesh
+} // namespace gr
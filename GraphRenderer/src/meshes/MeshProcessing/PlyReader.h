@@ -0,0 +1,131 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "../../utils/MappedFile.h"
+
+namespace gr
+{
+namespace mesh
+{
+
+enum class PlyType : uint8_t {
+	eInvalid,
+	eInt8,
+	eUint8,
+	eInt16,
+	eUint16,
+	eInt32,
+	eUint32,
+	eFloat32,
+	eFloat64
+};
+
+// Where the vertex attributes are written in an interleaved array of vertices.
+// Positions, colors and normals are 3 floats, texture coordinates 2 floats
+struct PlyVertexLayout {
+	size_t stride;
+	size_t positionOffset;
+	size_t colorOffset;
+	size_t normalOffset;
+	size_t texCoordOffset;
+};
+
+// Reader of ascii and binary little and big endian PLY files.
+// The file is memory mapped and the element blocks are decoded in parallel
+// chunks in the job system, directly into the destination arrays.
+// Properties of any type are converted to float, integer colors are normalized,
+// and faces with more than 3 vertices are triangulated as fans.
+// Errors throw std::runtime_error.
+class PlyReader
+{
+public:
+
+	PlyReader() = default;
+	PlyReader(const PlyReader&) = delete;
+	PlyReader& operator=(const PlyReader&) = delete;
+
+	// Maps the file and parses the header
+	void open(const char* fileName);
+	// Once set, the chunks that are not decoded yet are skipped,
+	// and the outputs of the reads are left incomplete
+	void setCancelFlag(const std::atomic<bool>* cancelled) { mCancelled = cancelled; }
+
+	uint32_t getNumVertices() const;
+	bool hasColors() const { return mHasColors; }
+	bool hasNormals() const { return mHasNormals; }
+	bool hasTexCoords() const { return mHasTexCoords; }
+
+	// dst must hold getNumVertices() vertices with the layout.
+	// Attributes that are not in the file are not written
+	void readVertices(void* dst, const PlyVertexLayout& layout);
+
+	// Triangle list of the faces
+	void readTriangles(std::vector<uint32_t>* outIndices);
+
+private:
+
+	enum class Format {
+		eAscii,
+		eBinaryLittleEndian,
+		eBinaryBigEndian
+	};
+
+	struct Property {
+		std::string name;
+		PlyType type = PlyType::eInvalid;
+		// eInvalid if the property is not a list
+		PlyType countType = PlyType::eInvalid;
+
+		bool isList() const { return countType != PlyType::eInvalid; }
+	};
+
+	struct Element {
+		std::string name;
+		uint64_t count = 0;
+		std::vector<Property> properties;
+		// size of a binary record, 0 if it has lists
+		uint32_t stride = 0;
+	};
+
+	// Consecutive records of an element, decoded by a job
+	struct Chunk {
+		const char* begin;
+		uint64_t firstRecord;
+		uint64_t numRecords;
+	};
+
+	tools::MappedFile mFile;
+	std::string mFileName;
+	Format mFormat = Format::eAscii;
+	std::vector<Element> mElements;
+	// begin of each element block, nullptr until it is located
+	std::vector<const char*> mElementBegins;
+
+	uint32_t mVertexElement = ~0u;
+	uint32_t mFaceElement = ~0u;
+	uint32_t mFaceIndicesProperty = ~0u;
+	bool mHasColors = false;
+	bool mHasNormals = false;
+	bool mHasTexCoords = false;
+	const std::atomic<bool>* mCancelled = nullptr;
+
+	const char* end() const;
+
+	// Splits the element block in chunks. Returns the end of the block,
+	// or nullptr if it can't be known without decoding it
+	const char* splitElement(uint32_t elementIdx, std::vector<Chunk>* chunks);
+	const char* splitElementBlock(uint32_t elementIdx, std::vector<Chunk>* chunks);
+	const char* getElementBegin(uint32_t elementIdx);
+
+	bool readTrianglesBinaryFixed(const char* begin, std::vector<uint32_t>* outIndices);
+
+	[[noreturn]] void throwError(const std::string& msg) const;
+
+};
+
+} // namespace mesh
+} // namespace gr
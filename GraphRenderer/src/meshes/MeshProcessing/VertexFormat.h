@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include <glm/glm.hpp>
+
+namespace gr
+{
+namespace mesh
+{
+
+// Layouts of the vertices in the GPU. All the compact attributes are decoded
+// to float by the vertex input, so all the formats use the same shaders.
+enum class VertexFormat : uint32_t {
+	// 44 bytes, all attributes as floats
+	eFloat = 0,
+	// 24 bytes, float position, snorm8 normal, unorm8 color, half texture coordinates
+	eCompact = 1,
+	// 20 bytes, as eCompact but with the position as unorm16 relative to the bbox
+	eCompactQuantized = 2
+};
+
+constexpr uint32_t NUM_VERTEX_FORMATS = 3;
+
+struct CompactVertex {
+	glm::vec3 pos;
+	uint32_t normal;
+	uint32_t color;
+	uint32_t texCoord;
+};
+
+struct QuantizedVertex {
+	glm::u16vec4 pos;
+	uint32_t normal;
+	uint32_t color;
+	uint32_t texCoord;
+};
+
+static_assert(sizeof(CompactVertex) == 24, "CompactVertex must not have padding");
+static_assert(sizeof(QuantizedVertex) == 20, "QuantizedVertex must not have padding");
+
+inline const char* getVertexFormatName(VertexFormat format)
+{
+	switch (format) {
+	case VertexFormat::eFloat: return "Float";
+	case VertexFormat::eCompact: return "Compact";
+	case VertexFormat::eCompactQuantized: return "Compact quantized";
+	default: return "Unknown";
+	}
+}
+
+} // namespace mesh
+} // namespace gr
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <type_traits>
+#include <cassert>
+
+#include "IObject.h"
+
+namespace gr
+{
+
+// Memory of the objects of one type of the ResourceDictionary
+class IObjectPool
+{
+public:
+	virtual ~IObjectPool() = default;
+
+	// Calls the destructor and returns the memory to the pool
+	virtual void destroy(IObject* object) = 0;
+
+	// Moves an object allocated elsewhere (i.e. by the deserialization) into the pool
+	virtual IObject* adopt(std::unique_ptr<IObject>&& object) = 0;
+};
+
+// Chunked arena of objects of type T. Objects are allocated
+// contiguously and never move, freed memory is reused first.
+template<typename T>
+class ObjectPool final : public IObjectPool
+{
+public:
+
+	ObjectPool() = default;
+	ObjectPool& operator=(const ObjectPool&) = delete;
+	~ObjectPool() override;
+
+	template<typename ...Args>
+	T* create(Args&&... args);
+
+	void destroy(IObject* object) override;
+
+	IObject* adopt(std::unique_ptr<IObject>&& object) override;
+
+private:
+
+	static constexpr uint32_t CHUNK_SIZE = 64;
+
+	typedef std::aligned_storage_t<sizeof(T), alignof(T)> Storage;
+
+	std::vector<std::unique_ptr<Storage[]>> mChunks;
+	std::vector<Storage*> mFreeList;
+	uint32_t mNumObjects = 0;
+
+	Storage* allocate();
+};
+
+
+template<typename T>
+inline ObjectPool<T>::~ObjectPool()
+{
+	// the owner must destroy all the objects before
+	assert(mNumObjects == 0);
+}
+
+template<typename T>
+template<typename ...Args>
+inline T* ObjectPool<T>::create(Args&&... args)
+{
+	Storage* mem = allocate();
+	T* object = new (mem) T(std::forward<Args>(args)...);
+	mNumObjects += 1;
+	return object;
+}
+
+template<typename T>
+inline void ObjectPool<T>::destroy(IObject* object)
+{
+	assert(object != nullptr);
+	T* casted = static_cast<T*>(object);
+	casted->~T();
+
+	mFreeList.push_back(reinterpret_cast<Storage*>(casted));
+	mNumObjects -= 1;
+}
+
+template<typename T>
+inline IObject* ObjectPool<T>::adopt(std::unique_ptr<IObject>&& object)
+{
+	assert(object != nullptr);
+	T* casted = dynamic_cast<T*>(object.get());
+	assert(casted != nullptr);
+
+	T* res = create(std::move(*casted));
+	object.reset();
+	return res;
+}
+
+template<typename T>
+inline typename ObjectPool<T>::Storage* ObjectPool<T>::allocate()
+{
+	if (mFreeList.empty()) {
+		mChunks.push_back(std::make_unique<Storage[]>(CHUNK_SIZE));
+		Storage* chunk = mChunks.back().get();
+		// reversed, to use the chunk in order
+		for (uint32_t i = CHUNK_SIZE; i > 0; --i) {
+			mFreeList.push_back(chunk + (i - 1));
+		}
+	}
+
+	Storage* mem = mFreeList.back();
+	mFreeList.pop_back();
+	return mem;
+}
+
+} // namespace gr
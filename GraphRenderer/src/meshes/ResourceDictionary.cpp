@@ -3,48 +3,101 @@
 #include "../control/FrameContext.h"
 
 #include <iostream>
+#include <algorithm>
 
 namespace gr
 {
 
-ResId ResourceDictionary::getAndUpdateId()
+ResourceDictionary::ResourceDictionary() :
+	mPools(s_createPools(std::make_index_sequence<NUM_TYPES>()))
 {
-	std::unique_lock idLock(mNextIdMutex);
+	for (std::atomic<Slot*>& chunk : mSlotChunks) {
+		chunk.store(nullptr, std::memory_order_relaxed);
+	}
+}
 
-	mLastIdUsed.value += 1;
+ResourceDictionary::~ResourceDictionary()
+{
+	for (uint32_t i = 0; i < mNumSlots; ++i) {
+		const Slot* slot = getSlot(i);
+		if (ResId(slot->id.load(std::memory_order_relaxed))) {
+			mPools[slot->typeIdx.load(std::memory_order_relaxed)]->destroy(
+				slot->object.load(std::memory_order_relaxed));
+		}
+	}
+	for (const RetiredObject& retired : mRetiredObjects) {
+		mPools[retired.typeIdx]->destroy(retired.object);
+	}
 
-	return mLastIdUsed;
+	for (std::atomic<Slot*>& chunk : mSlotChunks) {
+		delete[] chunk.load(std::memory_order_relaxed);
+	}
 }
 
 void ResourceDictionary::destroy(FrameContext* fc)
 {
-	for (std::pair<const ResId, std::unique_ptr<IObject>>& it : mObjectsDictionary) {
-		it.second->scheduleDestroy(fc);
-	}
+	forEachObject([fc](ResId, IObject* object) {
+		object->scheduleDestroy(fc);
+	});
 }
 
 void ResourceDictionary::flushDataAndFree(FrameContext* fc)
 {
-	std::unique_lock lock(mEraseObjectMutex);
+	std::unique_lock lock(mObjectsMutex);
+	freeErasedObjects(fc);
+}
 
-	for (const ResId& id : mObjectsToFree) {
-		for (std::unordered_set<ResId>& s : mObjectsByType) {
-			s.erase(id);
-		}
-		decltype(mObjectsDictionary)::iterator it = mObjectsDictionary.find(id);
-		it->second->scheduleDestroy(fc);
-		mObjectsDictionary.erase(it);
+void ResourceDictionary::freeErasedObjects(FrameContext* fc)
+{
+	mEpoch += 1;
+
+	// delete the objects that no reader can reference anymore
+	std::vector<RetiredObject>::iterator it = std::remove_if(
+		mRetiredObjects.begin(), mRetiredObjects.end(),
+		[this](const RetiredObject& retired) {
+			if (retired.epoch + OBJECT_RECLAIM_EPOCHS < mEpoch) {
+				mPools[retired.typeIdx]->destroy(retired.object);
+				return true;
+			}
+			return false;
+		});
+	mRetiredObjects.erase(it, mRetiredObjects.end());
+
+	std::vector<ResId> objectsToFree;
+	{
+		std::unique_lock eraseLock(mEraseObjectMutex);
+		objectsToFree.swap(mObjectsToFree);
 	}
 
-	mObjectsToFree.clear();
+	for (const ResId& id : objectsToFree) {
+		uint32_t typeIdx;
+		IObject* object = removeObject(id, &typeIdx);
+		if (object == nullptr) {
+			// erased more than once
+			continue;
+		}
+
+		removeFromTypeList(id, typeIdx);
+		decltype(mName2Id)::iterator itName = mName2Id.find(object->getObjectName());
+		if (itName != mName2Id.end() && itName->second == id) {
+			mName2Id.erase(itName);
+		}
+
+		object->scheduleDestroy(fc);
+		retireObject(object, typeIdx);
+	}
 }
 
-std::string ResourceDictionary::createUniqueName(const std::string& string)
+std::string ResourceDictionary::createUniqueName(std::string_view string)
 {
+	// continue from the last suffix used with this name
+	uint32_t& counter = mNameCounters[std::string(string)];
+
 	std::string newName;
-	int i = 0;
 	do {
-		newName = string + '_' + std::to_string(i++);
+		newName.assign(string);
+		newName += '_';
+		newName += std::to_string(counter++);
 	} while (mName2Id.count(newName) != 0);
 	return newName;
 }
@@ -57,8 +110,7 @@ void ResourceDictionary::erase(ResId id)
 
 uint32_t ResourceDictionary::size() const
 {
-	std::shared_lock slock(mObjectsMutex);
-	return uint32_t( mObjectsDictionary.size() );
+	return mNumObjects.load(std::memory_order_relaxed);
 }
 
 bool ResourceDictionary::empty() const
@@ -69,43 +121,51 @@ bool ResourceDictionary::empty() const
 void ResourceDictionary::clear(FrameContext* fc)
 {
 	std::unique_lock ulock(mObjectsMutex);
-	flushDataAndFree(fc);
+	freeErasedObjects(fc);
 
-	for (std::unordered_set<ResId>& s : mObjectsByType) {
+	for (std::vector<ResId>& s : mObjectsByType) {
 		s.clear();
 	}
 
-	for (decltype(mObjectsDictionary)::iterator it = mObjectsDictionary.begin();
-		it != mObjectsDictionary.end(); ++it) {
-		it->second->scheduleDestroy(fc);
+	for (uint32_t i = 0; i < mNumSlots; ++i) {
+		const ResId id(getSlot(i)->id.load(std::memory_order_relaxed));
+		if (id) {
+			uint32_t typeIdx;
+			IObject* object = removeObject(id, &typeIdx);
+			object->scheduleDestroy(fc);
+			retireObject(object, typeIdx);
+		}
 	}
 
-	mObjectsDictionary.clear();
 	mName2Id.clear();
+	mNameCounters.clear();
 }
 
 void ResourceDictionary::startAll(FrameContext* fc)
 {
 	std::unique_lock ulock(mObjectsMutex);
-	for (decltype(mObjectsDictionary)::iterator it = mObjectsDictionary.begin();
-		it != mObjectsDictionary.end(); ++it) {
-		it->second->start(fc);
-	}
+	forEachObject([fc](ResId, IObject* object) {
+		object->start(fc);
+	});
 }
 
-ResId ResourceDictionary::getId(const std::string& name) const
+ResId ResourceDictionary::getId(std::string_view name) const
 {
 	std::shared_lock slock(mObjectsMutex);
 	return mName2Id.at(name);
 }
 
-std::string ResourceDictionary::getName(const ResId id) const
+std::string_view ResourceDictionary::getName(const ResId id) const
 {
 	std::shared_lock slock(mObjectsMutex);
-	return mObjectsDictionary.at(id)->getObjectName();
+	IObject* object = findObject(id, nullptr);
+	if (object == nullptr) {
+		throw std::out_of_range("Object " + std::to_string(id) + " not in the dictionary");
+	}
+	return object->getObjectName();
 }
 
-bool ResourceDictionary::existsName(const std::string& name) const
+bool ResourceDictionary::existsName(std::string_view name) const
 {
 	std::shared_lock slock(mObjectsMutex);
 
@@ -114,25 +174,172 @@ bool ResourceDictionary::existsName(const std::string& name) const
 
 bool ResourceDictionary::exists(const ResId id) const
 {
-	std::shared_lock slock(mObjectsMutex);
-	return mObjectsDictionary.count(id) != 0;
+	return findObject(id, nullptr) != nullptr;
 }
 
-void ResourceDictionary::rename(ResId id, const std::string& newName)
+void ResourceDictionary::rename(ResId id, std::string_view newName)
 {
 	std::unique_lock slock(mObjectsMutex);
 
 	// assert that the new name is unique
 	assert(mName2Id.count(newName) == 0);
 
-	decltype(mObjectsDictionary)::iterator it = mObjectsDictionary.find(id);
+	IObject* object = findObject(id, nullptr);
+	assert(object != nullptr);
 	
-	mName2Id.erase(it->second->getObjectName());
+	// the key views the old name, erase it before changing the name
+	mName2Id.erase(object->getObjectName());
+	object->setObjectName(newName);
 	std::pair<decltype(mName2Id)::const_iterator, bool> insertIt = 
-		mName2Id.emplace(newName, id);
+		mName2Id.emplace(object->getObjectName(), id);
 	// assert inserted
 	assert(insertIt.second);
-	it->second->setObjectName(newName);
+}
+
+IObject* ResourceDictionary::findObject(ResId id, uint32_t* outTypeIdx) const
+{
+	if (!id) {
+		return nullptr;
+	}
+
+	const Slot* slot = getSlot(id.getSlotIndex());
+	if (slot == nullptr) {
+		return nullptr;
+	}
+
+	IObject* object = slot->object.load(std::memory_order_acquire);
+	const uint32_t typeIdx = slot->typeIdx.load(std::memory_order_acquire);
+	// check after reading the object and its type, in case the slot has been freed or reused
+	if (slot->id.load(std::memory_order_acquire) != id.value) {
+		return nullptr;
+	}
+
+	if (outTypeIdx != nullptr) {
+		*outTypeIdx = typeIdx;
+	}
+	return object;
+}
+
+ResourceDictionary::Slot* ResourceDictionary::getSlot(uint32_t slotIdx) const
+{
+	const uint32_t chunkIdx = slotIdx / SLOT_CHUNK_SIZE;
+	if (chunkIdx >= MAX_SLOT_CHUNKS) {
+		return nullptr;
+	}
+
+	Slot* chunk = mSlotChunks[chunkIdx].load(std::memory_order_acquire);
+	if (chunk == nullptr) {
+		return nullptr;
+	}
+
+	return chunk + (slotIdx % SLOT_CHUNK_SIZE);
+}
+
+ResourceDictionary::Slot* ResourceDictionary::createSlot(uint32_t slotIdx)
+{
+	const uint32_t chunkIdx = slotIdx / SLOT_CHUNK_SIZE;
+	if (chunkIdx >= MAX_SLOT_CHUNKS) {
+		throw std::runtime_error("Too many objects in the dictionary");
+	}
+
+	// create all the chunks up to the slot, so that [0, mNumSlots) always exist
+	for (uint32_t c = 0; c <= chunkIdx; ++c) {
+		if (mSlotChunks[c].load(std::memory_order_relaxed) == nullptr) {
+			Slot* chunk = new Slot[SLOT_CHUNK_SIZE];
+			for (uint32_t i = 0; i < SLOT_CHUNK_SIZE; ++i) {
+				chunk[i].id.store(ResId().value, std::memory_order_relaxed);
+				chunk[i].object.store(nullptr, std::memory_order_relaxed);
+				chunk[i].typeIdx.store(0, std::memory_order_relaxed);
+				chunk[i].nextGeneration = 0;
+				chunk[i].typeListIdx = 0;
+			}
+			mSlotChunks[c].store(chunk, std::memory_order_release);
+		}
+	}
+
+	mNumSlots = std::max(mNumSlots, slotIdx + 1);
+
+	return getSlot(slotIdx);
+}
+
+ResId ResourceDictionary::insertObject(IObject* object, uint32_t typeIdx)
+{
+	uint32_t slotIdx;
+	if (!mFreeSlots.empty()) {
+		slotIdx = mFreeSlots.back();
+		mFreeSlots.pop_back();
+	}
+	else {
+		slotIdx = mNumSlots;
+	}
+
+	Slot* slot = createSlot(slotIdx);
+	const ResId id = ResId::fromSlot(slotIdx, slot->nextGeneration);
+	insertObjectAt(id, object, typeIdx);
+
+	return id;
+}
+
+void ResourceDictionary::insertObjectAt(ResId id, IObject* object, uint32_t typeIdx)
+{
+	assert(object != nullptr);
+	Slot* slot = createSlot(id.getSlotIndex());
+	assert(!ResId(slot->id.load(std::memory_order_relaxed)));
+
+	slot->nextGeneration = id.getGeneration() + 1;
+	// the object and its type must be visible before the id
+	slot->typeIdx.store(typeIdx, std::memory_order_release);
+	slot->object.store(object, std::memory_order_release);
+	slot->id.store(id.value, std::memory_order_release);
+
+	mNumObjects.fetch_add(1, std::memory_order_relaxed);
+}
+
+IObject* ResourceDictionary::removeObject(ResId id, uint32_t* outTypeIdx)
+{
+	Slot* slot = getSlot(id.getSlotIndex());
+	if (slot == nullptr || slot->id.load(std::memory_order_relaxed) != id.value) {
+		return nullptr;
+	}
+
+	IObject* object = slot->object.load(std::memory_order_relaxed);
+	if (outTypeIdx != nullptr) {
+		*outTypeIdx = slot->typeIdx.load(std::memory_order_relaxed);
+	}
+
+	// invalidate the id before the object, the readers check the id last
+	slot->id.store(ResId().value, std::memory_order_release);
+	slot->object.store(nullptr, std::memory_order_release);
+
+	mFreeSlots.push_back(id.getSlotIndex());
+	mNumObjects.fetch_sub(1, std::memory_order_relaxed);
+
+	return object;
+}
+
+void ResourceDictionary::retireObject(IObject* object, uint32_t typeIdx)
+{
+	mRetiredObjects.push_back({ mEpoch, object, typeIdx });
+}
+
+void ResourceDictionary::addToTypeList(ResId id, uint32_t typeIdx)
+{
+	std::vector<ResId>& ids = mObjectsByType[typeIdx];
+	getSlot(id.getSlotIndex())->typeListIdx = static_cast<uint32_t>(ids.size());
+	ids.push_back(id);
+}
+
+void ResourceDictionary::removeFromTypeList(ResId id, uint32_t typeIdx)
+{
+	std::vector<ResId>& ids = mObjectsByType[typeIdx];
+	const uint32_t idx = getSlot(id.getSlotIndex())->typeListIdx;
+	assert(idx < ids.size() && ids[idx] == id);
+
+	if (idx != ids.size() - 1) {
+		ids[idx] = ids.back();
+		getSlot(ids[idx].getSlotIndex())->typeListIdx = idx;
+	}
+	ids.pop_back();
 }
 
 } // namespace gr
@@ -3,12 +3,18 @@
 #include "ResourcesHeader.h"
 
 #include <unordered_map>
+#include <string_view>
 #include <set>
+#include <array>
+#include <atomic>
 #include <shared_mutex>
 #include <memory>
 #include <iostream>
 
 #include "../utils/serialization.h"
+#include "../utils/grTools.h"
+
+#include "ObjectPool.h"
 
 #include "Mesh.h"
 #include "Texture.h"
@@ -32,16 +38,20 @@ class ResourceDictionary
 {
 public:
 
-	
-	static constexpr bool CONFIG_USE_DYNAMIC_CAST = true;
-
+	ResourceDictionary();
+	~ResourceDictionary();
 	ResourceDictionary& operator=(const ResourceDictionary&) = delete;
 
 	template<typename T>
-	ResId allocateObject(FrameContext* fc, std::string objectName, T** outPtr = nullptr);
+	ResId allocateObject(FrameContext* fc, std::string_view objectName, T** outPtr = nullptr);
 
+	// Lock free. The pointers returned are valid at least until
+	// the second call to flushDataAndFree after the object is erased
 	template<typename T>
 	void get(ResId id, T** object) const;
+	// Lock free. Returns nullptr if the object does not exist
+	template<typename T>
+	T* get(ResHandle<T> handle) const;
 
 	// erase will schedule destroy on the item
 	void erase(ResId id);
@@ -54,14 +64,19 @@ public:
 
 	void startAll(FrameContext* fc);
 
-	ResId getId(const std::string&  name) const;
-	std::string getName(const ResId id) const;
-	bool existsName(const std::string& name) const;
+	ResId getId(std::string_view name) const;
+	// The view is valid until the object is renamed or erased.
+	// It views a whole std::string, so it is null terminated
+	std::string_view getName(const ResId id) const;
+	bool existsName(std::string_view name) const;
+	// Lock free
 	bool exists(const ResId id) const;
-	void rename(ResId id, const std::string& newName);
+	void rename(ResId id, std::string_view newName);
 
+	// Copies the ids of the objects of type T, so that objects can be
+	// allocated or erased while they are visited
 	template <typename T>
-	std::vector<ResId> getAllObjectsOfType() const;
+	void getAllObjectsOfType(std::vector<ResId>* outIds) const;
 
 
 	void destroy(FrameContext* gc);
@@ -69,34 +84,146 @@ public:
 
 protected:
 
-	std::vector<ResId> mObjectsToFree;
-	std::unordered_map<ResId, std::unique_ptr<IObject>> mObjectsDictionary;
-	std::array<std::unordered_set<ResId>, ctools::length<ResourceTypesList>()> mObjectsByType;
+	// Generational slot map of the objects. Readers never lock: the chunks
+	// of slots are never moved or freed, and the id stored in a slot is
+	// checked after reading its object and type, to detect if the slot has been reused.
+	// Writers are serialized with mObjectsMutex.
+	struct Slot {
+		// ResId of the alive object, or invalid if the slot is free
+		std::atomic<uint64_t> id;
+		std::atomic<IObject*> object;
+		std::atomic<uint32_t> typeIdx;
+		// Only accessed by writers
+		uint32_t nextGeneration;
+		// position in mObjectsByType[typeIdx]
+		uint32_t typeListIdx;
+	};
+
+	static constexpr uint32_t SLOT_CHUNK_SIZE = 1024;
+	static constexpr uint32_t MAX_SLOT_CHUNKS = 4096;
+
+	std::array<std::atomic<Slot*>, MAX_SLOT_CHUNKS> mSlotChunks;
+	uint32_t mNumSlots = 0;
+	std::vector<uint32_t> mFreeSlots;
+	std::atomic<uint32_t> mNumObjects{ 0 };
+
+	// Erased objects are deleted after OBJECT_RECLAIM_EPOCHS calls to
+	// flushDataAndFree, to not free objects that readers may be using
+	static constexpr uint64_t OBJECT_RECLAIM_EPOCHS = 1;
+	uint64_t mEpoch = 0;
+	struct RetiredObject {
+		uint64_t epoch;
+		IObject* object;
+		uint32_t typeIdx;
+	};
+	std::vector<RetiredObject> mRetiredObjects;
+
+	// Objects of each type are allocated in its own pool
+	static constexpr size_t NUM_TYPES = ctools::length<ResourceTypesList>();
+	std::array<std::unique_ptr<IObjectPool>, NUM_TYPES> mPools;
 
-	std::unordered_map<std::string, ResId> mName2Id;
+	std::vector<ResId> mObjectsToFree;
+	std::array<std::vector<ResId>, NUM_TYPES> mObjectsByType;
 
-	ResId mLastIdUsed = ResId(1);
+	// The keys view the names stored in the objects, which never move
+	// in their pools. Thus looking up a name does not allocate
+	std::unordered_map<std::string_view, ResId> mName2Id;
+	// Next suffix to try for each base name when creating unique names
+	std::unordered_map<std::string, uint32_t> mNameCounters;
 
 	mutable std::mutex mEraseObjectMutex;
 	mutable std::shared_mutex mObjectsMutex;
-	mutable std::mutex mNextIdMutex;
 
 
-	ResId getAndUpdateId();
+	// Lock free. Returns nullptr if the id is not alive
+	IObject* findObject(ResId id, uint32_t* outTypeIdx) const;
+	template<typename T>
+	static T* castObject(IObject* object, uint32_t typeIdx);
+
+	// Functions of the slot map, they do not lock!
+	Slot* getSlot(uint32_t slotIdx) const;
+	Slot* createSlot(uint32_t slotIdx);
+	ResId insertObject(IObject* object, uint32_t typeIdx);
+	// Puts the object in the slot and generation of id
+	void insertObjectAt(ResId id, IObject* object, uint32_t typeIdx);
+	// Frees the slot and returns the object, or nullptr if it was not alive
+	IObject* removeObject(ResId id, uint32_t* outTypeIdx);
+	void retireObject(IObject* object, uint32_t typeIdx);
+	// Appends the id to mObjectsByType, or removes it moving the last id
+	void addToTypeList(ResId id, uint32_t typeIdx);
+	void removeFromTypeList(ResId id, uint32_t typeIdx);
+	// Erase the objects scheduled to free. Does not lock!
+	void freeErasedObjects(FrameContext* fc);
+
+	// Calls f(ResId, IObject*) for each alive object. Does not lock!
+	template<typename F>
+	void forEachObject(F&& f) const;
+
+	template<typename T>
+	ObjectPool<T>& getPool();
+
+	template<size_t ...Is>
+	static std::array<std::unique_ptr<IObjectPool>, NUM_TYPES> s_createPools(std::index_sequence<Is...>);
+
 	// Create new unique name from string. Does not lock!
-	std::string createUniqueName(const std::string& string);
+	std::string createUniqueName(std::string_view string);
 
 
 	// Serialization functions
+
+	// cereal only needs a pointer to save polymorphic objects
+	struct NonOwningObjectDeleter {
+		void operator()(IObject*) const {}
+	};
+
 	template<class Archive>
-	void serialize(Archive& archive)
+	void save(Archive& archive) const
 	{
 		std::shared_lock slock(mObjectsMutex);
 
-		archive(GR_SERIALIZE_NVP_MEMBER(mLastIdUsed));
-		archive(GR_SERIALIZE_NVP_MEMBER(mName2Id));
+		// same format as a map of owning pointers
+		std::unordered_map<ResId, std::unique_ptr<IObject, NonOwningObjectDeleter>> objectsDictionary;
+		std::unordered_map<std::string, ResId> name2Id;
+		forEachObject([&objectsDictionary, &name2Id](ResId id, IObject* object) {
+			objectsDictionary.emplace(id, object);
+			name2Id.emplace(object->getObjectName(), id);
+		});
+
+		archive(cereal::make_nvp("Name2Id", name2Id));
+		archive(GR_SERIALIZE_NVP_MEMBER(mObjectsByType));
+		archive(cereal::make_nvp("ObjectsDictionary", objectsDictionary));
+	}
+
+	template<class Archive>
+	void load(Archive& archive)
+	{
+		std::unique_lock lock(mObjectsMutex);
+		assert(mNumObjects == 0);
+
+		// the names are taken from the objects
+		std::unordered_map<std::string, ResId> name2Id;
+		std::unordered_map<ResId, std::unique_ptr<IObject>> objectsDictionary;
+		archive(cereal::make_nvp("Name2Id", name2Id));
 		archive(GR_SERIALIZE_NVP_MEMBER(mObjectsByType));
-		archive(GR_SERIALIZE_NVP_MEMBER(mObjectsDictionary));
+		archive(cereal::make_nvp("ObjectsDictionary", objectsDictionary));
+
+		for (uint32_t typeIdx = 0; typeIdx < static_cast<uint32_t>(NUM_TYPES); ++typeIdx) {
+			for (uint32_t i = 0; i < static_cast<uint32_t>(mObjectsByType[typeIdx].size()); ++i) {
+				const ResId id = mObjectsByType[typeIdx][i];
+				IObject* object = mPools[typeIdx]->adopt(std::move(objectsDictionary.at(id)));
+				insertObjectAt(id, object, typeIdx);
+				getSlot(id.getSlotIndex())->typeListIdx = i;
+				mName2Id.emplace(object->getObjectName(), id);
+			}
+		}
+
+		// rebuild the free list with the slots not loaded
+		mFreeSlots.clear();
+		for (uint32_t i = mNumSlots; i > 0; --i) {
+			if (!ResId(getSlot(i - 1)->id.load(std::memory_order_relaxed))) {
+				mFreeSlots.push_back(i - 1);
+			}
+		}
 	}
 
 	GR_SERIALIZE_PRIVATE_MEMBERS
@@ -105,47 +232,36 @@ protected:
 template<typename T>
 ResId ResourceDictionary::allocateObject(
 	FrameContext* fc,
-	std::string objectName,
+	std::string_view objectName,
 	T** outPtr)
 {
 	constexpr size_t typeIdx = ctools::indexOf<ResourceTypesList, T>();
 	static_assert(typeIdx != -1, "Type not added to Dictionary");
-	const ResId id = getAndUpdateId();
 
+	std::unique_lock lock(mObjectsMutex);
+
+	// Create object, and publish it to the readers once started
+	T* ptr = getPool<T>().create();
+	ptr->start(fc);
 
 	// check if the name is unique or create new
-	{
-		std::unique_lock lock(mObjectsMutex);
+	if (mName2Id.count(objectName) != 0) {
+		ptr->setObjectName(createUniqueName(objectName));
+	}
+	else {
+		ptr->setObjectName(objectName);
+	}
 
-		if (mName2Id.count(objectName) != 0) {
-			objectName = createUniqueName(objectName);
-		}
+	const ResId id = insertObject(ptr, static_cast<uint32_t>(typeIdx));
+	addToTypeList(id, static_cast<uint32_t>(typeIdx));
 
-		std::pair<decltype(mName2Id)::const_iterator, bool> itName =
-			mName2Id.emplace(std::move(objectName), id);
-		assert(itName.second);
-		// Create object and reference
-		std::pair<decltype(mObjectsDictionary)::iterator, bool> itObj =
-			mObjectsDictionary.emplace(id, std::unique_ptr<IObject>(new T()));
-		assert(itObj.second); // assert inserted
-		itObj.first->second->start(fc);
-
-		std::pair<std::unordered_set<ResId>::iterator, bool> itObjType =
-			mObjectsByType[typeIdx].insert(id);
-		assert(itObjType.second);
-
-		itObj.first->second->setObjectName(itName.first->first);
-
-		// return reference
-		if (outPtr != nullptr) {
-			if (CONFIG_USE_DYNAMIC_CAST) {
-				*outPtr = dynamic_cast<T*>(itObj.first->second.get());
-				assert(*outPtr != nullptr);
-			}
-			else {
-				*outPtr = reinterpret_cast<T*>(itObj.first->second.get());
-			}
-		}
+	std::pair<decltype(mName2Id)::const_iterator, bool> itName =
+		mName2Id.emplace(ptr->getObjectName(), id);
+	assert(itName.second);
+
+	// return reference
+	if (outPtr != nullptr) {
+		*outPtr = ptr;
 	}
 
 	return id;
@@ -155,34 +271,82 @@ template<typename T>
 void gr::ResourceDictionary::get(ResId id, T** object) const
 {
 	assert(object != nullptr);
-	std::shared_lock lock(mObjectsMutex);
 
-	IObject* ptr = mObjectsDictionary.at(id).get();
-	if (CONFIG_USE_DYNAMIC_CAST) {
-		*object = dynamic_cast<T*>(ptr);
-		assert(*object != nullptr);
+	uint32_t typeIdx;
+	IObject* ptr = findObject(id, &typeIdx);
+	if (ptr == nullptr) {
+		throw std::out_of_range("Object " + std::to_string(id) + " not in the dictionary");
+	}
+
+	*object = castObject<T>(ptr, typeIdx);
+	assert(*object != nullptr);
+}
+
+template<typename T>
+T* gr::ResourceDictionary::get(ResHandle<T> handle) const
+{
+	uint32_t typeIdx;
+	IObject* ptr = findObject(handle, &typeIdx);
+	if (ptr == nullptr) {
+		return nullptr;
+	}
+
+	return castObject<T>(ptr, typeIdx);
+}
+
+template<typename T>
+T* gr::ResourceDictionary::castObject(IObject* object, uint32_t typeIdx)
+{
+	if constexpr (std::is_same_v<T, IObject>) {
+		return object;
 	}
 	else {
-		*object = reinterpret_cast<T*>(ptr);
+		constexpr size_t expectedTypeIdx = ctools::indexOf<ResourceTypesList, T>();
+		static_assert(expectedTypeIdx != -1, "Type not added to Dictionary");
+
+		// the type is known from the slot, no need to dynamic_cast
+		assert(typeIdx == expectedTypeIdx);
+		return typeIdx == expectedTypeIdx ? static_cast<T*>(object) : nullptr;
+	}
+}
+
+template<typename F>
+void gr::ResourceDictionary::forEachObject(F&& f) const
+{
+	for (uint32_t i = 0; i < mNumSlots; ++i) {
+		const Slot* slot = getSlot(i);
+		const ResId id(slot->id.load(std::memory_order_relaxed));
+		if (id) {
+			f(id, slot->object.load(std::memory_order_relaxed));
+		}
 	}
 }
 
 
 template<typename T>
-std::vector<gr::ResId> 
-gr::ResourceDictionary::getAllObjectsOfType() const
+void gr::ResourceDictionary::getAllObjectsOfType(std::vector<ResId>* outIds) const
 {
 	constexpr size_t typeIdx = ctools::indexOf<ResourceTypesList, T>();
 	static_assert(typeIdx != -1, "Type not added to Dictionary");
 	std::shared_lock lock(mObjectsMutex);
 
-	std::vector<ResId> res;
-	res.reserve(mObjectsByType[typeIdx].size());
-	for (const ResId& id : mObjectsByType[typeIdx]) {
-		res.push_back(id);
-	}
+	const std::vector<ResId>& ids = mObjectsByType[typeIdx];
+	outIds->assign(ids.begin(), ids.end());
+}
+
+template<typename T>
+gr::ObjectPool<T>& gr::ResourceDictionary::getPool()
+{
+	constexpr size_t typeIdx = ctools::indexOf<ResourceTypesList, T>();
+	static_assert(typeIdx != -1, "Type not added to Dictionary");
+	return *static_cast<ObjectPool<T>*>(mPools[typeIdx].get());
+}
 
-	return res;
+template<size_t ...Is>
+std::array<std::unique_ptr<gr::IObjectPool>, gr::ResourceDictionary::NUM_TYPES>
+gr::ResourceDictionary::s_createPools(std::index_sequence<Is...>)
+{
+	return { std::make_unique<ObjectPool<typename ctools::TypeAt<ResourceTypesList, Is>::type>>()... };
 }
 
 } // namespace gr
@@ -0,0 +1,37 @@
+#include "ResourceLoader.h"
+
+#include "IObject.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace gr
+{
+
+void ResourceLoader::push(IObject* object)
+{
+	assert(object != nullptr);
+	if (std::find(mObjects.begin(), mObjects.end(), object) == mObjects.end()) {
+		mObjects.push_back(object);
+	}
+}
+
+void ResourceLoader::remove(IObject* object)
+{
+	std::vector<IObject*>::iterator it = std::find(mObjects.begin(), mObjects.end(), object);
+	if (it != mObjects.end()) {
+		mObjects.erase(it);
+	}
+}
+
+void ResourceLoader::update(FrameContext* fc)
+{
+	// updateLoad can not push or remove objects
+	std::vector<IObject*>::iterator it = std::remove_if(mObjects.begin(), mObjects.end(),
+		[fc](IObject* object) {
+			return object->updateLoad(fc);
+		});
+	mObjects.erase(it, mObjects.end());
+}
+
+} // namespace gr
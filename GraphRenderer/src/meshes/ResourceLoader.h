@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+namespace gr
+{
+
+class FrameContext;
+class IObject;
+
+// Objects of the ResourceDictionary that are loading in the background.
+// Each frame, the main thread calls IObject::updateLoad on them, to upload
+// the data prepared by their jobs, until they finish loading.
+// Not thread safe, only used from the main thread.
+class ResourceLoader
+{
+public:
+
+	ResourceLoader() = default;
+	ResourceLoader(const ResourceLoader&) = delete;
+	ResourceLoader& operator=(const ResourceLoader&) = delete;
+
+	// The object is updated every frame until it finishes loading
+	void push(IObject* object);
+	// Stops updating the object, i.e. if it is destroyed while loading
+	void remove(IObject* object);
+
+	// Called once per frame, before the scene is updated,
+	// so that the uploads are flushed in the same frame
+	void update(FrameContext* fc);
+
+	uint32_t getNumLoading() const { return static_cast<uint32_t>(mObjects.size()); }
+
+private:
+	std::vector<IObject*> mObjects;
+};
+
+} // namespace gr
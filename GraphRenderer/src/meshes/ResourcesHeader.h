@@ -55,6 +55,20 @@ struct ResId {
 		this->value = std::numeric_limits<uint64_t>::max();
 	}
 
+	// The id is a handle to a slot of the ResourceDictionary. The low 32 bits
+	// are the index of the slot, and the high 32 bits the generation of the slot
+	uint32_t getSlotIndex() const {
+		return static_cast<uint32_t>(this->value);
+	}
+
+	uint32_t getGeneration() const {
+		return static_cast<uint32_t>(this->value >> 32);
+	}
+
+	static ResId fromSlot(uint32_t index, uint32_t generation) {
+		return ResId((static_cast<uint64_t>(generation) << 32) | index);
+	}
+
 	// serialization
 	template <class Archive>
 	uint64_t save_minimal(
@@ -71,6 +85,15 @@ struct ResId {
 	}
 };
 
+// ResId of an object of type T, so that the dictionary can return
+// the object without having to cast it
+template<typename T>
+struct ResHandle : public ResId {
+
+	ResHandle() = default;
+	explicit ResHandle(ResId id) : ResId(id) {}
+};
+
 }
 
 namespace std
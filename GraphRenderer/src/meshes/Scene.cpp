@@ -8,9 +8,11 @@
 #include "GameObjectAddons/SimplePlayerControl.h"
 #include "../control/FrameContext.h"
 #include "../utils/grjob.h"
+#include "../utils/JobGraph.h"
 #include "../gui/Gui.h"
 
 
+
 namespace gr
 {
 Scene::Scene()
@@ -77,7 +79,8 @@ void Scene::renderImGui(FrameContext* fc, Gui* gui)
 		if (fc->gc().getDict().exists(id)) {
 
 			ImGui::PushID((void*)std::hash<ResId>()(id));
-			if (ImGui::Button(fc->gc().getDict().getName(id).c_str())) {
+			// the name views a whole string, thus is null terminated
+			if (ImGui::Button(fc->gc().getDict().getName(id).data())) {
 				gui->selectResourceInspector( id );
 			}
 
@@ -114,48 +117,64 @@ void Scene::renderImGui(FrameContext* fc, Gui* gui)
 
 void Scene::graphicsUpdate(FrameContext* fc)
 {
-	std::vector<grjob::Job> jobs;
-	jobs.reserve(mGameObjects.size() + 1);
-
-	const SceneRenderContext src = { mUiCameraGameObj.get()->getAddon<addon::Camera>() };
+	using namespace addon;
+
+	const uint64_t stamp = markActiveEntities(fc);
+	AddonStorage& storage = fc->gc().getAddonStorage();
+
+	const Camera* camera = mUiCameraGameObj.get()->getAddon<Camera>();
+	const Transform* cameraTransform = mUiCameraGameObj.get()->getAddon<Transform>();
+	const SceneRenderContext src = {
+		cameraTransform->getPos(),
+		camera->getProjection() * Camera::s_computeView(*cameraTransform),
+		camera->getProjectionScale() };
+
+	// Only addons that implement updateBeforeRender need a system.
+	// Cameras and renderables do not conflict, so they run concurrently
+	grjob::JobGraph graph;
+	storage.addGraphicsSystem<Camera>(&graph, fc, src, stamp,
+		addonMask<Camera, Transform>(),		// reads
+		addonMask<Camera>());				// writes
+	storage.addGraphicsSystem<Renderable>(&graph, fc, src, stamp,
+		addonMask<Renderable, Transform>(),	// reads
+		addonMask<Renderable>());			// writes
+
+	graph.run(grjob::Priority::eMid);
+}
 
-	if (mUiCameraGameObj) {
-		jobs.push_back(grjob::Job(&GameObject::graphicsUpdate, mUiCameraGameObj.get(), fc, src));
-	}
-	
-	for (ResId id : mGameObjects) {
-		GameObject* obj;
-		fc->gc().getDict().get(id, &obj);
+void Scene::logicUpdate(FrameContext* fc)
+{
+	using namespace addon;
 
-		jobs.push_back(grjob::Job(&GameObject::graphicsUpdate, obj, fc, src));
-	}
+	const uint64_t stamp = markActiveEntities(fc);
+	AddonStorage& storage = fc->gc().getAddonStorage();
 
+	// Only addons that implement update need a system
+	grjob::JobGraph graph;
+	storage.addLogicSystem<SimplePlayerControl>(&graph, fc, stamp,
+		addonMask<SimplePlayerControl, Transform>(),	// reads
+		addonMask<SimplePlayerControl, Transform>());	// writes
 
-	grjob::Counter* c = nullptr;
-	grjob::runJobBatch(grjob::Priority::eMid, jobs.data(), (uint32_t)jobs.size(), &c);
-	grjob::waitForCounterAndFree(c, 0);
+	graph.run(grjob::Priority::eMid);
 }
 
-void Scene::logicUpdate(FrameContext* fc)
+uint64_t Scene::markActiveEntities(FrameContext* fc)
 {
-	std::vector<grjob::Job> jobs;
-	jobs.reserve(mGameObjects.size() + 1);
+	addon::AddonStorage& storage = fc->gc().getAddonStorage();
+	const uint64_t stamp = fc->getFrameCount();
 
 	if (mUiCameraGameObj) {
-		jobs.push_back(grjob::Job(&GameObject::logicUpdate, mUiCameraGameObj.get(), fc));
+		storage.markActive(mUiCameraGameObj->getEntity(), stamp);
 	}
 
 	for (ResId id : mGameObjects) {
 		GameObject* obj;
 		fc->gc().getDict().get(id, &obj);
 
-		jobs.push_back(grjob::Job(&GameObject::logicUpdate, obj, fc));
+		storage.markActive(obj->getEntity(), stamp);
 	}
 
-
-	grjob::Counter* c = nullptr;
-	grjob::runJobBatch(grjob::Priority::eMid, jobs.data(), (uint32_t)jobs.size(), &c);
-	grjob::waitForCounterAndFree(c, 0);
+	return stamp;
 }
 
 void Scene::start(FrameContext* fc)
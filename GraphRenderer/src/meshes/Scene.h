@@ -37,6 +37,10 @@ private:
 
     std::set<ResId> mGameObjects;
 
+    // Marks the entities of the scene as active in the AddonStorage.
+    // Returns the stamp used
+    uint64_t markActiveEntities(FrameContext* fc);
+
     // Serialization functions
     template<class Archive>
     void serialize(Archive& archive)
@@ -51,7 +55,12 @@ private:
 };
 
 struct SceneRenderContext {
-    const addon::Camera* camera;
+    // World position of the camera
+    glm::vec3 cameraPosition;
+    glm::mat4 viewProjection;
+    // Camera::getProjectionScale, 0 if there is no camera. Copied so that
+    // the systems do not read the camera addon
+    float projectionScale;
 };
 
 } // namespace gr
@@ -2,44 +2,135 @@
 
 #include <imgui/imgui.h>
 #include <filesystem>
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
 
 #include "../control/FrameContext.h"
 #include "../graphics/RenderContext.h"
 #include "../utils/grTools.h"
+#include "../utils/grjob.h"
+#include "TextureProcessing/TextureCache.h"
+#include "TextureProcessing/ImageDecoder.h"
 
 namespace gr
 {
 
+namespace
+{
 
+// The mips up to this size are always resident, and loaded first
+constexpr uint32_t MIP_TAIL_SIZE = 128;
 
-bool Texture::load(FrameContext* fc, const char* filePath)
+const char* getQualityName(tex::CompressionQuality quality)
 {
+	switch (quality) {
+	case tex::CompressionQuality::eFast: return "Fast";
+	case tex::CompressionQuality::eHigh: return "High";
+	default: return "Unknown";
+	}
+}
 
-	std::filesystem::path path(filePath);
-	mPath = std::filesystem::relative(path, fc->gc().getProjectPath()).string();
+tex::BlockFormat getBlockFormat(Texture::Compression compression)
+{
+	switch (compression) {
+	case Texture::Compression::eBC1: return tex::BlockFormat::eBC1;
+	case Texture::Compression::eBC5: return tex::BlockFormat::eBC5;
+	case Texture::Compression::eBC7: return tex::BlockFormat::eBC7;
+	default:
+		throw std::logic_error("Error: the texture is not compressed");
+	}
+}
 
-	vkg::RenderContext* rc = &fc->rc();
+vk::Format getVkFormat(Texture::Compression compression)
+{
+	switch (compression) {
+	case Texture::Compression::eBC1: return vk::Format::eBc1RgbSrgbBlock;
+	case Texture::Compression::eBC5: return vk::Format::eBc5UnormBlock;
+	case Texture::Compression::eBC7: return vk::Format::eBc7SrgbBlock;
+	default: return vk::Format::eR8G8B8A8Srgb;
+	}
+}
+
+vk::Format getVkFormat(tex::PixelFormat format)
+{
+	switch (format) {
+	case tex::PixelFormat::eRGBA16: return vk::Format::eR16G16B16A16Unorm;
+	case tex::PixelFormat::eRGBA16F: return vk::Format::eR16G16B16A16Sfloat;
+	default: return vk::Format::eR8G8B8A8Srgb;
+	}
+}
 
-	uint32_t width, height;
+// Encodes all the mip levels of the image, the mips are downsampled before
+// encoding. Returns false if the image can't be read. If cancelled is set
+// while encoding, the levels are left incomplete
+bool encodeImage(const std::filesystem::path& path,
+	tex::BlockFormat format, tex::CompressionQuality quality,
+	const std::atomic<bool>& cancelled,
+	uint32_t* outWidth, uint32_t* outHeight,
+	std::vector<std::vector<uint8_t>>* outLevels)
+{
 	uint8_t* img;
-	tools::loadImageRGBA(mPath.c_str(), &img, &width, &height);
+	tools::loadImageRGBA(path.string().c_str(), &img, outWidth, outHeight);
 	if (img == nullptr) {
 		return false;
 	}
 
-	vk::DeviceSize imSize = 4 * width * height;
+	// BC5 holds linear data
+	const bool srgb = format != tex::BlockFormat::eBC5;
+	const uint32_t numLevels = vkg::RenderContext::computeMipLevels(
+		vk::Extent2D(*outWidth, *outHeight));
+	outLevels->resize(numLevels);
 
-	mImage2d = rc->createTexture2D(
-		{ static_cast<vk::DeviceSize>(width),
-			static_cast<vk::DeviceSize>(height) }, // extent
-		1, vk::SampleCountFlagBits::e1, // mip levels and samples
-		vk::Format::eR8G8B8A8Srgb,
-		vk::ImageAspectFlagBits::eColor
-	);
+	uint32_t width = *outWidth;
+	uint32_t height = *outHeight;
+	std::vector<uint8_t> level;
+	std::vector<uint8_t> nextLevel;
+	for (uint32_t mip = 0; mip < numLevels && !cancelled.load(std::memory_order_relaxed); ++mip) {
+		const uint8_t* pixels = mip == 0 ? img : level.data();
+		std::vector<uint8_t>& blocks = (*outLevels)[mip];
+		blocks.resize(tex::getCompressedSize(format, width, height));
+		tex::compressImageParallel(pixels, width, height, format, quality, blocks.data(), &cancelled);
+
+		if (mip + 1 < numLevels) {
+			tools::downsampleImageRGBA(pixels, width, height, srgb, &nextLevel);
+			level.swap(nextLevel);
+			width = std::max(width / 2, 1u);
+			height = std::max(height / 2, 1u);
+		}
+	}
 
-	rc->getTransferer()->transferToImage(
-		*rc, img,	// rc and data ptr
-		imSize, mImage2d,		// bytes, Image2D
+	tools::freeImage(img);
+	return true;
+}
+
+// Uploads the levels to all the mips of the image. The small mips are copied to
+// the staging memory now, and the first level, most of the data, is streamed
+// after them. The owner of the data is kept until the stream finishes or is cancelled
+vkg::BufferTransferer::StreamId uploadMipLevels(vkg::RenderContext* rc, const vkg::Image2D& image,
+	const uint8_t* const* levelData, const vk::DeviceSize* levelBytes,
+	std::shared_ptr<void> owner, std::shared_ptr<bool> resident)
+{
+	for (uint32_t mip = 1; mip < image.getMipLevels(); ++mip) {
+		rc->getTransferer()->transferToImage(
+			*rc, levelData[mip],
+			levelBytes[mip], image,
+			vk::ImageSubresourceLayers(
+				vk::ImageAspectFlagBits::eColor,
+				mip, 0, 1 // mip level, base array, layer count
+			),
+			vk::AccessFlagBits::eShaderRead, // dst Access Mask
+			vk::ImageLayout::eShaderReadOnlyOptimal, // dst Image Layout
+			vk::PipelineStageFlagBits::eFragmentShader, // dstStage
+			true
+		);
+	}
+
+	return rc->getTransferer()->streamToImage(
+		*rc, levelData[0],	// rc and data ptr
+		levelBytes[0], image,		// bytes, Image2D
 		vk::ImageSubresourceLayers(
 			vk::ImageAspectFlagBits::eColor,
 			0, 0, 1 // mip level, base array, layer count
@@ -47,16 +138,491 @@ bool Texture::load(FrameContext* fc, const char* filePath)
 		vk::AccessFlagBits::eShaderRead, // dst Access Mask
 		vk::ImageLayout::eShaderReadOnlyOptimal, // dst Image Layout
 		vk::PipelineStageFlagBits::eFragmentShader, // dstStage
-		true
+		true, false,
+		[owner, resident]() { *resident = true; }
 	);
+}
+
+} // namespace
+
+
+struct Texture::LoadJob {
+	std::atomic<LoadStage> stage{ LoadStage::eQueued };
+	std::atomic<bool> cancelled{ false };
+	grjob::Counter* counter = nullptr;
+
+	vkg::RenderContext* rc = nullptr;
+	std::filesystem::path absolutePath;
+	std::filesystem::path cachePath;
+	// Copied, the options of the texture can change while loading
+	Compression compression = Compression::eNone;
+	tex::CompressionQuality quality = tex::CompressionQuality::eFast;
+	std::string error;
+
+	// Set by the callback of the last transfer, that may outlive the job
+	std::shared_ptr<bool> resident = std::make_shared<bool>(false);
+	bool streamed = false;
+	vkg::BufferTransferer::StreamId stream = 0;
+};
+
+void Texture::load(FrameContext* fc, const char* filePath)
+{
+	// discard the previous image, and any load in progress
+	scheduleDestroy(fc);
+
+	std::filesystem::path path(filePath);
+	if (path.is_absolute()) {
+		path = std::filesystem::relative(path, fc->gc().getProjectPath());
+	}
+	mPath = path.string();
+
+	mLoadJob = std::make_shared<LoadJob>();
+	mLoadJob->rc = &fc->rc();
+	mLoadJob->absolutePath = fc->gc().getProjectPath() / path;
+	if (mCompression != Compression::eNone && fc->rc().isTextureCompressionBCEnabled()) {
+		mLoadJob->compression = mCompression;
+		mLoadJob->quality = mQuality;
+		mLoadJob->cachePath = tex::getTextureCachePath(
+			fc->gc().getProjectPath(), path, getBlockFormat(mCompression));
+	}
+	mLoadError.clear();
+
+	// Many images are decoded concurrently. The decoders use large structs in the stack
+	grjob::runJob(grjob::Priority::eLow, grjob::Job(&Texture::runLoadJob, this),
+		&mLoadJob->counter, true);
+
+	fc->gc().getLoader().push(this);
+}
+
+void Texture::runLoadJob()
+{
+	LoadJob& job = *mLoadJob;
+
+	try {
+		const bool loaded = job.compression != Compression::eNone ?
+			loadCompressed(job) : loadUncompressed(job);
+		if (!loaded) {
+			throw std::runtime_error("Error: Can't read the image " + job.absolutePath.string());
+		}
+	}
+	catch (const std::exception& e) {
+		job.error = e.what();
+		job.stage.store(LoadStage::eFailed, std::memory_order_release);
+		return;
+	}
+
+	// publish the members to the main thread
+	job.stage.store(LoadStage::eUploading, std::memory_order_release);
+}
+
+bool Texture::updateLoad(FrameContext* fc)
+{
+	assert(mLoadJob);
+	LoadJob& job = *mLoadJob;
+
+	const LoadStage stage = job.stage.load(std::memory_order_acquire);
+	if (stage != LoadStage::eUploading && stage != LoadStage::eFailed) {
+		return false;
+	}
+
+	// The job has finished, or is about to
+	if (job.counter != nullptr) {
+		grjob::waitForCounterAndFree(job.counter, 0);
+		job.counter = nullptr;
+	}
+
+	if (stage == LoadStage::eFailed) {
+		std::cerr << "Error: texture " << mPath << " not loaded. " << job.error << std::endl;
+		mLoadError = job.error;
+		fc->scheduleToDestroy(mImage2d);
+		mImage2d = vkg::Image2D();
+		mLoadJob.reset();
+		mLoadStage = LoadStage::eFailed;
+		return true;
+	}
+
+	if (!*job.resident) {
+		return false;
+	}
+
+	mLoadJob.reset();
+	mLoadStage = LoadStage::eReady;
+	return true;
+}
+
+void Texture::cancelLoad(FrameContext* fc)
+{
+	if (!mLoadJob) {
+		return;
+	}
+
+	fc->gc().getLoader().remove(this);
+
+	// the job writes the members of the texture
+	mLoadJob->cancelled.store(true, std::memory_order_relaxed);
+	if (mLoadJob->counter != nullptr) {
+		grjob::waitForCounterAndFree(mLoadJob->counter, 0);
+		mLoadJob->counter = nullptr;
+	}
+	// the stream reads the data owned by its callback, until cancelled
+	if (mLoadJob->streamed && !*mLoadJob->resident) {
+		fc->rc().getTransferer()->cancelStream(mLoadJob->stream);
+	}
+
+	mLoadJob.reset();
+	mLoadStage = LoadStage::eNone;
+}
+
+Texture::LoadStage Texture::getLoadStage() const
+{
+	return mLoadJob ? mLoadJob->stage.load(std::memory_order_relaxed) : mLoadStage;
+}
+
+const char* Texture::s_getLoadStageName(LoadStage stage)
+{
+	switch (stage)
+	{
+	case LoadStage::eNone: return "Not loaded";
+	case LoadStage::eQueued: return "Queued";
+	case LoadStage::eDecoding: return "Decoding";
+	case LoadStage::eEncoding: return "Encoding";
+	case LoadStage::eUploading: return "Uploading";
+	case LoadStage::eReady: return "Ready";
+	case LoadStage::eFailed: return "Failed";
+	default: return "Unknown";
+	}
+}
+
+const char* Texture::s_getCompressionName(Compression compression)
+{
+	switch (compression) {
+	case Compression::eNone: return "None (RGBA8)";
+	case Compression::eBC1: return "BC1 (color)";
+	case Compression::eBC5: return "BC5 (normal map)";
+	case Compression::eBC7: return "BC7 (color and alpha)";
+	default: return "Unknown";
+	}
+}
+
+bool Texture::loadCompressed(LoadJob& job)
+{
+	vkg::RenderContext* rc = job.rc;
+
+	const tex::BlockFormat blockFormat = getBlockFormat(job.compression);
+
+	// The levels are read from the mapped cache, or from the encoded data,
+	// that are kept until the stream of the first level finishes
+	std::shared_ptr<tex::TextureCacheReader> cache = std::make_shared<tex::TextureCacheReader>();
+	std::shared_ptr<std::vector<std::vector<uint8_t>>> encoded;
+	uint32_t width, height, numLevels;
+
+	mLoadedFromCache = cache->open(job.cachePath, job.absolutePath, blockFormat, job.quality);
+	if (mLoadedFromCache) {
+		width = cache->getHeader().width;
+		height = cache->getHeader().height;
+		numLevels = cache->getHeader().numLevels;
+	}
+	else {
+		job.stage.store(LoadStage::eEncoding, std::memory_order_relaxed);
+		encoded = std::make_shared<std::vector<std::vector<uint8_t>>>();
+		if (!encodeImage(job.absolutePath, blockFormat, job.quality, job.cancelled,
+			&width, &height, encoded.get())) {
+			return false;
+		}
+		// the levels are incomplete
+		if (job.cancelled.load(std::memory_order_relaxed)) {
+			return true;
+		}
+		numLevels = static_cast<uint32_t>(encoded->size());
+
+		tex::TextureCacheHeader header;
+		tex::getSourceInfo(job.absolutePath, &header);
+		header.format = blockFormat;
+		header.quality = job.quality;
+		header.width = width;
+		header.height = height;
+		header.flags = job.compression != Compression::eBC5 ? tex::TextureCacheHeader::FLAG_SRGB : 0;
+		// the texture can be used without the cache
+		try {
+			tex::writeTextureCache(job.cachePath, header, *encoded);
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+		}
+	}
+	if (job.cancelled.load(std::memory_order_relaxed)) {
+		return true;
+	}
+
+	// The encoded levels are streamed from the cache too, if it can be mapped
+	if (!mLoadedFromCache && cache->open(job.cachePath, job.absolutePath, blockFormat, job.quality)) {
+		encoded.reset();
+	}
+	const bool streamable = encoded == nullptr;
+
+	std::vector<const uint8_t*> data(numLevels);
+	std::vector<vk::DeviceSize> bytes(numLevels);
+	for (uint32_t mip = 0; mip < numLevels; ++mip) {
+		data[mip] = streamable ? cache->getLevelData(mip) : (*encoded)[mip].data();
+		bytes[mip] = streamable ? cache->getLevelBytes(mip) : (*encoded)[mip].size();
+	}
+
+	mFullExtent = vk::Extent2D(width, height);
+	mNumMips = numLevels;
+	mMipTail = 0;
+	if (streamable) {
+		// Only the mip tail is loaded, the bigger mips are streamed when used
+		while (mMipTail + 1 < mNumMips &&
+			std::max(getMipExtent(mMipTail).width, getMipExtent(mMipTail).height) > MIP_TAIL_SIZE) {
+			mMipTail += 1;
+		}
+		mCache = cache;
+	}
+	mResidentMip = mMipTail;
+	mRequestedMip = mMipTail;
+
+	mLoadedFormat = getVkFormat(job.compression);
+	mImage2d = rc->createTexture2D(
+		getMipExtent(mResidentMip), // extent
+		numLevels - mResidentMip, vk::SampleCountFlagBits::e1, // mip levels and samples
+		mLoadedFormat,
+		vk::ImageAspectFlagBits::eColor
+	);
+
+	std::shared_ptr<void> owner = streamable ?
+		std::shared_ptr<void>(cache) : std::shared_ptr<void>(encoded);
+	job.stream = uploadMipLevels(rc, mImage2d, data.data() + mResidentMip,
+		bytes.data() + mResidentMip, std::move(owner), job.resident);
+	job.streamed = true;
+
+	return true;
+}
+
+vk::Extent2D Texture::getMipExtent(uint32_t mip) const
+{
+	return vk::Extent2D(std::max(mFullExtent.width >> mip, 1u),
+		std::max(mFullExtent.height >> mip, 1u));
+}
+
+vk::DeviceSize Texture::getMipChainBytes(uint32_t mip) const
+{
+	assert(mCache);
+	vk::DeviceSize bytes = 0;
+	for (; mip < mNumMips; ++mip) {
+		bytes += mCache->getLevelBytes(mip);
+	}
+	return bytes;
+}
+
+vk::DeviceSize Texture::getDeviceMemorySize(const vkg::RenderContext& rc) const
+{
+	// the image is created by the load job
+	vk::DeviceSize bytes = 0;
+	if (isResident() && mImage2d) {
+		bytes += rc.getAllocationSize(mImage2d);
+	}
+	if (isStreaming()) {
+		bytes += rc.getAllocationSize(mMipStream.image);
+	}
+	return bytes;
+}
+
+void Texture::requestScreenSize(float screenPixels, uint64_t frame)
+{
+	if (!isStreamable()) {
+		return;
+	}
+
+	// About a texel per pixel
+	uint32_t mip = mMipTail;
+	if (screenPixels > 0.0f) {
+		const float texels = static_cast<float>(std::max(mFullExtent.width, mFullExtent.height));
+		const float lod = std::floor(std::log2(texels / screenPixels));
+		mip = static_cast<uint32_t>(std::clamp(lod, 0.0f, static_cast<float>(mMipTail)));
+	}
+
+	// The biggest one of the frame
+	mRequestedMip = mLastUsedFrame == frame ? std::min(mRequestedMip, mip) : mip;
+	mLastUsedFrame = frame;
+}
+
+void Texture::streamMip(FrameContext* fc, uint32_t mip)
+{
+	assert(isStreamable() && !isStreaming());
+	assert(mip < mNumMips && mip != mResidentMip);
+	vkg::RenderContext* rc = &fc->rc();
+
+	mMipStream.image = rc->createTexture2D(
+		getMipExtent(mip), // extent
+		mNumMips - mip, vk::SampleCountFlagBits::e1, // mip levels and samples
+		mLoadedFormat,
+		vk::ImageAspectFlagBits::eColor
+	);
+	mMipStream.mip = mip;
+	mMipStream.resident = std::make_shared<bool>(false);
+
+	std::vector<const uint8_t*> data(mNumMips - mip);
+	std::vector<vk::DeviceSize> bytes(mNumMips - mip);
+	for (uint32_t i = mip; i < mNumMips; ++i) {
+		data[i - mip] = mCache->getLevelData(i);
+		bytes[i - mip] = mCache->getLevelBytes(i);
+	}
+	mMipStream.stream = uploadMipLevels(rc, mMipStream.image, data.data(), bytes.data(),
+		mCache, mMipStream.resident);
+}
+
+void Texture::updateStreaming(FrameContext* fc)
+{
+	if (!isStreaming() || !*mMipStream.resident) {
+		return;
+	}
+
+	// the old image may be in use by the frames in flight
+	fc->scheduleToDestroy(mImage2d);
+	mImage2d = mMipStream.image;
+	mResidentMip = mMipStream.mip;
+	mMipStream = MipStream();
+}
+
+void Texture::cancelMipStream(FrameContext* fc)
+{
+	if (!isStreaming()) {
+		return;
+	}
+
+	if (!*mMipStream.resident) {
+		fc->rc().getTransferer()->cancelStream(mMipStream.stream);
+	}
+	fc->scheduleToDestroy(mMipStream.image);
+	mMipStream = MipStream();
+}
+
+bool Texture::loadUncompressed(LoadJob& job)
+{
+	vkg::RenderContext* rc = job.rc;
+	vkg::BufferTransferer* transferer = rc->getTransferer();
+
+	job.stage.store(LoadStage::eDecoding, std::memory_order_relaxed);
+	tex::ImageDecoder decoder;
+	if (!decoder.open(job.absolutePath)) {
+		return false;
+	}
+	if (job.cancelled.load(std::memory_order_relaxed)) {
+		return true;
+	}
+
+	const tex::ImageInfo& info = decoder.getInfo();
+	const vk::Format format = getVkFormat(info.format);
+	const vk::Extent2D extent(info.width, info.height);
+
+	// The mips are blitted in the graphics queue if the format supports it,
+	// if not the 8 bit images are downsampled here, and the others have no mips
+	const bool blitMips = rc->isLinearBlitSupported(format);
+	const bool downsampleMips = !blitMips && info.format == tex::PixelFormat::eRGBA8;
+	const uint32_t mipLevels = blitMips || downsampleMips ?
+		vkg::RenderContext::computeMipLevels(extent) : 1;
+
+	mLoadedFormat = format;
+	mFullExtent = extent;
+	mNumMips = mipLevels;
+	mMipTail = 0;
+	mResidentMip = 0;
+	mRequestedMip = 0;
+	mImage2d = rc->createTexture2D(
+		extent, // extent
+		mipLevels, vk::SampleCountFlagBits::e1, // mip levels and samples
+		format,
+		vk::ImageAspectFlagBits::eColor
+	);
+
+	const vk::ImageSubresourceLayers firstLevel(
+		vk::ImageAspectFlagBits::eColor,
+		0, 0, 1 // mip level, base array, layer count
+	);
+	std::shared_ptr<bool> resident = job.resident;
+
+	if (!downsampleMips) {
+		// Decoded in place, the staging memory is not read back
+		vkg::BufferTransferer::StagingReservation staging;
+		transferer->reserveStaging(*rc, decoder.getDecodedSize(), &staging);
+		try {
+			decoder.decode(staging.getData());
+		}
+		catch (const std::exception&) {
+			transferer->cancelReservation(std::move(staging));
+			throw;
+		}
+
+		transferer->transferReservedToImage(
+			std::move(staging), mImage2d, firstLevel,
+			vk::AccessFlagBits::eShaderRead, // dst Access Mask
+			vk::ImageLayout::eShaderReadOnlyOptimal, // dst Image Layout
+			vk::PipelineStageFlagBits::eFragmentShader, // dstStage
+			true, blitMips,
+			[resident]() { *resident = true; }
+		);
+		return true;
+	}
+
+	// The mips are downsampled from the decoded image, and uploaded before the first level
+	std::shared_ptr<std::vector<uint8_t>> pixels = std::make_shared<std::vector<uint8_t>>(
+		decoder.getDecodedSize());
+	decoder.decode(pixels->data());
+
+	std::vector<uint8_t> level;
+	std::vector<uint8_t> prevLevel;
+	for (uint32_t mip = 1; mip < mipLevels; ++mip) {
+		const vk::Extent2D prevExtent = mImage2d.getMipExtent(mip - 1);
+		tools::downsampleImageRGBA(mip == 1 ? pixels->data() : prevLevel.data(),
+			prevExtent.width, prevExtent.height, true, &level);
+		transferer->transferToImage(
+			*rc, level.data(),
+			level.size(), mImage2d,
+			vk::ImageSubresourceLayers(
+				vk::ImageAspectFlagBits::eColor,
+				mip, 0, 1 // mip level, base array, layer count
+			),
+			vk::AccessFlagBits::eShaderRead, // dst Access Mask
+			vk::ImageLayout::eShaderReadOnlyOptimal, // dst Image Layout
+			vk::PipelineStageFlagBits::eFragmentShader, // dstStage
+			true
+		);
+		level.swap(prevLevel);
+	}
+
+	// The pixels are freed with the callback, once resident or cancelled
+	job.stream = transferer->streamToImage(
+		*rc, pixels->data(),	// rc and data ptr
+		pixels->size(), mImage2d,		// bytes, Image2D
+		firstLevel,
+		vk::AccessFlagBits::eShaderRead, // dst Access Mask
+		vk::ImageLayout::eShaderReadOnlyOptimal, // dst Image Layout
+		vk::PipelineStageFlagBits::eFragmentShader, // dstStage
+		true, false,
+		[pixels, resident]() { *resident = true; }
+	);
+	job.streamed = true;
 
-	tools::freeImage(img);
 	return true;
 }
 
 void Texture::scheduleDestroy(FrameContext* fc)
 {
+	cancelLoad(fc);
+	cancelMipStream(fc);
 	fc->scheduleToDestroy(mImage2d);
+	mImage2d = vkg::Image2D();
+	mCache.reset();
+	mLoadStage = LoadStage::eNone;
+}
+
+void Texture::start(FrameContext* fc)
+{
+	// the images are not saved with the project
+	if (!mPath.empty()) {
+		const std::string path = mPath;
+		this->load(fc, path.c_str());
+	}
 }
 
 
@@ -65,7 +631,65 @@ void Texture::renderImGui(FrameContext* fc, Gui* gui)
 	ImGui::TextDisabled("Texture 2D");
 	ImGui::Separator();
 
-	ImGui::Text("Image size: %u x %u", mImage2d.getExtent().width, mImage2d.getExtent().height);
+	// The members are written by the load job until it finishes
+	const LoadStage stage = getLoadStage();
+	if (stage == LoadStage::eReady) {
+		ImGui::Text("Image size: %u x %u", mFullExtent.width, mFullExtent.height);
+		ImGui::Text("Mip levels: %u", mNumMips);
+		if (mCache) {
+			const vk::Extent2D extent = getMipExtent(mResidentMip);
+			ImGui::Text("Resident from mip %u (%u x %u)", mResidentMip, extent.width, extent.height);
+			if (isStreaming()) {
+				ImGui::SameLine();
+				ImGui::TextDisabled("streaming mip %u", mMipStream.mip);
+			}
+		}
+		ImGui::Text("Format: %s", vk::to_string(mLoadedFormat).c_str());
+		if (mImage2d.isBlockCompressed()) {
+			ImGui::Text(mLoadedFromCache ? "Loaded from texture cache" : "Encoded from source");
+		}
+		else if (mCompression != Compression::eNone) {
+			ImGui::TextDisabled("Compressed formats not supported by the device");
+		}
+	}
+	else if (stage == LoadStage::eFailed) {
+		ImGui::TextWrapped("Error loading the texture: %s", mLoadError.c_str());
+	}
+	else {
+		ImGui::Text("Loading: %s", s_getLoadStageName(stage));
+	}
+
+	// The texture is reloaded with the new format
+	bool reload = false;
+	if (ImGui::BeginCombo("Compression", s_getCompressionName(mCompression))) {
+		for (uint32_t i = 0; i < NUM_COMPRESSIONS; ++i) {
+			const Compression compression = static_cast<Compression>(i);
+			if (ImGui::Selectable(s_getCompressionName(compression), compression == mCompression) &&
+				compression != mCompression) {
+				mCompression = compression;
+				reload = true;
+			}
+		}
+		ImGui::EndCombo();
+	}
+	if (ImGui::BeginCombo("Quality", getQualityName(mQuality))) {
+		for (uint32_t i = 0; i < tex::NUM_COMPRESSION_QUALITIES; ++i) {
+			const tex::CompressionQuality quality = static_cast<tex::CompressionQuality>(i);
+			if (ImGui::Selectable(getQualityName(quality), quality == mQuality) &&
+				quality != mQuality) {
+				mQuality = quality;
+				if (mCompression != Compression::eNone) {
+					reload = true;
+				}
+			}
+		}
+		ImGui::EndCombo();
+	}
+	if (reload) {
+		const std::string path = mPath;
+		this->load(fc, path.c_str());
+		return;
+	}
 
 	ImGui::Separator();
 	ImGui::Text("Path of texture:");
@@ -78,4 +702,4 @@ void Texture::renderImGui(FrameContext* fc, Gui* gui)
 
 }
 
-} // namespace gr
\ No newline at end of file
+} // namespace gr
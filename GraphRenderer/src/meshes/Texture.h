@@ -1,7 +1,13 @@
 #pragma once
 
 #include "../graphics/resources/Image2D.h"
+#include "../graphics/memory/BufferTransferer.h"
 #include "IObject.h"
+#include "TextureProcessing/BlockCompression.h"
+#include "TextureProcessing/TextureCache.h"
+
+#include <memory>
+#include <filesystem>
 
 namespace gr
 {
@@ -16,15 +22,87 @@ class Texture : public IObject
 {
 public:
 
+	// Format of the texture in the GPU. The compressed ones are encoded
+	// on import and kept in the texture cache of the project
+	enum class Compression : uint32_t {
+		eNone = 0,
+		// Opaque sRGB colors
+		eBC1 = 1,
+		// Linear red and green, i.e. normal maps
+		eBC5 = 2,
+		// sRGB colors with alpha
+		eBC7 = 3
+	};
+	static constexpr uint32_t NUM_COMPRESSIONS = 4;
+
+	// Stages of the load, in order
+	enum class LoadStage : uint32_t {
+		eNone,
+		eQueued,
+		eDecoding,
+		eEncoding,
+		eUploading,
+		eReady,
+		eFailed
+	};
+
 	Texture() = default;
+	// Not copied, a load in progress would be shared
+	Texture(const Texture&) = delete;
+	Texture(Texture&&) = default;
+	Texture& operator=(const Texture&) = delete;
+	Texture& operator=(Texture&&) = default;
 
-	bool load(FrameContext* fc,
+	// Starts loading the image in the background, discarding the previous one.
+	// The image is decoded, or encoded if compressed, by a low priority job
+	// that queues its transfers, and the ResourceLoader waits until resident.
+	// If the device does not support the compressed formats, the texture is
+	// uploaded uncompressed
+	void load(FrameContext* fc,
 		const char* filePath);
 
 	void scheduleDestroy(FrameContext* fc) override final;
 	void renderImGui(FrameContext* fc, Gui* gui) override final;
+	void start(FrameContext* fc) override final;
+	bool updateLoad(FrameContext* fc) override final;
+
+	LoadStage getLoadStage() const;
+	bool isLoading() const { return mLoadJob != nullptr; }
+	static const char* s_getLoadStageName(LoadStage stage);
+
+	// False while the image is loaded and transferred to the GPU
+	bool isResident() const { return mLoadStage == LoadStage::eReady; }
+
+	// Residency of the mips, managed by the TextureStreamer. Only the textures
+	// loaded from the texture cache can change their resident mips, they are
+	// loaded with the mip tail only
+	bool isStreamable() const { return isResident() && mCache != nullptr; }
+	bool isStreaming() const { return static_cast<bool>(mMipStream.image); }
+	// First mip of the full texture in the image, that has the smaller ones too
+	uint32_t getResidentMip() const { return mResidentMip; }
+	// Mip requested by the objects that used the texture in the frame, or the mip tail
+	uint32_t getWantedMip(uint64_t frame) const {
+		return mLastUsedFrame == frame ? mRequestedMip : mMipTail;
+	}
+	uint64_t getLastUsedFrame() const { return mLastUsedFrame; }
+	// Bytes of the mips from mip to the smallest one
+	vk::DeviceSize getMipChainBytes(uint32_t mip) const;
+	// Of the image, and of the one being streamed
+	vk::DeviceSize getDeviceMemorySize(const vkg::RenderContext& rc) const;
+
+	// The smallest mip that covers the size on screen is requested, for this frame
+	void requestScreenSize(float screenPixels, uint64_t frame);
+	// Creates an image with the mips from mip, uploaded from the cache. The
+	// current image is used until the new one is resident, see updateStreaming
+	void streamMip(FrameContext* fc, uint32_t mip);
+	// Replaces the image once the one streamed is resident
+	void updateStreaming(FrameContext* fc);
 
 	static constexpr const char* s_getClassName() { return "Texture"; }
+	static const char* s_getCompressionName(Compression compression);
+
+	// Of the next load. The images are uncompressed unless it is chosen on import
+	void setCompression(Compression compression) { mCompression = compression; }
 
 
 protected:
@@ -32,12 +110,76 @@ protected:
 	vkg::Image2D mImage2d;
 	std::string mPath;
 
+	Compression mCompression = Compression::eNone;
+	tex::CompressionQuality mQuality = tex::CompressionQuality::eFast;
+	// Format of the loaded image, written by the load job
+	vk::Format mLoadedFormat = vk::Format::eUndefined;
+	bool mLoadedFromCache = false;
+
+	// Mapped while the texture is loaded, to stream its mips
+	std::shared_ptr<tex::TextureCacheReader> mCache;
+	vk::Extent2D mFullExtent;
+	uint32_t mNumMips = 0;
+	uint32_t mMipTail = 0;
+	uint32_t mResidentMip = 0;
+	uint32_t mRequestedMip = 0;
+	uint64_t mLastUsedFrame = 0;
+
+	struct MipStream {
+		vkg::Image2D image;
+		uint32_t mip = 0;
+		std::shared_ptr<bool> resident;
+		vkg::BufferTransferer::StreamId stream = 0;
+	};
+	MipStream mMipStream;
+
+	// State shared with the job that loads the texture
+	struct LoadJob;
+	std::shared_ptr<LoadJob> mLoadJob;
+	// Stage once the load has finished, or if there is no load
+	LoadStage mLoadStage = LoadStage::eNone;
+	std::string mLoadError;
+
+	// Runs in a job. Creates the image and queues its transfers. It only
+	// writes the members of the texture until it finishes, and the main
+	// thread does not read them until then
+	void runLoadJob();
+	// Uploads all the mips from the texture cache, or encodes them if
+	// it is outdated. Returns false if the image can't be read
+	bool loadCompressed(LoadJob& job);
+	// The image is decoded straight to staging memory, unless its mips
+	// need to be downsampled in the CPU
+	bool loadUncompressed(LoadJob& job);
+	// Waits for the job, and cancels the transfers not queued yet
+	void cancelLoad(FrameContext* fc);
+	void cancelMipStream(FrameContext* fc);
+	// Of the full texture
+	vk::Extent2D getMipExtent(uint32_t mip) const;
+
 	// Serialization functions
 	template<class Archive>
-	void serialize(Archive& archive)
+	void save(Archive& archive) const
+	{
+		archive(cereal::base_class<IObject>(this));
+		archive(GR_SERIALIZE_NVP_MEMBER(mPath));
+		archive(GR_SERIALIZE_NVP_MEMBER(mCompression));
+		archive(GR_SERIALIZE_NVP_MEMBER(mQuality));
+	}
+
+	template<class Archive>
+	void load(Archive& archive)
 	{
 		archive(cereal::base_class<IObject>(this));
 		archive(GR_SERIALIZE_NVP_MEMBER(mPath));
+		// projects saved before the compression were not compressed
+		try {
+			archive(GR_SERIALIZE_NVP_MEMBER(mCompression));
+			archive(GR_SERIALIZE_NVP_MEMBER(mQuality));
+		}
+		catch (const cereal::Exception&) {
+			mCompression = Compression::eNone;
+			mQuality = tex::CompressionQuality::eFast;
+		}
 	}
 
 	GR_SERIALIZE_PRIVATE_MEMBERS
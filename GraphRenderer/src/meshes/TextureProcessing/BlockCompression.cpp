@@ -0,0 +1,546 @@
+#include "BlockCompression.h"
+
+#include "../../utils/grjob.h"
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace gr
+{
+namespace tex
+{
+
+namespace
+{
+
+constexpr uint32_t TEXELS_PER_BLOCK = BLOCK_DIM * BLOCK_DIM;
+// Rows of blocks encoded by each job
+constexpr uint32_t BLOCK_ROWS_PER_JOB = 8;
+
+// Interpolation weights of the 4 bit indices of BC7, out of 64
+constexpr uint32_t BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct Block {
+	glm::vec4 texels[TEXELS_PER_BLOCK];
+};
+
+void loadBlock(const uint8_t* rgba, uint32_t width, uint32_t height,
+	uint32_t blockX, uint32_t blockY, Block* block)
+{
+	for (uint32_t y = 0; y < BLOCK_DIM; ++y) {
+		const uint32_t py = std::min(blockY * BLOCK_DIM + y, height - 1);
+		for (uint32_t x = 0; x < BLOCK_DIM; ++x) {
+			const uint32_t px = std::min(blockX * BLOCK_DIM + x, width - 1);
+			const uint8_t* t = rgba + 4 * (static_cast<size_t>(py) * width + px);
+			block->texels[y * BLOCK_DIM + x] = glm::vec4(t[0], t[1], t[2], t[3]);
+		}
+	}
+}
+
+// Least squares endpoints of the texels interpolated with the weights
+// t in [0, 1]. Returns false if all the weights are the same
+template<typename V>
+bool solveEndpoints(const V* values, const float* weights, uint32_t num, V* outE0, V* outE1)
+{
+	float a = 0.0f, b = 0.0f, c = 0.0f;
+	V x(0.0f), y(0.0f);
+	for (uint32_t i = 0; i < num; ++i) {
+		const float t = weights[i];
+		a += (1.0f - t) * (1.0f - t);
+		b += (1.0f - t) * t;
+		c += t * t;
+		x += (1.0f - t) * values[i];
+		y += t * values[i];
+	}
+	const float det = a * c - b * b;
+	if (std::abs(det) < 1e-6f) {
+		return false;
+	}
+	*outE0 = glm::clamp((c * x - b * y) / det, V(0.0f), V(255.0f));
+	*outE1 = glm::clamp((a * y - b * x) / det, V(0.0f), V(255.0f));
+	return true;
+}
+
+// Endpoints on the principal axis of the values, at the extremes of their projections
+template<typename V>
+void principalAxisEndpoints(const V* values, uint32_t num, V* outE0, V* outE1)
+{
+	V mean(0.0f);
+	for (uint32_t i = 0; i < num; ++i) {
+		mean += values[i];
+	}
+	mean /= static_cast<float>(num);
+
+	// Power iteration over the covariance, started on the diagonal of the bounding box
+	V minV = values[0], maxV = values[0];
+	for (uint32_t i = 1; i < num; ++i) {
+		minV = glm::min(minV, values[i]);
+		maxV = glm::max(maxV, values[i]);
+	}
+	V axis = maxV - minV;
+	if (glm::dot(axis, axis) == 0.0f) {
+		*outE0 = mean;
+		*outE1 = mean;
+		return;
+	}
+	for (uint32_t iter = 0; iter < 4; ++iter) {
+		V next(0.0f);
+		for (uint32_t i = 0; i < num; ++i) {
+			const V d = values[i] - mean;
+			next += glm::dot(d, axis) * d;
+		}
+		const float len = glm::length(next);
+		if (len == 0.0f) {
+			break;
+		}
+		axis = next / len;
+	}
+	axis = glm::normalize(axis);
+
+	float tMin = std::numeric_limits<float>::max();
+	float tMax = -std::numeric_limits<float>::max();
+	for (uint32_t i = 0; i < num; ++i) {
+		const float t = glm::dot(values[i] - mean, axis);
+		tMin = std::min(tMin, t);
+		tMax = std::max(tMax, t);
+	}
+	*outE0 = glm::clamp(mean + tMin * axis, V(0.0f), V(255.0f));
+	*outE1 = glm::clamp(mean + tMax * axis, V(0.0f), V(255.0f));
+}
+
+// BC1
+
+uint16_t packRgb565(const glm::vec3& c)
+{
+	const uint32_t r = static_cast<uint32_t>(std::lround(c.r * (31.0f / 255.0f)));
+	const uint32_t g = static_cast<uint32_t>(std::lround(c.g * (63.0f / 255.0f)));
+	const uint32_t b = static_cast<uint32_t>(std::lround(c.b * (31.0f / 255.0f)));
+	return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+glm::vec3 unpackRgb565(uint16_t c)
+{
+	const uint32_t r = (c >> 11) & 31;
+	const uint32_t g = (c >> 5) & 63;
+	const uint32_t b = c & 31;
+	return glm::vec3((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+}
+
+// Returns the squared error of the encoded block
+float encodeBC1Endpoints(const glm::vec3* colors, glm::vec3 e0, glm::vec3 e1, uint8_t* out)
+{
+	uint16_t c0 = packRgb565(e0);
+	uint16_t c1 = packRgb565(e1);
+	// c0 > c1 selects the mode of 4 opaque colors
+	if (c0 < c1) {
+		std::swap(c0, c1);
+	}
+
+	glm::vec3 palette[4];
+	palette[0] = unpackRgb565(c0);
+	palette[1] = unpackRgb565(c1);
+	palette[2] = (2.0f * palette[0] + palette[1]) / 3.0f;
+	palette[3] = (palette[0] + 2.0f * palette[1]) / 3.0f;
+
+	uint32_t indices = 0;
+	float error = 0.0f;
+	for (uint32_t i = 0; i < TEXELS_PER_BLOCK; ++i) {
+		uint32_t best = 0;
+		float bestError = std::numeric_limits<float>::max();
+		// With c0 == c1 all the colors are the same, index 0
+		const uint32_t numColors = c0 == c1 ? 1 : 4;
+		for (uint32_t p = 0; p < numColors; ++p) {
+			const glm::vec3 d = colors[i] - palette[p];
+			const float e = glm::dot(d, d);
+			if (e < bestError) {
+				bestError = e;
+				best = p;
+			}
+		}
+		indices |= best << (2 * i);
+		error += bestError;
+	}
+
+	out[0] = static_cast<uint8_t>(c0 & 0xFF);
+	out[1] = static_cast<uint8_t>(c0 >> 8);
+	out[2] = static_cast<uint8_t>(c1 & 0xFF);
+	out[3] = static_cast<uint8_t>(c1 >> 8);
+	std::memcpy(out + 4, &indices, sizeof(indices));
+	return error;
+}
+
+void encodeBC1(const Block& block, CompressionQuality quality, uint8_t* out)
+{
+	glm::vec3 colors[TEXELS_PER_BLOCK];
+	glm::vec3 minC(255.0f), maxC(0.0f);
+	for (uint32_t i = 0; i < TEXELS_PER_BLOCK; ++i) {
+		colors[i] = glm::vec3(block.texels[i]);
+		minC = glm::min(minC, colors[i]);
+		maxC = glm::max(maxC, colors[i]);
+	}
+
+	if (quality == CompressionQuality::eFast) {
+		// Inset the box, so that the extremes are not only reached by the endpoints
+		const glm::vec3 inset = (maxC - minC) / 16.0f;
+		encodeBC1Endpoints(colors, maxC - inset, minC + inset, out);
+		return;
+	}
+
+	glm::vec3 e0, e1;
+	principalAxisEndpoints(colors, TEXELS_PER_BLOCK, &e0, &e1);
+	uint8_t candidate[8];
+	float bestError = encodeBC1Endpoints(colors, e0, e1, out);
+
+	// Weights of the indices 0, 1, 2, 3 from the first endpoint
+	constexpr float WEIGHTS[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+	for (uint32_t iter = 0; iter < 2; ++iter) {
+		uint32_t indices;
+		std::memcpy(&indices, out + 4, sizeof(indices));
+		float weights[TEXELS_PER_BLOCK];
+		for (uint32_t i = 0; i < TEXELS_PER_BLOCK; ++i) {
+			weights[i] = WEIGHTS[(indices >> (2 * i)) & 3];
+		}
+		uint16_t c0, c1;
+		std::memcpy(&c0, out, sizeof(c0));
+		std::memcpy(&c1, out + 2, sizeof(c1));
+		if (c0 == c1 || !solveEndpoints(colors, weights, TEXELS_PER_BLOCK, &e0, &e1)) {
+			break;
+		}
+		const float error = encodeBC1Endpoints(colors, e0, e1, candidate);
+		if (error >= bestError) {
+			break;
+		}
+		bestError = error;
+		std::memcpy(out, candidate, sizeof(candidate));
+	}
+}
+
+// BC4, each of the two channels of BC5
+
+float encodeBC4Endpoints(const float* values, uint32_t r0, uint32_t r1, uint8_t* out)
+{
+	assert(r0 > r1);
+	// r0 > r1 selects the mode of 8 interpolated values
+	float palette[8];
+	palette[0] = static_cast<float>(r0);
+	palette[1] = static_cast<float>(r1);
+	for (uint32_t i = 2; i < 8; ++i) {
+		palette[i] = static_cast<float>(((8 - i) * r0 + (i - 1) * r1) / 7);
+	}
+
+	uint64_t indices = 0;
+	float error = 0.0f;
+	for (uint32_t i = 0; i < TEXELS_PER_BLOCK; ++i) {
+		uint64_t best = 0;
+		float bestError = std::numeric_limits<float>::max();
+		for (uint32_t p = 0; p < 8; ++p) {
+			const float d = values[i] - palette[p];
+			if (d * d < bestError) {
+				bestError = d * d;
+				best = p;
+			}
+		}
+		indices |= best << (3 * i);
+		error += bestError;
+	}
+
+	out[0] = static_cast<uint8_t>(r0);
+	out[1] = static_cast<uint8_t>(r1);
+	for (uint32_t i = 0; i < 6; ++i) {
+		out[2 + i] = static_cast<uint8_t>(indices >> (8 * i));
+	}
+	return error;
+}
+
+void encodeBC4(const Block& block, uint32_t channel, CompressionQuality quality, uint8_t* out)
+{
+	float values[TEXELS_PER_BLOCK];
+	float minV = 255.0f, maxV = 0.0f;
+	for (uint32_t i = 0; i < TEXELS_PER_BLOCK; ++i) {
+		values[i] = block.texels[i][channel];
+		minV = std::min(minV, values[i]);
+		maxV = std::max(maxV, values[i]);
+	}
+
+	const uint32_t minI = static_cast<uint32_t>(minV);
+	const uint32_t maxI = static_cast<uint32_t>(maxV);
+	if (minI == maxI) {
+		// all the indices are 0, the first endpoint in both modes
+		std::memset(out, 0, 8);
+		out[0] = static_cast<uint8_t>(maxI);
+		out[1] = static_cast<uint8_t>(maxI);
+		return;
+	}
+
+	float bestError = encodeBC4Endpoints(values, maxI, minI, out);
+	if (quality == CompressionQuality::eFast) {
+		return;
+	}
+
+	// Small search of inset endpoints
+	uint8_t candidate[8];
+	for (uint32_t d0 = 0; d0 <= 2; ++d0) {
+		for (uint32_t d1 = 0; d1 <= 2; ++d1) {
+			if ((d0 == 0 && d1 == 0) || maxI < minI + d0 + d1 + 1) {
+				continue;
+			}
+			const float error = encodeBC4Endpoints(values, maxI - d0, minI + d1, candidate);
+			if (error < bestError) {
+				bestError = error;
+				std::memcpy(out, candidate, sizeof(candidate));
+			}
+		}
+	}
+}
+
+// BC7 mode 6
+
+class BitWriter
+{
+public:
+	explicit BitWriter(uint8_t* out) : mOut(out) { std::memset(mOut, 0, 16); }
+
+	void write(uint32_t value, uint32_t numBits)
+	{
+		for (uint32_t i = 0; i < numBits; ++i, ++mPos) {
+			mOut[mPos / 8] |= static_cast<uint8_t>(((value >> i) & 1) << (mPos % 8));
+		}
+	}
+
+	uint32_t getPosition() const { return mPos; }
+
+private:
+	uint8_t* mOut;
+	uint32_t mPos = 0;
+};
+
+// 7 bits per channel and a shared lowest bit. Chooses the bit with less error
+void quantizeBC7Endpoint(const glm::vec4& e, glm::uvec4* outColor, uint32_t* outPBit)
+{
+	float bestError = std::numeric_limits<float>::max();
+	for (uint32_t p = 0; p < 2; ++p) {
+		glm::uvec4 c;
+		float error = 0.0f;
+		for (uint32_t k = 0; k < 4; ++k) {
+			const float q = std::round((e[k] - static_cast<float>(p)) * 0.5f);
+			c[k] = static_cast<uint32_t>(std::clamp(q, 0.0f, 127.0f));
+			const float d = e[k] - static_cast<float>((c[k] << 1) | p);
+			error += d * d;
+		}
+		if (error < bestError) {
+			bestError = error;
+			*outColor = c;
+			*outPBit = p;
+		}
+	}
+}
+
+float encodeBC7Endpoints(const glm::vec4* texels, const glm::vec4& e0, const glm::vec4& e1,
+	uint8_t* out, uint32_t* outIndices)
+{
+	glm::uvec4 c[2];
+	uint32_t p[2];
+	quantizeBC7Endpoint(e0, &c[0], &p[0]);
+	quantizeBC7Endpoint(e1, &c[1], &p[1]);
+
+	glm::vec4 ends[2];
+	for (uint32_t i = 0; i < 2; ++i) {
+		ends[i] = glm::vec4((c[i] << 1u) | glm::uvec4(p[i]));
+	}
+	glm::vec4 palette[16];
+	for (uint32_t w = 0; w < 16; ++w) {
+		const glm::uvec4 v = ((64u - BC7_WEIGHTS[w]) * glm::uvec4(ends[0]) +
+			BC7_WEIGHTS[w] * glm::uvec4(ends[1]) + 32u) >> 6u;
+		palette[w] = glm::vec4(v);
+	}
+
+	uint32_t indices[TEXELS_PER_BLOCK];
+	float error = 0.0f;
+	for (uint32_t i = 0; i < TEXELS_PER_BLOCK; ++i) {
+		float bestError = std::numeric_limits<float>::max();
+		for (uint32_t w = 0; w < 16; ++w) {
+			const glm::vec4 d = texels[i] - palette[w];
+			const float e = glm::dot(d, d);
+			if (e < bestError) {
+				bestError = e;
+				indices[i] = w;
+			}
+		}
+		error += bestError;
+	}
+
+	// The highest bit of the index of the first texel is implicitly 0
+	if (indices[0] >= 8) {
+		std::swap(c[0], c[1]);
+		std::swap(p[0], p[1]);
+		for (uint32_t i = 0; i < TEXELS_PER_BLOCK; ++i) {
+			indices[i] = 15 - indices[i];
+		}
+	}
+
+	BitWriter writer(out);
+	writer.write(1u << 6, 7); // mode 6
+	for (uint32_t k = 0; k < 4; ++k) {
+		writer.write(c[0][k], 7);
+		writer.write(c[1][k], 7);
+	}
+	writer.write(p[0], 1);
+	writer.write(p[1], 1);
+	writer.write(indices[0], 3);
+	for (uint32_t i = 1; i < TEXELS_PER_BLOCK; ++i) {
+		writer.write(indices[i], 4);
+	}
+	assert(writer.getPosition() == 128);
+
+	if (outIndices != nullptr) {
+		std::memcpy(outIndices, indices, sizeof(indices));
+	}
+	return error;
+}
+
+void encodeBC7(const Block& block, CompressionQuality quality, uint8_t* out)
+{
+	glm::vec4 minC(255.0f), maxC(0.0f);
+	for (uint32_t i = 0; i < TEXELS_PER_BLOCK; ++i) {
+		minC = glm::min(minC, block.texels[i]);
+		maxC = glm::max(maxC, block.texels[i]);
+	}
+
+	if (quality == CompressionQuality::eFast) {
+		encodeBC7Endpoints(block.texels, minC, maxC, out, nullptr);
+		return;
+	}
+
+	glm::vec4 e0, e1;
+	principalAxisEndpoints(block.texels, TEXELS_PER_BLOCK, &e0, &e1);
+	uint32_t indices[TEXELS_PER_BLOCK];
+	float bestError = encodeBC7Endpoints(block.texels, e0, e1, out, indices);
+
+	uint8_t candidate[16];
+	uint32_t candidateIndices[TEXELS_PER_BLOCK];
+	const float boxError = encodeBC7Endpoints(block.texels, minC, maxC, candidate, candidateIndices);
+	if (boxError < bestError) {
+		bestError = boxError;
+		std::memcpy(out, candidate, sizeof(candidate));
+		std::memcpy(indices, candidateIndices, sizeof(indices));
+	}
+
+	for (uint32_t iter = 0; iter < 2; ++iter) {
+		float weights[TEXELS_PER_BLOCK];
+		for (uint32_t i = 0; i < TEXELS_PER_BLOCK; ++i) {
+			weights[i] = static_cast<float>(BC7_WEIGHTS[indices[i]]) / 64.0f;
+		}
+		if (!solveEndpoints(block.texels, weights, TEXELS_PER_BLOCK, &e0, &e1)) {
+			break;
+		}
+		const float error = encodeBC7Endpoints(block.texels, e0, e1, candidate, candidateIndices);
+		if (error >= bestError) {
+			break;
+		}
+		bestError = error;
+		std::memcpy(out, candidate, sizeof(candidate));
+		std::memcpy(indices, candidateIndices, sizeof(indices));
+	}
+}
+
+} // namespace
+
+
+uint32_t getBlockBytes(BlockFormat format)
+{
+	switch (format) {
+	case BlockFormat::eBC1:
+		return 8;
+	case BlockFormat::eBC5:
+	case BlockFormat::eBC7:
+		return 16;
+	default:
+		assert(false);
+		return 0;
+	}
+}
+
+size_t getCompressedSize(BlockFormat format, uint32_t width, uint32_t height)
+{
+	const size_t blocksX = (width + BLOCK_DIM - 1) / BLOCK_DIM;
+	const size_t blocksY = (height + BLOCK_DIM - 1) / BLOCK_DIM;
+	return blocksX * blocksY * getBlockBytes(format);
+}
+
+void compressBlockRows(const uint8_t* rgba, uint32_t width, uint32_t height,
+	BlockFormat format, CompressionQuality quality,
+	uint32_t firstBlockRow, uint32_t numBlockRows, uint8_t* outBlocks)
+{
+	assert(width > 0 && height > 0);
+	const uint32_t blocksX = (width + BLOCK_DIM - 1) / BLOCK_DIM;
+	const uint32_t blockBytes = getBlockBytes(format);
+
+	Block block;
+	for (uint32_t by = firstBlockRow; by < firstBlockRow + numBlockRows; ++by) {
+		uint8_t* out = outBlocks + static_cast<size_t>(by) * blocksX * blockBytes;
+		for (uint32_t bx = 0; bx < blocksX; ++bx, out += blockBytes) {
+			loadBlock(rgba, width, height, bx, by, &block);
+			switch (format) {
+			case BlockFormat::eBC1:
+				encodeBC1(block, quality, out);
+				break;
+			case BlockFormat::eBC5:
+				encodeBC4(block, 0, quality, out);
+				encodeBC4(block, 1, quality, out + 8);
+				break;
+			case BlockFormat::eBC7:
+				encodeBC7(block, quality, out);
+				break;
+			}
+		}
+	}
+}
+
+void compressImageParallel(const uint8_t* rgba, uint32_t width, uint32_t height,
+	BlockFormat format, CompressionQuality quality, uint8_t* outBlocks,
+	const std::atomic<bool>* cancelled)
+{
+	const uint32_t blocksY = (height + BLOCK_DIM - 1) / BLOCK_DIM;
+	const uint32_t numJobs = (blocksY + BLOCK_ROWS_PER_JOB - 1) / BLOCK_ROWS_PER_JOB;
+	if (numJobs <= 1) {
+		compressBlockRows(rgba, width, height, format, quality, 0, blocksY, outBlocks);
+		return;
+	}
+
+	// Shared by the jobs, alive until they finish
+	struct Image {
+		const uint8_t* rgba;
+		uint32_t width, height, blocksY;
+		BlockFormat format;
+		CompressionQuality quality;
+		uint8_t* outBlocks;
+		const std::atomic<bool>* cancelled;
+	};
+	const Image image = { rgba, width, height, blocksY, format, quality, outBlocks, cancelled };
+	const Image* pImage = &image;
+
+	std::vector<grjob::Job> jobs;
+	jobs.reserve(numJobs);
+	for (uint32_t i = 0; i < numJobs; ++i) {
+		jobs.push_back(grjob::Job([pImage, i]() {
+			if (pImage->cancelled != nullptr && pImage->cancelled->load(std::memory_order_relaxed)) {
+				return;
+			}
+			const uint32_t first = i * BLOCK_ROWS_PER_JOB;
+			const uint32_t num = std::min(BLOCK_ROWS_PER_JOB, pImage->blocksY - first);
+			compressBlockRows(pImage->rgba, pImage->width, pImage->height,
+				pImage->format, pImage->quality, first, num, pImage->outBlocks);
+		}));
+	}
+	grjob::Counter* c = nullptr;
+	grjob::runJobBatch(grjob::Priority::eLow, jobs.data(), numJobs, &c);
+	grjob::waitForCounterAndFree(c, 0);
+}
+
+} // namespace tex
+} // namespace gr
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+namespace gr
+{
+namespace tex
+{
+
+// Block compressed formats of the texture cache. The images are split
+// in blocks of 4x4 texels, encoded independently.
+enum class BlockFormat : uint32_t {
+	// 4 colors per block, interpolated from 2 RGB565 endpoints. 8 bytes per block.
+	// For opaque color textures
+	eBC1 = 0,
+	// The red and green channels with 8 values per block each, 16 bytes per block.
+	// For normal maps
+	eBC5 = 1,
+	// RGBA, 16 bytes per block. Only mode 6 is encoded: one subset with
+	// 16 colors interpolated from 2 RGBA7777 endpoints with a shared bit each
+	eBC7 = 2
+};
+
+enum class CompressionQuality : uint32_t {
+	// Endpoints from the bounding box of the block
+	eFast = 0,
+	// Endpoints from the principal axis of the block, refined by least squares
+	eHigh = 1
+};
+constexpr uint32_t NUM_COMPRESSION_QUALITIES = 2;
+
+constexpr uint32_t BLOCK_DIM = 4;
+
+uint32_t getBlockBytes(BlockFormat format);
+
+// Bytes of an image of width x height texels, rounded up to whole blocks
+size_t getCompressedSize(BlockFormat format, uint32_t width, uint32_t height);
+
+// Encodes the rows of blocks [firstBlockRow, firstBlockRow + numBlockRows) of an RGBA8
+// image. The texels outside of the image repeat the border. outBlocks points to the
+// first block of the image, the rows are written at their offset
+void compressBlockRows(const uint8_t* rgba, uint32_t width, uint32_t height,
+	BlockFormat format, CompressionQuality quality,
+	uint32_t firstBlockRow, uint32_t numBlockRows, uint8_t* outBlocks);
+
+// Encodes the image in the job system, in groups of rows of blocks.
+// outBlocks must have getCompressedSize bytes. Once cancelled is set,
+// the groups that have not started are skipped and outBlocks is incomplete
+void compressImageParallel(const uint8_t* rgba, uint32_t width, uint32_t height,
+	BlockFormat format, CompressionQuality quality, uint8_t* outBlocks,
+	const std::atomic<bool>* cancelled = nullptr);
+
+} // namespace tex
+} // namespace gr
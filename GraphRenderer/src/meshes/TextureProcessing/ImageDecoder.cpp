@@ -0,0 +1,173 @@
+#include "ImageDecoder.h"
+
+#include <stb_image/stb_image.h>
+#include <glm/gtc/packing.hpp>
+
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace gr
+{
+namespace tex
+{
+
+namespace
+{
+
+// Frees the image of stb_image
+struct StbiImage {
+	void* pixels;
+	explicit StbiImage(void* p) : pixels(p) {}
+	~StbiImage() { stbi_image_free(pixels); }
+	StbiImage(const StbiImage&) = delete;
+	StbiImage& operator=(const StbiImage&) = delete;
+};
+
+// Expands the channels of the file to RGBA. Gray is replicated to RGB,
+// and the alpha is one if missing
+template<typename SrcT, typename DstT, typename ConvertFn>
+void expandToRGBA(const SrcT* src, size_t numPixels, uint32_t channels,
+	DstT one, ConvertFn convert, DstT* dst)
+{
+	for (size_t i = 0; i < numPixels; ++i, src += channels, dst += 4) {
+		switch (channels) {
+		case 1:
+			dst[0] = dst[1] = dst[2] = convert(src[0]);
+			dst[3] = one;
+			break;
+		case 2:
+			dst[0] = dst[1] = dst[2] = convert(src[0]);
+			dst[3] = convert(src[1]);
+			break;
+		case 3:
+			dst[0] = convert(src[0]);
+			dst[1] = convert(src[1]);
+			dst[2] = convert(src[2]);
+			dst[3] = one;
+			break;
+		default:
+			dst[0] = convert(src[0]);
+			dst[1] = convert(src[1]);
+			dst[2] = convert(src[2]);
+			dst[3] = convert(src[3]);
+			break;
+		}
+	}
+}
+
+} // namespace
+
+uint32_t getPixelBytes(PixelFormat format)
+{
+	switch (format) {
+	case PixelFormat::eRGBA8: return 4;
+	case PixelFormat::eRGBA16: return 8;
+	case PixelFormat::eRGBA16F: return 8;
+	default:
+		assert(false);
+		return 0;
+	}
+}
+
+bool ImageDecoder::open(const std::filesystem::path& path)
+{
+	if (!mFile.open(path.string().c_str())) {
+		return false;
+	}
+	if (mFile.size() > static_cast<size_t>(std::numeric_limits<int>::max())) {
+		mFile.close();
+		return false;
+	}
+
+	const int len = static_cast<int>(mFile.size());
+	int width, height, channels;
+	if (!stbi_info_from_memory(mFile.data(), len, &width, &height, &channels)) {
+		mFile.close();
+		return false;
+	}
+
+	mInfo.width = static_cast<uint32_t>(width);
+	mInfo.height = static_cast<uint32_t>(height);
+	mInfo.channels = static_cast<uint32_t>(channels);
+	if (stbi_is_hdr_from_memory(mFile.data(), len)) {
+		mInfo.format = PixelFormat::eRGBA16F;
+	}
+	else if (stbi_is_16_bit_from_memory(mFile.data(), len)) {
+		mInfo.format = PixelFormat::eRGBA16;
+	}
+	else {
+		mInfo.format = PixelFormat::eRGBA8;
+	}
+	return true;
+}
+
+size_t ImageDecoder::getDecodedSize() const
+{
+	return static_cast<size_t>(mInfo.width) * mInfo.height * getPixelBytes(mInfo.format);
+}
+
+void ImageDecoder::decode(uint8_t* dst) const
+{
+	assert(mFile.isOpen());
+
+	// The pixels are decoded with the channels of the file, and expanded
+	// while written to dst, instead of expanded by stb_image to a copy
+	const int len = static_cast<int>(mFile.size());
+	const size_t numPixels = static_cast<size_t>(mInfo.width) * mInfo.height;
+	int width, height, channels;
+	auto isDecoded = [this](const StbiImage& img, int width, int height) {
+		return img.pixels != nullptr && static_cast<uint32_t>(width) == mInfo.width &&
+			static_cast<uint32_t>(height) == mInfo.height;
+	};
+
+	switch (mInfo.format) {
+	case PixelFormat::eRGBA8:
+	{
+		StbiImage img(stbi_load_from_memory(mFile.data(), len, &width, &height, &channels, 0));
+		if (!isDecoded(img, width, height)) {
+			break;
+		}
+		const uint8_t* src = static_cast<const uint8_t*>(img.pixels);
+		if (channels == 4) {
+			std::memcpy(dst, src, numPixels * 4);
+		}
+		else {
+			expandToRGBA(src, numPixels, static_cast<uint32_t>(channels), uint8_t(255),
+				[](uint8_t c) { return c; }, dst);
+		}
+		return;
+	}
+	case PixelFormat::eRGBA16:
+	{
+		StbiImage img(stbi_load_16_from_memory(mFile.data(), len, &width, &height, &channels, 0));
+		if (!isDecoded(img, width, height)) {
+			break;
+		}
+		expandToRGBA(static_cast<const uint16_t*>(img.pixels), numPixels,
+			static_cast<uint32_t>(channels), uint16_t(0xffff),
+			[](uint16_t c) { return c; }, reinterpret_cast<uint16_t*>(dst));
+		return;
+	}
+	case PixelFormat::eRGBA16F:
+	{
+		StbiImage img(stbi_loadf_from_memory(mFile.data(), len, &width, &height, &channels, 0));
+		if (!isDecoded(img, width, height)) {
+			break;
+		}
+		expandToRGBA(static_cast<const float*>(img.pixels), numPixels,
+			static_cast<uint32_t>(channels), glm::packHalf1x16(1.0f),
+			[](float c) { return glm::packHalf1x16(c); }, reinterpret_cast<uint16_t*>(dst));
+		return;
+	}
+	default:
+		break;
+	}
+
+	// The failure reason of stb_image is global, it may be of another thread
+	throw std::runtime_error("Error: Can't decode the image");
+}
+
+} // namespace tex
+} // namespace gr
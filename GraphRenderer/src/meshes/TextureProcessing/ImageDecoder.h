@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <filesystem>
+
+#include "../../utils/MappedFile.h"
+
+namespace gr
+{
+namespace tex
+{
+
+// Layout of the decoded pixels, always with 4 channels
+enum class PixelFormat : uint32_t {
+	// 8 bit sRGB, i.e. PNG, JPEG, BMP, TGA
+	eRGBA8 = 0,
+	// 16 bit linear unorm, i.e. 16 bit PNG
+	eRGBA16 = 1,
+	// 16 bit floats, i.e. HDR
+	eRGBA16F = 2
+};
+
+uint32_t getPixelBytes(PixelFormat format);
+
+struct ImageInfo {
+	uint32_t width = 0;
+	uint32_t height = 0;
+	// Of the file, from 1 to 4. The missing ones are expanded on decode
+	uint32_t channels = 0;
+	PixelFormat format = PixelFormat::eRGBA8;
+};
+
+// Decodes images from a memory mapped file to a destination given by the
+// caller, i.e. reserved staging memory, so that the pixels are only written
+// once after decoding. Decoders of different images can run concurrently.
+class ImageDecoder
+{
+public:
+
+	// Maps the file and reads the header. Returns false if it is not an image
+	bool open(const std::filesystem::path& path);
+
+	const ImageInfo& getInfo() const { return mInfo; }
+	// Bytes of the decoded image
+	size_t getDecodedSize() const;
+
+	// Writes the image to dst, that must have getDecodedSize bytes, with the rows
+	// packed. Throws std::runtime_error if the data is not valid
+	void decode(uint8_t* dst) const;
+
+private:
+
+	tools::MappedFile mFile;
+	ImageInfo mInfo;
+};
+
+} // namespace tex
+} // namespace gr
@@ -0,0 +1,100 @@
+#include "StreamingPolicy.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace gr
+{
+namespace tex
+{
+
+namespace
+{
+
+// Evicts the top mips of the least recently used texture, used before lastUsedFrame.
+// Returns the bytes that will be freed, 0 if there is no texture to evict
+uint64_t evictLeastRecentlyUsed(StreamedTexture* textures, uint32_t numTextures,
+	uint64_t lastUsedFrame, std::vector<MipStream>* outStreams)
+{
+	// Textures with more mips than wanted, that are not streaming already
+	StreamedTexture* victim = nullptr;
+	for (uint32_t i = 0; i < numTextures; ++i) {
+		StreamedTexture& texture = textures[i];
+		if (texture.streaming || texture.lastUsedFrame >= lastUsedFrame ||
+			texture.wantedMip <= texture.residentMip) {
+			continue;
+		}
+		if (victim == nullptr || texture.lastUsedFrame < victim->lastUsedFrame) {
+			victim = &texture;
+		}
+	}
+	if (victim == nullptr) {
+		return 0;
+	}
+
+	victim->streaming = true;
+	outStreams->push_back(MipStream{ static_cast<uint32_t>(victim - textures), victim->wantedMip });
+	return victim->residentBytes - victim->wantedBytes;
+}
+
+} // namespace
+
+
+void planMipStreams(StreamedTexture* textures, uint32_t numTextures,
+	uint64_t usedBytes, uint32_t numStreaming, uint64_t budget, uint32_t maxStreaming,
+	std::vector<uint32_t>* scratchUpgrades, std::vector<MipStream>* outStreams)
+{
+	std::vector<uint32_t>& upgrades = *scratchUpgrades;
+	upgrades.clear();
+	for (uint32_t i = 0; i < numTextures; ++i) {
+		if (textures[i].wantedMip < textures[i].residentMip) {
+			upgrades.push_back(i);
+		}
+	}
+
+	// The textures that miss more mips first
+	std::sort(upgrades.begin(), upgrades.end(), [textures](uint32_t a, uint32_t b) {
+		return textures[a].residentMip - textures[a].wantedMip >
+			textures[b].residentMip - textures[b].wantedMip;
+	});
+
+	for (uint32_t i : upgrades) {
+		if (numStreaming >= maxStreaming) {
+			break;
+		}
+
+		StreamedTexture& texture = textures[i];
+		const uint64_t bytes = texture.wantedBytes;
+		while (usedBytes + bytes > budget && numStreaming + 1 < maxStreaming) {
+			const uint64_t freed = evictLeastRecentlyUsed(textures, numTextures,
+				texture.lastUsedFrame, outStreams);
+			if (freed == 0) {
+				break;
+			}
+			usedBytes -= std::min(freed, usedBytes);
+			numStreaming += 1;
+		}
+		if (usedBytes + bytes > budget) {
+			break;
+		}
+
+		texture.streaming = true;
+		outStreams->push_back(MipStream{ i, texture.wantedMip });
+		usedBytes += bytes;
+		numStreaming += 1;
+	}
+
+	// i.e. if the budget has been reduced
+	while (usedBytes > budget && numStreaming < maxStreaming) {
+		const uint64_t freed = evictLeastRecentlyUsed(textures, numTextures,
+			std::numeric_limits<uint64_t>::max(), outStreams);
+		if (freed == 0) {
+			break;
+		}
+		usedBytes -= std::min(freed, usedBytes);
+		numStreaming += 1;
+	}
+}
+
+} // namespace tex
+} // namespace gr
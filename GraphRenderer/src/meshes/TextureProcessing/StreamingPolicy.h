@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+namespace gr
+{
+namespace tex
+{
+
+// Policy of the TextureStreamer, apart from the textures and the device so that it can be tested.
+// Each frame the textures that want more mips than the resident ones are upgraded, the ones
+// that miss more mips first, while their bytes fit in the budget. To make room, the top mips of
+// the least recently used textures that want fewer mips are evicted. Evicting or upgrading a
+// texture streams a new image, and only maxStreaming textures are streamed at the same time.
+
+// A streamable texture that is not streaming
+struct StreamedTexture {
+	uint64_t lastUsedFrame = 0;
+	uint32_t residentMip = 0;
+	uint32_t wantedMip = 0;
+	// Bytes of the mips from the resident and from the wanted mip to the smallest one
+	uint64_t residentBytes = 0;
+	uint64_t wantedBytes = 0;
+	// Set once a stream of the texture is planned
+	bool streaming = false;
+};
+
+struct MipStream {
+	// Index of the texture
+	uint32_t texture;
+	// New resident mip, the wanted one
+	uint32_t mip;
+};
+
+// Appends to outStreams the textures to stream in the frame. usedBytes are the bytes of
+// all the textures and of the images being streamed, by numStreaming textures.
+// The budget is soft, the evicted mips are freed once the smaller image is resident
+void planMipStreams(StreamedTexture* textures, uint32_t numTextures,
+	uint64_t usedBytes, uint32_t numStreaming, uint64_t budget, uint32_t maxStreaming,
+	std::vector<uint32_t>* scratchUpgrades, std::vector<MipStream>* outStreams);
+
+} // namespace tex
+} // namespace gr
@@ -0,0 +1,186 @@
+#include "TextureCache.h"
+
+#include "../MeshProcessing/MeshCache.h"
+
+#include <fstream>
+#include <cstdio>
+#include <cassert>
+#include <algorithm>
+#include <system_error>
+
+namespace gr
+{
+namespace tex
+{
+
+namespace
+{
+
+uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+const char* getFormatExtension(BlockFormat format)
+{
+	switch (format) {
+	case BlockFormat::eBC1:
+		return "bc1";
+	case BlockFormat::eBC5:
+		return "bc5";
+	case BlockFormat::eBC7:
+		return "bc7";
+	default:
+		return "unknown";
+	}
+}
+
+} // namespace
+
+
+bool getSourceInfo(const std::filesystem::path& sourcePath, TextureCacheHeader* header)
+{
+	mesh::MeshCacheHeader source;
+	if (!mesh::getSourceInfo(sourcePath, &source)) {
+		return false;
+	}
+	header->sourceSize = source.sourceSize;
+	header->sourceWriteTime = source.sourceWriteTime;
+	return true;
+}
+
+std::filesystem::path getTextureCachePath(
+	const std::filesystem::path& projectPath,
+	const std::filesystem::path& relativeSourcePath,
+	BlockFormat format)
+{
+	const std::string source = relativeSourcePath.generic_string();
+	const uint64_t hash = mesh::hashBytes(source.data(), source.size());
+
+	char hashStr[17];
+	std::snprintf(hashStr, sizeof(hashStr), "%016llx", static_cast<unsigned long long>(hash));
+
+	std::filesystem::path path = projectPath / "cache" / "textures";
+	path /= relativeSourcePath.stem().string() + "_" + hashStr + "_" +
+		getFormatExtension(format) + ".grtex";
+	return path;
+}
+
+void writeTextureCache(const std::filesystem::path& path, TextureCacheHeader header,
+	const std::vector<std::vector<uint8_t>>& levels)
+{
+	header.magic = TextureCacheHeader::MAGIC;
+	header.version = TextureCacheHeader::VERSION;
+	header.numLevels = static_cast<uint32_t>(levels.size());
+
+	std::vector<TextureCacheLevel> table(levels.size());
+	uint64_t offset = sizeof(TextureCacheHeader) + sizeof(TextureCacheLevel) * levels.size();
+	for (size_t i = 0; i < levels.size(); ++i) {
+		offset = alignUp(offset, LEVEL_ALIGNMENT);
+		table[i].offset = offset;
+		table[i].bytes = levels[i].size();
+		offset += levels[i].size();
+	}
+
+	std::error_code ec;
+	std::filesystem::create_directories(path.parent_path(), ec);
+
+	std::filesystem::path tmpPath = path;
+	tmpPath += ".tmp";
+	{
+		std::ofstream stream(tmpPath, std::ios::binary | std::ios::trunc);
+		if (!stream) {
+			throw std::runtime_error("Error: Can't write texture cache " + tmpPath.string());
+		}
+
+		stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		stream.write(reinterpret_cast<const char*>(table.data()), sizeof(TextureCacheLevel) * table.size());
+
+		const char padding[LEVEL_ALIGNMENT] = {};
+		for (size_t i = 0; i < levels.size(); ++i) {
+			const uint64_t pos = static_cast<uint64_t>(stream.tellp());
+			stream.write(padding, static_cast<std::streamsize>(table[i].offset - pos));
+			stream.write(reinterpret_cast<const char*>(levels[i].data()),
+				static_cast<std::streamsize>(levels[i].size()));
+		}
+
+		if (!stream) {
+			throw std::runtime_error("Error: Can't write texture cache " + tmpPath.string());
+		}
+	}
+
+	std::filesystem::rename(tmpPath, path, ec);
+	if (ec) {
+		std::filesystem::remove(tmpPath, ec);
+		throw std::runtime_error("Error: Can't write texture cache " + path.string());
+	}
+}
+
+
+bool TextureCacheReader::open(const std::filesystem::path& cachePath,
+	const std::filesystem::path& sourcePath,
+	BlockFormat format, CompressionQuality quality)
+{
+	if (!mFile.open(cachePath.string().c_str())) {
+		return false;
+	}
+
+	if (!this->validate() ||
+		getHeader().format != format || getHeader().quality != quality) {
+		mFile.close();
+		return false;
+	}
+
+	// a missing source is not an error, the cache can be used alone
+	TextureCacheHeader source;
+	if (getSourceInfo(sourcePath, &source)) {
+		const TextureCacheHeader& header = getHeader();
+		if (header.sourceSize != source.sourceSize ||
+			header.sourceWriteTime != source.sourceWriteTime) {
+			mFile.close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+const TextureCacheHeader& TextureCacheReader::getHeader() const
+{
+	assert(mFile.isOpen());
+	return *reinterpret_cast<const TextureCacheHeader*>(mFile.data());
+}
+
+bool TextureCacheReader::validate() const
+{
+	if (mFile.size() < sizeof(TextureCacheHeader)) {
+		return false;
+	}
+
+	const TextureCacheHeader& header = getHeader();
+	if (header.magic != TextureCacheHeader::MAGIC || header.version != TextureCacheHeader::VERSION ||
+		header.width == 0 || header.height == 0 || header.numLevels == 0) {
+		return false;
+	}
+
+	const uint64_t tableEnd = sizeof(TextureCacheHeader) +
+		static_cast<uint64_t>(header.numLevels) * sizeof(TextureCacheLevel);
+	if (tableEnd > mFile.size()) {
+		return false;
+	}
+
+	const TextureCacheLevel* levels = getLevels();
+	for (uint32_t i = 0; i < header.numLevels; ++i) {
+		const uint32_t width = std::max(header.width >> i, 1u);
+		const uint32_t height = std::max(header.height >> i, 1u);
+		if (levels[i].offset < tableEnd || levels[i].offset + levels[i].bytes > mFile.size() ||
+			levels[i].bytes != getCompressedSize(header.format, width, height)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+} // namespace tex
+} // namespace gr
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <filesystem>
+
+#include "BlockCompression.h"
+#include "../../utils/MappedFile.h"
+
+namespace gr
+{
+namespace tex
+{
+
+// Binary container of a block compressed texture with all its mip levels,
+// in the spirit of KTX2. It is memory mapped on load and the levels are
+// uploaded as they are. The file contains a TextureCacheHeader, followed by
+// a TextureCacheLevel for each mip level, followed by the data of the levels
+// aligned to LEVEL_ALIGNMENT, from the biggest to the smallest.
+
+struct TextureCacheHeader {
+	static constexpr uint32_t MAGIC = 0x58545247; // "GRTX"
+	static constexpr uint32_t VERSION = 1;
+	// The colors are in sRGB
+	static constexpr uint32_t FLAG_SRGB = 1;
+
+	uint32_t magic = MAGIC;
+	uint32_t version = VERSION;
+	BlockFormat format = BlockFormat::eBC7;
+	CompressionQuality quality = CompressionQuality::eFast;
+
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t numLevels = 0;
+	uint32_t flags = 0;
+
+	// Source file, to know if the cache is outdated
+	uint64_t sourceSize = 0;
+	int64_t sourceWriteTime = 0;
+};
+
+struct TextureCacheLevel {
+	uint64_t offset; // from the start of the file
+	uint64_t bytes;
+};
+
+static_assert(sizeof(TextureCacheHeader) == 48, "TextureCacheHeader must not have padding");
+static_assert(sizeof(TextureCacheLevel) == 16, "TextureCacheLevel must not have padding");
+
+constexpr uint64_t LEVEL_ALIGNMENT = 64;
+
+// Fills the source members of the header. Returns false if the file does not exist
+bool getSourceInfo(const std::filesystem::path& sourcePath, TextureCacheHeader* header);
+
+// Cache file for a source path relative to the project. Each format has its own file
+std::filesystem::path getTextureCachePath(
+	const std::filesystem::path& projectPath,
+	const std::filesystem::path& relativeSourcePath,
+	BlockFormat format);
+
+// Writes to a temporary file that is renamed once completed.
+// Throws std::runtime_error if the file can't be written
+void writeTextureCache(const std::filesystem::path& path, TextureCacheHeader header,
+	const std::vector<std::vector<uint8_t>>& levels);
+
+
+class TextureCacheReader
+{
+public:
+
+	// Maps the cache. Returns false if it does not exist, is from another version,
+	// format or quality, or the source file has changed since it was written
+	bool open(const std::filesystem::path& cachePath,
+		const std::filesystem::path& sourcePath,
+		BlockFormat format, CompressionQuality quality);
+
+	const TextureCacheHeader& getHeader() const;
+
+	const uint8_t* getLevelData(uint32_t level) const {
+		return mFile.data() + getLevels()[level].offset;
+	}
+	uint64_t getLevelBytes(uint32_t level) const {
+		return getLevels()[level].bytes;
+	}
+
+private:
+
+	tools::MappedFile mFile;
+
+	const TextureCacheLevel* getLevels() const {
+		return reinterpret_cast<const TextureCacheLevel*>(mFile.data() + sizeof(TextureCacheHeader));
+	}
+
+	bool validate() const;
+};
+
+} // namespace tex
+} // namespace gr
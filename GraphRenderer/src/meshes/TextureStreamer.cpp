@@ -0,0 +1,66 @@
+#include "TextureStreamer.h"
+
+#include "Texture.h"
+#include "ResourceDictionary.h"
+#include "../control/FrameContext.h"
+
+namespace gr
+{
+
+// Textures whose mips are streamed at the same time. Each one keeps two
+// images in memory until the new one is resident
+constexpr uint32_t MAX_STREAMING_TEXTURES = 4;
+
+void TextureStreamer::requestScreenSize(ResId texture, float screenPixels)
+{
+	mRequests.enqueue(std::make_pair(texture, screenPixels));
+}
+
+void TextureStreamer::update(FrameContext* fc)
+{
+	ResourceDictionary& dict = fc->gc().getDict();
+	const uint64_t frame = fc->getFrameCount();
+
+	std::pair<ResId, float> request;
+	while (mRequests.try_dequeue(request)) {
+		// the texture may have been erased
+		if (Texture* texture = dict.get(ResHandle<Texture>(request.first))) {
+			texture->requestScreenSize(request.second, frame);
+		}
+	}
+
+	mUsedBytes = 0;
+	mNumStreaming = 0;
+	mStreamable.clear();
+	mStreamed.clear();
+	dict.getAllObjectsOfType<Texture>(&mTextures);
+	for (const ResId& id : mTextures) {
+		Texture* texture = dict.get(ResHandle<Texture>(id));
+		texture->updateStreaming(fc);
+		mUsedBytes += texture->getDeviceMemorySize(fc->rc());
+
+		if (texture->isStreaming()) {
+			mNumStreaming += 1;
+		}
+		else if (texture->isStreamable()) {
+			tex::StreamedTexture streamed;
+			streamed.lastUsedFrame = texture->getLastUsedFrame();
+			streamed.residentMip = texture->getResidentMip();
+			streamed.wantedMip = texture->getWantedMip(frame);
+			streamed.residentBytes = texture->getMipChainBytes(streamed.residentMip);
+			streamed.wantedBytes = texture->getMipChainBytes(streamed.wantedMip);
+			mStreamable.push_back(texture);
+			mStreamed.push_back(streamed);
+		}
+	}
+
+	mMipStreams.clear();
+	tex::planMipStreams(mStreamed.data(), static_cast<uint32_t>(mStreamed.size()),
+		mUsedBytes, mNumStreaming, mBudget, MAX_STREAMING_TEXTURES, &mUpgrades, &mMipStreams);
+	for (const tex::MipStream& stream : mMipStreams) {
+		mStreamable[stream.texture]->streamMip(fc, stream.mip);
+	}
+	mNumStreaming += static_cast<uint32_t>(mMipStreams.size());
+}
+
+} // namespace gr
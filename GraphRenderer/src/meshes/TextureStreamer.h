@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include <utility>
+#include <vulkan/vulkan.hpp>
+#include <concurrentqueue/concurrentqueue.h>
+
+#include "ResourcesHeader.h"
+#include "TextureProcessing/StreamingPolicy.h"
+
+namespace gr
+{
+
+class FrameContext;
+class Texture;
+
+// Residency of the mips of the textures loaded from the texture cache.
+// They are loaded with the mip tail only, and their bigger mips are streamed
+// when the objects that use them request them, according to their size on
+// screen. The memory of all the textures is kept under a budget, by evicting
+// the top mips of the least recently used textures, see tex::planMipStreams.
+// The requests are lock free, the rest is only used from the main thread.
+class TextureStreamer
+{
+public:
+
+	TextureStreamer() = default;
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	// Lock free, called by the objects drawn with the texture. The texture
+	// covers screenPixels pixels of the height of the viewport
+	void requestScreenSize(ResId texture, float screenPixels);
+
+	// Called once per frame, after the ResourceLoader. Swaps the mips
+	// streamed, and starts streaming the ones requested in the last frame
+	void update(FrameContext* fc);
+
+	void setBudget(vk::DeviceSize bytes) { mBudget = bytes; }
+	vk::DeviceSize getBudget() const { return mBudget; }
+
+	// Device memory of all the textures, and of the mips being streamed
+	vk::DeviceSize getUsedBytes() const { return mUsedBytes; }
+	uint32_t getNumStreaming() const { return mNumStreaming; }
+
+private:
+
+	vk::DeviceSize mBudget = 256ull << 20;
+	vk::DeviceSize mUsedBytes = 0;
+	uint32_t mNumStreaming = 0;
+
+	moodycamel::ConcurrentQueue<std::pair<ResId, float>> mRequests;
+
+	// Scratch storage of the update, reused every frame
+	std::vector<ResId> mTextures;
+	std::vector<Texture*> mStreamable;
+	std::vector<tex::StreamedTexture> mStreamed;
+	std::vector<uint32_t> mUpgrades;
+	std::vector<tex::MipStream> mMipStreams;
+};
+
+} // namespace gr
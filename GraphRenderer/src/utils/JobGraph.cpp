@@ -0,0 +1,97 @@
+#include "JobGraph.h"
+
+#include <algorithm>
+
+namespace gr
+{
+namespace grjob
+{
+
+uint32_t JobGraph::addNode(
+	const char* name,
+	ResourceMask reads,
+	ResourceMask writes,
+	uint32_t numElements,
+	uint32_t chunkSize,
+	ChunkFunction&& function)
+{
+	assert(chunkSize > 0);
+	const uint32_t idx = static_cast<uint32_t>(mNodes.size());
+
+	Node node;
+	node.name = name;
+	node.reads = reads;
+	node.writes = writes;
+	node.numElements = numElements;
+	node.chunkSize = chunkSize;
+	node.function = std::move(function);
+
+	for (uint32_t i = 0; i < idx; ++i) {
+		const Node& prev = mNodes[i];
+		const bool writeConflict = (prev.writes & (reads | writes)) != 0;
+		const bool readConflict = (prev.reads & writes) != 0;
+		if (writeConflict || readConflict) {
+			node.dependencies.push_back(i);
+		}
+	}
+
+	mNodes.push_back(std::move(node));
+
+	return idx;
+}
+
+void JobGraph::run(Priority priority)
+{
+	mPriority = priority;
+
+	// Nodes are scheduled in order, thus the counters of the
+	// dependencies always exist when a node starts
+	for (uint32_t i = 0; i < static_cast<uint32_t>(mNodes.size()); ++i) {
+		mNodes[i].counter = nullptr;
+		runJob(priority, Job(&JobGraph::s_runNode, this, i), &mNodes[i].counter);
+	}
+
+	// Wait for all before freeing, a node may still be waiting on a counter
+	for (Node& node : mNodes) {
+		waitForCounter(node.counter, 0);
+	}
+	for (Node& node : mNodes) {
+		waitForCounterAndFree(node.counter, 0);
+		node.counter = nullptr;
+	}
+}
+
+void JobGraph::s_runNode(JobGraph* graph, uint32_t nodeIdx)
+{
+	const Node& node = graph->mNodes[nodeIdx];
+
+	for (uint32_t dep : node.dependencies) {
+		waitForCounter(graph->mNodes[dep].counter, 0);
+	}
+
+	if (node.numElements == 0) {
+		return;
+	}
+
+	if (node.numElements <= node.chunkSize) {
+		node.function(0, node.numElements);
+		return;
+	}
+
+	std::vector<Job> jobs;
+	jobs.reserve((node.numElements + node.chunkSize - 1) / node.chunkSize);
+	for (uint32_t begin = 0; begin < node.numElements; begin += node.chunkSize) {
+		const uint32_t end = std::min(begin + node.chunkSize, node.numElements);
+		const Node* pNode = &node;
+		jobs.push_back(Job([pNode, begin, end]() {
+			pNode->function(begin, end);
+		}));
+	}
+
+	Counter* c = nullptr;
+	runJobBatch(graph->mPriority, jobs.data(), static_cast<uint32_t>(jobs.size()), &c);
+	waitForCounterAndFree(c, 0);
+}
+
+} // namespace grjob
+} // namespace gr
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+
+#include "grjob.h"
+
+namespace gr
+{
+namespace grjob
+{
+
+// Graph of jobs, where each node declares the resources that reads
+// and writes as a bit mask. A node waits for all the previous nodes that
+// write a resource that it accesses, or that read a resource that it writes.
+// Nodes without conflicts run concurrently, and each node splits its
+// elements in chunks that also run in parallel.
+class JobGraph
+{
+public:
+
+	typedef uint64_t ResourceMask;
+	// Function called for each chunk [begin, end) of a node
+	typedef std::function<void(uint32_t begin, uint32_t end)> ChunkFunction;
+
+	JobGraph() = default;
+	JobGraph& operator=(const JobGraph&) = delete;
+
+	// Nodes are ordered: a node can only depend on the ones added before it
+	uint32_t addNode(const char* name,
+		ResourceMask reads,
+		ResourceMask writes,
+		uint32_t numElements,
+		uint32_t chunkSize,
+		ChunkFunction&& function);
+
+	// Blocks the fiber until all nodes have finished
+	void run(Priority priority);
+
+	void clear() { mNodes.clear(); }
+
+	uint32_t size() const { return static_cast<uint32_t>(mNodes.size()); }
+
+protected:
+
+	struct Node {
+		const char* name;
+		ResourceMask reads;
+		ResourceMask writes;
+		uint32_t numElements;
+		uint32_t chunkSize;
+		ChunkFunction function;
+
+		std::vector<uint32_t> dependencies;
+		Counter* counter = nullptr;
+	};
+
+	std::vector<Node> mNodes;
+	Priority mPriority = Priority::eMid;
+
+	static void s_runNode(JobGraph* graph, uint32_t nodeIdx);
+};
+
+} // namespace grjob
+} // namespace gr
@@ -0,0 +1,174 @@
+#include "MappedFile.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace gr
+{
+namespace tools
+{
+
+MappedFile::MappedFile(MappedFile&& o) noexcept
+{
+	this->swap(o);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& o) noexcept
+{
+	if (this != &o) {
+		this->close();
+		this->swap(o);
+	}
+	return *this;
+}
+
+MappedFile::~MappedFile()
+{
+	this->close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const char* fileName)
+{
+	this->close();
+
+	HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize)) {
+		CloseHandle(file);
+		return false;
+	}
+
+	mFileHandle = file;
+	mSize = static_cast<size_t>(fileSize.QuadPart);
+	mIsOpen = true;
+
+	// empty files cannot be mapped
+	if (mSize == 0) {
+		return true;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		this->close();
+		return false;
+	}
+	mMappingHandle = mapping;
+
+	mData = reinterpret_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (mData == nullptr) {
+		this->close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (mData != nullptr) {
+		UnmapViewOfFile(mData);
+	}
+	if (mMappingHandle != nullptr) {
+		CloseHandle(mMappingHandle);
+	}
+	if (mFileHandle != nullptr) {
+		CloseHandle(mFileHandle);
+	}
+
+	mData = nullptr;
+	mSize = 0;
+	mIsOpen = false;
+	mMappingHandle = nullptr;
+	mFileHandle = nullptr;
+}
+
+void MappedFile::swap(MappedFile& o) noexcept
+{
+	std::swap(mData, o.mData);
+	std::swap(mSize, o.mSize);
+	std::swap(mIsOpen, o.mIsOpen);
+	std::swap(mFileHandle, o.mFileHandle);
+	std::swap(mMappingHandle, o.mMappingHandle);
+}
+
+#else
+
+bool MappedFile::open(const char* fileName)
+{
+	this->close();
+
+	int fd = ::open(fileName, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		::close(fd);
+		return false;
+	}
+
+	mFileDescriptor = fd;
+	mSize = static_cast<size_t>(st.st_size);
+	mIsOpen = true;
+
+	// empty files cannot be mapped
+	if (mSize == 0) {
+		return true;
+	}
+
+	void* ptr = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (ptr == MAP_FAILED) {
+		this->close();
+		return false;
+	}
+	madvise(ptr, mSize, MADV_SEQUENTIAL);
+	mData = reinterpret_cast<const uint8_t*>(ptr);
+
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (mData != nullptr) {
+		munmap(const_cast<uint8_t*>(mData), mSize);
+	}
+	if (mFileDescriptor >= 0) {
+		::close(mFileDescriptor);
+	}
+
+	mData = nullptr;
+	mSize = 0;
+	mIsOpen = false;
+	mFileDescriptor = -1;
+}
+
+void MappedFile::swap(MappedFile& o) noexcept
+{
+	std::swap(mData, o.mData);
+	std::swap(mSize, o.mSize);
+	std::swap(mIsOpen, o.mIsOpen);
+	std::swap(mFileDescriptor, o.mFileDescriptor);
+}
+
+#endif
+
+} // namespace tools
+} // namespace gr
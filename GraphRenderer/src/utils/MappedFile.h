@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include <cstddef>
+
+namespace gr
+{
+namespace tools
+{
+
+// Read only memory mapped file
+class MappedFile
+{
+public:
+
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& o) noexcept;
+	MappedFile& operator=(MappedFile&& o) noexcept;
+
+	~MappedFile();
+
+	// Returns false if the file cannot be opened or mapped
+	bool open(const char* fileName);
+	void close();
+
+	const uint8_t* data() const { return mData; }
+	size_t size() const { return mSize; }
+
+	bool isOpen() const { return mIsOpen; }
+
+private:
+
+	const uint8_t* mData = nullptr;
+	size_t mSize = 0;
+	bool mIsOpen = false;
+
+#ifdef _WIN32
+	void* mFileHandle = nullptr;
+	void* mMappingHandle = nullptr;
+#else
+	int mFileDescriptor = -1;
+#endif
+
+	void swap(MappedFile& o) noexcept;
+};
+
+} // namespace tools
+} // namespace gr
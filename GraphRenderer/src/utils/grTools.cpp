@@ -2,6 +2,9 @@
 
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <stb_image/stb_image.h>
 
 namespace gr
@@ -45,4 +48,68 @@ void tools::freeImage(uint8_t* img)
 	stbi_image_free(img);
 }
 
+namespace
+{
+float srgbToLinear(uint8_t c)
+{
+	const float v = static_cast<float>(c) / 255.0f;
+	return v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+}
+
+uint8_t linearToSrgb(float v)
+{
+	const float c = v <= 0.0031308f ? v * 12.92f : 1.055f * std::pow(v, 1.0f / 2.4f) - 0.055f;
+	return static_cast<uint8_t>(std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f));
+}
+} // namespace
+
+void tools::downsampleImageRGBA(
+	const uint8_t* img,
+	uint32_t width, uint32_t height,
+	bool srgb,
+	std::vector<uint8_t>* outImg)
+{
+	static const std::array<float, 256> toLinear = []() {
+		std::array<float, 256> table;
+		for (uint32_t i = 0; i < 256; ++i) {
+			table[i] = srgbToLinear(static_cast<uint8_t>(i));
+		}
+		return table;
+	}();
+
+	const uint32_t outWidth = std::max(width / 2, 1u);
+	const uint32_t outHeight = std::max(height / 2, 1u);
+	outImg->resize(4 * static_cast<size_t>(outWidth) * outHeight);
+
+	for (uint32_t y = 0; y < outHeight; ++y) {
+		// The odd rows and columns are clamped
+		const uint32_t y0 = std::min(2 * y, height - 1);
+		const uint32_t y1 = std::min(2 * y + 1, height - 1);
+		for (uint32_t x = 0; x < outWidth; ++x) {
+			const uint32_t x0 = std::min(2 * x, width - 1);
+			const uint32_t x1 = std::min(2 * x + 1, width - 1);
+			const uint8_t* texels[4] = {
+				img + 4 * (static_cast<size_t>(y0) * width + x0),
+				img + 4 * (static_cast<size_t>(y0) * width + x1),
+				img + 4 * (static_cast<size_t>(y1) * width + x0),
+				img + 4 * (static_cast<size_t>(y1) * width + x1)
+			};
+
+			uint8_t* dst = outImg->data() + 4 * (static_cast<size_t>(y) * outWidth + x);
+			for (uint32_t c = 0; c < 4; ++c) {
+				// alpha is always linear
+				if (srgb && c != 3) {
+					const float sum = toLinear[texels[0][c]] + toLinear[texels[1][c]] +
+						toLinear[texels[2][c]] + toLinear[texels[3][c]];
+					dst[c] = linearToSrgb(0.25f * sum);
+				}
+				else {
+					const uint32_t sum = texels[0][c] + texels[1][c] + texels[2][c] + texels[3][c];
+					dst[c] = static_cast<uint8_t>((sum + 2) / 4);
+				}
+			}
+		}
+	}
+}
+
 }; // namespace gr
@@ -21,6 +21,17 @@ void loadImageRGBA(
 
 void freeImage(uint8_t* img);
 
+// Box filter of 2x2 texels, the result is of max(width / 2, 1) x max(height / 2, 1).
+// If srgb, the colors are averaged in linear space. Used to generate the mips
+// of the formats that can not be blitted with a linear filter
+void downsampleImageRGBA(
+	const uint8_t* img,
+	uint32_t width,
+	uint32_t height,
+	bool srgb,
+	std::vector<uint8_t>* outImg
+);
+
 }; // namespace tools 
 }; // namespace gr
 
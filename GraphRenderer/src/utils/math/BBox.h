@@ -13,6 +13,8 @@ public:
 	AABBox() : mMin(std::numeric_limits<float>::infinity()),
 		mMax(-std::numeric_limits<float>::infinity()) {}
 
+	AABBox(const glm::vec3& min, const glm::vec3& max) : mMin(min), mMax(max) {}
+
 	inline const glm::vec3& getMin() const { return mMin; }
 	inline const glm::vec3& getMax() const { return mMax; }
 	inline glm::vec3 getSize() const { return mMax - mMin; }
@@ -0,0 +1,212 @@
+// Benchmark of the deduplication of the corners of the OBJ files, sequential and in the job
+// system, against the node based map of whole vertices used before. The input is a synthetic
+// grid of 1001x1001 vertices, with 6M corners. Build it with the job system:
+//   cl /std:c++17 /O2 /EHsc /I../src /I../../Libraries/includes CornerDedupBenchmark.cpp
+//       ../src/meshes/MeshProcessing/CornerDedup.cpp
+//       ../src/utils/grjob.cpp ../src/utils/Fibers/*.cpp
+// Returns 0 if all the versions find the same vertices.
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+
+#include "meshes/MeshProcessing/CornerDedup.h"
+#include "utils/grjob.h"
+
+#include <chrono>
+#include <cstdio>
+#include <unordered_map>
+#include <vector>
+
+using namespace gr;
+
+namespace
+{
+
+constexpr uint32_t GRID_SIZE = 1001;
+
+int gFailures = 0;
+
+void check(bool condition, const char* what)
+{
+	if (!condition) {
+		std::printf("FAILED: %s\n", what);
+		gFailures += 1;
+	}
+}
+
+// Mesh::Vertex
+struct Vertex {
+	glm::vec3 pos = glm::vec3(0.0f);
+	glm::vec3 color = glm::vec3(0.0f);
+	glm::vec3 normal = glm::vec3(0.0f);
+	glm::vec2 texCoord = glm::vec2(0.0f);
+
+	bool operator==(const Vertex& o) const
+	{
+		return this->pos == o.pos &&
+			this->normal == o.normal &&
+			this->color == o.color &&
+			this->texCoord == o.texCoord;
+	}
+};
+
+// The hash of the vertices before the corners were deduplicated
+struct VertexHash {
+	std::size_t operator()(const Vertex& o) const
+	{
+		return ((std::hash<glm::vec3>()(o.pos) ^
+			(std::hash<glm::vec3>()(o.normal)) ^
+			(std::hash<glm::vec3>()(o.color) << 1)) >> 1) ^
+			(std::hash<glm::vec2>()(o.texCoord) << 1);
+	}
+};
+
+struct Mesh {
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+};
+
+// A height field with a position, texture coordinate and normal for each vertex,
+// and two triangles for each quad
+mesh::ObjData createGrid()
+{
+	mesh::ObjData obj;
+	for (uint32_t y = 0; y < GRID_SIZE; ++y) {
+		for (uint32_t x = 0; x < GRID_SIZE; ++x) {
+			const float u = static_cast<float>(x) / (GRID_SIZE - 1);
+			const float v = static_cast<float>(y) / (GRID_SIZE - 1);
+			const float height = 0.1f * glm::sin(10.0f * u) * glm::cos(10.0f * v);
+			obj.positions.push_back(glm::vec3(u, height, v));
+			obj.texCoords.push_back(glm::vec2(u, v));
+			obj.normals.push_back(glm::normalize(glm::vec3(-height, 1.0f, height)));
+		}
+	}
+	for (uint32_t y = 0; y + 1 < GRID_SIZE; ++y) {
+		for (uint32_t x = 0; x + 1 < GRID_SIZE; ++x) {
+			const int32_t i = static_cast<int32_t>(y * GRID_SIZE + x);
+			const int32_t row = static_cast<int32_t>(GRID_SIZE);
+			const int32_t quad[6] = { i, i + 1, i + row, i + 1, i + row + 1, i + row };
+			for (int32_t c : quad) {
+				obj.corners.push_back(mesh::ObjCorner{ c, c, c });
+			}
+		}
+	}
+	return obj;
+}
+
+Vertex getVertex(const mesh::ObjData& obj, const mesh::ObjCorner& idx)
+{
+	Vertex v;
+	v.pos = obj.positions[idx.vertex];
+	if (idx.texCoord >= 0) {
+		v.texCoord = obj.texCoords[idx.texCoord];
+	}
+	if (idx.normal >= 0) {
+		v.normal = obj.normals[idx.normal];
+	}
+	v.color = obj.colors.empty() ? glm::vec3(1.0f) : obj.colors[idx.vertex];
+	return v;
+}
+
+// Mesh::parseObj before the corners were deduplicated
+void deduplicateVertices(const mesh::ObjData& obj, Mesh* mesh)
+{
+	std::unordered_map<Vertex, uint32_t, VertexHash> verticesCache;
+
+	mesh->indices.reserve(obj.corners.size());
+	for (const mesh::ObjCorner& idx : obj.corners) {
+		const Vertex v = getVertex(obj, idx);
+		const decltype(verticesCache)::const_iterator it = verticesCache.find(v);
+		if (it != verticesCache.end()) {
+			mesh->indices.push_back(it->second);
+		}
+		else {
+			mesh->indices.push_back(static_cast<uint32_t>(mesh->vertices.size()));
+			mesh->vertices.push_back(v);
+			verticesCache.emplace(v, mesh->indices.back());
+		}
+	}
+}
+
+// Mesh::parseObj
+void deduplicateCorners(const mesh::ObjData& obj, bool parallel, Mesh* mesh)
+{
+	std::vector<mesh::ObjCorner> uniqueCorners;
+	if (parallel) {
+		mesh::deduplicateCornersParallel(obj.corners.data(),
+			static_cast<uint32_t>(obj.corners.size()), &uniqueCorners, &mesh->indices);
+	}
+	else {
+		mesh::deduplicateCorners(obj.corners.data(),
+			static_cast<uint32_t>(obj.corners.size()), &uniqueCorners, &mesh->indices);
+	}
+
+	mesh->vertices.resize(uniqueCorners.size());
+	for (size_t i = 0; i < uniqueCorners.size(); ++i) {
+		mesh->vertices[i] = getVertex(obj, uniqueCorners[i]);
+	}
+}
+
+template<typename F>
+double measure(F&& f)
+{
+	const auto start = std::chrono::steady_clock::now();
+	f();
+	const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+	return seconds.count();
+}
+
+// The vertices of the triangles, whatever their order
+bool sameTriangles(const Mesh& a, const Mesh& b)
+{
+	if (a.vertices.size() != b.vertices.size() || a.indices.size() != b.indices.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < a.indices.size(); ++i) {
+		if (!(a.vertices[a.indices[i]] == b.vertices[b.indices[i]])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void runBenchmark()
+{
+	const mesh::ObjData obj = createGrid();
+
+	Mesh map, serial, parallel;
+	const double mapSeconds = measure([&]() { deduplicateVertices(obj, &map); });
+	const double serialSeconds = measure([&]() { deduplicateCorners(obj, false, &serial); });
+	const double parallelSeconds = measure([&]() { deduplicateCorners(obj, true, &parallel); });
+
+	std::printf("%zu corners, %zu unique vertices, %u threads\n",
+		obj.corners.size(), map.vertices.size(), grjob::getNumThreads());
+	std::printf("map of vertices   %.3fs\n", mapSeconds);
+	std::printf("corners           %.3fs, %.1fx\n", serialSeconds, mapSeconds / serialSeconds);
+	std::printf("corners parallel  %.3fs, %.1fx\n", parallelSeconds, mapSeconds / parallelSeconds);
+
+	check(map.vertices.size() == static_cast<size_t>(GRID_SIZE) * GRID_SIZE, "the map finds all the vertices");
+	check(sameTriangles(map, serial), "the corners give the same triangles");
+	check(sameTriangles(map, parallel), "the corners in parallel give the same triangles");
+}
+
+} // namespace
+
+int main()
+{
+	// as the engine
+	grjob::createSystem(6);
+	grjob::Job mainJob([]() {
+		runBenchmark();
+		grjob::stopRunningJobSystem();
+	});
+	grjob::runJobOnMainThread(mainJob, nullptr, true);
+	grjob::startRunningJobSystem();
+	grjob::destroySystem();
+
+	if (gFailures != 0) {
+		return 1;
+	}
+	std::printf("Passed\n");
+	return 0;
+}
@@ -0,0 +1,222 @@
+// Test of the mesh cache: a processed mesh is written to a .grmesh file and loaded back
+// through the memory mapped reader, as the meshes do without a device. It also checks
+// when the cache is outdated by its source. Build it with the cache and the mapped files:
+//   c++ -std=c++17 -O2 -I../src -I../../Libraries/includes MeshCacheTest.cpp
+//       ../src/meshes/MeshProcessing/MeshCache.cpp ../src/utils/MappedFile.cpp -o MeshCacheTest
+// Returns 0 if it passes.
+
+#include "meshes/MeshProcessing/MeshCache.h"
+#include "meshes/MeshProcessing/MeshSimplifier.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <vector>
+
+using namespace gr;
+
+namespace
+{
+
+constexpr uint32_t GRID_SIZE = 1000;
+
+int gFailures = 0;
+
+void check(bool condition, const char* what)
+{
+	if (!condition) {
+		std::printf("FAILED: %s\n", what);
+		gFailures += 1;
+	}
+}
+
+// Mesh::Vertex
+struct Vertex {
+	glm::vec3 pos;
+	glm::vec3 color;
+	glm::vec3 normal;
+	glm::vec2 texCoord;
+};
+
+struct MeshData {
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	glm::vec3 bboxMin = glm::vec3(0.0f);
+	glm::vec3 bboxMax = glm::vec3(0.0f);
+};
+
+// A height field, with two triangles for each quad
+MeshData createGrid()
+{
+	MeshData mesh;
+	for (uint32_t y = 0; y < GRID_SIZE; ++y) {
+		for (uint32_t x = 0; x < GRID_SIZE; ++x) {
+			const float u = static_cast<float>(x) / (GRID_SIZE - 1);
+			const float v = static_cast<float>(y) / (GRID_SIZE - 1);
+			const float height = 0.1f * std::sin(10.0f * u) * std::cos(10.0f * v);
+			mesh.vertices.push_back(Vertex{ glm::vec3(u, height, v), glm::vec3(1.0f),
+				glm::normalize(glm::vec3(-height, 1.0f, height)), glm::vec2(u, v) });
+			mesh.bboxMin = glm::min(mesh.bboxMin, mesh.vertices.back().pos);
+			mesh.bboxMax = glm::max(mesh.bboxMax, mesh.vertices.back().pos);
+		}
+	}
+	for (uint32_t y = 0; y + 1 < GRID_SIZE; ++y) {
+		for (uint32_t x = 0; x + 1 < GRID_SIZE; ++x) {
+			const uint32_t i = y * GRID_SIZE + x;
+			mesh.indices.insert(mesh.indices.end(),
+				{ i, i + 1, i + GRID_SIZE, i + 1, i + GRID_SIZE + 1, i + GRID_SIZE });
+		}
+	}
+	return mesh;
+}
+
+// The source that the cache was imported from, only its size, write time and hash matter
+void writeSource(const std::filesystem::path& path, char firstVertex)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file << "v " << firstVertex << " 0 0\nv 0 1 0\nv 0 0 1\nf 1 2 3\n";
+}
+
+// Mesh::writeCache
+void writeCache(const std::filesystem::path& cachePath, const std::filesystem::path& sourcePath,
+	const MeshData& mesh)
+{
+	const std::vector<mesh::LodRange> lods = { mesh::LodRange{ 0, static_cast<uint32_t>(mesh.indices.size()), 0.0f } };
+
+	mesh::MeshCacheHeader header;
+	mesh::getSourceInfo(sourcePath, &header);
+	header.sourceHash = mesh::hashFile(sourcePath);
+	header.bboxMin = mesh.bboxMin;
+	header.bboxMax = mesh.bboxMax;
+
+	mesh::MeshCacheWriter writer;
+	writer.addSection(mesh::MeshCacheSectionType::eVertices, sizeof(Vertex),
+		mesh.vertices.size(), mesh.vertices.data());
+	writer.addSection(mesh::MeshCacheSectionType::eIndices, sizeof(uint32_t),
+		mesh.indices.size(), mesh.indices.data());
+	writer.addSection(mesh::MeshCacheSectionType::eLods, sizeof(mesh::LodRange),
+		lods.size(), lods.data());
+	writer.write(cachePath, header);
+}
+
+// Mesh::loadFromCache, the sections are copied as they are to the staging memory
+bool loadCache(const mesh::MeshCacheReader& cache, const MeshData& mesh, std::vector<uint8_t>* staging)
+{
+	const mesh::MeshCacheSection* vertices = cache.findSection(mesh::MeshCacheSectionType::eVertices);
+	const mesh::MeshCacheSection* indices = cache.findSection(mesh::MeshCacheSectionType::eIndices);
+	const mesh::MeshCacheSection* lods = cache.findSection(mesh::MeshCacheSectionType::eLods);
+	if (vertices == nullptr || indices == nullptr || lods == nullptr) {
+		return false;
+	}
+
+	const uint64_t vertexBytes = cache.getSectionBytes(*vertices);
+	const uint64_t indexBytes = cache.getSectionBytes(*indices);
+	staging->resize(vertexBytes + indexBytes);
+	std::memcpy(staging->data(), cache.getSectionData(*vertices), vertexBytes);
+	std::memcpy(staging->data() + vertexBytes, cache.getSectionData(*indices), indexBytes);
+
+	const mesh::LodRange* lod = reinterpret_cast<const mesh::LodRange*>(cache.getSectionData(*lods));
+	return vertices->elementSize == sizeof(Vertex) && vertices->count == mesh.vertices.size() &&
+		indices->count == mesh.indices.size() && lods->count == 1 && lod->numIndices == mesh.indices.size() &&
+		vertices->offset % mesh::SECTION_ALIGNMENT == 0 && indices->offset % mesh::SECTION_ALIGNMENT == 0 &&
+		std::memcmp(staging->data(), mesh.vertices.data(), vertexBytes) == 0 &&
+		std::memcmp(staging->data() + vertexBytes, mesh.indices.data(), indexBytes) == 0;
+}
+
+bool isCacheValid(const std::filesystem::path& cachePath, const std::filesystem::path& sourcePath)
+{
+	mesh::MeshCacheReader cache;
+	return cache.open(cachePath, sourcePath);
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start)
+{
+	const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+	return seconds.count();
+}
+
+void testCache(const std::filesystem::path& dir)
+{
+	const std::filesystem::path sourcePath = dir / "grid.obj";
+	const std::filesystem::path cachePath = dir / "grid.grmesh";
+	const MeshData mesh = createGrid();
+	writeSource(sourcePath, '0');
+
+	auto start = std::chrono::steady_clock::now();
+	writeCache(cachePath, sourcePath, mesh);
+	const double writeSeconds = secondsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	std::vector<uint8_t> staging;
+	mesh::MeshCacheReader cache;
+	const bool opened = cache.open(cachePath, sourcePath);
+	const bool loaded = opened && loadCache(cache, mesh, &staging);
+	const double loadSeconds = secondsSince(start);
+
+	check(opened, "the cache is opened");
+	check(loaded, "the sections are loaded as they were written");
+	check(opened && cache.findSection(mesh::MeshCacheSectionType::eMeshlets) == nullptr,
+		"the sections that were not written are not found");
+	check(opened && cache.getHeader().bboxMin == mesh.bboxMin && cache.getHeader().bboxMax == mesh.bboxMax,
+		"the header keeps the bounding box");
+	cache.close();
+
+	const double megabytes = static_cast<double>(std::filesystem::file_size(cachePath)) / (1 << 20);
+	std::printf("%.1f MB cache, written in %.3fs, loaded in %.3fs, %.0f MB/s\n",
+		megabytes, writeSeconds, loadSeconds, megabytes / loadSeconds);
+
+	// The source is written again with the same content, as when it is checked out again
+	const std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(sourcePath);
+	std::filesystem::last_write_time(sourcePath, writeTime + std::chrono::hours(1));
+	check(isCacheValid(cachePath, sourcePath), "the cache is valid if only the write time changes");
+
+	// An edit of the same size, written so close to the cache that the time does not tell
+	writeSource(sourcePath, '1');
+	std::filesystem::last_write_time(sourcePath, writeTime);
+	check(!isCacheValid(cachePath, sourcePath), "the cache is outdated by an edit of the same size");
+
+	writeSource(sourcePath, '0');
+	std::ofstream(sourcePath, std::ios::binary | std::ios::app) << "f 3 2 1\n";
+	check(!isCacheValid(cachePath, sourcePath), "the cache is outdated by an edit of another size");
+
+	std::filesystem::remove(sourcePath);
+	check(isCacheValid(cachePath, sourcePath), "the cache is used without its source");
+
+	// Cache of another version
+	{
+		std::fstream file(cachePath, std::ios::binary | std::ios::in | std::ios::out);
+		const uint32_t version = mesh::MeshCacheHeader::VERSION + 1;
+		file.seekp(offsetof(mesh::MeshCacheHeader, version));
+		file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+	}
+	check(!isCacheValid(cachePath, sourcePath), "the caches of other versions are not used");
+}
+
+} // namespace
+
+int main()
+{
+	const std::filesystem::path dir = std::filesystem::temp_directory_path() / "MeshCacheTest";
+	std::filesystem::create_directories(dir);
+
+	try {
+		testCache(dir);
+	}
+	catch (const std::exception& e) {
+		std::printf("%s\n", e.what());
+		check(false, "the cache is written and read");
+	}
+
+	std::error_code ec;
+	std::filesystem::remove_all(dir, ec);
+
+	if (gFailures != 0) {
+		return 1;
+	}
+	std::printf("Passed\n");
+	return 0;
+}
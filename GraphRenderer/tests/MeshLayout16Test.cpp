@@ -0,0 +1,148 @@
+// Test of the 16 bit indices of the meshes with more than 65536 vertices.
+// It does not need the engine nor a device, build it with the mesh optimizer:
+//   c++ -std=c++17 -O2 -I../src -I../../Libraries/includes MeshLayout16Test.cpp
+//       ../src/meshes/MeshProcessing/MeshOptimizer.cpp -o MeshLayout16Test
+// Returns 0 if it passes.
+
+#include "meshes/MeshProcessing/MeshOptimizer.h"
+#include "meshes/MeshProcessing/MeshSimplifier.h"
+
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <vector>
+#include <glm/glm.hpp>
+
+using namespace gr;
+
+namespace
+{
+
+// As in Mesh.cpp
+constexpr uint32_t MAX_SUBMESHES_PER_65536_VERTICES = 2;
+constexpr uint32_t REGION_MAX_VERTICES = 57344;
+
+// Side of the grid, 409600 vertices
+constexpr uint32_t GRID_SIZE = 640;
+constexpr uint32_t NUM_LODS = 4;
+
+int gFailures = 0;
+
+void check(bool condition, const char* what)
+{
+	if (!condition) {
+		std::printf("FAILED: %s\n", what);
+		gFailures += 1;
+	}
+}
+
+// Triangles of the grid that use every step vertices, so that the LODs share the vertices
+void appendGrid(uint32_t step, std::vector<uint32_t>* indices)
+{
+	for (uint32_t y = 0; y + step < GRID_SIZE; y += step) {
+		for (uint32_t x = 0; x + step < GRID_SIZE; x += step) {
+			const uint32_t a = y * GRID_SIZE + x;
+			const uint32_t b = a + step;
+			const uint32_t c = a + step * GRID_SIZE;
+			const uint32_t d = c + step;
+			indices->insert(indices->end(), { a, b, c, b, d, c });
+		}
+	}
+}
+
+} // namespace
+
+int main()
+{
+	// A connected surface, as an imported mesh
+	std::vector<glm::vec3> positions;
+	for (uint32_t y = 0; y < GRID_SIZE; ++y) {
+		for (uint32_t x = 0; x < GRID_SIZE; ++x) {
+			positions.push_back(glm::vec3(x, y, 8.0f * std::sin(0.1f * x) * std::cos(0.13f * y)) / float(GRID_SIZE));
+		}
+	}
+	uint32_t numVertices = static_cast<uint32_t>(positions.size());
+	std::vector<uint32_t> indices;
+	appendGrid(1, &indices);
+
+	// Mesh::optimize
+	std::vector<uint32_t> clusters;
+	mesh::optimizeVertexCache(indices.data(), indices.size(), numVertices,
+		mesh::VERTEX_CACHE_SIZE, &clusters);
+	mesh::optimizeOverdraw(indices.data(), indices.size(), clusters,
+		positions.data(), sizeof(glm::vec3), numVertices);
+	std::vector<uint32_t> triangleRegions;
+	const uint32_t numRegions = mesh::partitionTriangles(indices.data(), indices.size(),
+		positions.data(), sizeof(glm::vec3), numVertices, REGION_MAX_VERTICES, &triangleRegions);
+	check(numRegions > 1, "the mesh is split in regions");
+	std::vector<uint32_t> remap;
+	check(mesh::optimizeVertexFetchRemap(indices.data(), indices.size(), numVertices, &remap) == numVertices,
+		"all the vertices are used");
+
+	// Mesh::generateLods, the LODs are coarser grids of the same vertices
+	std::vector<mesh::LodRange> lods(1, mesh::LodRange{ 0, static_cast<uint32_t>(indices.size()), 0.0f });
+	std::vector<uint32_t> vertexRegions;
+	mesh::getVertexRegions(indices.data(), indices.size(), triangleRegions.data(), numVertices, &vertexRegions);
+	for (uint32_t lod = 1; lod < NUM_LODS; ++lod) {
+		std::vector<uint32_t> lodIndices;
+		appendGrid(1u << lod, &lodIndices);
+		for (uint32_t& i : lodIndices) {
+			i = remap[i];
+		}
+		mesh::optimizeVertexCache(lodIndices.data(), lodIndices.size(), numVertices);
+		std::vector<uint32_t> lodRegions;
+		mesh::sortTrianglesByRegion(lodIndices.data(), lodIndices.size(),
+			vertexRegions.data(), numRegions, &lodRegions);
+		triangleRegions.insert(triangleRegions.end(), lodRegions.begin(), lodRegions.end());
+		lods.push_back(mesh::LodRange{ static_cast<uint32_t>(indices.size()),
+			static_cast<uint32_t>(lodIndices.size()), 0.0f });
+		indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+	}
+
+	// Without the layout, the triangles address vertices too far apart
+	const uint32_t maxSubmeshes = MAX_SUBMESHES_PER_65536_VERTICES *
+		(numVertices / (std::numeric_limits<uint16_t>::max() + 1) + 1);
+	std::vector<mesh::Submesh> submeshes;
+	std::vector<uint32_t> lodFirstSubmesh;
+	std::vector<uint16_t> indices16;
+	check(!mesh::splitIndices16(indices.data(), lods.data(), lods.size(), maxSubmeshes,
+		&submeshes, &lodFirstSubmesh, &indices16), "the optimized order needs the layout");
+
+	// Mesh::layoutVertices
+	const std::vector<uint32_t> oldIndices = indices;
+	std::vector<uint32_t> source;
+	check(mesh::layoutRegionVertices(indices.data(), indices.size(), triangleRegions.data(),
+		numRegions, numVertices, &source), "the regions fit in 16 bit indices");
+	check(source.size() < numVertices + numVertices / 10, "less than 10% of the vertices are duplicated");
+	for (size_t i = 0; i < indices.size(); ++i) {
+		if (indices[i] >= source.size() || source[indices[i]] != oldIndices[i]) {
+			check(false, "the layout keeps the triangles");
+			break;
+		}
+	}
+	numVertices = static_cast<uint32_t>(source.size());
+
+	// Mesh::prepareBuffers, the mesh ends up with 16 bit indices
+	const uint32_t maxLaidOutSubmeshes = MAX_SUBMESHES_PER_65536_VERTICES *
+		(numVertices / (std::numeric_limits<uint16_t>::max() + 1) + 1);
+	check(mesh::splitIndices16(indices.data(), lods.data(), lods.size(), maxLaidOutSubmeshes,
+		&submeshes, &lodFirstSubmesh, &indices16), "every LOD is drawn with 16 bit indices");
+	check(lodFirstSubmesh.size() == lods.size() + 1 && lodFirstSubmesh.back() == submeshes.size(),
+		"the submeshes of every LOD");
+	for (const mesh::Submesh& s : submeshes) {
+		for (uint32_t i = s.firstIndex; i < s.firstIndex + s.numIndices; ++i) {
+			if (s.vertexOffset + static_cast<uint32_t>(indices16[i]) != indices[i]) {
+				check(false, "the submeshes address the same vertices");
+				break;
+			}
+		}
+	}
+
+	std::printf("%u regions, %u vertices laid out from %zu, %zu submeshes for %zu LODs\n",
+		numRegions, numVertices, positions.size(), submeshes.size(), lods.size());
+	if (gFailures != 0) {
+		return 1;
+	}
+	std::printf("Passed\n");
+	return 0;
+}
@@ -0,0 +1,110 @@
+// Test of the relative indices of the OBJ faces whose vertices are in the previous chunk.
+// It runs the parser in the job system, as the engine does. Build it with the job system:
+//   cl /std:c++17 /O2 /EHsc /I../src /I../../Libraries/includes ObjParserChunkTest.cpp
+//       ../src/meshes/MeshProcessing/ObjParser.cpp ../src/utils/MappedFile.cpp
+//       ../src/utils/grjob.cpp ../src/utils/Fibers/*.cpp
+// Returns 0 if it passes.
+
+#include "meshes/MeshProcessing/ObjParser.h"
+#include "utils/grjob.h"
+
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+using namespace gr;
+
+namespace
+{
+
+// Bigger than several chunks of the parser, of 1 MB at least
+constexpr uint32_t NUM_FACES = 100000;
+
+int gFailures = 0;
+
+void check(bool condition, const char* what)
+{
+	if (!condition) {
+		std::printf("FAILED: %s\n", what);
+		gFailures += 1;
+	}
+}
+
+// Each face has its own vertices, texture coordinates and normals, referenced with
+// negative indices, so that the chunks split some faces from the lines they use
+void writeObj(const std::filesystem::path& path)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	for (uint32_t f = 0; f < NUM_FACES; ++f) {
+		for (uint32_t i = 0; i < 3; ++i) {
+			file << "v " << f << ' ' << i << " 0\n";
+		}
+		for (uint32_t i = 0; i < 3; ++i) {
+			file << "vt " << i << ' ' << f << '\n';
+		}
+		for (uint32_t i = 0; i < 3; ++i) {
+			file << "vn 0 " << i << ' ' << f << '\n';
+		}
+		file << "f -3/-3/-3 -2/-2/-2 -1/-1/-1\n";
+	}
+}
+
+void testChunks(const std::filesystem::path& path)
+{
+	writeObj(path);
+	check(std::filesystem::file_size(path) > (3u << 20), "the file has several chunks");
+
+	mesh::ObjData data;
+	try {
+		mesh::parseObj(path.string().c_str(), &data);
+	}
+	catch (const std::exception& e) {
+		std::printf("%s\n", e.what());
+		check(false, "the file is parsed");
+		return;
+	}
+
+	check(data.positions.size() == 3 * NUM_FACES && data.texCoords.size() == 3 * NUM_FACES &&
+		data.normals.size() == 3 * NUM_FACES, "all the attributes are read");
+	check(data.corners.size() == 3 * NUM_FACES, "all the faces are read");
+	for (uint32_t c = 0; c < data.corners.size(); ++c) {
+		const mesh::ObjCorner& corner = data.corners[c];
+		const glm::vec3 pos = data.positions[corner.vertex];
+		const glm::vec2 uv = data.texCoords[corner.texCoord];
+		const glm::vec3 normal = data.normals[corner.normal];
+		const float face = static_cast<float>(c / 3);
+		const float i = static_cast<float>(c % 3);
+		if (pos != glm::vec3(face, i, 0.0f) || uv != glm::vec2(i, face) || normal != glm::vec3(0.0f, i, face)) {
+			check(false, "the corners use the lines before the face");
+			break;
+		}
+	}
+}
+
+} // namespace
+
+int main()
+{
+	const std::filesystem::path path = std::filesystem::temp_directory_path() / "ObjParserChunkTest.obj";
+
+	grjob::createSystem(4);
+	grjob::Job mainJob([&path]() {
+		testChunks(path);
+		grjob::stopRunningJobSystem();
+	});
+	grjob::runJobOnMainThread(mainJob, nullptr, true);
+	grjob::startRunningJobSystem();
+	grjob::destroySystem();
+
+	std::error_code ec;
+	std::filesystem::remove(path, ec);
+
+	std::printf("%u faces\n", NUM_FACES);
+	if (gFailures != 0) {
+		return 1;
+	}
+	std::printf("Passed\n");
+	return 0;
+}
@@ -0,0 +1,284 @@
+// Benchmark of the lookups of the ResourceDictionary from 16 threads, with the slot map
+// against the previous map under a shared mutex. The dictionary includes all the resources
+// and the device, so both lookups are reproduced here as ResourceDictionary::findObject and
+// castObject do them, and as they were before. It only needs the standard library:
+//   c++ -std=c++17 -O2 -pthread ResourceLookupBenchmark.cpp -o ResourceLookupBenchmark
+// Returns 0 if all the lookups return the right objects.
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+
+constexpr uint32_t NUM_THREADS = 16;
+constexpr uint32_t LOOKUPS_PER_THREAD = 1000000;
+constexpr uint32_t NUM_OBJECTS = 10000;
+// Type of the objects looked up, as the index of Mesh in ResourceTypesList
+constexpr uint32_t TYPE_IDX = 0;
+constexpr uint64_t INVALID_ID = std::numeric_limits<uint64_t>::max();
+
+int gFailures = 0;
+
+void check(bool condition, const char* what)
+{
+	if (!condition) {
+		std::printf("FAILED: %s\n", what);
+		gFailures += 1;
+	}
+}
+
+// As ResId, the slot index in the low 32 bits and the generation in the high 32 bits
+uint64_t makeId(uint32_t slot, uint32_t generation)
+{
+	return (static_cast<uint64_t>(generation) << 32) | slot;
+}
+
+struct IObject {
+	virtual ~IObject() = default;
+	uint64_t id = INVALID_ID;
+};
+
+struct Mesh : IObject {
+};
+
+// ResourceDictionary before the slot map
+class MapDictionary
+{
+public:
+
+	void insert(uint64_t id, IObject* object)
+	{
+		std::unique_lock lock(mObjectsMutex);
+		mObjectsDictionary.emplace(id, object);
+	}
+
+	void erase(uint64_t id)
+	{
+		std::unique_lock lock(mObjectsMutex);
+		mObjectsDictionary.erase(id);
+	}
+
+	Mesh* get(uint64_t id) const
+	{
+		std::shared_lock lock(mObjectsMutex);
+		const auto it = mObjectsDictionary.find(id);
+		return it != mObjectsDictionary.end() ? dynamic_cast<Mesh*>(it->second) : nullptr;
+	}
+
+private:
+
+	std::unordered_map<uint64_t, IObject*> mObjectsDictionary;
+	mutable std::shared_mutex mObjectsMutex;
+};
+
+// The slots of ResourceDictionary, with a single writer
+class SlotDictionary
+{
+public:
+
+	SlotDictionary()
+	{
+		for (std::atomic<Slot*>& chunk : mSlotChunks) {
+			chunk.store(nullptr, std::memory_order_relaxed);
+		}
+	}
+
+	~SlotDictionary()
+	{
+		for (std::atomic<Slot*>& chunk : mSlotChunks) {
+			delete[] chunk.load(std::memory_order_relaxed);
+		}
+	}
+
+	void insert(uint64_t id, IObject* object)
+	{
+		Slot* slot = createSlot(static_cast<uint32_t>(id));
+		slot->typeIdx.store(TYPE_IDX, std::memory_order_release);
+		slot->object.store(object, std::memory_order_release);
+		slot->id.store(id, std::memory_order_release);
+	}
+
+	void erase(uint64_t id)
+	{
+		Slot* slot = getSlot(static_cast<uint32_t>(id));
+		slot->id.store(INVALID_ID, std::memory_order_release);
+		slot->object.store(nullptr, std::memory_order_release);
+	}
+
+	Mesh* get(uint64_t id) const
+	{
+		const Slot* slot = getSlot(static_cast<uint32_t>(id));
+		if (slot == nullptr) {
+			return nullptr;
+		}
+		IObject* object = slot->object.load(std::memory_order_acquire);
+		const uint32_t typeIdx = slot->typeIdx.load(std::memory_order_acquire);
+		if (slot->id.load(std::memory_order_acquire) != id) {
+			return nullptr;
+		}
+		return typeIdx == TYPE_IDX ? static_cast<Mesh*>(object) : nullptr;
+	}
+
+private:
+
+	struct Slot {
+		std::atomic<uint64_t> id;
+		std::atomic<IObject*> object;
+		std::atomic<uint32_t> typeIdx;
+	};
+
+	static constexpr uint32_t SLOT_CHUNK_SIZE = 1024;
+	static constexpr uint32_t MAX_SLOT_CHUNKS = 4096;
+
+	std::array<std::atomic<Slot*>, MAX_SLOT_CHUNKS> mSlotChunks;
+
+	Slot* getSlot(uint32_t slotIdx) const
+	{
+		const uint32_t chunkIdx = slotIdx / SLOT_CHUNK_SIZE;
+		if (chunkIdx >= MAX_SLOT_CHUNKS) {
+			return nullptr;
+		}
+		Slot* chunk = mSlotChunks[chunkIdx].load(std::memory_order_acquire);
+		return chunk != nullptr ? chunk + (slotIdx % SLOT_CHUNK_SIZE) : nullptr;
+	}
+
+	Slot* createSlot(uint32_t slotIdx)
+	{
+		const uint32_t chunkIdx = slotIdx / SLOT_CHUNK_SIZE;
+		if (mSlotChunks[chunkIdx].load(std::memory_order_relaxed) == nullptr) {
+			Slot* chunk = new Slot[SLOT_CHUNK_SIZE];
+			for (uint32_t i = 0; i < SLOT_CHUNK_SIZE; ++i) {
+				chunk[i].id.store(INVALID_ID, std::memory_order_relaxed);
+				chunk[i].object.store(nullptr, std::memory_order_relaxed);
+				chunk[i].typeIdx.store(0, std::memory_order_relaxed);
+			}
+			mSlotChunks[chunkIdx].store(chunk, std::memory_order_release);
+		}
+		return getSlot(slotIdx);
+	}
+};
+
+struct Result {
+	double lookupsPerSecond = 0.0;
+	uint64_t misses = 0;
+	uint64_t wrongObjects = 0;
+	uint64_t replacements = 0;
+};
+
+// NUM_THREADS threads look up random objects. If replacing, another thread erases
+// objects and inserts them again with the next generation, as erase and allocateObject.
+// The objects are deleted at the end, as the dictionary retires them for the readers
+template<typename Dictionary>
+Result runLookups(bool replacing)
+{
+	Dictionary dictionary;
+	std::vector<std::unique_ptr<Mesh>> objects;
+	std::unique_ptr<std::atomic<uint64_t>[]> ids(new std::atomic<uint64_t>[NUM_OBJECTS]);
+	for (uint32_t i = 0; i < NUM_OBJECTS; ++i) {
+		objects.push_back(std::make_unique<Mesh>());
+		objects.back()->id = makeId(i, 0);
+		dictionary.insert(objects.back()->id, objects.back().get());
+		ids[i].store(objects.back()->id, std::memory_order_relaxed);
+	}
+
+	Result result;
+	std::atomic<uint32_t> numRunning{ NUM_THREADS };
+	std::atomic<uint64_t> misses{ 0 };
+	std::atomic<uint64_t> wrongObjects{ 0 };
+
+	std::thread writer([&]() {
+		uint32_t rng = 12345;
+		while (replacing && numRunning.load(std::memory_order_relaxed) > 0) {
+			rng = rng * 1664525u + 1013904223u;
+			const uint32_t slot = (rng >> 8) % NUM_OBJECTS;
+			const uint64_t oldId = ids[slot].load(std::memory_order_relaxed);
+			objects.push_back(std::make_unique<Mesh>());
+			objects.back()->id = makeId(slot, static_cast<uint32_t>(oldId >> 32) + 1);
+			dictionary.erase(oldId);
+			dictionary.insert(objects.back()->id, objects.back().get());
+			ids[slot].store(objects.back()->id, std::memory_order_release);
+			result.replacements += 1;
+			std::this_thread::sleep_for(std::chrono::microseconds(10));
+		}
+	});
+
+	const auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> readers;
+	for (uint32_t t = 0; t < NUM_THREADS; ++t) {
+		readers.emplace_back([&, t]() {
+			uint32_t rng = t + 1;
+			uint64_t threadMisses = 0;
+			uint64_t threadWrong = 0;
+			for (uint32_t i = 0; i < LOOKUPS_PER_THREAD; ++i) {
+				rng = rng * 1664525u + 1013904223u;
+				const uint64_t id = ids[(rng >> 8) % NUM_OBJECTS].load(std::memory_order_acquire);
+				const Mesh* mesh = dictionary.get(id);
+				if (mesh == nullptr) {
+					threadMisses += 1;
+				}
+				else if (mesh->id != id) {
+					threadWrong += 1;
+				}
+			}
+			misses.fetch_add(threadMisses, std::memory_order_relaxed);
+			wrongObjects.fetch_add(threadWrong, std::memory_order_relaxed);
+			numRunning.fetch_sub(1, std::memory_order_relaxed);
+		});
+	}
+	for (std::thread& reader : readers) {
+		reader.join();
+	}
+	const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+	writer.join();
+
+	result.lookupsPerSecond = static_cast<double>(NUM_THREADS) * LOOKUPS_PER_THREAD / seconds.count();
+	result.misses = misses.load();
+	result.wrongObjects = wrongObjects.load();
+	return result;
+}
+
+void printResult(const char* name, const Result& result)
+{
+	std::printf("%-28s %8.1f M lookups/s, %llu replaced, %llu misses\n", name,
+		result.lookupsPerSecond * 1e-6, static_cast<unsigned long long>(result.replacements),
+		static_cast<unsigned long long>(result.misses));
+}
+
+} // namespace
+
+int main()
+{
+	const Result mapRead = runLookups<MapDictionary>(false);
+	const Result slotRead = runLookups<SlotDictionary>(false);
+	const Result mapReplacing = runLookups<MapDictionary>(true);
+	const Result slotReplacing = runLookups<SlotDictionary>(true);
+
+	std::printf("%u threads, %u objects\n", NUM_THREADS, NUM_OBJECTS);
+	printResult("map, read only", mapRead);
+	printResult("slot map, read only", slotRead);
+	printResult("map, replacing objects", mapReplacing);
+	printResult("slot map, replacing objects", slotReplacing);
+	std::printf("slot map speedup: %.1fx read only, %.1fx replacing objects\n",
+		slotRead.lookupsPerSecond / mapRead.lookupsPerSecond,
+		slotReplacing.lookupsPerSecond / mapReplacing.lookupsPerSecond);
+
+	check(mapRead.misses == 0 && slotRead.misses == 0, "the objects that exist are found");
+	check(mapRead.wrongObjects == 0 && slotRead.wrongObjects == 0 &&
+		mapReplacing.wrongObjects == 0 && slotReplacing.wrongObjects == 0,
+		"the lookups never return another object");
+	if (gFailures != 0) {
+		return 1;
+	}
+	std::printf("Passed\n");
+	return 0;
+}
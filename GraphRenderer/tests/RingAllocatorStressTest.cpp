@@ -0,0 +1,206 @@
+// Stress test of the ring that suballocates the staging memory. Several threads allocate
+// millions of blocks of random sizes and alignments, while another one frees them out of
+// order, as the transfers finish. It does not need a device:
+//   c++ -std=c++17 -O2 -pthread -I../src RingAllocatorStressTest.cpp
+//       ../src/graphics/memory/RingAllocator.cpp -o RingAllocatorStressTest
+// Returns 0 if it passes.
+
+#include "graphics/memory/RingAllocator.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace gr;
+
+namespace
+{
+
+constexpr uint64_t CAPACITY = 1 << 20;
+constexpr uint32_t NUM_ALLOCATING_THREADS = 4;
+constexpr uint32_t BLOCKS_PER_THREAD = 1000000;
+// Most blocks are small, some are a big part of the ring
+constexpr uint64_t MAX_SMALL_BLOCK = 512;
+constexpr uint64_t MAX_BIG_BLOCK = CAPACITY / 4;
+constexpr uint32_t BIG_BLOCK_PERIOD = 1000;
+// Blocks allocated and not freed, that the freeing thread picks from at random
+constexpr size_t MAX_PENDING = 256;
+
+int gFailures = 0;
+
+void check(bool condition, const char* what)
+{
+	if (!condition) {
+		std::printf("FAILED: %s\n", what);
+		gFailures += 1;
+	}
+}
+
+struct Block {
+	vkg::RingAllocator::Allocation allocation;
+	uint64_t numBytes;
+	uint64_t alignment;
+	uint32_t tag;
+};
+
+class Stress
+{
+public:
+
+	Stress() : mRing(new std::atomic<uint32_t>[CAPACITY])
+	{
+		mAllocator.setCapacity(CAPACITY);
+		for (uint64_t i = 0; i < CAPACITY; ++i) {
+			mRing[i].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	void run()
+	{
+		std::vector<std::thread> threads;
+		for (uint32_t t = 0; t < NUM_ALLOCATING_THREADS; ++t) {
+			threads.emplace_back([this, t]() { allocateBlocks(t); });
+		}
+		std::thread freeing([this]() { freeBlocks(); });
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+		mAllocating.store(false, std::memory_order_release);
+		freeing.join();
+
+		check(mAllocator.getUsedBytes() == 0, "all the bytes are reclaimed");
+		check(mBadRanges.load() == 0, "the allocations are aligned and inside the ring");
+		check(mOverlaps == 0, "the allocations in use do not overlap");
+		check(mFreed == NUM_ALLOCATING_THREADS * BLOCKS_PER_THREAD, "all the blocks are freed");
+	}
+
+	uint64_t getRingBytes() const { return mRingBytes; }
+	uint64_t getFullRetries() const { return mFullRetries.load(); }
+
+private:
+
+	vkg::RingAllocator mAllocator;
+	// Tag of the block that owns each byte of the ring
+	std::unique_ptr<std::atomic<uint32_t>[]> mRing;
+	std::atomic<uint32_t> mNextTag{ 1 };
+	std::atomic<bool> mAllocating{ true };
+	std::atomic<uint64_t> mBadRanges{ 0 };
+	std::atomic<uint64_t> mFullRetries{ 0 };
+
+	// Allocated blocks, handed to the freeing thread
+	std::mutex mMutex;
+	std::vector<Block> mAllocated;
+
+	// Only accessed by the freeing thread
+	uint64_t mOverlaps = 0;
+	uint64_t mFreed = 0;
+	uint64_t mRingBytes = 0;
+
+	void allocateBlocks(uint32_t thread)
+	{
+		std::mt19937_64 rng(thread + 1);
+		for (uint32_t i = 0; i < BLOCKS_PER_THREAD; ++i) {
+			Block block;
+			const uint64_t maxBytes = i % BIG_BLOCK_PERIOD == 0 ? MAX_BIG_BLOCK : MAX_SMALL_BLOCK;
+			block.numBytes = 1 + rng() % maxBytes;
+			block.alignment = 1ull << (rng() % 9);
+			// The ring is full until the freeing thread catches up
+			while (!mAllocator.allocate(block.numBytes, block.alignment, &block.allocation)) {
+				mFullRetries.fetch_add(1, std::memory_order_relaxed);
+				std::this_thread::yield();
+			}
+
+			const vkg::RingAllocator::Allocation& a = block.allocation;
+			if (a.offset % block.alignment != 0 || a.offset + block.numBytes > CAPACITY ||
+				a.end - a.begin < block.numBytes || a.end - a.begin > CAPACITY) {
+				mBadRanges.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			// The data written to the block, as the transfers copy theirs
+			block.tag = mNextTag.fetch_add(1, std::memory_order_relaxed);
+			for (uint64_t b = a.offset; b < a.offset + block.numBytes && b < CAPACITY; ++b) {
+				mRing[b].store(block.tag, std::memory_order_relaxed);
+			}
+
+			std::lock_guard<std::mutex> lock(mMutex);
+			mAllocated.push_back(block);
+		}
+	}
+
+	void freeBlocks()
+	{
+		std::mt19937_64 rng(0);
+		std::vector<Block> pending;
+		std::vector<Block> received;
+		for (;;) {
+			const bool allocating = mAllocating.load(std::memory_order_acquire);
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				received.swap(mAllocated);
+			}
+			pending.insert(pending.end(), received.begin(), received.end());
+			received.clear();
+
+			if (pending.empty()) {
+				if (!allocating) {
+					break;
+				}
+				std::this_thread::yield();
+				continue;
+			}
+
+			// Out of order, keeping some blocks in use while the others are freed
+			while (pending.size() > (allocating ? MAX_PENDING : 0)) {
+				const size_t i = rng() % pending.size();
+				freeBlock(pending[i]);
+				pending[i] = pending.back();
+				pending.pop_back();
+			}
+			// Or the ring may be full of pending blocks
+			if (!pending.empty() && rng() % 4 == 0) {
+				freeBlock(pending.front());
+				pending.front() = pending.back();
+				pending.pop_back();
+			}
+		}
+	}
+
+	void freeBlock(const Block& block)
+	{
+		const vkg::RingAllocator::Allocation& a = block.allocation;
+		for (uint64_t b = a.offset; b < a.offset + block.numBytes && b < CAPACITY; ++b) {
+			if (mRing[b].load(std::memory_order_relaxed) != block.tag) {
+				mOverlaps += 1;
+				break;
+			}
+		}
+		mRingBytes += a.end - a.begin;
+		mAllocator.free(a);
+		mFreed += 1;
+	}
+};
+
+} // namespace
+
+int main()
+{
+	const auto start = std::chrono::steady_clock::now();
+	Stress stress;
+	stress.run();
+	const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+	std::printf("%u blocks in %.2fs, %.1f turns of the ring, %llu retries while full\n",
+		NUM_ALLOCATING_THREADS * BLOCKS_PER_THREAD, seconds.count(),
+		static_cast<double>(stress.getRingBytes()) / CAPACITY,
+		static_cast<unsigned long long>(stress.getFullRetries()));
+	if (gFailures != 0) {
+		return 1;
+	}
+	std::printf("Passed\n");
+	return 0;
+}
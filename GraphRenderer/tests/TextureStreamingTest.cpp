@@ -0,0 +1,233 @@
+// Test of the residency of the texture mips under the memory budget, with the policy
+// of the TextureStreamer driven frame by frame as the engine does, without a device:
+//   c++ -std=c++17 -O2 -I../src TextureStreamingTest.cpp
+//       ../src/meshes/TextureProcessing/StreamingPolicy.cpp -o TextureStreamingTest
+// Returns 0 if it passes.
+
+#include "meshes/TextureProcessing/StreamingPolicy.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+using namespace gr;
+
+namespace
+{
+
+// As in TextureStreamer.cpp and Texture.cpp
+constexpr uint32_t MAX_STREAMING_TEXTURES = 4;
+constexpr uint32_t MIP_TAIL_SIZE = 128;
+
+// BC7 textures of 2048x2048, with 12 mips
+constexpr uint32_t TEXTURE_SIZE = 2048;
+constexpr uint32_t NUM_MIPS = 12;
+constexpr uint32_t NUM_TEXTURES = 16;
+// Frames until a streamed image is resident
+constexpr uint64_t STREAM_FRAMES = 2;
+
+int gFailures = 0;
+
+void check(bool condition, const char* what)
+{
+	if (!condition) {
+		std::printf("FAILED: %s\n", what);
+		gFailures += 1;
+	}
+}
+
+// Texture::getMipChainBytes
+uint64_t getMipChainBytes(uint32_t mip)
+{
+	uint64_t bytes = 0;
+	for (; mip < NUM_MIPS; ++mip) {
+		const uint64_t blocks = std::max(1u, (TEXTURE_SIZE >> mip) / 4);
+		bytes += blocks * blocks * 16;
+	}
+	return bytes;
+}
+
+uint32_t getMipTail()
+{
+	uint32_t mip = 0;
+	while ((TEXTURE_SIZE >> mip) > MIP_TAIL_SIZE) {
+		mip += 1;
+	}
+	return mip;
+}
+
+// The state that Texture keeps for the streamer
+struct Texture {
+	uint32_t residentMip = getMipTail();
+	uint64_t lastUsedFrame = 0;
+	uint32_t requestedMip = getMipTail();
+	bool streaming = false;
+	uint32_t streamMip = 0;
+	uint64_t streamResidentFrame = 0;
+};
+
+// TextureStreamer::update, with the textures instead of the dictionary
+class Streamer
+{
+public:
+
+	uint64_t budget = 256ull << 20;
+	// Evicted textures, in order
+	std::vector<uint32_t> evictions;
+	uint32_t maxStreaming = 0;
+
+	void update(std::vector<Texture>& textures, uint64_t frame)
+	{
+		uint64_t usedBytes = 0;
+		uint32_t numStreaming = 0;
+		mStreamable.clear();
+		mStreamed.clear();
+		for (uint32_t i = 0; i < textures.size(); ++i) {
+			Texture& texture = textures[i];
+			// Texture::updateStreaming
+			if (texture.streaming && texture.streamResidentFrame <= frame) {
+				texture.residentMip = texture.streamMip;
+				texture.streaming = false;
+			}
+			usedBytes += getMipChainBytes(texture.residentMip);
+
+			if (texture.streaming) {
+				usedBytes += getMipChainBytes(texture.streamMip);
+				numStreaming += 1;
+			}
+			else {
+				tex::StreamedTexture streamed;
+				streamed.lastUsedFrame = texture.lastUsedFrame;
+				streamed.residentMip = texture.residentMip;
+				streamed.wantedMip = texture.lastUsedFrame == frame ? texture.requestedMip : getMipTail();
+				streamed.residentBytes = getMipChainBytes(streamed.residentMip);
+				streamed.wantedBytes = getMipChainBytes(streamed.wantedMip);
+				mStreamable.push_back(i);
+				mStreamed.push_back(streamed);
+			}
+		}
+
+		mMipStreams.clear();
+		tex::planMipStreams(mStreamed.data(), static_cast<uint32_t>(mStreamed.size()),
+			usedBytes, numStreaming, budget, MAX_STREAMING_TEXTURES, &mUpgrades, &mMipStreams);
+		for (const tex::MipStream& stream : mMipStreams) {
+			Texture& texture = textures[mStreamable[stream.texture]];
+			check(!texture.streaming, "a texture is streamed once at a time");
+			if (stream.mip > texture.residentMip) {
+				check(texture.lastUsedFrame != frame, "the textures drawn in the frame are not evicted");
+				evictions.push_back(mStreamable[stream.texture]);
+			}
+			// Texture::streamMip
+			texture.streaming = true;
+			texture.streamMip = stream.mip;
+			texture.streamResidentFrame = frame + STREAM_FRAMES;
+		}
+		maxStreaming = std::max(maxStreaming, numStreaming + static_cast<uint32_t>(mMipStreams.size()));
+	}
+
+private:
+
+	std::vector<uint32_t> mStreamable;
+	std::vector<tex::StreamedTexture> mStreamed;
+	std::vector<uint32_t> mUpgrades;
+	std::vector<tex::MipStream> mMipStreams;
+};
+
+// Texture::requestScreenSize, for the whole texture on screen
+void draw(Texture* texture, uint64_t frame)
+{
+	texture->requestedMip = 0;
+	texture->lastUsedFrame = frame;
+}
+
+uint64_t getResidentBytes(const std::vector<Texture>& textures)
+{
+	uint64_t bytes = 0;
+	for (const Texture& texture : textures) {
+		bytes += getMipChainBytes(texture.residentMip);
+	}
+	return bytes;
+}
+
+bool isStreaming(const std::vector<Texture>& textures)
+{
+	for (const Texture& texture : textures) {
+		if (texture.streaming) {
+			return true;
+		}
+	}
+	return false;
+}
+
+} // namespace
+
+int main()
+{
+	std::vector<Texture> textures(NUM_TEXTURES);
+	Streamer streamer;
+	uint64_t frame = 1;
+
+	// Within the budget, the textures drawn get all their mips
+	for (; frame < 20; ++frame) {
+		for (uint32_t i = 0; i < NUM_TEXTURES / 2; ++i) {
+			draw(&textures[i], frame);
+		}
+		streamer.update(textures, frame);
+	}
+	for (uint32_t i = 0; i < NUM_TEXTURES; ++i) {
+		check(textures[i].residentMip == (i < NUM_TEXTURES / 2 ? 0 : getMipTail()) && !textures[i].streaming,
+			"the textures drawn within the budget are resident");
+	}
+	check(streamer.evictions.empty(), "nothing is evicted within the budget");
+	check(streamer.maxStreaming <= MAX_STREAMING_TEXTURES, "few textures are streamed at the same time");
+
+	// Over the budget, the textures that are not drawn lose their top mips, the least
+	// recently used first, for the ones drawn now. The textures drawn are never evicted,
+	// so the budget is met once the first half is not drawn
+	streamer.budget = 4 * getMipChainBytes(0) + NUM_TEXTURES * getMipChainBytes(getMipTail());
+	const uint64_t firstFrame = frame;
+	for (; frame < firstFrame + 40; ++frame) {
+		for (uint32_t i = 0; i < NUM_TEXTURES; ++i) {
+			// the first half stops being drawn one after the other, then the second half is drawn
+			if (i < NUM_TEXTURES / 2 ? frame < firstFrame + i : frame >= firstFrame + NUM_TEXTURES / 2) {
+				draw(&textures[i], frame);
+			}
+		}
+		streamer.update(textures, frame);
+		if (frame >= firstFrame + NUM_TEXTURES / 2 && !isStreaming(textures)) {
+			check(getResidentBytes(textures) <= streamer.budget, "the resident mips are within the budget");
+		}
+	}
+	check(!streamer.evictions.empty(), "the textures not drawn are evicted");
+	check(std::is_sorted(streamer.evictions.begin(), streamer.evictions.end()), "the least recently used are evicted first");
+	uint32_t numDrawnResident = 0;
+	for (uint32_t i = 0; i < NUM_TEXTURES; ++i) {
+		if (i < NUM_TEXTURES / 2) {
+			check(textures[i].residentMip == getMipTail(), "the textures not drawn are back to the mip tail");
+		}
+		else if (textures[i].residentMip == 0) {
+			numDrawnResident += 1;
+		}
+	}
+	check(numDrawnResident == 4, "the drawn textures fill the budget");
+	check(streamer.maxStreaming <= MAX_STREAMING_TEXTURES, "few textures are streamed at the same time");
+
+	// Once the budget is reduced, the textures not drawn are evicted until they fit
+	const size_t numEvictions = streamer.evictions.size();
+	streamer.budget = NUM_TEXTURES * getMipChainBytes(getMipTail());
+	for (const uint64_t lastFrame = frame + 10; frame < lastFrame; ++frame) {
+		streamer.update(textures, frame);
+	}
+	check(getResidentBytes(textures) <= streamer.budget && !isStreaming(textures),
+		"the resident mips are within the reduced budget");
+	check(streamer.evictions.size() - numEvictions == 4, "the mips over the reduced budget are evicted");
+
+	std::printf("%zu evictions, %u textures streamed at the same time, %llu KB resident\n",
+		streamer.evictions.size(), streamer.maxStreaming,
+		static_cast<unsigned long long>(getResidentBytes(textures) >> 10));
+	if (gFailures != 0) {
+		return 1;
+	}
+	std::printf("Passed\n");
+	return 0;
+}